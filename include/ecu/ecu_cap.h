@@ -0,0 +1,160 @@
+#pragma once
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Файл записи трафика (capture), только дозапись. Всё little-endian.
+//
+//   [заголовок файла ECU_CAP_HDR_SIZE байт][блок 0][блок 1]...
+//
+// Блок — block_size байт (кратно 4096): заголовок блока и записи подряд, хвост заполнен нулями.
+// Блоки пишутся целиком по выровненным смещениям (O_DIRECT, где ФС позволяет), поэтому
+// блок k всегда лежит по смещению ECU_CAP_HDR_SIZE + k * block_size, а его заголовок —
+// индекс: время первой и последней записи. Поиск по времени — двоичный по заголовкам блоков,
+// без чтения записей. Недописанный последний блок (сбой питания) виден по полю used.
+
+#define ECU_CAP_MAGIC       "ECUCAP\0\1"
+#define ECU_CAP_VERSION     1u
+#define ECU_CAP_HDR_SIZE    4096u
+#define ECU_CAP_ALIGN       4096u
+#define ECU_CAP_BLOCK_MAGIC 0x314B4345u   // "ECK1"
+#define ECU_CAP_PORTS       16
+#define ECU_CAP_NAME_MAX    16
+
+typedef struct {
+    char     magic[8];        // ECU_CAP_MAGIC
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t mono_ns;         // CLOCK_MONOTONIC при открытии файла
+    uint64_t real_ns;         // CLOCK_REALTIME в тот же момент (перевод меток в дату)
+    uint32_t file_no;         // номер файла в сессии (ротация)
+    uint32_t reserved;
+    char     uart[ECU_CAP_PORTS][ECU_CAP_NAME_MAX];   // имена UART по индексу порта
+} ecu_cap_file_hdr_t;
+
+typedef struct {
+    uint32_t magic;           // ECU_CAP_BLOCK_MAGIC
+    uint32_t seq;             // номер блока в файле
+    uint64_t first_ns;        // метка первой записи
+    uint64_t last_ns;         // метка последней записи
+    uint32_t records;
+    uint32_t used;            // байт блока занято (с заголовком)
+} ecu_cap_block_t;
+
+// Порт записи
+#define ECU_CAP_PORT_NET      0x80u   // | слот клиента
+#define ECU_CAP_PORT_NET_ALL  0xFEu   // рассылка всем клиентам
+#define ECU_CAP_PORT_NONE     0xFFu   // иначе — индекс UART
+
+// Направление
+#define ECU_CAP_RX 0u   // принято шлюзом
+#define ECU_CAP_TX 1u   // отдано шлюзом
+
+// Флаги
+#define ECU_CAP_F_RAW   (1u << 0)   // байты с линии как есть (SLIP/поток TCP)
+#define ECU_CAP_F_FRAME (1u << 1)   // целый ECU кадр
+#define ECU_CAP_F_FWD   (1u << 2)   // кадр переслан UART -> UART
+
+// Запись: заголовок и len байт данных, выровнено до 8
+typedef struct {
+    uint64_t ts_ns;           // CLOCK_MONOTONIC
+    uint16_t len;
+    uint8_t  port;            // ECU_CAP_PORT_*
+    uint8_t  dir;             // ECU_CAP_RX/TX
+    uint16_t flags;           // ECU_CAP_F_*
+    uint16_t reserved;
+} ecu_cap_rec_t;
+
+_Static_assert(sizeof(ecu_cap_file_hdr_t) <= ECU_CAP_HDR_SIZE, "cap file header too big");
+_Static_assert(sizeof(ecu_cap_block_t) == 32, "cap block header size must be 32");
+_Static_assert(sizeof(ecu_cap_rec_t) == 16, "cap record header size must be 16");
+
+#define ECU_CAP_REC_SIZE(len) ((sizeof(ecu_cap_rec_t) + (size_t)(len) + 7u) & ~(size_t)7u)
+
+// Запись файлов (один поток). Файлы <prefix>-YYYYMMDD-HHMMSS.ecap, новый — по размеру/времени.
+typedef struct {
+    char     prefix[96];
+    char     path[128];       // текущий файл
+    uint32_t block_size;
+    uint64_t max_bytes;       // размер файла до ротации (0 = без ограничения)
+    uint64_t max_ns;          // длительность файла до ротации (0 = без ограничения)
+    unsigned max_files;       // хранить последних файлов (0 = все)
+    char     uart[ECU_CAP_PORTS][ECU_CAP_NAME_MAX];
+
+    int      fd;              // -1 = закрыт
+    int      direct;          // файл открыт с O_DIRECT
+    uint8_t* blk;             // текущий блок (выровнен)
+    uint8_t* hdr;             // заголовок файла (выровнен)
+    uint32_t blk_no;          // номер текущего блока в файле
+    uint64_t file_start_ns;
+    uint32_t file_no;
+    char     (*history)[128]; // кольцо путей для max_files
+    unsigned hist_head;
+    int      err;             // errno последней ошибки (запись остановлена)
+
+    // статистика (читается из других потоков)
+    _Atomic uint32_t records;
+    _Atomic uint32_t blocks;  // блоков записано полностью
+    _Atomic uint32_t files;
+} ecu_cap_t;
+
+// Подготовить запись; файл создаётся при первой записи. block_kb — размер блока в КБ (кратно 4).
+// 0 = OK, -1 = ошибка
+int  ecu_cap_open(ecu_cap_t* c, const char* prefix, unsigned block_kb, uint64_t max_bytes,
+                  uint32_t max_sec, unsigned max_files);
+
+// Имя UART для заголовка файлов (до первой записи)
+void ecu_cap_set_uart(ecu_cap_t* c, unsigned idx, const char* name);
+
+// Добавить запись; len > блока обрезается. 0 = OK, -1 = ошибка записи (c->err)
+int  ecu_cap_write(ecu_cap_t* c, uint64_t ts_ns, unsigned port, unsigned dir, unsigned flags,
+                   const uint8_t* data, size_t len);
+
+// Дописать неполный текущий блок на место (он будет перезаписан, когда заполнится).
+// Вызывается периодически — при сбое теряется не больше периода. 0 = OK, -1 = ошибка
+int  ecu_cap_sync(ecu_cap_t* c);
+
+// Дописать и закрыть
+void ecu_cap_close(ecu_cap_t* c);
+
+// Чтение: заголовки блоков читаются по смещениям, записи — из буфера блока
+typedef struct {
+    int                fd;
+    ecu_cap_file_hdr_t hdr;
+    uint32_t           blocks;    // блоков в файле (последний может быть неполным)
+    const uint8_t*     map;       // ecu_cap_map: файл целиком (NULL = не отображён)
+    size_t             map_len;
+} ecu_cap_reader_t;
+
+// 0 = OK, -1 = ошибка (errno; EINVAL — не файл capture)
+int  ecu_cap_reader_open(ecu_cap_reader_t* r, const char* path);
+void ecu_cap_reader_close(ecu_cap_reader_t* r);
+
+// Заголовок блока idx. 0 = OK, -1 = ошибка/блок пуст
+int  ecu_cap_read_block_hdr(ecu_cap_reader_t* r, uint32_t idx, ecu_cap_block_t* out);
+
+// Блок целиком в buf (hdr.block_size байт). 0 = OK, -1 = ошибка/блок испорчен
+int  ecu_cap_read_block(ecu_cap_reader_t* r, uint32_t idx, uint8_t* buf);
+
+// Первый блок, в котором есть записи с меткой >= ts_ns (двоичный поиск по заголовкам).
+// r->blocks = таких нет
+uint32_t ecu_cap_seek(ecu_cap_reader_t* r, uint64_t ts_ns);
+
+// Отобразить файл в память (только чтение): блоки без копирования через ecu_cap_block_at,
+// из нескольких потоков сразу. Снимается в ecu_cap_reader_close. 0 = OK, -1 = ошибка (errno)
+int  ecu_cap_map(ecu_cap_reader_t* r);
+
+// Блок idx в отображении. NULL = блок пуст, испорчен или оборван (записи за концом файла)
+const uint8_t* ecu_cap_block_at(const ecu_cap_reader_t* r, uint32_t idx);
+
+// Следующая запись блока: *off — смещение в блоке (начать с sizeof(ecu_cap_block_t)).
+// NULL = записей больше нет
+const ecu_cap_rec_t* ecu_cap_next(const uint8_t* blk, uint32_t block_size, uint32_t* off);
+
+#ifdef __cplusplus
+}
+#endif
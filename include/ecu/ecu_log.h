@@ -0,0 +1,166 @@
+#pragma once
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ecu/ecu_cap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Бинарный журнал кадров. Писатели (любые потоки) копируют кадр в запись фиксированного
+// размера в заранее выделенном кольце — без блокировок, без форматирования и системных вызовов.
+// Отдельный поток с низким приоритетом (SCHED_IDLE) вычитывает кольцо и печатает записи
+// текстом и/или пишет их в двоичном виде в файл/сокет. Если он не успевает, новые записи
+// отбрасываются (ecu_log_drops), писатели не ждут никогда.
+//
+// Tap — Unix сокет SOCK_SEQPACKET для внешних мониторов (tools/gw_dump). Пакет — пачка целых
+// записей в двоичном виде. Отправка без ожидания: если читатель отстал и буфер его сокета полон,
+// пакет для него отбрасывается ядром (EAGAIN), а следующему предшествует запись ECU_LOG_LOST.
+// Пока других приёмников нет и к tap никто не подключён, ecu_log_write сразу возвращается.
+//
+// Capture — файлы ecu/ecu_cap.h: те же записи с меткой в нс, портом и направлением, блоками.
+
+#define ECU_LOG_SNAP 1056   // байт данных в записи: целый ECU кадр (1042) с запасом
+
+// Что и где увидели
+typedef enum {
+    ECU_LOG_RAW_UART = 1,   // сырые байты из UART
+    ECU_LOG_RAW_NET  = 2,   // сырые байты от клиента
+    ECU_LOG_RX_UART  = 3,   // ECU кадр из UART (после SLIP)
+    ECU_LOG_RX_NET   = 4,   // ECU кадр от клиента
+    ECU_LOG_TX_NET   = 5,   // кадр UART разослан клиентам
+    ECU_LOG_TX_UART  = 6,   // кадр клиента поставлен на UART
+    ECU_LOG_FWD_UART = 7,   // кадр переслан UART -> UART
+    ECU_LOG_TEST     = 8,   // тестовый кадр (-send_test)
+    ECU_LOG_LOST     = 9,   // tap: читатель пропустил записи, data = u32 число
+} ecu_log_kind_t;
+
+#define ECU_LOG_PORT_NONE 0xFFu
+
+// Маски видов для текстового приёмника (ecu_log_start)
+#define ECU_LOG_KIND_BIT(k)  (1u << (k))
+#define ECU_LOG_KINDS_RAW    (ECU_LOG_KIND_BIT(ECU_LOG_RAW_UART) | ECU_LOG_KIND_BIT(ECU_LOG_RAW_NET))
+#define ECU_LOG_KINDS_ALL    0xFFFFFFFFu
+#define ECU_LOG_KINDS_FRAMES (ECU_LOG_KINDS_ALL & ~ECU_LOG_KINDS_RAW)
+
+#define ECU_LOG_TAP_READERS 4   // одновременных читателей tap
+
+// Запись. В двоичном потоке — заголовок (ECU_LOG_REC_HDR байт, little-endian) и cap_len байт данных
+typedef struct {
+    uint64_t ts_us;     // CLOCK_MONOTONIC, мкс
+    uint16_t len;       // исходная длина (может быть больше cap_len)
+    uint16_t cap_len;   // сохранено байт
+    uint8_t  kind;      // ecu_log_kind_t
+    uint8_t  port;      // индекс UART / слот клиента, ECU_LOG_PORT_NONE = нет
+    uint16_t reserved;
+    uint8_t  data[ECU_LOG_SNAP];
+} ecu_log_rec_t;
+
+#define ECU_LOG_REC_HDR offsetof(ecu_log_rec_t, data)
+
+typedef struct {
+    _Atomic uint32_t seq;   // номер позиции, для которой слот свободен/заполнен
+    ecu_log_rec_t    rec;
+} ecu_log_slot_t;
+
+typedef struct {
+    // писатели
+    alignas(64) _Atomic uint32_t head;
+    _Atomic uint32_t drops;       // записей не поместилось
+    atomic_int       idle;        // приёмников нет — записи не нужны (ставит поток вычитывания)
+
+    // читатель
+    alignas(64) uint32_t tail;
+    _Atomic uint32_t written;     // записей отдано приёмникам
+    _Atomic uint32_t tap_drops;   // записей не досталось читателям tap (буфер сокета полон)
+
+    alignas(64) ecu_log_slot_t* slots;
+    uint32_t mask;                // records - 1
+
+    // поток вычитывания (ecu_log_start)
+    FILE*       text;             // текстовый дамп (NULL = нет)
+    uint32_t    text_kinds;       // ECU_LOG_KIND_BIT() видов для text
+    int         bin_fd;           // двоичные записи (-1 = нет)
+    ecu_cap_t*  cap;              // файлы capture (NULL = нет; ошибка записи отключает)
+    uint64_t    cap_sync_ns;      // когда дописан неполный блок
+    uint8_t*    bin_buf;          // пачка двоичных записей до write()
+    size_t      bin_len;
+    int         tap_fd;           // слушающий сокет tap (-1 = нет)
+    int         tap_reader[ECU_LOG_TAP_READERS];   // -1 = свободно
+    uint32_t    tap_lost[ECU_LOG_TAP_READERS];     // пропущено читателем с последнего пакета
+    atomic_int  tap_readers;      // подключено читателей
+    uint8_t*    tap_buf;          // пакет tap
+    size_t      tap_len;
+    char        tap_path[108];
+    pthread_t   thread;
+    int         running;
+    atomic_int  stop;
+} ecu_log_t;
+
+// records округляется вверх до степени двойки. 0 = OK, -1 = нет памяти
+int  ecu_log_init(ecu_log_t* l, size_t records);
+
+// Остановить поток (если запущен) и освободить кольцо
+void ecu_log_free(ecu_log_t* l);
+
+// Записать (любой поток). Кадр длиннее ECU_LOG_SNAP обрезается, сырые байты
+// (ECU_LOG_KINDS_RAW) пишутся несколькими записями подряд.
+// 0 = OK (или приёмников сейчас нет), -1 = кольцо полно (запись отброшена и посчитана)
+int  ecu_log_write(ecu_log_t* l, unsigned kind, unsigned port, uint64_t ts_us,
+                   const uint8_t* data, size_t len);
+
+// Один читатель: первая запись без извлечения (NULL = пусто), затем ecu_log_pop()
+const ecu_log_rec_t* ecu_log_peek(ecu_log_t* l);
+void ecu_log_pop(ecu_log_t* l);
+
+static inline uint32_t ecu_log_drops(const ecu_log_t* l)
+{
+    return atomic_load_explicit((_Atomic uint32_t*)&l->drops, memory_order_relaxed);
+}
+
+static inline uint32_t ecu_log_written(const ecu_log_t* l)
+{
+    return atomic_load_explicit((_Atomic uint32_t*)&l->written, memory_order_relaxed);
+}
+
+static inline uint32_t ecu_log_tap_drops(const ecu_log_t* l)
+{
+    return atomic_load_explicit((_Atomic uint32_t*)&l->tap_drops, memory_order_relaxed);
+}
+
+// Открыть tap: слушающий сокет path (старый файл сокета удаляется). До ecu_log_start.
+// 0 = OK, -1 = ошибка (errno)
+int  ecu_log_tap(ecu_log_t* l, const char* path);
+
+// Писать записи в capture (до ecu_log_start). Закрывает cap вызывающий — после ecu_log_stop
+void ecu_log_capture(ecu_log_t* l, ecu_cap_t* cap);
+
+// Порт, направление и флаги capture для записи вида kind. 0 = OK, -1 = вид в capture не пишется
+int  ecu_log_cap_port(unsigned kind, unsigned port, unsigned* cap_port, unsigned* dir, unsigned* flags);
+
+// Запустить поток вычитывания: text — текстовый дамп видов text_kinds, bin_fd — двоичные записи
+// (файл или сокет; ошибка записи отключает приёмник). 0 = OK, -1 = ошибка
+int  ecu_log_start(ecu_log_t* l, FILE* text, uint32_t text_kinds, int bin_fd);
+
+// Остановить поток, дописав всё, что есть в кольце; закрыть tap
+void ecu_log_stop(ecu_log_t* l);
+
+static inline int ecu_log_tap_readers(const ecu_log_t* l)
+{
+    return atomic_load_explicit((atomic_int*)&l->tap_readers, memory_order_relaxed);
+}
+
+// Напечатать запись одной строкой: "<ts> <KIND> [<port>] len=N: XX XX ..."
+void ecu_log_print(FILE* out, const ecu_log_rec_t* r);
+
+// Имя вида записи ("RX UART", ...)
+const char* ecu_log_kind_name(unsigned kind);
+
+#ifdef __cplusplus
+}
+#endif
@@ -60,5 +60,10 @@ int ecu_frame_check_crc(const ecu_hdr_t* h, const uint8_t* payload, uint16_t crc
 // Считать CRC
 uint16_t ecu_frame_calc_crc2(const ecu_hdr_t* h, const uint8_t* payload);
 
+// Собрать кадр header+payload+crc в out (h->payload_len должен быть заполнен).
+// Возвращает длину кадра, или 0 если out_cap мало.
+size_t ecu_frame_pack(const ecu_hdr_t* h, const uint8_t* payload, uint8_t* out, size_t out_cap);
 
-
+// Проверить кадр целиком (заголовок, длина, CRC). 1 = OK (hdr/payload указывают в frame), 0 = bad
+int ecu_frame_validate(const uint8_t* frame, size_t frame_len,
+                       const ecu_hdr_t** out_hdr, const uint8_t** out_payload);
@@ -20,11 +20,13 @@ typedef struct {
     int       in_frame;  // видели ли начало (не обязательно, но удобно)
     size_t    frames;    // счётчик принятых кадров
     size_t    drops;     // переполнения/сбросы
+    size_t    consumed;  // сколько входных байт обработал последний slip_rx_push
 } slip_rx_t;
 
 void   slip_rx_init(slip_rx_t* s, uint8_t* out_buf, size_t out_cap);
 
-// Пушим входные байты.
+// Пушим входные байты. Обработка останавливается на конце кадра/ошибке,
+// число обработанных байт — в s->consumed (остаток нужно передать следующим вызовом).
 // Возвращает:
 //  0  - кадр не завершён
 //  1  - кадр завершён, длина в *frame_len (out_len), данные в out[]
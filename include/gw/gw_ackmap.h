@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Команды клиентов с ECU_F_ACK_REQUIRED уходят узлу со своим seq шлюза (по счётчику на узел),
+// шлюз помнит (узел, seq шлюза) -> (клиент, seq клиента). ACK узла идёт только этому клиенту
+// с его исходным seq, остальные клиенты его не получают.
+// Запись снимается первым совпавшим ACK (повтор ACK уже рассылается всем) или отключением клиента,
+// иначе живёт, пока её место не займёт команда на GW_ACKMAP_SLOTS позже. Кадры узел -> узел
+// (пересылка UART -> UART) записи не трогают: ACK на них идёт узлу-отправителю, а не шлюзу.
+
+#define GW_ACKMAP_NODES 256
+#define GW_ACKMAP_SLOTS 256   // неподтверждённых команд на узел (место — младшие биты seq шлюза)
+
+typedef struct {
+    uint32_t client_id;   // gw_net_client_t.id, 0 = пусто
+    uint16_t gw_seq;
+    uint16_t client_seq;
+} gw_ackmap_ent_t;
+
+typedef struct {
+    uint16_t        next_seq;   // следующий seq шлюза этому узлу (0 пропускается)
+    gw_ackmap_ent_t ent[GW_ACKMAP_SLOTS];
+} gw_ackmap_node_t;
+
+typedef struct {
+    gw_ackmap_node_t* node[GW_ACKMAP_NODES];  // таблица узла — при первой команде с ACK
+
+    uint32_t mapped;      // команд отправлено с seq шлюза
+    uint32_t overwritten; // место заняла новая команда раньше, чем пришёл ACK
+    uint32_t forgotten;   // снято без ACK: клиент отключился
+    uint32_t routed;      // ACK доставлено клиенту-отправителю
+    uint32_t orphaned;    // отправителя уже нет, запись не успели снять — ACK никому
+    uint32_t unmatched;   // ACK без записи — разослан всем, как раньше
+} gw_ackmap_t;
+
+// seq шлюза для следующей команды узлу (счётчик не двигается до gw_ackmap_put).
+// 0 = нет памяти: команду с ACK отправить нельзя (ACK некому вернуть)
+uint16_t gw_ackmap_next(gw_ackmap_t* m, uint8_t node);
+
+// Команда ушла узлу с seq gw_ackmap_next(): запомнить отправителя
+void gw_ackmap_put(gw_ackmap_t* m, uint8_t node, uint16_t gw_seq, uint32_t client_id, uint16_t client_seq);
+
+// ACK от узла с ack_seq = gw_seq. 1 = найден (*client_id, *client_seq), запись снята; 0 = записи нет
+int  gw_ackmap_take(gw_ackmap_t* m, uint8_t node, uint16_t gw_seq, uint32_t* client_id,
+                    uint16_t* client_seq);
+
+// Клиент client_id отключился: снять все его записи
+void gw_ackmap_drop_client(gw_ackmap_t* m, uint32_t client_id);
+
+void gw_ackmap_free(gw_ackmap_t* m);
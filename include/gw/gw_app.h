@@ -1,2 +1,16 @@
 #pragma once
-int gw_app_run(int show_packets, int preview_raw, const char* send_test_ports, const char* cmd_ui_port);
+
+typedef struct {
+    const char* config_path;      // NULL = GW_CONFIG_PATH_DEFAULT, если файл существует
+    int         show_packets;     // -show
+    int         preview_raw;      // -prev_show
+    const char* send_test_ports;  // -send_test PORT
+    double      send_time_s;      // -send_time SEC: поток кадров вместо одного HEARTBEAT
+    double      send_rate;        // -send_rate HZ (0 = сколько примет линия)
+    unsigned    send_size;        // -send_size BYTES: payload кадра
+    const char* send_loop;        // -send_loop self|A:B,...: проверять приём в петле
+    const char* cmd_ui_port;      // -cmd_ui PORT
+    const char* trace_path;       // -trace FILE: двоичный журнал кадров (ecu/ecu_log.h)
+} gw_app_opts_t;
+
+int gw_app_run(const gw_app_opts_t* opts);
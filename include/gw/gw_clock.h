@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+// CLOCK_MONOTONIC в микросекундах, прочитанный в начале такта цикла событий.
+// Отметки времени кадров (задержки, пачки клиентов) берут gw_clock_now() — без системного
+// вызова на кадр; точность — длительность такта. У каждого потока своё значение.
+extern __thread uint64_t gw_clock_tick_us;
+
+static inline uint64_t gw_clock_read_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000u) + ((uint64_t)ts.tv_nsec / 1000u);
+}
+
+// Прочитать часы (после epoll_wait/io_uring_enter) и запомнить для всего такта
+static inline uint64_t gw_clock_tick(void)
+{
+    gw_clock_tick_us = gw_clock_read_us();
+    return gw_clock_tick_us;
+}
+
+// Время текущего такта вызывающего потока
+static inline uint64_t gw_clock_now(void)
+{
+    return gw_clock_tick_us;
+}
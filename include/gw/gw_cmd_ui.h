@@ -1,3 +1,6 @@
 #pragma once
 
-int gw_cmd_ui_run(const char* port_name, int show_packets, int preview_raw);
+#include "gw/gw_config.h"
+
+// PORT — имя UART из конфигурации (ttyS1, ttyS4, ttyS5 по умолчанию)
+int gw_cmd_ui_run(const gw_config_t* cfg, const char* port_name, int show_packets, int preview_raw);
@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "gw/gw_router.h"
+
+#ifndef GW_CONFIG_PATH_DEFAULT
+#define GW_CONFIG_PATH_DEFAULT "/etc/ecu_gw.conf"
+#endif
+
+// Значения по умолчанию (если в файле не заданы)
+#define GW_CFG_TCP_PORT        9100
+#define GW_CFG_BAUD            115200
+#define GW_CFG_MAX_CLIENTS     8
+#define GW_CFG_CLIENT_RX_BUF   8192
+#define GW_CFG_CLIENT_TX_BUF   65536
+#define GW_CFG_UART_RX_BUF     4096
+#define GW_CFG_UART_TX_QUEUE   8192
+#define GW_CFG_CMD_BURST       4096
+#define GW_CFG_TICK_MS         100
+#define GW_CFG_RING_SLOTS      256
+
+// [gateway] backend — цикл событий
+#define GW_BACKEND_EPOLL       0
+#define GW_BACKEND_IO_URING    1
+
+// [capture]
+#define GW_CFG_CAP_MAX_MB      64
+#define GW_CFG_CAP_MAX_SEC     3600
+#define GW_CFG_CAP_BLOCK_KB    64
+
+#define GW_CFG_NAME_MAX        16
+#define GW_CFG_PATH_MAX        64
+
+typedef struct {
+    char   name[GW_CFG_NAME_MAX];     // ttyS1
+    char   dev_path[GW_CFG_PATH_MAX]; // /dev/ttyS1
+    int    baud;
+    size_t rx_buf;                    // байт сырого RX накопителя
+    size_t tx_queue;                  // байт каждой полосы TX очереди
+    int    cpu;                       // ядро потока UART в режиме threads (-1 = любое)
+    int    conflate;                  // GW_UART_CONFLATE_*: слияние ждущих команд узлу
+    uint32_t cmd_rate;                // байт/с кадров от каждого клиента в этот UART (0 = без ограничения)
+    uint32_t cmd_burst;               // байт, которые клиент может поставить разом (ёмкость корзины)
+} gw_uart_cfg_t;
+
+typedef struct {
+    // [gateway]
+    uint32_t tick_ms;         // таймаут epoll_wait (период ageing/таймеров)
+    uint32_t route_age_ms;    // время жизни выученной привязки
+    int      threads;         // 1 = поток на каждый UART (меняется только перезапуском)
+    size_t   ring_slots;      // кадров в кольцах между потоками UART и сетевым потоком
+    int      net_cpu;         // ядро сетевого потока в режиме threads (-1 = любое)
+    int      backend;         // GW_BACKEND_* (меняется только перезапуском)
+    char     tap_path[GW_CFG_PATH_MAX]; // сокет tap для внешних мониторов ("" = нет, только перезапуском)
+
+    // [net]
+    uint16_t tcp_port;
+    int      max_clients;
+    size_t   client_rx_buf;
+    size_t   client_tx_buf;   // очередь кадров UART->NET на клиента
+    uint32_t tx_batch_us;     // задержка отправки клиентам для накопления пачки (0 = сразу)
+
+    // [capture] — запись трафика в файлы (ecu/ecu_cap.h), меняется только перезапуском
+    char     cap_prefix[GW_CFG_PATH_MAX];   // <prefix>-YYYYMMDD-HHMMSS.ecap ("" = нет)
+    uint32_t cap_max_mb;      // размер файла до ротации (0 = без ограничения)
+    uint32_t cap_max_sec;     // длительность файла до ротации (0 = без ограничения)
+    uint32_t cap_files;       // хранить последних файлов сессии (0 = все)
+    uint32_t cap_block_kb;    // блок файла (единица записи и индекса по времени)
+
+    // [uart NAME]
+    int           uart_count;
+    gw_uart_cfg_t uarts[GW_UART_MAX];
+
+    // статические привязки node -> индекс UART (-1 = нет); nodes = ... в секции [uart NAME]
+    int16_t node_uart[GW_ROUTER_NODES];
+} gw_config_t;
+
+// Заполнить значения по умолчанию: ttyS1/ttyS4/ttyS5 @ 115200, узлы 1/2/3, TCP 9100
+void gw_config_defaults(gw_config_t* c);
+
+// Прочитать файл поверх значений по умолчанию.
+// Возвращает 0 = OK, -1 = ошибка (текст в err, включая номер строки)
+int  gw_config_load(gw_config_t* c, const char* path, char* err, size_t err_len);
+
+// Найти UART по имени (ttyS1), пути (/dev/ttyS1) или номеру (1). Индекс или -1
+int  gw_config_find_uart(const gw_config_t* c, const char* token);
+
+// Первый узел, статически привязанный к UART (для кадров, которые формирует шлюз)
+uint8_t gw_config_uart_node(const gw_config_t* c, int uart_idx);
+
+// Напечатать действующую конфигурацию
+void gw_config_dump(const gw_config_t* c, FILE* out);
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Счётчик статистики без блокировок. У каждого счётчика ровно один писатель — поток,
+// которому принадлежит порт (в режиме threads — поток UART), читать можно из любого потока.
+// Поэтому прибавление — обычные load/store (relaxed), без атомарного read-modify-write:
+// на горячем пути это те же две инструкции, что и у простого ++.
+// 32 бита, переполняются по кругу — скорость считать по разности двух снимков.
+typedef atomic_uint gw_counter_t;
+
+static inline void gw_counter_add(gw_counter_t* c, uint32_t v)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+// Максимум (high-water mark)
+static inline void gw_counter_max(gw_counter_t* c, uint32_t v)
+{
+    if (v > atomic_load_explicit(c, memory_order_relaxed)) atomic_store_explicit(c, v, memory_order_relaxed);
+}
+
+static inline uint32_t gw_counter_get(const gw_counter_t* c)
+{
+    return atomic_load_explicit((gw_counter_t*)c, memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ecu/ecu_proto.h"
+#include "gw/gw_latency.h"
+#include "gw/gw_metrics.h"
+#include "gw/gw_net.h"
+#include "gw/gw_router.h"
+#include "gw/gw_sched.h"
+
+// Управление шлюзом по TCP: COMMAND с dst = ECU_NODE_GW (255).
+// command_id начинаются с 0x0100, чтобы не пересекаться с командами узлов (1..8).
+// Ответ приходит только запросившему клиенту:
+//  - ноль или больше EVENT кадров src=GW, event_code = command_id, data = ответ;
+//  - затем ACK (если в запросе стоит ACK_REQUIRED), status_code как у узлов.
+#define GW_CTL_GET_ROUTES   0x0101u  // таблица маршрутов node -> UART
+#define GW_CTL_GET_FWD      0x0102u  // счётчики прямой пересылки UART -> UART
+#define GW_CTL_GET_STATS    0x0103u  // реестр счётчиков: записи gw_metrics_rec_t (gw/gw_metrics.h);
+                                     // param[0] (необязательный) — вид GW_METRICS_*, 0 = все
+#define GW_CTL_GET_LATENCY  0x0104u  // гистограммы задержек: записи gw_latency_rec_t (gw/gw_latency.h);
+                                     // param[0] (необязательный) — GW_LAT_SCOPE_*, 0 = все
+#define GW_CTL_RESET_LATENCY 0x0105u // обнулить гистограммы задержек, EVENT без данных
+#define GW_CTL_SUBSCRIBE    0x0106u  // подписка этого соединения: param[0] — GW_NET_SUB_*;
+                                     // EVENT data[0] = действующий режим
+#define GW_CTL_SCHEDULE     0x0107u  // отложенная команда: param = gw_ctl_sched_req_t + кадр ECU;
+                                     // EVENT gw_ctl_sched_rec_t сразу (QUEUED) и в срок (SENT/DROPPED)
+
+// Запись ответа GW_CTL_GET_ROUTES (data EVENT = массив записей)
+typedef struct ECU_PACKED {
+    uint8_t  node_id;
+    uint8_t  uart;        // индекс UART в конфигурации
+    uint8_t  flags;       // GW_ROUTE_F_*
+    uint8_t  reserved;
+    uint32_t age_ms;      // 0xFFFFFFFF для статической привязки
+    uint32_t rx_frames;
+} gw_ctl_route_rec_t;
+
+_Static_assert(sizeof(gw_ctl_route_rec_t) == 12, "ctl route rec size must be 12");
+
+// Запись ответа GW_CTL_GET_FWD (только ненулевые пары)
+typedef struct ECU_PACKED {
+    uint8_t  from_uart;
+    uint8_t  to_uart;
+    uint16_t reserved;
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t drops;
+} gw_ctl_fwd_rec_t;
+
+_Static_assert(sizeof(gw_ctl_fwd_rec_t) == 16, "ctl fwd rec size must be 16");
+
+// Параметры GW_CTL_SCHEDULE; за ними — целый кадр ECU (заголовок, payload, CRC) узлу за UART.
+// Кадр уходит как есть, без DRR и токенов cmd_rate; с ECU_F_ACK_REQUIRED ACK узла вернётся
+// поставившему клиенту с seq кадра (gw_ackmap). Очередь полна — ACK со status_code 3
+typedef struct ECU_PACKED {
+    uint8_t  clock;       // GW_SCHED_CLOCK_*
+    uint8_t  reserved[3];
+    uint64_t at_ms;       // срок; прошедший — отправить сразу
+} gw_ctl_sched_req_t;
+
+_Static_assert(sizeof(gw_ctl_sched_req_t) == 12, "ctl sched req size must be 12");
+
+// Состояние задания в EVENT GW_CTL_SCHEDULE
+#define GW_CTL_SCHED_QUEUED  0u   // поставлено в очередь
+#define GW_CTL_SCHED_SENT    1u   // в срок поставлено в TX очередь UART
+#define GW_CTL_SCHED_DROPPED 2u   // в срок некуда отправить (нет маршрута, кадр не встаёт в UART)
+
+// Данные EVENT GW_CTL_SCHEDULE. now_us из ответа QUEUED — часы шлюза для сроков GW_SCHED_CLOCK_MONO
+typedef struct ECU_PACKED {
+    uint32_t id;          // номер задания
+    uint8_t  state;       // GW_CTL_SCHED_*
+    uint8_t  uart;        // SENT: индекс UART
+    uint16_t pending;     // заданий в очереди
+    uint64_t at_us;       // срок, CLOCK_MONOTONIC шлюза
+    uint64_t now_us;      // CLOCK_MONOTONIC шлюза при постановке/отправке
+    uint32_t late_us;     // SENT/DROPPED: now_us - at_us (опоздание отправки)
+    uint32_t reserved;
+} gw_ctl_sched_rec_t;
+
+_Static_assert(sizeof(gw_ctl_sched_rec_t) == 32, "ctl sched rec size must be 32");
+
+typedef struct {
+    gw_net_t*          net;
+    const gw_router_t* router;
+    uint16_t*          gw_seq;    // счётчик seq кадров, которые формирует шлюз
+    const struct gw_state* state; // для GW_CTL_GET_STATS
+    gw_sched_t*        sched;     // для GW_CTL_SCHEDULE
+    uint64_t           now_us;    // CLOCK_MONOTONIC
+} gw_ctl_ctx_t;
+
+// Обработать кадр, адресованный шлюзу, от клиента client_fd.
+// Возвращает 1 = обработан, 0 = не команда управления (игнор), -1 = ошибка отправки ответа
+int gw_ctl_handle(gw_ctl_ctx_t* ctx, int client_fd, const ecu_hdr_t* h, const uint8_t* payload);
+
+// EVENT от шлюза клиенту client_fd вне ответа на запрос (отчёт GW_CTL_SCHEDULE). 0 = OK, -1 = ошибка
+int gw_ctl_event(gw_ctl_ctx_t* ctx, int client_fd, uint16_t code, const uint8_t* data, size_t data_len);
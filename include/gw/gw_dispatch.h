@@ -0,0 +1,47 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gw/gw_state.h"
+
+// Обработка кадров, общая для циклов событий epoll (gw_app.c) и io_uring (gw_uring_loop.c):
+// циклы только доставляют байты в rx_buf UART/клиентов и отправляют накопленные очереди.
+
+// Запись в журнал кадров (-show / -prev_show / -trace / tap): копия в кольцо st->trace,
+// печать — в потоке журнала. port — индекс UART или слот клиента (ECU_LOG_PORT_NONE = нет)
+void gw_dispatch_trace(gw_state_t* st, unsigned kind, unsigned port, const uint8_t* data, size_t len);
+
+// Кадр на UART idx: в режиме threads — в кольцо потока UART, иначе в TX очередь
+// (UART отмечается в st->uart_tx_dirty, запись — в конце такта). o — откуда кадр (задержки).
+// 0 = OK, -1 = очередь/кольцо полно
+int  gw_dispatch_uart_send(gw_state_t* st, int idx, const uint8_t* frame, size_t len, const gw_lat_origin_t* o);
+
+// Выделить SLIP кадры из rx_buf UART idx, проверить и обработать (маршрутизация, рассылка клиентам)
+void gw_dispatch_uart_rx(gw_state_t* st, int idx, uint64_t now);
+
+// Режим threads: кадры, которые поток UART idx уже проверил
+void gw_dispatch_worker_rx(gw_state_t* st, int idx, uint64_t now);
+
+// Обработать полные кадры из rx_buf всех клиентов: запросы к шлюзу и маршрутизация на UART.
+// В каждый UART кадры клиентов ставятся кругами DRR (квант на клиента за круг) и не быстрее
+// cmd_rate/cmd_burst этого UART на клиента (срочные — мимо токенов). Кадр, которому не хватило токенов
+// или места в TX очереди UART, остаётся в rx_buf и держит только следующие кадры в тот же UART;
+// сокет клиента не читается (rx_paused), когда ждущие кадры заняли rx_buf.
+// Возвращает мкс до появления токенов у ждущего клиента, -1 = никто не ждёт
+long gw_dispatch_clients(gw_state_t* st, uint64_t now);
+
+// Отложенные команды (GW_CTL_SCHEDULE), срок которых наступил: в очереди UART, мимо DRR и токенов,
+// опоздание — в гистограмму GW_LAT_SCOPE_SCHED и отчётом поставившему клиенту. Задание, чей UART
+// не принимает кадр, ждёт места в списке этого UART, задания других UART идут дальше.
+// Вызывать сразу после gw_clock_tick(), до кадров клиентов, и после них — для новых заданий.
+// Ждущие места повторяются при каждом вызове; цикл событий будит запись, освободившая место
+// (epoll — такт без ожидания, io_uring — завершение записи, threads — rx_efd от потока UART).
+// Возвращает мкс до следующего срока, -1 = в куче нет заданий
+long gw_dispatch_sched(gw_state_t* st, uint64_t now);
+
+// Раз в секунду: устаревание выученных привязок
+void gw_dispatch_age(gw_state_t* st, uint64_t now);
+
+// SIGHUP: перечитать конфигурацию (в режиме threads — с остановкой потоков UART).
+// 0 = OK (в том числе если файл с ошибкой и конфигурация не изменилась), -1 = шлюз не может работать дальше
+int  gw_dispatch_reload(gw_state_t* st, uint64_t now);
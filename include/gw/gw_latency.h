@@ -0,0 +1,174 @@
+#pragma once
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ecu/ecu_proto.h"
+#include "gw/gw_clock.h"
+
+// Задержка кадра внутри шлюза: от чтения из UART/сокета до передачи ядру последнего байта
+// (write в UART, send клиенту). Время — gw_clock_now() соответствующих тактов.
+// Отметки кадра:
+//  t_read — такт, в котором прочитан кадр (в режиме threads — такт потока UART);
+//  t_enq  — такт, в котором кадр поставлен в TX очередь UART/клиента (после декодирования,
+//           маршрутизации и, в режиме threads, перехода между потоками через кольцо);
+//           конец этапа RX — отдельное чтение часов в момент постановки (gw_latency_rx_done);
+//  t_out  — такт, в котором ядро приняло последний байт кадра.
+// Гистограммы ведутся по направлениям и этапам, итоговая задержка — ещё и по узлам.
+// Реестр один на процесс: пишут сетевой поток и потоки UART.
+
+// Направление
+#define GW_LAT_TO_NET     0u   // UART -> клиенты (узел = src)
+#define GW_LAT_TO_UART    1u   // клиент -> UART (узел = dst)
+#define GW_LAT_UART_UART  2u   // UART -> UART, пересылка без ПК (узел = src)
+#define GW_LAT_DIRS       3u
+
+// Этап
+#define GW_LAT_RX     0u   // t_read -> t_enq
+#define GW_LAT_QUEUE  1u   // t_enq  -> t_out
+#define GW_LAT_TOTAL  2u   // t_read -> t_out
+#define GW_LAT_STAGES 3u
+
+// Полосы TX очереди UART (GW_UART_LANES): ожидание кадра в полосе до первого записанного байта
+#define GW_LAT_LANES  3u
+
+// Гистограмма в мкс с логарифмическими корзинами (как HDR): 0..7 точно, дальше 8 корзин
+// на каждую степень двойки — ошибка значения не больше 12.5%, весь диапазон u32 в 240 корзинах.
+// Писать можно из нескольких потоков (атомарное прибавление), читать — из любого
+#define GW_HIST_BUCKETS 240
+
+typedef struct {
+    atomic_uint bucket[GW_HIST_BUCKETS];
+    atomic_uint max;
+} gw_hist_t;
+
+void     gw_hist_add(gw_hist_t* h, uint32_t us);
+void     gw_hist_reset(gw_hist_t* h);
+
+// Снимок гистограммы: число значений, минимум/максимум и перцентили (верхняя граница корзины)
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t p999;
+} gw_hist_summary_t;
+
+void     gw_hist_summary(const gw_hist_t* h, gw_hist_summary_t* out);
+
+// Откуда пришёл кадр: передаётся вместе с кадром до TX очереди
+typedef struct {
+    uint32_t t_read;   // младшие 32 бита gw_clock_now() (разности по кругу — до 71 минуты)
+    uint8_t  dir;      // GW_LAT_*
+    uint8_t  node;
+} gw_lat_origin_t;
+
+// Упаковка origin в u64 (тег слота кольца gw_spsc в режиме threads)
+static inline uint64_t gw_lat_origin_pack(const gw_lat_origin_t* o)
+{
+    return (uint64_t)o->t_read | ((uint64_t)o->dir << 32) | ((uint64_t)o->node << 40);
+}
+
+static inline gw_lat_origin_t gw_lat_origin_unpack(uint64_t v)
+{
+    gw_lat_origin_t o;
+    o.t_read = (uint32_t)v;
+    o.dir = (uint8_t)(v >> 32);
+    o.node = (uint8_t)(v >> 40);
+    return o;
+}
+
+// Отметки кадров в TX очереди. Позиции — накопительные счётчики байт очереди:
+// кадр отправлен, когда sent дошёл до его end. Очередь меток ограничена — если она полна,
+// кадр просто не измеряется (выборка), очередь данных от этого не зависит.
+#define GW_LAT_MARKS 32
+
+typedef struct {
+    uint32_t end;      // queued после постановки кадра
+    uint32_t t_read;
+    uint32_t t_enq;
+    uint8_t  dir;
+    uint8_t  node;
+    uint16_t reserved;
+} gw_lat_mark_t;
+
+typedef struct {
+    gw_lat_mark_t mark[GW_LAT_MARKS];
+    uint32_t head;     // следующая свободная
+    uint32_t tail;     // старейшая неотправленная
+    uint32_t queued;   // байт поставлено в очередь за всё время
+    uint32_t sent;     // байт отдано ядру за всё время
+} gw_lat_fifo_t;
+
+// Владелец очереди: поставлено bytes (o = NULL — кадр не измеряется, только сдвиг позиции)
+void gw_lat_fifo_queued(gw_lat_fifo_t* f, size_t bytes, const gw_lat_origin_t* o, uint64_t now_us);
+
+// Владелец очереди: ядро приняло bytes — завершить отметки дошедших кадров
+void gw_lat_fifo_sent(gw_lat_fifo_t* f, size_t bytes, uint64_t now_us);
+
+// Владелец очереди: bytes с начала очереди выброшены, не отправлены — их отметки не измеряются
+void gw_lat_fifo_skip(gw_lat_fifo_t* f, size_t bytes);
+
+// Владелец очереди: из середины очереди вырезаны bytes байт с позиции at (в счёте queued) —
+// их отметки не измеряются, отметки за ними сдвигаются
+void gw_lat_fifo_cut(gw_lat_fifo_t* f, uint32_t at, size_t bytes);
+
+// Очередь сброшена целиком (закрытие порта/клиента): отметки выбрасываются
+void gw_lat_fifo_clear(gw_lat_fifo_t* f);
+
+// Реестр. init выделяет гистограммы по узлам; без него считаются только этапы.
+// 0 = OK, -1 = нет памяти
+int  gw_latency_init(void);
+void gw_latency_free(void);
+
+// Добавить значение этапа (TOTAL — ещё и в гистограмму узла)
+void gw_latency_add(unsigned dir, unsigned stage, uint8_t node, uint32_t us);
+
+// Кадр поставлен в очередь: этап RX кадра, прочитанного в такте t_read. Часы читаются заново —
+// в одном такте чтение и постановка, и время такта дало бы ноль
+static inline void gw_latency_rx_done(unsigned dir, uint8_t node, uint32_t t_read)
+{
+    gw_latency_add(dir, GW_LAT_RX, node, (uint32_t)gw_clock_read_us() - t_read);
+}
+
+// Ожидание кадра в полосе lane TX очереди UART (все UART вместе)
+void gw_latency_lane_add(unsigned lane, uint32_t us);
+
+// Опоздание отложенной команды (gw_sched): от срока до постановки в TX очередь UART
+void gw_latency_sched_add(uint32_t us);
+
+// Обнулить все гистограммы. Записи других потоков в момент сброса могут частично остаться
+void gw_latency_reset(void);
+
+// Вид записи
+#define GW_LAT_SCOPE_STAGE 1u   // направление x этап, node = 0
+#define GW_LAT_SCOPE_NODE  2u   // направление x узел, только TOTAL
+#define GW_LAT_SCOPE_LANE  3u   // полоса TX UART (node = полоса), dir = TO_UART, stage = QUEUE
+#define GW_LAT_SCOPE_SCHED 4u   // опоздание отложенных команд, dir = TO_UART, stage = RX, node = 0
+
+// Запись реестра (она же запись ответа GW_CTL_GET_LATENCY), мкс
+typedef struct ECU_PACKED {
+    uint8_t  scope;    // GW_LAT_SCOPE_*
+    uint8_t  dir;      // GW_LAT_TO_*
+    uint8_t  stage;    // GW_LAT_RX/QUEUE/TOTAL
+    uint8_t  node;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t p999;
+} gw_latency_rec_t;
+
+_Static_assert(sizeof(gw_latency_rec_t) == 32, "latency rec size must be 32");
+
+// Обойти непустые гистограммы вида scope (0 = все). fn возвращает <0, чтобы прервать обход.
+// Возвращает 0 или значение fn (<0)
+int  gw_latency_foreach(unsigned scope, int (*fn)(void* arg, const gw_latency_rec_t* rec), void* arg);
+
+// Текстовый дамп непустых гистограмм (SIGUSR1)
+void gw_latency_dump(FILE* out);
@@ -0,0 +1,114 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ecu/ecu_proto.h"
+#include "gw/gw_router.h"
+
+// Статистика шлюза. Счётчики лежат там, где их обновляют:
+//  - UART — gw_uart_t.stats (gw_counter_t, пишет владелец порта, в том числе поток UART);
+//  - клиенты — gw_net_client_t.stats (за время соединения);
+//  - узлы и типы сообщений — gw_metrics_t в состоянии шлюза (сетевой поток).
+// Реестр ниже только собирает их в записи: для GW_CTL_GET_STATS и текстового дампа по SIGUSR1.
+
+#define GW_METRICS_MSG_TYPES 16   // msg_type 0..15, остальные считаются в 0
+
+// Кадры между шлюзом и узлами: rx — принятые с UART, tx — поставленные на UART
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t rx_bytes;
+    uint32_t tx_frames;
+    uint32_t tx_bytes;
+    uint32_t tx_rejected;   // TX очередь/кольцо UART было полно
+} gw_metrics_flow_t;
+
+typedef struct {
+    gw_metrics_flow_t node[GW_ROUTER_NODES];       // rx по src, tx по dst
+    gw_metrics_flow_t msg[GW_METRICS_MSG_TYPES];   // по msg_type
+} gw_metrics_t;
+
+static inline gw_metrics_flow_t* gw_metrics_msg(gw_metrics_t* m, uint8_t msg_type)
+{
+    return &m->msg[msg_type < GW_METRICS_MSG_TYPES ? msg_type : 0];
+}
+
+// Кадр принят с UART
+static inline void gw_metrics_rx(gw_metrics_t* m, const ecu_hdr_t* h, size_t len)
+{
+    gw_metrics_flow_t* n = &m->node[h->src];
+    gw_metrics_flow_t* t = gw_metrics_msg(m, h->msg_type);
+    n->rx_frames++;
+    n->rx_bytes += (uint32_t)len;
+    t->rx_frames++;
+    t->rx_bytes += (uint32_t)len;
+}
+
+// Кадр поставлен на UART (ok = 0: очередь полна)
+static inline void gw_metrics_tx(gw_metrics_t* m, const ecu_hdr_t* h, size_t len, int ok)
+{
+    gw_metrics_flow_t* n = &m->node[h->dst];
+    gw_metrics_flow_t* t = gw_metrics_msg(m, h->msg_type);
+    if (!ok) {
+        n->tx_rejected++;
+        t->tx_rejected++;
+        return;
+    }
+    n->tx_frames++;
+    n->tx_bytes += (uint32_t)len;
+    t->tx_frames++;
+    t->tx_bytes += (uint32_t)len;
+}
+
+// Вид записи реестра
+#define GW_METRICS_UART    1u
+#define GW_METRICS_CLIENT  2u
+#define GW_METRICS_NODE    3u
+#define GW_METRICS_MSG     4u
+#define GW_METRICS_LANE    5u
+
+// Запись реестра (она же запись ответа GW_CTL_GET_STATS). Поля по видам:
+//  UART:   in/out — с порта/на порт, crc_errors — заголовок/CRC, framing_errors — ошибки SLIP
+//          и переполнения RX, drops — целый кадр не передан дальше, hwm — максимум TX очереди (байт),
+//          rejected — TX очередь полна;
+//  CLIENT: in/out — от клиента/клиенту, crc_errors, framing_errors — неверная длина и переполнение
+//          rx_buf, drops — очередь клиента полна, hwm — максимум его очереди,
+//          rejected — кадр клиента не доставлен (нет маршрута или больше очереди UART),
+//          conflated — TELEMETRY заменено более новым (подписка GW_NET_SUB_LATEST),
+//          throttled_ms — кадры клиента ждали токенов UART (cmd_rate), paused_ms — места
+//          в TX очереди UART (сокет клиента в это время не читается);
+//  NODE:   in — от узла (src), out — узлу (dst), rejected — UART полон;
+//  MSG:    то же по msg_type;
+//  LANE:   полоса TX очереди UART, id = UART * GW_UART_LANES + полоса; out — поставлено в полосу,
+//          hwm — максимум полосы (байт), conflated — команд заменено более новыми.
+//          Ожидание в полосах — GW_CTL_GET_LATENCY (GW_LAT_SCOPE_LANE).
+// Счётчики 32-битные, по кругу.
+typedef struct ECU_PACKED {
+    uint8_t  kind;        // GW_METRICS_*
+    uint8_t  id;          // индекс UART / слот клиента / node_id / msg_type
+    uint16_t reserved;
+    uint32_t frames_in;
+    uint32_t bytes_in;
+    uint32_t frames_out;
+    uint32_t bytes_out;
+    uint32_t crc_errors;
+    uint32_t framing_errors;
+    uint32_t drops;
+    uint32_t hwm;
+    uint32_t rejected;
+    uint32_t conflated;   // кадров заменено более новыми (LANE, CLIENT)
+    uint32_t throttled_ms;// CLIENT: ожидание токенов, мс
+    uint32_t paused_ms;   // CLIENT: ожидание места в очереди UART, мс
+} gw_metrics_rec_t;
+
+_Static_assert(sizeof(gw_metrics_rec_t) == 52, "metrics rec size must be 52");
+
+struct gw_state;
+
+// Обойти записи вида kind (0 = все): все UART, подключённые клиенты, узлы и типы с ненулевыми
+// счётчиками. fn возвращает <0, чтобы прервать обход. Возвращает 0 или значение fn (<0)
+int  gw_metrics_foreach(const struct gw_state* st, unsigned kind,
+                        int (*fn)(void* arg, const gw_metrics_rec_t* rec), void* arg);
+
+// Текстовый дамп всех записей и гистограмм задержек (SIGUSR1)
+void gw_metrics_dump(const struct gw_state* st, FILE* out);
@@ -2,41 +2,159 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "gw/gw_latency.h"
+#include "gw/gw_router.h"
+
 #ifndef GW_NET_MAX_CLIENTS
 #define GW_NET_MAX_CLIENTS 8
 #endif
 
+#define GW_NET_RX_BUF_DEFAULT 8192
+#define GW_NET_RX_SPILL_MAX   (256 * 1024)  // io_uring: принятое после паузы клиента (пул буферов кольца)
+#define GW_NET_TX_BUF_DEFAULT 65536
+
+// Подписка клиента (GW_CTL_SUBSCRIBE)
+#define GW_NET_SUB_ALL     0u   // все кадры по порядку
+#define GW_NET_SUB_LATEST  1u   // TELEMETRY: не больше одного неотправленного кадра на узел —
+                                // ждущий снимается, новый встаёт в конец очереди (последний кадр
+                                // заменяется на месте); остальные кадры без потерь и по порядку
+#define GW_NET_NODES       256
+
+// Счётчики клиента за время соединения (только сетевой поток)
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t rx_frames;       // кадров выделено из потока
+    uint32_t rx_len_errors;   // неверная длина кадра или переполнение rx_buf (буфер сброшен)
+    uint32_t rx_crc_errors;   // кадр с ошибкой заголовка/CRC
+    uint32_t rx_rejected;     // кадр не доставлен: нет маршрута или очередь UART полна
+    uint32_t tx_frames;       // кадров поставлено в очередь
+    uint32_t tx_bytes;        // байт отправлено
+    uint32_t tx_hwm;          // максимум очереди, байт
+    uint32_t tx_conflated;    // TELEMETRY заменено более новым (GW_NET_SUB_LATEST)
+    uint64_t throttled_us;    // кадры клиента ждали токенов cmd_rate (мкс)
+    uint64_t paused_us;       // кадры клиента ждали места в TX очереди UART (мкс)
+} gw_net_client_stats_t;
+
+// Кадры клиента в один UART (gw_dispatch_clients): token bucket и дефицит DRR
+typedef struct {
+    uint64_t tokens;          // байт * 1e6: пополнение rate байт/с за мкс без округлений
+    uint64_t t_fill;          // время последнего пополнения (0 = корзина ещё не пополнялась — полна)
+    uint32_t deficit;         // DRR: байт, которые ещё можно поставить в этом круге
+    uint32_t round;           // круг, в котором добавлен квант
+} gw_net_flow_t;
+
 typedef struct {
-    int     fd;
-    uint8_t rx_buf[8192];
-    size_t  rx_len;
+    int      fd;
+    uint32_t id;            // номер подключения, не повторяется (0 = нет): fd и слот переиспользуются
+    uint8_t* rx_buf;
+    size_t   rx_cap;
+    size_t   rx_len;
+    uint8_t* rx_spill;      // gw_net_client_feed: не поместилось в rx_buf, пока кадры клиента ждут;
+    size_t   rx_spill_len;  // переходит в rx_buf по мере снятия кадров
+
+    // TX очередь: [tx_off, tx_len) ещё не отправлено
+    uint8_t* tx_buf;
+    size_t   tx_cap;
+    size_t   tx_off;
+    size_t   tx_len;
+    uint64_t tx_first_us;   // когда в пустую очередь положили первый кадр (для пачек)
+    uint32_t tx_drops;      // кадров не поместилось в очередь (медленный клиент)
+    size_t   tx_busy;       // байт от tx_off отданы ядру асинхронной записью (io_uring) — не сдвигать
+    uint32_t tx_total;      // байт поставлено за время соединения (позиции tm_pos)
+    uint8_t  sub;           // GW_NET_SUB_*
+    uint32_t tm_pos[GW_NET_NODES]; // GW_NET_SUB_LATEST: позиция последнего TELEMETRY узла (tx_total до постановки)
+
+    uint32_t ep_events;     // маска, под которой fd зарегистрирован в epoll (0 = не зарегистрирован)
+
+    // разбор входящих кадров (gw_dispatch_clients): кадры rx_buf ждут токенов или места в TX очереди
+    // UART и заняли rx_buf — сокет не читается
+    uint8_t  rx_paused;
+    uint64_t throttled_since; // кадр клиента ждёт токенов с этого времени (0 = не ждёт)
+    uint64_t paused_since;    // кадр клиента ждёт места в TX очереди UART с этого времени
+    gw_net_flow_t flow[GW_UART_MAX];
+
+    gw_net_client_stats_t stats;
+    gw_lat_fifo_t tx_marks; // отметки измеряемых кадров в TX очереди (завершают flush/sent)
 } gw_net_client_t;
 
 typedef struct {
     int listen_fd;
-    gw_net_client_t clients[GW_NET_MAX_CLIENTS];
+    int max_clients;
+    gw_net_client_t* clients;
+    uint32_t last_id;       // id последнего принятого клиента
+
+    // клиент отключён (gw_net_remove_client, сокращение max_clients): забыть, что связано с его id
+    void (*on_close)(void* arg, uint32_t id);
+    void* on_close_arg;
 } gw_net_t;
 
-int  gw_net_listen(gw_net_t* n, uint16_t port);
+// limits: max_clients <= 0 / rx_cap == 0 / tx_cap == 0 — значения по умолчанию
+int  gw_net_listen(gw_net_t* n, uint16_t port, int max_clients, size_t rx_cap, size_t tx_cap);
 void gw_net_close(gw_net_t* n);
 
 int  gw_net_listen_fd(const gw_net_t* n);
 
+// слушать другой порт; при ошибке остаётся старый listen-сокет. 0 = OK, -1 = ошибка
+int  gw_net_relisten(gw_net_t* n, uint16_t port);
+
+// сменить лимиты на лету, подключённые клиенты и их очереди сохраняются.
+// Возвращает число отключённых клиентов (если новый max_clients меньше), -1 = ошибка
+int  gw_net_reconfigure(gw_net_t* n, int max_clients, size_t rx_cap, size_t tx_cap);
+
 // accept all pending clients; returns number accepted, or <0
 int  gw_net_accept(gw_net_t* n);
 
 // find client by fd; returns pointer or NULL
 gw_net_client_t* gw_net_find_client(gw_net_t* n, int fd);
 
+// find connected client by id; returns pointer or NULL (client has disconnected)
+gw_net_client_t* gw_net_find_id(gw_net_t* n, uint32_t id);
+
 // remove client (close fd)
 void gw_net_remove_client(gw_net_t* n, int fd);
 
 // read into client's rx buffer; returns bytes read, 0 no data, -1 disconnect/error
 int  gw_net_client_read(gw_net_client_t* c);
 
-// try extract one frame from client stream (len+frame)
-// returns: 1 got frame, 0 not enough, -1 protocol error (drop buffer)
-int  gw_net_client_try_get_frame(gw_net_client_t* c, uint8_t* out_frame, size_t out_cap, size_t* out_len);
+// append bytes received outside gw_net_client_read (io_uring). What does not fit while frames wait
+// in rx_buf goes to rx_spill (up to GW_NET_RX_SPILL_MAX, beyond that the buffers are reset). Returns len
+int  gw_net_client_feed(gw_net_client_t* c, const uint8_t* data, size_t len);
+
+// head frame of client stream (len+frame), left in rx_buf until gw_net_client_pop_frame.
+// returns: 1 got frame (*frame points into rx_buf), 0 not enough, -1 protocol error (drop buffer)
+int  gw_net_client_peek_frame(gw_net_client_t* c, size_t max_len, const uint8_t** frame, size_t* len);
+
+// remove the head frame returned by gw_net_client_peek_frame
+void gw_net_client_pop_frame(gw_net_client_t* c);
+
+// same for the frame starting at offset off of rx_buf (off = end of frames peeked before it):
+// frames of other UARTs pass a waiting one (gw_dispatch_clients)
+int  gw_net_client_peek_frame_at(gw_net_client_t* c, size_t off, size_t max_len, const uint8_t** frame,
+                                 size_t* len);
+void gw_net_client_pop_frame_at(gw_net_client_t* c, size_t off);
+
+// queue frame (len+frame) to one client (reply to a GW-addressed request); -1 if queue is full
+int  gw_net_send_frame(gw_net_t* n, int fd, const uint8_t* frame, size_t len, uint64_t now_us);
+
+// queue frame to one client; o as in gw_net_broadcast_frame. 0 = OK, -1 = queue is full
+int  gw_net_client_send(gw_net_client_t* c, const uint8_t* frame, size_t len, uint64_t now_us,
+                        const gw_lat_origin_t* o);
+
+// queue frame to all clients (GW_NET_SUB_LATEST clients may replace a pending TELEMETRY instead);
+// returns number of clients it was queued to.
+// o != NULL: measure the frame's latency until it is handed to each client's socket
+int  gw_net_broadcast_frame(gw_net_t* n, const uint8_t* frame, size_t len, uint64_t now_us,
+                            const gw_lat_origin_t* o);
+
+// bytes waiting in client's TX queue
+size_t gw_net_client_tx_pending(const gw_net_client_t* c);
+
+// write client's TX queue; returns bytes written, 0 would block, -1 error (client must be removed)
+int  gw_net_client_flush(gw_net_client_t* c);
+
+// n bytes from tx_off were written by an asynchronous send (io_uring); clears tx_busy
+void gw_net_client_sent(gw_net_client_t* c, size_t n);
 
-// send frame to all clients (best-effort; на следующем шаге сделаем TX очереди)
-int  gw_net_broadcast_frame(gw_net_t* n, const uint8_t* frame, size_t len);
+// flush clients whose oldest queued frame waited >= batch_us (all, if force);
+// clients that failed are removed. Returns microseconds until the next batch is due, or -1 if none.
+long gw_net_flush(gw_net_t* n, uint64_t now_us, uint32_t batch_us, int force);
@@ -1,6 +1,10 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 
+// Индексы UART в порядке секций [uart NAME] конфигурации.
+// Без конфигурации: ttyS1, ttyS4, ttyS5.
 typedef enum {
     GW_UART_1 = 0,
     GW_UART_4 = 1,
@@ -8,4 +12,77 @@ typedef enum {
     GW_UART_COUNT = 3
 } gw_uart_index_t;
 
-int gw_router_node_to_uart(uint8_t node_id, gw_uart_index_t* out_uart);
+#ifndef GW_UART_MAX
+#define GW_UART_MAX 8
+#endif
+
+// Время жизни выученной привязки без трафика от узла (HEARTBEAT раз в 1 сек, offline > 3 сек)
+#ifndef GW_ROUTER_AGE_MS
+#define GW_ROUTER_AGE_MS 30000u
+#endif
+
+#define GW_ROUTER_NODES 256
+
+// Флаги записи таблицы
+#define GW_ROUTE_F_STATIC   (1u << 0)   // статическая привязка по умолчанию
+#define GW_ROUTE_F_LEARNED  (1u << 1)   // выучена по полю src принятых кадров
+#define GW_ROUTE_F_HELLO    (1u << 2)   // узел присылал HELLO
+
+typedef struct {
+    uint8_t  flags;         // GW_ROUTE_F_*
+    uint8_t  static_uart;   // привязка по умолчанию (если GW_ROUTE_F_STATIC)
+    uint8_t  learned_uart;  // выученная привязка (если GW_ROUTE_F_LEARNED)
+    uint64_t last_seen_ms;  // CLOCK_MONOTONIC, последний кадр от узла
+    uint32_t rx_frames;     // кадров от узла с момента изучения
+    uint32_t moves;         // сколько раз узел "переезжал" на другой UART
+} gw_route_t;
+
+// Счётчики прямой пересылки UART -> UART (узел -> узел без PC)
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t drops;   // очередь TX целевого UART переполнена
+} gw_fwd_stats_t;
+
+// Таблица маршрутов node_id -> UART по аналогии с learning switch:
+// статические привязки задают исходное состояние, выученные их перекрывают и стареют.
+typedef struct {
+    gw_route_t     nodes[GW_ROUTER_NODES];
+    uint32_t       age_ms;
+    int            uart_count;
+    const char*    uart_names[GW_UART_MAX];       // для печати
+    gw_fwd_stats_t fwd[GW_UART_MAX][GW_UART_MAX]; // [from][to]
+} gw_router_t;
+
+// Событие gw_router_learn()
+typedef enum {
+    GW_ROUTER_LEARN_REFRESH = 0,  // привязка уже была, обновили время
+    GW_ROUTER_LEARN_NEW     = 1,  // новый узел
+    GW_ROUTER_LEARN_MOVED   = 2   // узел появился на другом UART
+} gw_router_learn_t;
+
+// Инициализация пустой таблицы для uart_count портов (имена — для печати, могут быть NULL)
+void gw_router_init(gw_router_t* r, uint32_t age_ms, int uart_count, const char* const* uart_names);
+
+// Статическая привязка узла к UART (перекрывается выученной)
+int  gw_router_set_static(gw_router_t* r, uint8_t node_id, gw_uart_index_t uart);
+
+// Перенести выученные привязки и счётчики пересылки из old в r (после смены списка UART).
+// uart_map[старый индекс] = новый индекс или -1, если UART убран
+void gw_router_migrate(gw_router_t* r, const gw_router_t* old, const int* uart_map);
+
+// Выучить привязку по src валидного кадра, принятого с UART.
+// Возвращает gw_router_learn_t или <0, если node_id не может быть выучен (broadcast/GW).
+int  gw_router_learn(gw_router_t* r, uint8_t node_id, gw_uart_index_t uart, int is_hello, uint64_t now_ms);
+
+// Удалить выученные привязки старше age_ms; возвращает число удалённых
+int  gw_router_age(gw_router_t* r, uint64_t now_ms);
+
+// Найти UART для dst. 1 = найден, 0 = нет
+int  gw_router_lookup(const gw_router_t* r, uint8_t node_id, gw_uart_index_t* out_uart);
+
+// Учесть пересылку кадра с UART from на UART to (ok = 0 если кадр не поместился в очередь)
+void gw_router_count_fwd(gw_router_t* r, gw_uart_index_t from, gw_uart_index_t to, size_t len, int ok);
+
+// Печать таблицы (только узлы с привязкой)
+void gw_router_dump(const gw_router_t* r, uint64_t now_ms, FILE* out);
@@ -0,0 +1,91 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ecu/ecu_limits.h"
+#include "gw/gw_router.h"
+
+// Отложенные команды (GW_CTL_SCHEDULE): готовый кадр ECU ждёт в шлюзе своего срока и уходит
+// в UART из цикла событий в этот момент — без задержек TCP и ПК между командами.
+// Очередь — двоичная куча по сроку (при равных сроках — по порядку постановки),
+// кадры лежат в пуле мест, выделенном при первом задании.
+// Задание, чей UART в срок не принимает кадр (TX очередь полна), уходит из кучи в список ожидания
+// этого UART: оно не задерживает задания других UART, а следующие задания того же UART встают
+// за ним, чтобы порядок отправки в UART совпадал с порядком сроков.
+
+#define GW_SCHED_MAX     256                       // заданий в очереди
+#define GW_SCHED_LATE_US 1000u                     // опоздание больше 1 мс — в счётчик late
+#define GW_SCHED_HORIZON_US (24ull * 3600u * 1000000u) // срок дальше суток — ошибка в часах клиента
+
+// Часы срока
+#define GW_SCHED_CLOCK_MONO 0u   // CLOCK_MONOTONIC шлюза, мс
+#define GW_SCHED_CLOCK_UNIX 1u   // CLOCK_REALTIME шлюза, мс от 1970 (пересчитывается при постановке)
+
+typedef struct {
+    uint64_t at_us;       // срок, CLOCK_MONOTONIC
+    uint32_t id;          // номер задания (отчёт клиенту)
+    uint32_t client_id;   // gw_net_client_t.id поставившего
+    uint16_t len;
+    uint16_t next;        // следующее в списке ожидания UART
+    uint8_t  frame[ECU_MAX_FRAME_SIZE];
+} gw_sched_ent_t;
+
+#define GW_SCHED_NONE 0xFFFFu
+
+// Список ожидания места в TX очереди одного UART, по порядку сроков
+typedef struct {
+    uint16_t head;        // GW_SCHED_NONE = пусто
+    uint16_t tail;
+} gw_sched_wait_t;
+
+typedef struct {
+    gw_sched_ent_t* ent;                // GW_SCHED_MAX мест, NULL до первого задания
+    uint16_t        heap[GW_SCHED_MAX]; // места по сроку, ближайшее — heap[0]
+    uint16_t        spare[GW_SCHED_MAX];// стек свободных мест
+    gw_sched_wait_t wait[GW_UART_MAX];
+    int             count;              // в куче
+    int             waiting;            // в списках ожидания
+    int             spare_n;
+    uint32_t        last_id;
+
+    uint32_t queued;      // поставлено заданий
+    uint32_t sent;        // отправлено в UART
+    uint32_t late;        // из них позже срока больше чем на GW_SCHED_LATE_US
+    uint32_t dropped;     // в срок некуда отправить (нет маршрута, кадр не встаёт в очередь UART)
+    uint32_t rejected;    // очередь заданий полна
+} gw_sched_t;
+
+// Срок at_ms по часам clock (GW_SCHED_CLOCK_*) в CLOCK_MONOTONIC мкс, now_us — текущее время.
+// 0 = OK, -1 = неизвестные часы или срок дальше GW_SCHED_HORIZON_US
+int  gw_sched_deadline(unsigned clock, uint64_t at_ms, uint64_t now_us, uint64_t* at_us);
+
+// Поставить кадр frame (проверенный кадр ECU) на срок at_us. *id — номер задания.
+// 0 = OK, -1 = очередь полна или нет памяти
+int  gw_sched_add(gw_sched_t* s, uint64_t at_us, uint32_t client_id, const uint8_t* frame, size_t len,
+                  uint32_t* id);
+
+// Задание с ближайшим сроком, NULL = очередь пуста
+gw_sched_ent_t* gw_sched_head(gw_sched_t* s);
+
+// Снять задание gw_sched_head() и освободить его место
+void gw_sched_pop(gw_sched_t* s);
+
+// Переложить задание gw_sched_head() в конец списка ожидания UART uart
+void gw_sched_defer(gw_sched_t* s, unsigned uart);
+
+// Первое задание в списке ожидания UART uart, NULL = список пуст
+gw_sched_ent_t* gw_sched_waiting(gw_sched_t* s, unsigned uart);
+
+// Снять первое задание списка ожидания UART uart и освободить его место
+void gw_sched_unwait(gw_sched_t* s, unsigned uart);
+
+// Вернуть все ожидающие задания в кучу (индексы UART сменились после перечитывания конфигурации)
+void gw_sched_requeue(gw_sched_t* s);
+
+// Заданий в очереди: в куче и в списках ожидания
+static inline int gw_sched_pending(const gw_sched_t* s)
+{
+    return s->count + s->waiting;
+}
+
+void gw_sched_free(gw_sched_t* s);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ecu/ecu_proto.h"
+#include "gw/gw_config.h"
+
+// Кадр длительного теста: EVENT src=GW, event_code GW_SEND_TEST_EVENT,
+// data = gw_send_test_data_t и заполнитель (байт i = test_seq * 31 + i)
+#define GW_SEND_TEST_EVENT    0x01F0u
+#define GW_SEND_TEST_SIZE_MIN 12u     // payload: заголовок EVENT + gw_send_test_data_t
+#define GW_SEND_TEST_SIZE_DEF 64u
+
+typedef struct ECU_PACKED {
+    uint32_t test_seq;   // номер кадра порта-отправителя, с 0 подряд
+    uint8_t  port;       // индекс UART отправителя
+    uint8_t  reserved[3];
+} gw_send_test_data_t;
+
+_Static_assert(sizeof(gw_send_test_data_t) == 8, "send test data size must be 8");
+
+typedef struct {
+    const char* ports;         // -send_test PORT: all или список через _
+    double      time_s;        // -send_time: 0 = один HEARTBEAT на порт
+    double      rate;          // -send_rate: кадров/с на порт, 0 = сколько примет линия
+    unsigned    size;          // -send_size: байт payload (0 = GW_SEND_TEST_SIZE_DEF)
+    const char* loop;          // -send_loop: NULL = без приёма, self или пары A:B через запятую
+    int         show_packets;
+} gw_send_test_opts_t;
+
+// Тест передачи по UART из конфигурации. 0 = OK, 1 = ошибки/потери, 2 = неверные параметры
+int gw_send_test_run(const gw_config_t* cfg, const gw_send_test_opts_t* o);
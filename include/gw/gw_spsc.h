@@ -0,0 +1,44 @@
+#pragma once
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GW_CACHE_LINE 64
+
+// Кольцо кадров "один писатель — один читатель" без блокировок.
+// Индексы писателя и читателя лежат в разных кэш-линиях (нет false sharing),
+// каждая сторона держит копию чужого индекса и перечитывает его только когда кольцо
+// кажется полным/пустым. Слоты фиксированного размера: [u32 len][u64 tag][данные],
+// tag — значение вызывающего, передаётся вместе с кадром (отметки времени).
+typedef struct {
+    // писатель
+    alignas(GW_CACHE_LINE) _Atomic size_t head;
+    size_t tail_cache;
+
+    // читатель
+    alignas(GW_CACHE_LINE) _Atomic size_t tail;
+    size_t head_cache;
+
+    // неизменяемое после init
+    alignas(GW_CACHE_LINE) size_t mask;   // slots - 1
+    size_t   slot_size;                   // байт на слот (кратно кэш-линии)
+    size_t   data_cap;                    // макс. длина данных в слоте
+    uint8_t* slots;
+} gw_spsc_t;
+
+// slots округляется вверх до степени двойки. 0 = OK, -1 = нет памяти
+int  gw_spsc_init(gw_spsc_t* q, size_t slots, size_t data_cap);
+void gw_spsc_free(gw_spsc_t* q);
+
+// Писатель: положить копию data. 0 = OK, -1 = кольцо полно (или len > data_cap)
+int  gw_spsc_push(gw_spsc_t* q, const uint8_t* data, size_t len);
+int  gw_spsc_push_tag(gw_spsc_t* q, const uint8_t* data, size_t len, uint64_t tag);
+
+// Читатель: первый кадр без извлечения (NULL = пусто), затем gw_spsc_pop()
+const uint8_t* gw_spsc_peek(gw_spsc_t* q, size_t* len);
+const uint8_t* gw_spsc_peek_tag(gw_spsc_t* q, size_t* len, uint64_t* tag);
+void gw_spsc_pop(gw_spsc_t* q);
+
+// Примерное число кадров в кольце (для статистики, с любой стороны)
+size_t gw_spsc_count(const gw_spsc_t* q);
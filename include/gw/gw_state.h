@@ -0,0 +1,92 @@
+#pragma once
+#include <stdint.h>
+
+#include "ecu/ecu_log.h"
+#include "gw/gw_ackmap.h"
+#include "gw/gw_config.h"
+#include "gw/gw_metrics.h"
+#include "gw/gw_net.h"
+#include "gw/gw_router.h"
+#include "gw/gw_sched.h"
+#include "gw/gw_uart.h"
+#include "gw/gw_worker.h"
+
+#define GW_TRACE_RECORDS 1024   // записей в кольце журнала кадров (~1 МБ, только если журнал включён)
+#define GW_CAPTURE_RECORDS 4096 // с [capture]: запас на всплески, пока поток журнала ждёт диск
+
+// Состояние работающего шлюза: всё, что построено по конфигурации и живёт в цикле событий
+typedef struct gw_state {
+    gw_config_t cfg;
+    const char* config_path;   // файл, из которого загружена cfg (NULL = встроенные значения)
+
+    int         uart_count;
+    gw_uart_t   uarts[GW_UART_MAX];
+    gw_net_t    net;
+    gw_router_t router;
+
+    // [gateway] threads = 1: UART обслуживают потоки, сетевой поток видит только eventfd колец
+    int         threaded;
+    gw_worker_t workers[GW_UART_MAX];
+    cpu_set_t   cpu_default;   // маска процесса до привязки сетевого потока (net_cpu)
+
+    // epoll создаётся и при backend = io_uring: если кольцо не заработает, цикл переходит на него
+    int         backend;       // GW_BACKEND_*, действующий цикл событий
+    int         ep;            // epoll
+    int         sig_fd;        // signalfd (SIGHUP, SIGUSR1)
+    uint16_t    gw_seq;        // seq кадров, которые формирует сам шлюз
+    gw_ackmap_t acks;          // seq команд клиентов с ACK -> отправитель (ACK только ему)
+    gw_sched_t  sched;         // отложенные команды (GW_CTL_SCHEDULE), срок — gw_dispatch_sched
+    int         sched_fd;      // timerfd на ближайший срок: таймаут epoll_wait округляется до мс
+    uint64_t    sched_armed_us;// на какой срок взведён sched_fd (0 = не взведён)
+
+    uint32_t    uart_tx_dirty; // биты UART, в TX очередь которых положили кадры за такт
+    uint64_t    last_age_ms;   // последнее устаревание привязок (gw_dispatch_age)
+    uint32_t    client_round;  // номер круга DRR кадров клиентов (gw_dispatch_clients)
+    int         client_rr;     // с какого слота клиента начинается следующий проход
+
+    gw_metrics_t metrics;      // счётчики по узлам и типам сообщений
+
+    int         show_packets;
+    int         preview_raw;   // сырые байты в журнал (-prev_show, tap, capture)
+    int         trace_frames;  // кадры в журнал (-show, -trace, tap, capture)
+    ecu_log_t   trace;         // журнал кадров: пишут все потоки, вычитывает свой поток с низким приоритетом
+    ecu_cap_t   capture;       // [capture]: файлы пишет поток журнала (blk == NULL — выключено)
+} gw_state_t;
+
+// Открыть UART, TCP, epoll и signalfd (SIGHUP, SIGUSR1) по st->cfg, построить таблицу маршрутов.
+// 0 = OK, -1 = ошибка (уже напечатана)
+int  gw_state_open(gw_state_t* st);
+
+// Закрыть всё открытое
+void gw_state_close(gw_state_t* st);
+
+// Перечитать st->config_path и применить отличия на лету (SIGHUP):
+//  - новые UART и UART со сменой dev открываются, убранные закрываются, остальные не трогаются;
+//  - скорость меняется без закрытия порта, очереди — с сохранением содержимого;
+//  - таблица маршрутов строится заново и заменяется целиком, выученные привязки переносятся;
+//  - TCP клиенты остаются подключены, при смене порта listen-сокет пересоздаётся.
+// Ошибка в файле или при открытии порта/сокета — ничего не меняется.
+// 0 = применено, -1 = ошибка (уже напечатана)
+int  gw_state_reload(gw_state_t* st);
+
+// Режим threads: запустить потоки UART и добавить их eventfd в epoll
+// (прежние потоки, если были, освобождаются). 0 = OK, -1 = ошибка
+int  gw_state_start_workers(gw_state_t* st);
+
+// Режим threads: остановить потоки UART. Кольца rx остаются — их нужно вычитать до
+// gw_state_reload()/gw_state_start_workers(), пока индексы UART прежние
+void gw_state_stop_workers(gw_state_t* st);
+
+// Пришедшие сигналы (gw_state_read_signals)
+#define GW_SIG_HUP   (1 << 0)   // перечитать конфигурацию
+#define GW_SIG_USR1  (1 << 1)   // дамп статистики
+
+// Прочитать signalfd; маска GW_SIG_*, 0 = ничего
+int  gw_state_read_signals(gw_state_t* st);
+
+// Взвести timerfd отложенных команд на срок at_us (CLOCK_MONOTONIC, 0 = снять), если он сменился
+void gw_state_sched_arm(gw_state_t* st, uint64_t at_us);
+
+// Маска epoll для UART: EPOLLIN, плюс EPOLLOUT если TX очередь не пуста и запись не ждёт
+// ухода очереди драйвера (gw_uart_tx_hold_us: конец ожидания — по таймауту цикла)
+uint32_t gw_state_uart_events(const gw_uart_t* u);
@@ -4,46 +4,171 @@
 #include <stddef.h>
 
 #include "ecu/ecu_slip.h"
+#include "gw/gw_counter.h"
+#include "gw/gw_latency.h"
+
+// Полосы TX очереди: кадр из полосы с меньшим номером уходит раньше, переключение между
+// полосами — только на границе кадра (начатый кадр дописывается целиком). Кадры, уже отданные
+// драйверу, не обгоняются: поэтому младшие полосы отдаются драйверу по кадру и только пока
+// его очередь меньше бюджета tx_inflight — срочный кадр ждёт не больше бюджета и кадра.
+// Очередь драйвера оценивается по записанным байтам и времени на baud_actual, TIOCOUTQ — только сверка
+#define GW_UART_LANE_URGENT 0u   // флаг ECU_F_URGENT
+#define GW_UART_LANE_CTRL   1u   // ACK, COMMAND, TIME_SYNC, HEARTBEAT
+#define GW_UART_LANE_BULK   2u   // CONFIG, EVENT, TELEMETRY, остальное и сырые байты
+#define GW_UART_LANES       3u
+
+// Бюджет очереди драйвера для младших полос: столько мкс передачи на скорости порта, не меньше MIN байт
+#define GW_UART_INFLIGHT_US  2000u
+#define GW_UART_INFLIGHT_MIN 64u
+// Сверка оценки очереди драйвера с TIOCOUTQ, когда оценка держит кадр: не чаще раза за столько мкс
+#define GW_UART_OUTQ_SYNC_US 100000u
+
+// Слияние команд в TX очереди: COMMAND тому же узлу с тем же command_id, который ещё не начат
+// передачей, заменяется новым — к узлу уходит только последнее значение
+#define GW_UART_CONFLATE_OFF   0   // не сливать
+#define GW_UART_CONFLATE_NOACK 1   // только команды без ECU_F_ACK_REQUIRED
+#define GW_UART_CONFLATE_ALL   2   // все команды: ACK придёт только на последнюю
+
+// Счётчики полосы (писатель — владелец порта)
+typedef struct {
+    gw_counter_t frames;          // кадров поставлено в полосу
+    gw_counter_t bytes;           // байт SLIP
+    gw_counter_t hwm;             // максимум полосы, байт
+    gw_counter_t conflated;       // кадров заменено более новой командой
+} gw_uart_lane_stats_t;
+
+// Счётчики UART. Писатель — владелец порта (поток UART в режиме threads),
+// кроме tx_frames/tx_rejected: их ведёт сетевой поток, который ставит кадры на UART
+typedef struct {
+    gw_counter_t rx_bytes;        // прочитано из порта
+    gw_counter_t rx_frames;       // целых ECU кадров
+    gw_counter_t rx_crc_errors;   // кадров с ошибкой заголовка/CRC
+    gw_counter_t rx_slip_errors;  // SLIP: кадр длиннее буфера/неверный escape
+    gw_counter_t rx_overflows;    // накопитель RX переполнен и сброшен
+    gw_counter_t rx_dropped;      // целый кадр не передан дальше (threads: кольцо rx полно)
+    gw_counter_t tx_frames;       // кадров принято на отправку
+    gw_counter_t tx_rejected;     // кадров не принято: TX очередь (или кольцо tx) полна
+    gw_counter_t tx_bytes;        // записано в порт
+    gw_counter_t tx_hwm;          // максимум TX очереди (все полосы), байт
+    gw_uart_lane_stats_t lane[GW_UART_LANES];
+} gw_uart_stats_t;
+
+// Кадр в полосе
+#define GW_UART_TXF_CMD  1u   // команда, которую можно заменить (dst, cmd)
+#define GW_UART_TXF_DEAD 2u   // заменена кадром другой длины: байты пропускаются, не передаются
+
+typedef struct {
+    uint32_t len;      // байт SLIP
+    uint32_t t_enq;    // младшие 32 бита gw_clock_now() постановки
+    uint32_t off;      // позиция первого байта в кольце полосы
+    uint16_t cmd;      // command_id (GW_UART_TXF_CMD)
+    uint8_t  dst;
+    uint8_t  flags;    // GW_UART_TXF_*
+} gw_uart_txf_t;
+
+typedef struct {
+    uint8_t*       buf;       // кольцо байт SLIP, tx_cap
+    size_t         head;      // write position
+    size_t         tail;      // read position
+    gw_uart_txf_t* frm;       // кадры полосы по порядку, кольцо tx_frm_cap
+    size_t         frm_head;
+    size_t         frm_tail;
+    size_t         sent;      // байт головного кадра уже записано (> 0 — кадр начат)
+    size_t         dead;      // кадров GW_UART_TXF_DEAD в полосе
+    gw_lat_fifo_t  marks;     // отметки измеряемых кадров полосы (завершает gw_uart_tx_advance)
+} gw_uart_lane_t;
 
 typedef struct {
     int fd;
     const char* dev_path;
-    int baud;
+    int baud;          // запрошенная скорость
+    int baud_actual;   // скорость, которую установил драйвер
 
-    // RX накопитель "сырых байт". Пока без SLIP: просто буфер.
-    // На следующем шаге сюда добавим SLIP decoder.
-    uint8_t rx_buf[4096];
-    size_t  rx_len;
+    // RX накопитель "сырых байт" (размер из конфигурации)
+    uint8_t* rx_buf;
+    size_t   rx_cap;
+    size_t   rx_len;
 
     // SLIP decoder output (1 кадр)
     uint8_t slip_frame[1200]; // ECU_HEADER(16)+payload(1024)+crc(2)=1042, запас
     slip_rx_t slip;
 
-    // TX очередь (кольцевой буфер)
-    uint8_t tx_buf[8192];
-    size_t  tx_head; // write position
-    size_t  tx_tail; // read position
+    // TX очередь: полосы по приоритету, у каждой кольцо tx_cap байт (размер из конфигурации)
+    gw_uart_lane_t tx_lane[GW_UART_LANES];
+    uint8_t* tx_mem;     // одна аллокация на кольца и списки кадров всех полос
+    size_t   tx_cap;
+    size_t   tx_frm_cap; // кадров в полосе
+    size_t   tx_pending; // байт во всех полосах
+    unsigned tx_cur;     // полоса последнего gw_uart_tx_chunk (её байты снимает gw_uart_tx_advance)
+    size_t   tx_out;     // байт последнего куска, ещё не снятых (io_uring: запись в полёте, их не трогать)
+    int      conflate;   // GW_UART_CONFLATE_*
+    size_t   tx_inflight;   // бюджет очереди драйвера для младших полос, байт (0 = без ограничения)
+    uint64_t tx_hold_until; // до этого момента (gw_clock) новый кадр младшей полосы ждёт, 0 = не ждёт
+    size_t   tx_drv_est;    // оценка очереди драйвера на tx_drv_t, байт (уходит в линию на baud_actual)
+    uint64_t tx_drv_t;
+    uint64_t tx_drv_sync;   // последняя сверка с TIOCOUTQ
+    int      tx_drv_trusted;// сверка подтвердила очередь не ниже бюджета: ждать по оценке, без ioctl
+
+    uint32_t ep_events; // маска, под которой fd зарегистрирован в epoll (0 = не зарегистрирован)
+
+    gw_uart_stats_t stats; // переживают перезагрузку конфигурации (переезжают с gw_uart_move)
 } gw_uart_t;
 
-// Открыть и настроить UART (O_NONBLOCK, raw 8N1)
+#define GW_UART_RX_BUF_DEFAULT   4096
+#define GW_UART_TX_QUEUE_DEFAULT 8192
+
+// Открыть и настроить UART (O_NONBLOCK, raw 8N1), буферы по умолчанию.
+// Скорость любая: стандартные через Bxxx, остальные через termios2/BOTHER (Linux)
 int gw_uart_open(gw_uart_t* u, const char* dev_path, int baud);
 
+// То же с заданными размерами RX накопителя и каждой полосы TX очереди
+int gw_uart_open_ex(gw_uart_t* u, const char* dev_path, int baud, size_t rx_cap, size_t tx_cap);
+
 // Закрыть
 void gw_uart_close(gw_uart_t* u);
 
+// Перенести открытый UART в другую структуру (src становится закрытой, fd = -1)
+void gw_uart_move(gw_uart_t* dst, gw_uart_t* src);
+
+// Сменить скорость открытого порта без закрытия и сброса очередей
+int gw_uart_set_baud(gw_uart_t* u, int baud);
+
+// Сменить размеры RX накопителя и полос TX очереди с сохранением содержимого.
+// -1 (errno = ENOSPC), если накопленное не помещается в новый размер
+int gw_uart_resize(gw_uart_t* u, size_t rx_cap, size_t tx_cap);
+
 // fd для epoll
 int gw_uart_fd(const gw_uart_t* u);
 
 // Можно ли читать/писать
 int gw_uart_handle_read(gw_uart_t* u);   // читает в rx_buf, возвращает bytes read или <0
-int gw_uart_handle_write(gw_uart_t* u);  // пишет из tx_buf, возвращает bytes written или <0
+int gw_uart_handle_write(gw_uart_t* u);  // пишет из полос TX, возвращает bytes written или <0
+                                         // (срочные кадры — пока драйвер берёт, младшие — по кадру за вызов)
 
-// Поставить данные в очередь на отправку (не блокирует)
+// Поставить сырые байты в полосу bulk одним куском (не блокирует)
 int gw_uart_queue_tx(gw_uart_t* u, const uint8_t* data, size_t len);
 
-// Сколько байт в TX очереди
+// Сколько байт в TX очереди (все полосы)
 size_t gw_uart_tx_pending(const gw_uart_t* u);
 
+// Полоса для ECU кадра (по флагам и msg_type заголовка)
+unsigned gw_uart_lane_of(const uint8_t* frame, size_t frame_len);
+
+// Дописать принятые байты в rx_buf (чтение сделал не gw_uart_handle_read, а io_uring).
+// При переполнении накопитель сбрасывается, как в gw_uart_handle_read. Возвращает len
+int gw_uart_feed(gw_uart_t* u, const uint8_t* data, size_t len);
+
+// Непрерывный кусок следующей по приоритету полосы (для записи вне gw_uart_handle_write); 0 = пусто
+// или ждать (gw_uart_tx_hold_us). Кусок младшей полосы — не дальше конца одного кадра
+size_t gw_uart_tx_chunk(gw_uart_t* u, const uint8_t** data);
+
+// Мкс до конца ожидания младших полос (очередь драйвера не ниже бюджета): -1 = запись не ждёт,
+// 0 = срок вышел — снова вызвать gw_uart_handle_write/gw_uart_tx_chunk. Для таймаута цикла событий
+long gw_uart_tx_hold_us(const gw_uart_t* u, uint64_t now);
+
+// Снять n записанных байт с начала куска последнего gw_uart_tx_chunk
+void gw_uart_tx_advance(gw_uart_t* u, size_t n);
+
 // Очистить RX буфер (когда обработал)
 void gw_uart_rx_consume(gw_uart_t* u, size_t n);
 
@@ -51,5 +176,11 @@ void gw_uart_rx_consume(gw_uart_t* u, size_t n);
 // Возвращает: 1 = кадр получен (data,len), 0 = нет, -1 = ошибка (сброс/мусор)
 int gw_uart_try_get_slip_frame(gw_uart_t* u, const uint8_t** data, size_t* len);
 
-// Упаковать ECU-frame bytes (уже с CRC!) в SLIP и поставить в TX очередь
-int gw_uart_send_slip(gw_uart_t* u, const uint8_t* frame, size_t frame_len);
\ No newline at end of file
+// Упаковать ECU-frame bytes (уже с CRC!) в SLIP и поставить в полосу gw_uart_lane_of.
+// Команда, которую разрешает слить conflate, заменяет ждущую команду узлу с тем же command_id:
+// на её месте, если длина SLIP совпала, иначе старая выбрасывается, а новая встаёт в конец
+int gw_uart_send_slip(gw_uart_t* u, const uint8_t* frame, size_t frame_len);
+
+// То же с измерением задержки кадра (o = NULL — без измерения): отметка постановки —
+// gw_clock_now() вызывающего потока, отправки — в gw_uart_tx_advance
+int gw_uart_send_slip_ex(gw_uart_t* u, const uint8_t* frame, size_t frame_len, const gw_lat_origin_t* o);
\ No newline at end of file
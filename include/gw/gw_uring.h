@@ -0,0 +1,87 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gw/gw_state.h"
+
+// Цикл событий на io_uring ([gateway] backend = io_uring).
+// Чтение UART и клиентов — multishot запросы в общий кольцевой пул буферов (provided buffers),
+// запись в UART и клиентам за такт готовится пачкой и уходит в ядро вместе с ожиданием
+// следующих событий — один io_uring_enter на такт вместо epoll_wait + read/write/epoll_ctl на fd.
+// Ядро без нужных возможностей (или сборка без <linux/io_uring.h>) — GW_URING_UNAVAILABLE,
+// состояние не тронуто, и работает цикл epoll.
+#define GW_URING_UNAVAILABLE (-2)
+
+// Работать, пока не случится фатальная ошибка. -1 = ошибка, GW_URING_UNAVAILABLE = кольцо не создано
+int gw_uring_run(gw_state_t* st);
+
+#ifdef GW_HAVE_IO_URING
+#include <linux/io_uring.h>
+
+// IORING_OP_READ_MULTISHOT (Linux 6.7) — номер из ABI, в старых заголовках его нет
+#define GW_IORING_OP_READ_MULTISHOT 49
+
+// Кольцо io_uring на системных вызовах (без liburing) и пул буферов для чтения (группа 0)
+typedef struct {
+    int       fd;
+    unsigned  features;     // IORING_FEAT_*
+    unsigned  flags;        // IORING_SETUP_*, с которыми кольцо создано
+
+    // SQ: подготовленные, но ещё не отданные ядру записи — [*sq_tail, sq_local)
+    uint8_t*  sq_ptr;
+    size_t    sq_map;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned  sq_mask;
+    unsigned  sq_entries;
+    unsigned  sq_local;
+    struct io_uring_sqe* sqes;
+    size_t    sqes_map;
+
+    // CQ
+    uint8_t*  cq_ptr;
+    size_t    cq_map;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned  cq_mask;
+    struct io_uring_cqe* cqes;
+
+    // provided buffers
+    struct io_uring_buf_ring* br;
+    size_t    br_map;
+    uint8_t*  bufs;
+    unsigned  buf_count;    // степень двойки
+    unsigned  buf_size;
+    uint16_t  br_tail;
+
+    uint8_t   ops[64];      // поддерживаемые IORING_OP_* (IORING_REGISTER_PROBE)
+
+    uint64_t  enters;       // вызовов io_uring_enter (статистика)
+} gw_uring_t;
+
+// Создать кольцо на entries записей SQ и пул из buf_count буферов по buf_size байт.
+// Нужны IORING_FEAT_EXT_ARG (таймаут в io_uring_enter) и IORING_REGISTER_PBUF_RING (Linux 5.19).
+// 0 = OK, -1 = ошибка (errno)
+int  gw_uring_init(gw_uring_t* r, unsigned entries, unsigned buf_count, unsigned buf_size);
+void gw_uring_free(gw_uring_t* r);
+
+// Поддерживает ли ядро операцию op
+int  gw_uring_has_op(const gw_uring_t* r, unsigned op);
+
+// Свободная обнулённая запись SQ; если SQ заполнена — сначала отдать накопленное ядру.
+// NULL = места нет
+struct io_uring_sqe* gw_uring_sqe(gw_uring_t* r);
+
+// Отдать ядру подготовленные записи и дождаться хотя бы одного события — одним io_uring_enter.
+// timeout_us < 0 — без таймаута. 0 = OK (в том числе таймаут/EINTR), -1 = ошибка
+int  gw_uring_submit_wait(gw_uring_t* r, long timeout_us);
+
+// Очередное завершение (NULL = нет), затем gw_uring_cqe_seen()
+struct io_uring_cqe* gw_uring_cqe(gw_uring_t* r);
+void gw_uring_cqe_seen(gw_uring_t* r);
+
+// Данные буфера bid из пула; вернуть буфер в пул после обработки
+uint8_t* gw_uring_buf(gw_uring_t* r, unsigned bid);
+void gw_uring_buf_put(gw_uring_t* r, unsigned bid);
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ecu/ecu_log.h"
+#include "gw/gw_spsc.h"
+#include "gw/gw_uart.h"
+
+// Многопоточный режим ([gateway] threads = 1): каждый UART обслуживает свой поток.
+// Поток читает порт, выделяет SLIP кадры, проверяет их и кладёт в кольцо rx;
+// сетевой поток (epoll) забирает их по eventfd rx_efd, маршрутизирует и рассылает клиентам.
+// Кадры на UART идут обратно через кольца tx/tx_urgent и eventfd tx_efd: срочный кадр
+// (полоса GW_UART_LANE_URGENT) не ждёт в кольце за кадрами младших полос, worker берёт его первым.
+// Пока поток запущен, gw_uart_t принадлежит только ему.
+typedef struct {
+    gw_spsc_t  rx;        // worker -> net: проверенные ECU кадры
+    gw_spsc_t  tx;        // net -> worker: ECU кадры для отправки в UART (полосы ctrl и bulk)
+    gw_spsc_t  tx_urgent; // net -> worker: срочные кадры
+
+    gw_uart_t* uart;
+    int        idx;       // индекс UART в конфигурации
+    int        cpu;       // привязка потока к ядру (-1 = нет)
+    cpu_set_t  cpu_mask;  // маска, которую поток ставит себе при старте
+    ecu_log_t* raw_log;   // журнал сырых байт из порта (NULL = не писать)
+
+    int        rx_efd;    // eventfd: в rx есть кадры (ждёт сетевой поток)
+    int        tx_efd;    // eventfd: в tx есть кадры или просьба остановиться (ждёт worker)
+    int        tx_kick;   // сетевой поток положил кадры в tx, но ещё не разбудил worker
+    atomic_int tx_wait;   // кольцо tx (tx_urgent) было полно: worker будит сетевой поток (rx_efd), освободив место
+
+    pthread_t  thread;
+    int        running;
+    atomic_int stop;
+
+    // счётчики worker'а (читать можно из любого потока)
+    atomic_uint rx_frames;      // проверенных кадров передано в сетевой поток
+    atomic_uint rx_bad;         // кадров с ошибкой заголовка/CRC
+    atomic_uint rx_ring_drops;  // кольцо rx полно — сетевой поток не успевает
+    atomic_uint tx_frames;      // кадров поставлено в TX очередь UART
+    atomic_uint tx_ring_drops;  // при остановке не поместилось в очередь UART
+} gw_worker_t;
+
+// Создать кольца и eventfd, запустить поток для открытого UART.
+// ring_slots — кадров в кольцах rx и tx (в tx_urgent — четверть, не меньше 8); cpu < 0 — поток получает any_mask
+// (маску процесса до привязки сетевого потока), иначе только ядро cpu.
+// raw_log — журнал для сырых байт порта (-prev_show, tap), NULL = нет. 0 = OK, -1 = ошибка
+int  gw_worker_start(gw_worker_t* w, gw_uart_t* u, int idx, size_t ring_slots,
+                     int cpu, const cpu_set_t* any_mask, ecu_log_t* raw_log);
+
+// Остановить поток. Кадры из tx_urgent и tx переносятся в очередь UART, rx остаётся для вычитывания.
+void gw_worker_stop(gw_worker_t* w);
+
+// Освободить кольца и eventfd (после gw_worker_stop и вычитывания rx)
+void gw_worker_free(gw_worker_t* w);
+
+// Кольцо, через которое кадр идёт в поток UART: tx_urgent для полосы URGENT, иначе tx
+static inline gw_spsc_t* gw_worker_tx_ring(gw_worker_t* w, const uint8_t* frame, size_t len)
+{
+    return gw_uart_lane_of(frame, len) == GW_UART_LANE_URGENT ? &w->tx_urgent : &w->tx;
+}
+
+// Сетевой поток: кадр на UART, o — откуда он пришёл (измерение задержки). 0 = OK, -1 = кольцо кадра
+// (gw_worker_tx_ring) полно (поток UART разбудит сетевой через rx_efd, когда место освободится)
+int  gw_worker_send(gw_worker_t* w, const uint8_t* frame, size_t len, const gw_lat_origin_t* o);
+
+// Сетевой поток: разбудить worker, если с прошлого раза в tx что-то положили
+void gw_worker_kick(gw_worker_t* w);
+
+// Сетевой поток: сбросить счётчик rx_efd (перед вычитыванием кольца rx)
+void gw_worker_ack(gw_worker_t* w);
+
+// Привязать вызывающий (сетевой) поток к ядру cpu (cpu < 0 — ничего не делать). 0 = OK
+int  gw_worker_set_affinity(int cpu);
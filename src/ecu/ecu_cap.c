@@ -0,0 +1,350 @@
+// O_DIRECT
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "ecu/ecu_cap.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CAP_BLK_HDR ((uint32_t)sizeof(ecu_cap_block_t))
+
+static uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static ecu_cap_block_t* blk_hdr(ecu_cap_t* c)
+{
+    return (ecu_cap_block_t*)c->blk;
+}
+
+static void blk_reset(ecu_cap_t* c)
+{
+    memset(c->blk, 0, c->block_size);
+    ecu_cap_block_t* b = blk_hdr(c);
+    b->magic = ECU_CAP_BLOCK_MAGIC;
+    b->seq = c->blk_no;
+    b->used = CAP_BLK_HDR;
+}
+
+int ecu_cap_open(ecu_cap_t* c, const char* prefix, unsigned block_kb, uint64_t max_bytes,
+                 uint32_t max_sec, unsigned max_files)
+{
+    if (!c || !prefix || !*prefix) return -1;
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    if (strlen(prefix) >= sizeof(c->prefix) || block_kb < 4 || block_kb % 4 != 0 || block_kb > 4096) {
+        errno = EINVAL;
+        return -1;
+    }
+    snprintf(c->prefix, sizeof(c->prefix), "%s", prefix);
+    c->block_size = block_kb * 1024u;
+    c->max_bytes = max_bytes;
+    c->max_ns = (uint64_t)max_sec * 1000000000u;
+    c->max_files = max_files;
+
+    void* p = NULL;
+    if (posix_memalign(&p, ECU_CAP_ALIGN, c->block_size) != 0) return -1;
+    c->blk = (uint8_t*)p;
+    if (posix_memalign(&p, ECU_CAP_ALIGN, ECU_CAP_HDR_SIZE) != 0) {
+        ecu_cap_close(c);
+        return -1;
+    }
+    c->hdr = (uint8_t*)p;
+    if (max_files > 0) {
+        c->history = calloc(max_files, sizeof(*c->history));
+        if (!c->history) {
+            ecu_cap_close(c);
+            return -1;
+        }
+    }
+    atomic_init(&c->records, 0);
+    atomic_init(&c->blocks, 0);
+    atomic_init(&c->files, 0);
+    return 0;
+}
+
+void ecu_cap_set_uart(ecu_cap_t* c, unsigned idx, const char* name)
+{
+    if (!c || idx >= ECU_CAP_PORTS || !name) return;
+    snprintf(c->uart[idx], sizeof(c->uart[idx]), "%s", name);
+}
+
+// Целые выровненные блоки по выровненным смещениям. Если ФС не принимает O_DIRECT
+// (tmpfs, часть FUSE), файл переводится на обычную запись через кэш страниц
+static int write_at(ecu_cap_t* c, const uint8_t* buf, size_t len, uint64_t off)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t w = pwrite(c->fd, buf + done, len - done, (off_t)(off + done));
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && c->direct) {
+                int fl = fcntl(c->fd, F_GETFL);
+                if (fl >= 0 && fcntl(c->fd, F_SETFL, fl & ~O_DIRECT) == 0) {
+                    c->direct = 0;
+                    continue;
+                }
+            }
+            c->err = errno;
+            return -1;
+        }
+        done += (size_t)w;
+    }
+    return 0;
+}
+
+// Старые файлы сессии сверх max_files удаляются
+static void history_push(ecu_cap_t* c)
+{
+    if (!c->history) return;
+    char* slot = c->history[c->hist_head];
+    if (slot[0]) (void)unlink(slot);
+    snprintf(slot, sizeof(c->history[0]), "%s", c->path);
+    c->hist_head = (c->hist_head + 1) % c->max_files;
+}
+
+static int file_open(ecu_cap_t* c, uint64_t ts_ns)
+{
+    char stamp[16];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    // ротация в пределах секунды — суффикс -N
+    for (int n = 0; n < 100; n++) {
+        if (n == 0) snprintf(c->path, sizeof(c->path), "%s-%s.ecap", c->prefix, stamp);
+        else snprintf(c->path, sizeof(c->path), "%s-%s-%d.ecap", c->prefix, stamp, n);
+        int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+        c->fd = open(c->path, flags | O_DIRECT, 0644);
+        c->direct = c->fd >= 0;
+        if (c->fd < 0 && errno == EINVAL) c->fd = open(c->path, flags, 0644);
+        if (c->fd >= 0 || errno != EEXIST) break;
+    }
+    if (c->fd < 0) {
+        c->err = errno;
+        return -1;
+    }
+
+    memset(c->hdr, 0, ECU_CAP_HDR_SIZE);
+    ecu_cap_file_hdr_t* h = (ecu_cap_file_hdr_t*)c->hdr;
+    memcpy(h->magic, ECU_CAP_MAGIC, sizeof(h->magic));
+    h->version = ECU_CAP_VERSION;
+    h->block_size = c->block_size;
+    h->mono_ns = clock_ns(CLOCK_MONOTONIC);
+    h->real_ns = clock_ns(CLOCK_REALTIME);
+    h->file_no = c->file_no;
+    memcpy(h->uart, c->uart, sizeof(h->uart));
+    if (write_at(c, c->hdr, ECU_CAP_HDR_SIZE, 0) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+
+    c->file_no++;
+    c->file_start_ns = ts_ns;
+    c->blk_no = 0;
+    blk_reset(c);
+    history_push(c);
+    atomic_fetch_add_explicit(&c->files, 1u, memory_order_relaxed);
+    return 0;
+}
+
+static int block_finish(ecu_cap_t* c)
+{
+    if (blk_hdr(c)->records == 0) return 0;
+    if (write_at(c, c->blk, c->block_size, ECU_CAP_HDR_SIZE + (uint64_t)c->blk_no * c->block_size) < 0) return -1;
+    c->blk_no++;
+    blk_reset(c);
+    atomic_fetch_add_explicit(&c->blocks, 1u, memory_order_relaxed);
+    return 0;
+}
+
+static void file_close(ecu_cap_t* c)
+{
+    if (c->fd < 0) return;
+    (void)block_finish(c);
+    close(c->fd);
+    c->fd = -1;
+}
+
+int ecu_cap_write(ecu_cap_t* c, uint64_t ts_ns, unsigned port, unsigned dir, unsigned flags,
+                  const uint8_t* data, size_t len)
+{
+    if (!c || !c->blk || c->err) return -1;
+    size_t max = c->block_size - CAP_BLK_HDR - sizeof(ecu_cap_rec_t);
+    if (len > max) len = max;
+    if (len > 0xFFFFu) len = 0xFFFFu;
+    size_t need = ECU_CAP_REC_SIZE(len);
+
+    if (c->fd >= 0 && c->max_ns && ts_ns - c->file_start_ns >= c->max_ns) file_close(c);
+    if (c->fd >= 0 && blk_hdr(c)->used + need > c->block_size) {
+        if (block_finish(c) < 0) return -1;
+        // следующий блок не влезает в предел размера — новый файл
+        if (c->max_bytes && ECU_CAP_HDR_SIZE + (uint64_t)(c->blk_no + 1) * c->block_size > c->max_bytes) file_close(c);
+    }
+    if (c->fd < 0 && file_open(c, ts_ns) < 0) return -1;
+
+    ecu_cap_block_t* b = blk_hdr(c);
+    ecu_cap_rec_t* r = (ecu_cap_rec_t*)(c->blk + b->used);
+    r->ts_ns = ts_ns;
+    r->len = (uint16_t)len;
+    r->port = (uint8_t)port;
+    r->dir = (uint8_t)dir;
+    r->flags = (uint16_t)flags;
+    r->reserved = 0;
+    if (len) memcpy(r + 1, data, len);
+
+    if (b->records == 0) b->first_ns = ts_ns;
+    b->last_ns = ts_ns;
+    b->records++;
+    b->used += (uint32_t)need;
+    atomic_fetch_add_explicit(&c->records, 1u, memory_order_relaxed);
+    return 0;
+}
+
+int ecu_cap_sync(ecu_cap_t* c)
+{
+    if (!c || c->err) return -1;
+    if (c->fd < 0 || blk_hdr(c)->records == 0) return 0;
+    return write_at(c, c->blk, c->block_size, ECU_CAP_HDR_SIZE + (uint64_t)c->blk_no * c->block_size);
+}
+
+void ecu_cap_close(ecu_cap_t* c)
+{
+    if (!c) return;
+    if (!c->err) file_close(c);
+    else if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    free(c->blk);
+    free(c->hdr);
+    free(c->history);
+    c->blk = NULL;
+    c->hdr = NULL;
+    c->history = NULL;
+}
+
+int ecu_cap_reader_open(ecu_cap_reader_t* r, const char* path)
+{
+    if (!r || !path) return -1;
+    memset(r, 0, sizeof(*r));
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (r->fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(r->fd, &st) < 0 || pread(r->fd, &r->hdr, sizeof(r->hdr), 0) != (ssize_t)sizeof(r->hdr) ||
+        memcmp(r->hdr.magic, ECU_CAP_MAGIC, sizeof(r->hdr.magic)) != 0 || r->hdr.version != ECU_CAP_VERSION ||
+        r->hdr.block_size < ECU_CAP_ALIGN || r->hdr.block_size % ECU_CAP_ALIGN != 0) {
+        close(r->fd);
+        r->fd = -1;
+        errno = EINVAL;
+        return -1;
+    }
+    // хвост, оборванный посреди блока, тоже блок — заголовок покажет, сколько в нём целого
+    uint64_t body = (uint64_t)st.st_size > ECU_CAP_HDR_SIZE ? (uint64_t)st.st_size - ECU_CAP_HDR_SIZE : 0;
+    r->blocks = (uint32_t)(body / r->hdr.block_size);
+    if (body % r->hdr.block_size >= CAP_BLK_HDR) r->blocks++;
+    return 0;
+}
+
+void ecu_cap_reader_close(ecu_cap_reader_t* r)
+{
+    if (!r || r->fd < 0) return;
+    if (r->map) munmap((void*)r->map, r->map_len);
+    r->map = NULL;
+    close(r->fd);
+    r->fd = -1;
+}
+
+static int block_hdr_ok(const ecu_cap_reader_t* r, uint32_t idx, const ecu_cap_block_t* b)
+{
+    return b->magic == ECU_CAP_BLOCK_MAGIC && b->seq == idx && b->records > 0 && b->used >= CAP_BLK_HDR &&
+           b->used <= r->hdr.block_size && b->first_ns <= b->last_ns;
+}
+
+int ecu_cap_read_block_hdr(ecu_cap_reader_t* r, uint32_t idx, ecu_cap_block_t* out)
+{
+    if (!r || r->fd < 0 || idx >= r->blocks) return -1;
+    off_t off = (off_t)(ECU_CAP_HDR_SIZE + (uint64_t)idx * r->hdr.block_size);
+    if (pread(r->fd, out, sizeof(*out), off) != (ssize_t)sizeof(*out)) return -1;
+    return block_hdr_ok(r, idx, out) ? 0 : -1;
+}
+
+int ecu_cap_read_block(ecu_cap_reader_t* r, uint32_t idx, uint8_t* buf)
+{
+    if (!r || r->fd < 0 || idx >= r->blocks) return -1;
+    off_t off = (off_t)(ECU_CAP_HDR_SIZE + (uint64_t)idx * r->hdr.block_size);
+    ssize_t n = pread(r->fd, buf, r->hdr.block_size, off);
+    if (n < (ssize_t)CAP_BLK_HDR) return -1;
+    const ecu_cap_block_t* b = (const ecu_cap_block_t*)buf;
+    if (!block_hdr_ok(r, idx, b)) return -1;
+    // оборванный блок: целы только записи в прочитанной части
+    if ((uint32_t)n < b->used) {
+        memset(buf + n, 0, r->hdr.block_size - (size_t)n);
+        ((ecu_cap_block_t*)buf)->used = (uint32_t)n;
+    }
+    return 0;
+}
+
+int ecu_cap_map(ecu_cap_reader_t* r)
+{
+    if (!r || r->fd < 0) return -1;
+    if (r->map) return 0;
+    struct stat st;
+    if (fstat(r->fd, &st) < 0) return -1;
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+    if (p == MAP_FAILED) return -1;
+    // разбор идёт подряд: ядро читает вперёд крупно
+    (void)madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    r->map = (const uint8_t*)p;
+    r->map_len = (size_t)st.st_size;
+    return 0;
+}
+
+const uint8_t* ecu_cap_block_at(const ecu_cap_reader_t* r, uint32_t idx)
+{
+    if (!r || !r->map || idx >= r->blocks) return NULL;
+    uint64_t off = ECU_CAP_HDR_SIZE + (uint64_t)idx * r->hdr.block_size;
+    if (off + CAP_BLK_HDR > r->map_len) return NULL;
+    const ecu_cap_block_t* b = (const ecu_cap_block_t*)(r->map + off);
+    // чтение за концом отображения — SIGBUS: оборванный блок не отдаём
+    if (!block_hdr_ok(r, idx, b) || off + b->used > r->map_len) return NULL;
+    return r->map + off;
+}
+
+uint32_t ecu_cap_seek(ecu_cap_reader_t* r, uint64_t ts_ns)
+{
+    if (!r || r->fd < 0) return 0;
+    // блоки упорядочены по времени; испорченный (только хвост файла) считается «позже»
+    uint32_t lo = 0, hi = r->blocks;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        ecu_cap_block_t b;
+        if (ecu_cap_read_block_hdr(r, mid, &b) < 0 || b.last_ns >= ts_ns) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+const ecu_cap_rec_t* ecu_cap_next(const uint8_t* blk, uint32_t block_size, uint32_t* off)
+{
+    const ecu_cap_block_t* b = (const ecu_cap_block_t*)blk;
+    uint32_t used = b->used <= block_size ? b->used : block_size;
+    if (*off < CAP_BLK_HDR || (size_t)*off + sizeof(ecu_cap_rec_t) > used) return NULL;
+    const ecu_cap_rec_t* r = (const ecu_cap_rec_t*)(blk + *off);
+    size_t sz = ECU_CAP_REC_SIZE(r->len);
+    if (*off + sz > used) return NULL;
+    *off += (uint32_t)sz;
+    return r;
+}
@@ -0,0 +1,496 @@
+// SCHED_IDLE
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "ecu/ecu_log.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_DRAIN_PERIOD_MS 10
+#define LOG_BIN_BUF         (64 * 1024)
+#define LOG_TAP_BUF         (16 * 1024)     // пакет tap: не больше 16 КБ целых записей
+#define LOG_TAP_SNDBUF      (1024 * 1024)   // буфер сокета читателя: ~1 с трафика всех UART
+#define LOG_CAP_SYNC_NS     1000000000ull   // неполный блок capture — на диск раз в секунду
+
+int ecu_log_init(ecu_log_t* l, size_t records)
+{
+    if (!l || records == 0) return -1;
+    memset(l, 0, sizeof(*l));
+    l->bin_fd = -1;
+    l->tap_fd = -1;
+    for (int i = 0; i < ECU_LOG_TAP_READERS; i++) l->tap_reader[i] = -1;
+
+    size_t n = 1;
+    while (n < records) n <<= 1;
+    l->slots = (ecu_log_slot_t*)calloc(n, sizeof(*l->slots));
+    if (!l->slots) return -1;
+    l->mask = (uint32_t)(n - 1);
+    for (size_t i = 0; i < n; i++) atomic_init(&l->slots[i].seq, (uint32_t)i);
+    atomic_init(&l->head, 0);
+    atomic_init(&l->drops, 0);
+    atomic_init(&l->idle, 0);
+    atomic_init(&l->written, 0);
+    atomic_init(&l->tap_drops, 0);
+    atomic_init(&l->tap_readers, 0);
+    atomic_init(&l->stop, 0);
+    return 0;
+}
+
+static void tap_close(ecu_log_t* l);
+
+void ecu_log_free(ecu_log_t* l)
+{
+    if (!l) return;
+    ecu_log_stop(l);
+    tap_close(l);
+    free(l->slots);
+    l->slots = NULL;
+}
+
+static int write_one(ecu_log_t* l, unsigned kind, unsigned port, uint64_t ts_us, const uint8_t* data, size_t len)
+{
+    // занять позицию: слот свободен для pos, когда его seq == pos (очередь Вьюкова)
+    uint32_t pos = atomic_load_explicit(&l->head, memory_order_relaxed);
+    ecu_log_slot_t* s;
+    for (;;) {
+        s = &l->slots[pos & l->mask];
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&l->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) break;
+        } else if (dif < 0) {
+            // читатель ещё не освободил слот — кольцо полно
+            atomic_fetch_add_explicit(&l->drops, 1u, memory_order_relaxed);
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&l->head, memory_order_relaxed);
+        }
+    }
+
+    ecu_log_rec_t* r = &s->rec;
+    size_t cap = len < ECU_LOG_SNAP ? len : ECU_LOG_SNAP;
+    r->ts_us = ts_us;
+    r->len = (uint16_t)(len > 0xFFFFu ? 0xFFFFu : len);
+    r->cap_len = (uint16_t)cap;
+    r->kind = (uint8_t)kind;
+    r->port = (uint8_t)(port > ECU_LOG_PORT_NONE ? ECU_LOG_PORT_NONE : port);
+    r->reserved = 0;
+    if (cap) memcpy(r->data, data, cap);
+
+    // запись видна читателю вместе с данными
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+int ecu_log_write(ecu_log_t* l, unsigned kind, unsigned port, uint64_t ts_us,
+                  const uint8_t* data, size_t len)
+{
+    if (!l || !l->slots) return -1;
+    // смотреть некому — ни копии, ни счёта потерь
+    if (atomic_load_explicit(&l->idle, memory_order_relaxed)) return 0;
+    if (len <= ECU_LOG_SNAP || !(ECU_LOG_KINDS_RAW & ECU_LOG_KIND_BIT(kind))) {
+        return write_one(l, kind, port, ts_us, data, len);
+    }
+
+    // поток байт можно резать где угодно — capture и tap получают его целиком
+    int rc = 0;
+    for (size_t off = 0; off < len; off += ECU_LOG_SNAP) {
+        size_t n = len - off < ECU_LOG_SNAP ? len - off : ECU_LOG_SNAP;
+        if (write_one(l, kind, port, ts_us, data + off, n) < 0) rc = -1;
+    }
+    return rc;
+}
+
+const ecu_log_rec_t* ecu_log_peek(ecu_log_t* l)
+{
+    ecu_log_slot_t* s = &l->slots[l->tail & l->mask];
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    if (seq != l->tail + 1) return NULL;
+    return &s->rec;
+}
+
+void ecu_log_pop(ecu_log_t* l)
+{
+    ecu_log_slot_t* s = &l->slots[l->tail & l->mask];
+    // слот свободен для позиции на круг вперёд
+    atomic_store_explicit(&s->seq, l->tail + l->mask + 1, memory_order_release);
+    l->tail++;
+    atomic_store_explicit(&l->written, atomic_load_explicit(&l->written, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+const char* ecu_log_kind_name(unsigned kind)
+{
+    switch (kind) {
+        case ECU_LOG_RAW_UART: return "RAW UART";
+        case ECU_LOG_RAW_NET:  return "RAW NET";
+        case ECU_LOG_RX_UART:  return "RX UART";
+        case ECU_LOG_RX_NET:   return "RX NET";
+        case ECU_LOG_TX_NET:   return "PROC UART->NET";
+        case ECU_LOG_TX_UART:  return "PROC NET->UART";
+        case ECU_LOG_FWD_UART: return "PROC UART->UART";
+        case ECU_LOG_TEST:     return "TEST ECU";
+        case ECU_LOG_LOST:     return "LOST";
+        default:               return "?";
+    }
+}
+
+void ecu_log_print(FILE* out, const ecu_log_rec_t* r)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char line[64 + ECU_LOG_SNAP * 3 + 8];
+    int n;
+
+    if (r->port == ECU_LOG_PORT_NONE) {
+        n = snprintf(line, 64, "%llu.%06llu %s len=%u: ", (unsigned long long)(r->ts_us / 1000000u),
+                     (unsigned long long)(r->ts_us % 1000000u), ecu_log_kind_name(r->kind), (unsigned)r->len);
+    } else {
+        n = snprintf(line, 64, "%llu.%06llu %s [%u] len=%u: ", (unsigned long long)(r->ts_us / 1000000u),
+                     (unsigned long long)(r->ts_us % 1000000u), ecu_log_kind_name(r->kind), (unsigned)r->port,
+                     (unsigned)r->len);
+    }
+    if (n < 0) return;
+    if (n > 63) n = 63;
+
+    // одна строка целиком и один fwrite, без fprintf на байт
+    char* p = line + n;
+    for (unsigned i = 0; i < r->cap_len; i++) {
+        if (i) *p++ = ' ';
+        *p++ = hex[r->data[i] >> 4];
+        *p++ = hex[r->data[i] & 0x0F];
+    }
+    if (r->cap_len < r->len) {
+        memcpy(p, " ...", 4);
+        p += 4;
+    }
+    *p++ = '\n';
+    fwrite(line, 1, (size_t)(p - line), out);
+}
+
+static void bin_flush(ecu_log_t* l)
+{
+    size_t off = 0;
+    while (l->bin_fd >= 0 && off < l->bin_len) {
+        ssize_t w = write(l->bin_fd, l->bin_buf + off, l->bin_len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            // приёмник пропал — дальше только текст (если есть)
+            l->bin_fd = -1;
+            break;
+        }
+        off += (size_t)w;
+    }
+    l->bin_len = 0;
+}
+
+static void bin_add(ecu_log_t* l, const ecu_log_rec_t* r)
+{
+    size_t n = ECU_LOG_REC_HDR + r->cap_len;
+    if (l->bin_len + n > LOG_BIN_BUF) bin_flush(l);
+    memcpy(l->bin_buf + l->bin_len, r, n);
+    l->bin_len += n;
+}
+
+int ecu_log_tap(ecu_log_t* l, const char* path)
+{
+    if (!l || !path || l->running || l->tap_fd >= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct sockaddr_un a;
+    memset(&a, 0, sizeof(a));
+    a.sun_family = AF_UNIX;
+    size_t plen = strlen(path);
+    if (plen == 0 || plen >= sizeof(a.sun_path) || plen >= sizeof(l->tap_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(a.sun_path, path, plen);
+
+    // сокет от прошлого запуска; чужой файл не трогаем — bind вернёт EADDRINUSE
+    struct stat sb;
+    if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode)) (void)unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (const struct sockaddr*)&a, sizeof(a)) < 0 || listen(fd, ECU_LOG_TAP_READERS) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    l->tap_fd = fd;
+    memcpy(l->tap_path, path, plen + 1);
+    return 0;
+}
+
+static void tap_drop_reader(ecu_log_t* l, int i)
+{
+    close(l->tap_reader[i]);
+    l->tap_reader[i] = -1;
+    l->tap_lost[i] = 0;
+    atomic_fetch_sub_explicit(&l->tap_readers, 1, memory_order_relaxed);
+}
+
+static void tap_close(ecu_log_t* l)
+{
+    for (int i = 0; i < ECU_LOG_TAP_READERS; i++) {
+        if (l->tap_reader[i] >= 0) tap_drop_reader(l, i);
+    }
+    if (l->tap_fd >= 0) {
+        close(l->tap_fd);
+        l->tap_fd = -1;
+        (void)unlink(l->tap_path);
+    }
+}
+
+// Пакет без ожидания. 1 = отправлен, 0 = буфер сокета полон, -1 = читатель отключился
+static int tap_send_one(int fd, const void* buf, size_t len)
+{
+    if (send(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) return 1;
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) ? 0 : -1;
+}
+
+static void tap_flush(ecu_log_t* l, uint32_t records)
+{
+    for (int i = 0; i < ECU_LOG_TAP_READERS && l->tap_len > 0; i++) {
+        int fd = l->tap_reader[i];
+        if (fd < 0) continue;
+        int rc = 1;
+        if (l->tap_lost[i] > 0) {
+            // сначала сказать читателю, сколько он пропустил
+            ecu_log_rec_t lost;
+            memset(&lost, 0, ECU_LOG_REC_HDR);
+            lost.ts_us = ((const ecu_log_rec_t*)l->tap_buf)->ts_us;
+            lost.len = lost.cap_len = sizeof(uint32_t);
+            lost.kind = ECU_LOG_LOST;
+            lost.port = ECU_LOG_PORT_NONE;
+            memcpy(lost.data, &l->tap_lost[i], sizeof(uint32_t));
+            rc = tap_send_one(fd, &lost, ECU_LOG_REC_HDR + sizeof(uint32_t));
+            if (rc > 0) l->tap_lost[i] = 0;
+        }
+        if (rc > 0) rc = tap_send_one(fd, l->tap_buf, l->tap_len);
+        if (rc < 0) {
+            tap_drop_reader(l, i);
+        } else if (rc == 0) {
+            // читатель отстал: ядро не берёт пакет — он теряется только для этого читателя
+            l->tap_lost[i] += records;
+            atomic_fetch_add_explicit(&l->tap_drops, records, memory_order_relaxed);
+        }
+    }
+    l->tap_len = 0;
+}
+
+// Новые читатели и отключившиеся; ждать не дольше timeout_ms
+static void tap_poll(ecu_log_t* l, int timeout_ms)
+{
+    struct pollfd p[1 + ECU_LOG_TAP_READERS];
+    int slot[1 + ECU_LOG_TAP_READERS];
+    int n = 0;
+    p[n].fd = l->tap_fd;
+    p[n].events = POLLIN;
+    slot[n++] = -1;
+    for (int i = 0; i < ECU_LOG_TAP_READERS; i++) {
+        if (l->tap_reader[i] < 0) continue;
+        p[n].fd = l->tap_reader[i];
+        p[n].events = POLLIN;
+        slot[n++] = i;
+    }
+    if (poll(p, (nfds_t)n, timeout_ms) <= 0) return;
+
+    for (int k = 1; k < n; k++) {
+        if (!p[k].revents) continue;
+        // читатель ничего не шлёт: 0 байт или ошибка — отключился, данные — выбросить
+        char junk[64];
+        ssize_t r = recv(p[k].fd, junk, sizeof(junk), MSG_DONTWAIT);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK) || (p[k].revents & (POLLHUP | POLLERR))) {
+            tap_drop_reader(l, slot[k]);
+        }
+    }
+    if (!(p[0].revents & POLLIN)) return;
+
+    int fd;
+    while ((fd = accept4(l->tap_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        int i = 0;
+        while (i < ECU_LOG_TAP_READERS && l->tap_reader[i] >= 0) i++;
+        if (i == ECU_LOG_TAP_READERS) {
+            close(fd);
+            continue;
+        }
+        int sz = LOG_TAP_SNDBUF;
+        (void)setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+        l->tap_reader[i] = fd;
+        l->tap_lost[i] = 0;
+        atomic_fetch_add_explicit(&l->tap_readers, 1, memory_order_relaxed);
+    }
+}
+
+void ecu_log_capture(ecu_log_t* l, ecu_cap_t* cap)
+{
+    if (!l || l->running) return;
+    l->cap = cap;
+}
+
+int ecu_log_cap_port(unsigned kind, unsigned port, unsigned* cap_port, unsigned* dir, unsigned* flags)
+{
+    unsigned uart = port == ECU_LOG_PORT_NONE ? ECU_CAP_PORT_NONE : port;
+    unsigned net = port == ECU_LOG_PORT_NONE ? ECU_CAP_PORT_NONE : (ECU_CAP_PORT_NET | (port & 0x7Fu));
+    switch (kind) {
+        case ECU_LOG_RAW_UART: *dir = ECU_CAP_RX; *flags = ECU_CAP_F_RAW; *cap_port = uart; break;
+        case ECU_LOG_RAW_NET:  *dir = ECU_CAP_RX; *flags = ECU_CAP_F_RAW; *cap_port = net; break;
+        case ECU_LOG_RX_UART:  *dir = ECU_CAP_RX; *flags = ECU_CAP_F_FRAME; *cap_port = uart; break;
+        case ECU_LOG_RX_NET:   *dir = ECU_CAP_RX; *flags = ECU_CAP_F_FRAME; *cap_port = net; break;
+        // port записи TX NET — UART-источник, кадр уходит всем клиентам
+        case ECU_LOG_TX_NET:   *dir = ECU_CAP_TX; *flags = ECU_CAP_F_FRAME; *cap_port = ECU_CAP_PORT_NET_ALL; break;
+        case ECU_LOG_TX_UART:  *dir = ECU_CAP_TX; *flags = ECU_CAP_F_FRAME; *cap_port = uart; break;
+        case ECU_LOG_FWD_UART: *dir = ECU_CAP_TX; *flags = ECU_CAP_F_FRAME | ECU_CAP_F_FWD; *cap_port = uart; break;
+        default: return -1;
+    }
+    return 0;
+}
+
+static void cap_add(ecu_log_t* l, const ecu_log_rec_t* r)
+{
+    unsigned port, dir, flags;
+    if (ecu_log_cap_port(r->kind, r->port, &port, &dir, &flags) < 0) return;
+    // ошибка записи (диск полон) — capture остановлен, причина в cap->err
+    if (ecu_cap_write(l->cap, r->ts_us * 1000u, port, dir, flags, r->data, r->cap_len) < 0) l->cap = NULL;
+}
+
+// Вычитать всё, что есть. Возвращает число записей
+static unsigned drain(ecu_log_t* l)
+{
+    unsigned n = 0;
+    uint32_t tap_n = 0;
+    int tap = ecu_log_tap_readers(l) > 0;
+    const ecu_log_rec_t* r;
+    while ((r = ecu_log_peek(l)) != NULL) {
+        if (l->text && (l->text_kinds & ECU_LOG_KIND_BIT(r->kind))) ecu_log_print(l->text, r);
+        if (l->bin_fd >= 0) bin_add(l, r);
+        if (l->cap) cap_add(l, r);
+        if (tap) {
+            size_t sz = ECU_LOG_REC_HDR + r->cap_len;
+            if (l->tap_len + sz > LOG_TAP_BUF) {
+                tap_flush(l, tap_n);
+                tap_n = 0;
+            }
+            memcpy(l->tap_buf + l->tap_len, r, sz);
+            l->tap_len += sz;
+            tap_n++;
+        }
+        ecu_log_pop(l);
+        n++;
+    }
+    if (n) {
+        if (l->text) fflush(l->text);
+        if (l->bin_fd >= 0) bin_flush(l);
+        if (tap) tap_flush(l, tap_n);
+    }
+    return n;
+}
+
+// Писателям можно не копировать записи, пока их некому отдать
+static void update_idle(ecu_log_t* l)
+{
+    int idle = !l->text && l->bin_fd < 0 && !l->cap && ecu_log_tap_readers(l) == 0;
+    atomic_store_explicit(&l->idle, idle, memory_order_relaxed);
+}
+
+static void cap_sync(ecu_log_t* l)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    if (now - l->cap_sync_ns < LOG_CAP_SYNC_NS) return;
+    l->cap_sync_ns = now;
+    if (ecu_cap_sync(l->cap) < 0) l->cap = NULL;
+}
+
+static void* drain_main(void* arg)
+{
+    ecu_log_t* l = (ecu_log_t*)arg;
+
+    // только свободное от пересылки время процессора
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    (void)pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+
+    // писатели не будят поток (ни одного системного вызова на кадр) — опрос по таймеру;
+    // с tap ожидание — poll() на сокетах tap с тем же периодом
+    const struct timespec period = { 0, LOG_DRAIN_PERIOD_MS * 1000000L };
+    while (!atomic_load_explicit(&l->stop, memory_order_acquire)) {
+        unsigned n = drain(l);
+        if (l->tap_fd >= 0) tap_poll(l, n ? 0 : LOG_DRAIN_PERIOD_MS);
+        else if (n == 0) nanosleep(&period, NULL);
+        if (l->cap) cap_sync(l);
+        update_idle(l);
+    }
+    drain(l);
+    if (l->cap) (void)ecu_cap_sync(l->cap);
+    return NULL;
+}
+
+int ecu_log_start(ecu_log_t* l, FILE* text, uint32_t text_kinds, int bin_fd)
+{
+    if (!l || !l->slots || l->running) return -1;
+    l->text = text;
+    l->text_kinds = text_kinds;
+    l->bin_fd = bin_fd;
+    l->bin_len = 0;
+    l->tap_len = 0;
+    if (bin_fd >= 0) {
+        l->bin_buf = (uint8_t*)malloc(LOG_BIN_BUF);
+        if (!l->bin_buf) return -1;
+    }
+    if (l->tap_fd >= 0) {
+        l->tap_buf = (uint8_t*)malloc(LOG_TAP_BUF);
+        if (!l->tap_buf) {
+            free(l->bin_buf);
+            l->bin_buf = NULL;
+            return -1;
+        }
+    }
+    atomic_store_explicit(&l->stop, 0, memory_order_relaxed);
+    update_idle(l);
+
+    // сигналы процесса (SIGHUP/SIGUSR1 через signalfd) не должны доставаться потоку журнала
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rc = pthread_create(&l->thread, NULL, drain_main, l);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        free(l->bin_buf);
+        l->bin_buf = NULL;
+        free(l->tap_buf);
+        l->tap_buf = NULL;
+        errno = rc;
+        return -1;
+    }
+    l->running = 1;
+    return 0;
+}
+
+void ecu_log_stop(ecu_log_t* l)
+{
+    if (!l || !l->running) return;
+    atomic_store_explicit(&l->stop, 1, memory_order_release);
+    pthread_join(l->thread, NULL);
+    l->running = 0;
+    tap_close(l);
+    free(l->bin_buf);
+    l->bin_buf = NULL;
+    free(l->tap_buf);
+    l->tap_buf = NULL;
+}
@@ -1,6 +1,7 @@
 #include "ecu/ecu_proto.h"
 #include "ecu/ecu_limits.h"
 #include <stddef.h>
+#include <string.h>
 
 int ecu_hdr_validate(const ecu_hdr_t* h)
 {
@@ -41,3 +42,38 @@ int ecu_frame_check_crc(const ecu_hdr_t* h, const uint8_t* payload, uint16_t crc
     uint16_t calc = ecu_frame_calc_crc2(h, payload);
     return (calc == crc_le) ? 1 : 0;
 }
+
+size_t ecu_frame_pack(const ecu_hdr_t* h, const uint8_t* payload, uint8_t* out, size_t out_cap)
+{
+    if (!h || !out) return 0;
+    size_t len = (size_t)ECU_HEADER_SIZE + (size_t)h->payload_len + ECU_CRC_SIZE;
+    if (len > out_cap) return 0;
+    if (h->payload_len && !payload) return 0;
+
+    uint16_t crc = ecu_frame_calc_crc2(h, payload);
+    memcpy(out, h, ECU_HEADER_SIZE);
+    if (h->payload_len) memcpy(out + ECU_HEADER_SIZE, payload, h->payload_len);
+    memcpy(out + ECU_HEADER_SIZE + h->payload_len, &crc, ECU_CRC_SIZE);
+    return len;
+}
+
+int ecu_frame_validate(const uint8_t* frame, size_t frame_len,
+                       const ecu_hdr_t** out_hdr, const uint8_t** out_payload)
+{
+    if (!frame || frame_len < ECU_HEADER_SIZE + ECU_CRC_SIZE) return 0;
+
+    const ecu_hdr_t* h = (const ecu_hdr_t*)frame;
+    if (!ecu_hdr_validate(h)) return 0;
+
+    size_t need = (size_t)ECU_HEADER_SIZE + (size_t)h->payload_len + ECU_CRC_SIZE;
+    if (frame_len != need) return 0;
+
+    const uint8_t* payload = frame + ECU_HEADER_SIZE;
+    uint16_t crc_le;
+    memcpy(&crc_le, frame + ECU_HEADER_SIZE + h->payload_len, sizeof(crc_le));
+    if (!ecu_frame_check_crc(h, payload, crc_le)) return 0;
+
+    if (out_hdr) *out_hdr = h;
+    if (out_payload) *out_payload = payload;
+    return 1;
+}
@@ -9,6 +9,7 @@ void slip_rx_init(slip_rx_t* s, uint8_t* out_buf, size_t out_cap)
     s->in_frame = 0;
     s->frames = 0;
     s->drops = 0;
+    s->consumed = 0;
 }
 
 static int slip_rx_put(slip_rx_t* s, uint8_t b)
@@ -29,9 +30,11 @@ int slip_rx_push(slip_rx_t* s, const uint8_t* data, size_t len, size_t* frame_le
 {
     if (frame_len) *frame_len = 0;
     int got_frame = 0;
+    s->consumed = 0;
 
     for (size_t i = 0; i < len; i++) {
         uint8_t b = data[i];
+        s->consumed = i + 1;
 
         if (b == SLIP_END) {
             if (s->in_frame && s->out_len > 0) {
@@ -0,0 +1,67 @@
+#include "gw/gw_ackmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint16_t gw_ackmap_next(gw_ackmap_t* m, uint8_t node)
+{
+    if (!m) return 0;
+    gw_ackmap_node_t* t = m->node[node];
+    if (!t) {
+        t = (gw_ackmap_node_t*)calloc(1, sizeof(*t));
+        if (!t) return 0;
+        t->next_seq = 1;
+        m->node[node] = t;
+    }
+    return t->next_seq;
+}
+
+void gw_ackmap_put(gw_ackmap_t* m, uint8_t node, uint16_t gw_seq, uint32_t client_id, uint16_t client_seq)
+{
+    gw_ackmap_node_t* t = m ? m->node[node] : NULL;
+    if (!t || gw_seq == 0) return;
+
+    gw_ackmap_ent_t* e = &t->ent[gw_seq % GW_ACKMAP_SLOTS];
+    if (e->client_id != 0 && e->gw_seq != gw_seq) m->overwritten++;
+    e->client_id = client_id;
+    e->gw_seq = gw_seq;
+    e->client_seq = client_seq;
+    m->mapped++;
+
+    t->next_seq = (uint16_t)(gw_seq + 1);
+    if (t->next_seq == 0) t->next_seq = 1;
+}
+
+int gw_ackmap_take(gw_ackmap_t* m, uint8_t node, uint16_t gw_seq, uint32_t* client_id,
+                   uint16_t* client_seq)
+{
+    gw_ackmap_node_t* t = m ? m->node[node] : NULL;
+    if (!t) return 0;
+    gw_ackmap_ent_t* e = &t->ent[gw_seq % GW_ACKMAP_SLOTS];
+    if (e->client_id == 0 || e->gw_seq != gw_seq) return 0;
+    *client_id = e->client_id;
+    *client_seq = e->client_seq;
+    e->client_id = 0;
+    return 1;
+}
+
+void gw_ackmap_drop_client(gw_ackmap_t* m, uint32_t client_id)
+{
+    if (!m || client_id == 0) return;
+    for (int n = 0; n < GW_ACKMAP_NODES; n++) {
+        gw_ackmap_node_t* t = m->node[n];
+        if (!t) continue;
+        for (int i = 0; i < GW_ACKMAP_SLOTS; i++) {
+            if (t->ent[i].client_id != client_id) continue;
+            t->ent[i].client_id = 0;
+            m->forgotten++;
+        }
+    }
+}
+
+void gw_ackmap_free(gw_ackmap_t* m)
+{
+    if (!m) return;
+    for (int i = 0; i < GW_ACKMAP_NODES; i++) free(m->node[i]);
+    memset(m, 0, sizeof(*m));
+}
@@ -1,14 +1,21 @@
 #include "gw/gw_app.h"
 
+#include "gw/gw_clock.h"
 #include "gw/gw_net.h"
 #include "gw/gw_uart.h"
 #include "gw/gw_router.h"
 #include "gw/gw_cmd_ui.h"
+#include "gw/gw_config.h"
+#include "gw/gw_dispatch.h"
+#include "gw/gw_send_test.h"
+#include "gw/gw_state.h"
+#include "gw/gw_uring.h"
 
 #include "ecu/ecu_limits.h"
 #include "ecu/ecu_proto.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,9 +26,6 @@
 #include <sys/socket.h>
 #include <sys/epoll.h>
 
-#define GW_TCP_PORT 9100
-#define GW_BAUD     115200
-
 static int ep_add(int ep, int fd, uint32_t events)
 {
     struct epoll_event ev;
@@ -40,9 +44,9 @@ static int ep_mod(int ep, int fd, uint32_t events)
     return epoll_ctl(ep, EPOLL_CTL_MOD, fd, &ev);
 }
 
-static int is_uart_fd(const gw_uart_t uarts[GW_UART_COUNT], int fd, int* out_idx)
+static int is_uart_fd(const gw_uart_t* uarts, int count, int fd, int* out_idx)
 {
-    for (int i = 0; i < GW_UART_COUNT; i++) {
+    for (int i = 0; i < count; i++) {
         if (gw_uart_fd(&uarts[i]) == fd) {
             if (out_idx) *out_idx = i;
             return 1;
@@ -51,390 +55,352 @@ static int is_uart_fd(const gw_uart_t uarts[GW_UART_COUNT], int fd, int* out_idx
     return 0;
 }
 
-static uint32_t uart_events_mask(const gw_uart_t* u)
+static int load_config(const gw_app_opts_t* opts, gw_config_t* cfg)
 {
-    uint32_t ev = EPOLLIN;
-    if (gw_uart_tx_pending(u) > 0) ev |= EPOLLOUT;
-    return ev;
-}
-
-static int validate_ecu_bytes(const uint8_t* frame, size_t frame_len,
-                              const ecu_hdr_t** out_hdr,
-                              const uint8_t** out_payload)
-{
-    if (frame_len < ECU_HEADER_SIZE + ECU_CRC_SIZE) return 0;
-
-    const ecu_hdr_t* h = (const ecu_hdr_t*)frame;
-    if (!ecu_hdr_validate(h)) return 0;
-
-    size_t need = (size_t)ECU_HEADER_SIZE + (size_t)h->payload_len + ECU_CRC_SIZE;
-    if (frame_len != need) return 0;
-
-    const uint8_t* payload = frame + ECU_HEADER_SIZE;
-    uint16_t crc_le;
-    memcpy(&crc_le, frame + ECU_HEADER_SIZE + h->payload_len, sizeof(crc_le));
-
-    if (!ecu_frame_check_crc(h, payload, crc_le)) return 0;
-
-    if (out_hdr) *out_hdr = h;
-    if (out_payload) *out_payload = payload;
-    return 1;
-}
+    gw_config_defaults(cfg);
 
-static void dump_hex(const char* tag, const uint8_t* data, size_t len)
-{
-    fprintf(stderr, "%s len=%zu: ", tag, len);
-    for (size_t i = 0; i < len; i++) {
-        fprintf(stderr, "%02X", data[i]);
-        if (i + 1 < len) fputc(' ', stderr);
+    const char* path = opts->config_path;
+    if (!path) {
+        // файл по умолчанию необязателен
+        if (access(GW_CONFIG_PATH_DEFAULT, R_OK) != 0) return 0;
+        path = GW_CONFIG_PATH_DEFAULT;
     }
-    fputc('\n', stderr);
-}
 
-static void dump_hex_with_port(const char* tag, const char* port_name, const uint8_t* data, size_t len)
-{
-    fprintf(stderr, "%s [%s] len=%zu: ", tag, port_name ? port_name : "unknown", len);
-    for (size_t i = 0; i < len; i++) {
-        fprintf(stderr, "%02X", data[i]);
-        if (i + 1 < len) fputc(' ', stderr);
-    }
-    fputc('\n', stderr);
-}
-
-static const char* net_peer_name(int fd, char* buf, size_t buf_len)
-{
-    if (!buf || buf_len == 0) return "unknown";
-    buf[0] = '\0';
-
-    struct sockaddr_in sa;
-    socklen_t sl = sizeof(sa);
-    if (getpeername(fd, (struct sockaddr*)&sa, &sl) == 0) {
-        char ip[INET_ADDRSTRLEN];
-        if (inet_ntop(AF_INET, &sa.sin_addr, ip, sizeof(ip))) {
-            snprintf(buf, buf_len, "%s:%u", ip, (unsigned)ntohs(sa.sin_port));
-            return buf;
-        }
-    }
-
-    snprintf(buf, buf_len, "fd=%d", fd);
-    return buf;
-}
-
-static int port_token_to_uart(const char* tok, gw_uart_index_t* out_idx)
-{
-    if (!tok || !out_idx) return 0;
-
-    if (strcmp(tok, "1") == 0 || strcasecmp(tok, "ttyS1") == 0 || strcasecmp(tok, "/dev/ttyS1") == 0) {
-        *out_idx = GW_UART_1;
-        return 1;
-    }
-    if (strcmp(tok, "4") == 0 || strcasecmp(tok, "ttyS4") == 0 || strcasecmp(tok, "/dev/ttyS4") == 0) {
-        *out_idx = GW_UART_4;
-        return 1;
-    }
-    if (strcmp(tok, "5") == 0 || strcasecmp(tok, "ttyS5") == 0 || strcasecmp(tok, "/dev/ttyS5") == 0) {
-        *out_idx = GW_UART_5;
-        return 1;
+    char err[256];
+    if (gw_config_load(cfg, path, err, sizeof(err)) < 0) {
+        fprintf(stderr, "config: %s\n", err);
+        return -1;
     }
+    fprintf(stderr, "config: loaded %s\n", path);
     return 0;
 }
 
-static int parse_send_ports(const char* spec, uint8_t* out_mask)
+static void net_update_events(int ep, gw_net_t* net, uint64_t now, uint32_t batch_us)
 {
-    if (!spec || !out_mask) return -1;
-    *out_mask = 0;
-
-    if (strcasecmp(spec, "all") == 0) {
-        *out_mask = (uint8_t)((1u << GW_UART_1) | (1u << GW_UART_4) | (1u << GW_UART_5));
-        return 0;
+    for (int k = 0; k < net->max_clients; k++) {
+        gw_net_client_t* c = &net->clients[k];
+        if (c->fd < 0) continue;
+
+        // EPOLLOUT только если пачка уже должна была уйти, но сокет не принял всё;
+        // EPOLLIN снят, пока кадр клиента ждёт токенов или места в очереди UART (rx_paused)
+        uint32_t want = c->rx_paused ? 0 : EPOLLIN;
+        if (gw_net_client_tx_pending(c) > 0 && now - c->tx_first_us >= batch_us) want |= EPOLLOUT;
+        if (want == 0) want = EPOLLERR;   // ep_events == 0 — «ещё не в epoll»
+        if (want == c->ep_events) continue;
+
+        int rc = c->ep_events ? ep_mod(ep, c->fd, want) : ep_add(ep, c->fd, want);
+        if (rc == 0) c->ep_events = want;
     }
-
-    char tmp[128];
-    size_t n = strlen(spec);
-    if (n == 0 || n >= sizeof(tmp)) return -1;
-    memcpy(tmp, spec, n + 1);
-
-    char* saveptr = NULL;
-    char* tok = strtok_r(tmp, "_", &saveptr);
-    while (tok) {
-        gw_uart_index_t idx;
-        if (!port_token_to_uart(tok, &idx)) return -1;
-        *out_mask = (uint8_t)(*out_mask | (uint8_t)(1u << idx));
-        tok = strtok_r(NULL, "_", &saveptr);
-    }
-
-    return (*out_mask != 0) ? 0 : -1;
 }
 
-static uint8_t uart_to_node(gw_uart_index_t idx)
+static int is_worker_fd(const gw_state_t* st, int fd, int* out_idx)
 {
-    switch (idx) {
-        case GW_UART_1: return ECU_NODE1;
-        case GW_UART_4: return ECU_NODE2;
-        case GW_UART_5: return ECU_NODE3;
-        default: return ECU_NODE_BROADCAST;
+    for (int i = 0; i < st->uart_count; i++) {
+        if (st->workers[i].uart && st->workers[i].rx_efd == fd) {
+            *out_idx = i;
+            return 1;
+        }
     }
+    return 0;
 }
 
-static int gw_app_send_test(const char* ports_spec, int show_packets)
+// UART, в очередь которых за такт положили кадры или у которых кончилось ожидание очереди драйвера:
+// записать сразу, а EPOLLOUT включать, только если драйвер принял не всё (вместо epoll_ctl на каждый кадр).
+// Возвращает мкс до конца ближайшего ожидания (-1 = нет), *freed — биты UART, записавших в драйвер
+static long uart_flush_dirty(gw_state_t* st, uint64_t now, uint32_t* freed)
 {
-    uint8_t mask = 0;
-    if (parse_send_ports(ports_spec, &mask) < 0) {
-        fprintf(stderr, "Invalid PORT format for -send_test: %s (use all or list like 1_4_5)\n", ports_spec ? ports_spec : "");
-        return 2;
-    }
-
-    const char* devs[GW_UART_COUNT] = {"/dev/ttyS1", "/dev/ttyS4", "/dev/ttyS5"};
-    gw_uart_t uarts[GW_UART_COUNT];
-    memset(uarts, 0, sizeof(uarts));
-
-    uint16_t seq = 1;
-    int sent_count = 0;
-
-    for (int i = 0; i < GW_UART_COUNT; i++) {
-        if ((mask & (uint8_t)(1u << i)) == 0) continue;
-
-        if (gw_uart_open(&uarts[i], devs[i], GW_BAUD) < 0) {
-            perror(devs[i]);
-            continue;
-        }
-
-        ecu_hdr_t h;
-        memset(&h, 0, sizeof(h));
-        h.magic = ECU_MAGIC;
-        h.version = ECU_VERSION;
-        h.msg_type = ECU_MSG_HEARTBEAT;
-        h.src = ECU_NODE_GW;
-        h.dst = uart_to_node((gw_uart_index_t)i);
-        h.seq = seq++;
-        h.flags = 0;
-        h.payload_len = 0;
-
-        uint16_t crc = ecu_frame_calc_crc2(&h, NULL);
-        uint8_t frame[ECU_HEADER_SIZE + ECU_CRC_SIZE];
-        memcpy(frame, &h, ECU_HEADER_SIZE);
-        memcpy(frame + ECU_HEADER_SIZE, &crc, ECU_CRC_SIZE);
-
-        if (show_packets) dump_hex_with_port("TEST ECU", devs[i], frame, sizeof(frame));
-
-        if (gw_uart_send_slip(&uarts[i], frame, sizeof(frame)) < 0) {
-            fprintf(stderr, "Failed to enqueue test frame for %s\n", devs[i]);
-            gw_uart_close(&uarts[i]);
-            continue;
+    uint32_t dirty = st->uart_tx_dirty;
+    st->uart_tx_dirty = 0;
+    long next_us = -1;
+    for (int i = 0; i < st->uart_count; i++) {
+        gw_uart_t* u = &st->uarts[i];
+        if (gw_uart_tx_hold_us(u, now) == 0) dirty |= 1u << i;
+        if (dirty & (1u << i)) {
+            int wr = gw_uart_tx_pending(u) > 0 ? gw_uart_handle_write(u) : 0;
+            if (wr < 0) fprintf(stderr, "UART write error on %s\n", u->dev_path);
+            if (wr > 0) *freed |= 1u << i;
+            uint32_t want = gw_state_uart_events(u);
+            if (want != u->ep_events && ep_mod(st->ep, gw_uart_fd(u), want) == 0) u->ep_events = want;
         }
-
-        int ok = 1;
-        for (int tries = 0; tries < 100 && gw_uart_tx_pending(&uarts[i]) > 0; tries++) {
-            int wr = gw_uart_handle_write(&uarts[i]);
-            if (wr < 0) {
-                fprintf(stderr, "Write failed for %s\n", devs[i]);
-                ok = 0;
-                break;
-            }
-            if (wr == 0) usleep(5000);
-        }
-
-        if (gw_uart_tx_pending(&uarts[i]) > 0) {
-            fprintf(stderr, "Timeout sending test frame on %s\n", devs[i]);
-            ok = 0;
-        }
-
-        if (ok) {
-            fprintf(stderr, "Test frame sent on %s\n", devs[i]);
-            sent_count++;
-        }
-
-        gw_uart_close(&uarts[i]);
+        long hold = gw_uart_tx_hold_us(u, now);
+        if (hold >= 0 && (next_us < 0 || hold < next_us)) next_us = hold;
     }
-
-    return (sent_count > 0) ? 0 : 1;
+    return next_us;
 }
 
-int gw_app_run(int show_packets, int preview_raw, const char* send_test_ports, const char* cmd_ui_port)
+// Цикл событий на epoll: готовность fd -> read()/write() на каждый fd
+static int epoll_run(gw_state_t* st)
 {
-    if (cmd_ui_port && cmd_ui_port[0] != '\0') {
-        return gw_cmd_ui_run(cmd_ui_port, show_packets, preview_raw);
-    }
-
-    if (send_test_ports && send_test_ports[0] != '\0') {
-        return gw_app_send_test(send_test_ports, show_packets);
-    }
-
-    // 1) UARTs
-    gw_uart_t uarts[GW_UART_COUNT];
-    if (gw_uart_open(&uarts[GW_UART_1], "/dev/ttyS1", GW_BAUD) < 0) {
-        perror("open /dev/ttyS1");
-        return 1;
-    }
-    if (gw_uart_open(&uarts[GW_UART_4], "/dev/ttyS4", GW_BAUD) < 0) {
-        perror("open /dev/ttyS4");
-        return 1;
-    }
-    if (gw_uart_open(&uarts[GW_UART_5], "/dev/ttyS5", GW_BAUD) < 0) {
-        perror("open /dev/ttyS5");
-        return 1;
-    }
-
-    // 2) NET listen
-    gw_net_t net;
-    if (gw_net_listen(&net, GW_TCP_PORT) < 0) {
-        perror("gw_net_listen");
-        return 1;
-    }
-
-    // 3) epoll
-    int ep = epoll_create1(0);
-    if (ep < 0) {
-        perror("epoll_create1");
-        return 1;
-    }
-
-    // add listen fd
-    if (ep_add(ep, gw_net_listen_fd(&net), EPOLLIN) < 0) {
-        perror("epoll add listen");
-        return 1;
-    }
-
-    // add uart fds
-    for (int i = 0; i < GW_UART_COUNT; i++) {
-        int fd = gw_uart_fd(&uarts[i]);
-        if (ep_add(ep, fd, uart_events_mask(&uarts[i])) < 0) {
-            perror("epoll add uart");
-            return 1;
-        }
-    }
-
-    fprintf(stderr, "ecu-gw: TCP :%d, UARTs: ttyS1 ttyS4 ttyS5 @ %d\n", GW_TCP_PORT, GW_BAUD);
-
-    uint8_t net_frame[ECU_MAX_FRAME_SIZE];
+    int ep = st->ep;
+    gw_net_t* net = &st->net;
+    int timeout_ms = (int)st->cfg.tick_ms;
 
     for (;;) {
         struct epoll_event evs[16];
-        int n = epoll_wait(ep, evs, 16, 100);
+        int n = epoll_wait(ep, evs, 16, timeout_ms);
         if (n < 0) {
             if (errno == EINTR) continue;
             perror("epoll_wait");
-            break;
+            return -1;
         }
 
+        uint64_t now = gw_clock_tick();
+        gw_dispatch_age(st, now);
+
         for (int i = 0; i < n; i++) {
             int fd = evs[i].data.fd;
             uint32_t e = evs[i].events;
 
-            // 3.1) new client(s)
-            if (fd == gw_net_listen_fd(&net)) {
-                int acc = gw_net_accept(&net);
+            // SIGHUP: перечитать конфигурацию, соединения остаются; SIGUSR1: дамп статистики
+            if (fd == st->sig_fd) {
+                int sig = gw_state_read_signals(st);
+                if (sig & GW_SIG_USR1) gw_metrics_dump(st, stderr);
+                if (!(sig & GW_SIG_HUP)) continue;
+                if (gw_dispatch_reload(st, now) < 0) return -1;
+                // дальше в этой пачке могут быть события закрытых fd — дождаться нового epoll_wait
+                break;
+            }
+
+            // срок отложенной команды: сами команды — в конце такта (gw_dispatch_sched)
+            if (fd == st->sched_fd) {
+                uint64_t ticks;
+                ssize_t r = read(fd, &ticks, sizeof(ticks));
+                (void)r;
+                st->sched_armed_us = 0;
+                continue;
+            }
+
+            // 3.1) new client(s); регистрируются в epoll в net_update_events()
+            if (fd == gw_net_listen_fd(net)) {
+                int acc = gw_net_accept(net);
                 if (acc < 0) perror("accept");
-                // добавить новых клиентов в epoll
-                for (int k = 0; k < GW_NET_MAX_CLIENTS; k++) {
-                    int cfd = net.clients[k].fd;
-                    if (cfd >= 0) {
-                        // add may fail if already added; ignore
-                        ep_add(ep, cfd, EPOLLIN);
-                    }
-                }
+                continue;
+            }
+
+            // 3.2) кадры от потоков UART (режим threads)
+            int widx = -1;
+            if (st->threaded && is_worker_fd(st, fd, &widx)) {
+                gw_worker_ack(&st->workers[widx]);
+                gw_dispatch_worker_rx(st, widx, now);
                 continue;
             }
 
             // 3.2) UART events
             int uart_idx = -1;
-            if (is_uart_fd(uarts, fd, &uart_idx)) {
-                gw_uart_t* u = &uarts[uart_idx];
+            if (!st->threaded && is_uart_fd(st->uarts, st->uart_count, fd, &uart_idx)) {
+                gw_uart_t* u = &st->uarts[uart_idx];
 
                 if (e & EPOLLIN) {
                     int rr = gw_uart_handle_read(u);
                     if (rr < 0) {
                         fprintf(stderr, "UART read error on %s\n", u->dev_path);
                     } else {
-                        if (preview_raw && rr > 0 && (size_t)rr <= u->rx_len) {
-                            dump_hex_with_port("RAW UART", u->dev_path,
-                                               &u->rx_buf[u->rx_len - (size_t)rr], (size_t)rr);
+                        if (st->preview_raw && rr > 0 && (size_t)rr <= u->rx_len) {
+                            gw_dispatch_trace(st, ECU_LOG_RAW_UART, (unsigned)uart_idx,
+                                              &u->rx_buf[u->rx_len - (size_t)rr], (size_t)rr);
                         }
-
                         // вытащить SLIP кадры (по одному/несколько)
-                        for (;;) {
-                            const uint8_t* f = NULL;
-                            size_t flen = 0;
-                            int gr = gw_uart_try_get_slip_frame(u, &f, &flen);
-                            if (gr == 0) break;
-                            if (gr < 0) break;
-
-                            if (show_packets) dump_hex("RX UART", f, flen);
-
-                            const ecu_hdr_t* h = NULL;
-                            if (!validate_ecu_bytes(f, flen, &h, NULL)) {
-                                fprintf(stderr, "UART %s: bad ECU frame (drop)\n", u->dev_path);
-                                continue;
-                            }
-                            // отправить на ПК всем клиентам
-                            gw_net_broadcast_frame(&net, f, flen);
-                            if (show_packets) dump_hex("PROC UART->NET", f, flen);
-                        }
-                    }
-                }
-
-                if (e & EPOLLOUT) {
-                    int wr = gw_uart_handle_write(u);
-                    if (wr < 0) {
-                        fprintf(stderr, "UART write error on %s\n", u->dev_path);
+                        gw_dispatch_uart_rx(st, uart_idx, now);
                     }
                 }
 
-                // обновить маску EPOLLOUT в зависимости от очереди
-                ep_mod(ep, fd, uart_events_mask(u));
+                // запись и маска EPOLLOUT — в uart_flush_dirty() в конце такта
+                if (e & EPOLLOUT) st->uart_tx_dirty |= 1u << uart_idx;
                 continue;
             }
 
             // 3.3) client socket events
-            gw_net_client_t* c = gw_net_find_client(&net, fd);
+            gw_net_client_t* c = gw_net_find_client(net, fd);
             if (c) {
-                if (e & EPOLLIN) {
+                if (e & (EPOLLERR | EPOLLHUP)) {
+                    gw_net_remove_client(net, fd);
+                    continue;
+                }
+                if (e & EPOLLOUT) {
+                    if (gw_net_client_flush(c) < 0) {
+                        gw_net_remove_client(net, fd);
+                        continue;
+                    }
+                }
+                if ((e & EPOLLIN) && !c->rx_paused) {
                     int rr = gw_net_client_read(c);
                     if (rr < 0) {
-                        gw_net_remove_client(&net, fd);
+                        gw_net_remove_client(net, fd);
                         continue;
-                    } else if (preview_raw && rr > 0 && (size_t)rr <= c->rx_len) {
-                        char peer[64];
-                        dump_hex_with_port("RAW NET", net_peer_name(c->fd, peer, sizeof(peer)),
-                                           &c->rx_buf[c->rx_len - (size_t)rr], (size_t)rr);
-                    }
-
-                    // обработать все полные кадры в буфере
-                    for (;;) {
-                        size_t flen = 0;
-                        int gr = gw_net_client_try_get_frame(c, net_frame, sizeof(net_frame), &flen);
-                        if (gr == 0) break;
-                        if (gr < 0) break;
-
-                        if (show_packets) dump_hex("RX NET", net_frame, flen);
-
-                        const ecu_hdr_t* h = NULL;
-                        if (!validate_ecu_bytes(net_frame, flen, &h, NULL)) {
-                            fprintf(stderr, "NET: bad ECU frame (drop)\n");
-                            continue;
-                        }
-
-                        // роутинг на UART по dst
-                        gw_uart_index_t out;
-                        if (!gw_router_node_to_uart(h->dst, &out)) {
-                            // dst может быть GW/broadcast — пока игнорируем
-                            continue;
-                        }
-
-                        // отправить на UART (SLIP)
-                        (void)gw_uart_send_slip(&uarts[out], net_frame, flen);
-                        if (show_packets) dump_hex("PROC NET->UART", net_frame, flen);
-                        // включить EPOLLOUT если нужно
-                        ep_mod(ep, gw_uart_fd(&uarts[out]), uart_events_mask(&uarts[out]));
+                    } else if (st->preview_raw && rr > 0 && (size_t)rr <= c->rx_len) {
+                        gw_dispatch_trace(st, ECU_LOG_RAW_NET, (unsigned)(c - net->clients),
+                                          &c->rx_buf[c->rx_len - (size_t)rr], (size_t)rr);
                     }
                 }
                 continue;
             }
         }
+
+        // записи конца такта идут со своим временем (отметки отправки кадров)
+        now = gw_clock_tick();
+
+        // отложенные команды, срок которых наступил, — первыми
+        (void)gw_dispatch_sched(st, now);
+
+        // кадры клиентов — в очереди UART (DRR и токены по UART)
+        long client_us = gw_dispatch_clients(st, now);
+
+        // задания, поставленные клиентами за такт (прошедший срок — сразу); следующий срок ждёт timerfd
+        long sched_us = gw_dispatch_sched(st, now);
+        gw_state_sched_arm(st, sched_us >= 0 ? now + (uint64_t)sched_us : 0);
+
+        // разбудить потоки UART, которым положили кадры (один eventfd на пачку)
+        for (int k = 0; st->threaded && k < st->uart_count; k++) gw_worker_kick(&st->workers[k]);
+        uint32_t freed = 0;
+        long hold_us = st->threaded ? -1 : uart_flush_dirty(st, now, &freed);
+
+        // отправить накопленные кадры клиентам (сразу или по истечении tx_batch_us)
+        long next_us = gw_net_flush(net, now, st->cfg.tx_batch_us, 0);
+        net_update_events(ep, net, now, st->cfg.tx_batch_us);
+        if (client_us >= 0 && (next_us < 0 || client_us < next_us)) next_us = client_us;
+        if (hold_us >= 0 && (next_us < 0 || hold_us < next_us)) next_us = hold_us;
+        // запись освободила место в TX очереди UART, которого ждут отложенные команды, — следующий
+        // такт без ожидания: опустевшая очередь не даст EPOLLOUT
+        for (int i = 0; freed && i < st->uart_count; i++) {
+            if ((freed & (1u << i)) && gw_sched_waiting(&st->sched, (unsigned)i)) next_us = 0;
+        }
+
+        timeout_ms = (int)st->cfg.tick_ms;
+        if (next_us >= 0) {
+            long ms = (next_us + 999) / 1000;
+            if (ms < timeout_ms) timeout_ms = (int)ms;
+        }
+    }
+}
+
+// Журнал кадров: -show/-prev_show — текстом в stderr, -trace FILE — двоичные записи в файл,
+// [gateway] tap — сокет для gw_dump (кадры и сырые байты, пока подключён хоть один читатель),
+// [capture] — файлы записи трафика.
+// *fd — открытый файл (-1 = нет), закрыть после ecu_log_free. 0 = OK, -1 = ошибка
+static int trace_open(gw_state_t* st, const char* path, int* fd)
+{
+    uint32_t text_kinds = (st->show_packets ? ECU_LOG_KINDS_FRAMES : 0u) | (st->preview_raw ? ECU_LOG_KINDS_RAW : 0u);
+    const gw_config_t* c = &st->cfg;
+    int all = c->tap_path[0] || c->cap_prefix[0];
+    *fd = -1;
+    if (!text_kinds && !path && !all) return 0;
+    if (ecu_log_init(&st->trace, c->cap_prefix[0] ? GW_CAPTURE_RECORDS : GW_TRACE_RECORDS) < 0) {
+        perror("trace");
+        return -1;
+    }
+    if (c->tap_path[0] && ecu_log_tap(&st->trace, c->tap_path) < 0) {
+        fprintf(stderr, "tap %s: %s\n", c->tap_path, strerror(errno));
+        ecu_log_free(&st->trace);
+        return -1;
+    }
+    if (c->cap_prefix[0]) {
+        if (ecu_cap_open(&st->capture, c->cap_prefix, c->cap_block_kb, (uint64_t)c->cap_max_mb << 20, c->cap_max_sec,
+                         c->cap_files) < 0) {
+            fprintf(stderr, "capture %s: %s\n", c->cap_prefix, strerror(errno));
+            ecu_log_free(&st->trace);
+            return -1;
+        }
+        for (int i = 0; i < c->uart_count && i < ECU_CAP_PORTS; i++) ecu_cap_set_uart(&st->capture, (unsigned)i, c->uarts[i].name);
+        ecu_log_capture(&st->trace, &st->capture);
+    }
+    if (path) {
+        *fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (*fd < 0) {
+            fprintf(stderr, "trace %s: %s\n", path, strerror(errno));
+            ecu_log_free(&st->trace);
+            ecu_cap_close(&st->capture);
+            return -1;
+        }
+    }
+    if (ecu_log_start(&st->trace, text_kinds ? stderr : NULL, text_kinds, *fd) < 0) {
+        perror("trace");
+        ecu_log_free(&st->trace);
+        ecu_cap_close(&st->capture);
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+        return -1;
     }
 
-    close(ep);
-    gw_net_close(&net);
-    for (int i = 0; i < GW_UART_COUNT; i++) gw_uart_close(&uarts[i]);
+    // что пишется в кольцо: с tap/capture — всё, приёмники разберут сами
+    if (all) st->preview_raw = 1;
+    st->trace_frames = st->show_packets || path || all;
     return 0;
 }
+
+static void trace_close(gw_state_t* st, int fd)
+{
+    // поток журнала дописывает остаток кольца
+    ecu_log_free(&st->trace);
+    if (fd >= 0) close(fd);
+    if (ecu_log_drops(&st->trace) > 0) {
+        fprintf(stderr, "trace: %u record(s) dropped\n", (unsigned)ecu_log_drops(&st->trace));
+    }
+    if (st->capture.blk) {
+        if (st->capture.err) fprintf(stderr, "capture: stopped: %s\n", strerror(st->capture.err));
+        ecu_cap_close(&st->capture);
+    }
+}
+
+int gw_app_run(const gw_app_opts_t* opts)
+{
+    if (!opts) return 2;
+    int show_packets = opts->show_packets;
+    int preview_raw = opts->preview_raw;
+
+    gw_config_t cfg;
+    if (load_config(opts, &cfg) < 0) return 2;
+
+    if (opts->cmd_ui_port && opts->cmd_ui_port[0] != '\0') {
+        return gw_cmd_ui_run(&cfg, opts->cmd_ui_port, show_packets, preview_raw);
+    }
+
+    if (opts->send_test_ports && opts->send_test_ports[0] != '\0') {
+        gw_send_test_opts_t so;
+        memset(&so, 0, sizeof(so));
+        so.ports = opts->send_test_ports;
+        so.time_s = opts->send_time_s;
+        so.rate = opts->send_rate;
+        so.size = opts->send_size;
+        so.loop = opts->send_loop;
+        so.show_packets = show_packets;
+        return gw_send_test_run(&cfg, &so);
+    }
+
+    // состояние велико (таблица маршрутов, буферы UART) — не на стеке
+    static gw_state_t st;
+    memset(&st, 0, sizeof(st));
+    st.cfg = cfg;
+    st.config_path = opts->config_path ? opts->config_path : GW_CONFIG_PATH_DEFAULT;
+    st.show_packets = show_packets;
+    st.preview_raw = preview_raw;
+    int trace_fd;
+    if (trace_open(&st, opts->trace_path, &trace_fd) < 0) return 1;
+    if (gw_state_open(&st) < 0) {
+        trace_close(&st, trace_fd);
+        return 1;
+    }
+
+    fprintf(stderr, "ecu-gw: TCP :%u, UARTs:", (unsigned)st.cfg.tcp_port);
+    for (int i = 0; i < st.uart_count; i++) {
+        const gw_uart_t* u = &st.uarts[i];
+        fprintf(stderr, " %s@%d", st.cfg.uarts[i].name, u->baud);
+        if (u->baud_actual != u->baud) fprintf(stderr, "(driver %d)", u->baud_actual);
+    }
+    fputc('\n', stderr);
+    if (st.threaded) fprintf(stderr, "ecu-gw: threads mode, %d UART worker(s)\n", st.uart_count);
+    if (show_packets) gw_config_dump(&st.cfg, stderr);
+
+    st.last_age_ms = gw_clock_tick() / 1000u;
+    st.backend = GW_BACKEND_EPOLL;
+    int rc = GW_URING_UNAVAILABLE;
+    if (st.cfg.backend == GW_BACKEND_IO_URING) {
+        rc = gw_uring_run(&st);
+        if (rc == GW_URING_UNAVAILABLE) fprintf(stderr, "ecu-gw: io_uring unavailable, using epoll\n");
+    }
+    if (rc == GW_URING_UNAVAILABLE) rc = epoll_run(&st);
+
+    // потоки UART пишут в журнал — он закрывается после них
+    gw_state_close(&st);
+    trace_close(&st, trace_fd);
+    return rc < 0 ? 1 : 0;
+}
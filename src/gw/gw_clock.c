@@ -0,0 +1,3 @@
+#include "gw/gw_clock.h"
+
+__thread uint64_t gw_clock_tick_us;
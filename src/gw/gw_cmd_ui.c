@@ -60,26 +60,6 @@ static uint32_t uart_events_mask(const gw_uart_t* u)
     return ev;
 }
 
-static int validate_ecu_bytes(const uint8_t* frame, size_t frame_len, const ecu_hdr_t** out_hdr, const uint8_t** out_payload)
-{
-    if (frame_len < ECU_HEADER_SIZE + ECU_CRC_SIZE) return 0;
-
-    const ecu_hdr_t* h = (const ecu_hdr_t*)frame;
-    if (!ecu_hdr_validate(h)) return 0;
-
-    size_t need = (size_t)ECU_HEADER_SIZE + (size_t)h->payload_len + ECU_CRC_SIZE;
-    if (frame_len != need) return 0;
-
-    const uint8_t* payload = frame + ECU_HEADER_SIZE;
-    uint16_t crc_le = 0;
-    memcpy(&crc_le, frame + ECU_HEADER_SIZE + h->payload_len, sizeof(crc_le));
-    if (!ecu_frame_check_crc(h, payload, crc_le)) return 0;
-
-    if (out_hdr) *out_hdr = h;
-    if (out_payload) *out_payload = payload;
-    return 1;
-}
-
 static void now_hms(char out[16])
 {
     time_t t = time(NULL);
@@ -214,25 +194,14 @@ static void restore_stdin(term_guard_t* tg)
     tg->active = 0;
 }
 
-static int port_to_uart(const char* port_name, const char** out_dev, uint8_t* out_dst)
+static int port_to_uart(const gw_config_t* cfg, const char* port_name, const gw_uart_cfg_t** out_uc, uint8_t* out_dst)
 {
-    if (!port_name || !out_dev || !out_dst) return 0;
-    if (strcmp(port_name, "ttyS1") == 0) {
-        *out_dev = "/dev/ttyS1";
-        *out_dst = ECU_NODE1;
-        return 1;
-    }
-    if (strcmp(port_name, "ttyS4") == 0) {
-        *out_dev = "/dev/ttyS4";
-        *out_dst = ECU_NODE2;
-        return 1;
-    }
-    if (strcmp(port_name, "ttyS5") == 0) {
-        *out_dev = "/dev/ttyS5";
-        *out_dst = ECU_NODE3;
-        return 1;
-    }
-    return 0;
+    if (!cfg || !port_name || !out_uc || !out_dst) return 0;
+    int idx = gw_config_find_uart(cfg, port_name);
+    if (idx < 0) return 0;
+    *out_uc = &cfg->uarts[idx];
+    *out_dst = gw_config_uart_node(cfg, idx);
+    return 1;
 }
 
 static int parse_u16_anybase(const char* s, uint16_t* out)
@@ -590,21 +559,24 @@ static int process_uart_rx(cmd_ui_t* ui, gw_uart_t* uart, int preview_raw, int s
         int gr = gw_uart_try_get_slip_frame(uart, &frame, &frame_len);
         if (gr == 0) break;
         if (gr < 0) {
-            decode_error = 1;
-            char src_line[CMD_UI_LINE_MAX];
-            if (src_chunk_len > 0) {
-                format_src_bytes(src_chunk, src_chunk_len, src_line, sizeof(src_line));
-                ui_add_rx_line(ui, "%s", src_line);
-            } else {
-                ui_add_rx_line(ui, "SRC: []");
+            // за сбойным местом могут идти целые кадры — разбор продолжается, SRC печатаем один раз
+            if (!decode_error) {
+                char src_line[CMD_UI_LINE_MAX];
+                if (src_chunk_len > 0) {
+                    format_src_bytes(src_chunk, src_chunk_len, src_line, sizeof(src_line));
+                    ui_add_rx_line(ui, "%s", src_line);
+                } else {
+                    ui_add_rx_line(ui, "SRC: []");
+                }
             }
+            decode_error = 1;
             changed = 1;
-            break;
+            continue;
         }
 
         const ecu_hdr_t* h = NULL;
         const uint8_t* payload = NULL;
-        if (!validate_ecu_bytes(frame, frame_len, &h, &payload)) {
+        if (!ecu_frame_validate(frame, frame_len, &h, &payload)) {
             ui_add_rx_line(ui, "DROP bad ECU frame len=%zu", frame_len);
             changed = 1;
             continue;
@@ -648,20 +620,25 @@ static int process_uart_rx(cmd_ui_t* ui, gw_uart_t* uart, int preview_raw, int s
     return changed;
 }
 
-int gw_cmd_ui_run(const char* port_name, int show_packets, int preview_raw)
+int gw_cmd_ui_run(const gw_config_t* cfg, const char* port_name, int show_packets, int preview_raw)
 {
-    const char* dev = NULL;
+    const gw_uart_cfg_t* uc = NULL;
     uint8_t dst = ECU_NODE1;
-    if (!port_to_uart(port_name, &dev, &dst)) {
-        fprintf(stderr, "Invalid -cmd_ui PORT: %s (use ttyS1|ttyS4|ttyS5)\n", port_name ? port_name : "");
+    if (!port_to_uart(cfg, port_name, &uc, &dst)) {
+        fprintf(stderr, "Invalid -cmd_ui PORT: %s (use", port_name ? port_name : "");
+        for (int i = 0; cfg && i < cfg->uart_count; i++) fprintf(stderr, "%s%s", i ? "|" : " ", cfg->uarts[i].name);
+        fprintf(stderr, ")\n");
         return 2;
     }
 
     gw_uart_t uart;
-    if (gw_uart_open(&uart, dev, 115200) < 0) {
-        perror(dev);
+    if (gw_uart_open_ex(&uart, uc->dev_path, uc->baud, uc->rx_buf, uc->tx_queue) < 0) {
+        perror(uc->dev_path);
         return 1;
     }
+    if (uart.baud_actual != uart.baud) {
+        fprintf(stderr, "%s: requested %d baud, driver set %d\n", uc->dev_path, uart.baud, uart.baud_actual);
+    }
 
     term_guard_t tg;
     if (set_stdin_raw(&tg) < 0) {
@@ -0,0 +1,473 @@
+#include "gw/gw_config.h"
+
+#include "ecu/ecu_limits.h"
+#include "gw/gw_uart.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef enum {
+    SEC_NONE = 0,
+    SEC_GATEWAY,
+    SEC_NET,
+    SEC_UART,
+    SEC_CAPTURE
+} cfg_section_t;
+
+static void set_err(char* err, size_t err_len, const char* fmt, ...)
+{
+    if (!err || err_len == 0) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(err, err_len, fmt, ap);
+    va_end(ap);
+}
+
+static void uart_defaults(gw_uart_cfg_t* u, const char* name, const char* dev)
+{
+    memset(u, 0, sizeof(*u));
+    snprintf(u->name, sizeof(u->name), "%s", name);
+    snprintf(u->dev_path, sizeof(u->dev_path), "%s", dev);
+    u->baud = GW_CFG_BAUD;
+    u->rx_buf = GW_CFG_UART_RX_BUF;
+    u->tx_queue = GW_CFG_UART_TX_QUEUE;
+    u->cpu = -1;
+    u->conflate = GW_UART_CONFLATE_NOACK;
+    u->cmd_rate = 0;
+    u->cmd_burst = GW_CFG_CMD_BURST;
+}
+
+void gw_config_defaults(gw_config_t* c)
+{
+    if (!c) return;
+    memset(c, 0, sizeof(*c));
+
+    c->tick_ms = GW_CFG_TICK_MS;
+    c->route_age_ms = GW_ROUTER_AGE_MS;
+    c->threads = 0;
+    c->ring_slots = GW_CFG_RING_SLOTS;
+    c->net_cpu = -1;
+    c->backend = GW_BACKEND_EPOLL;
+
+    c->tcp_port = GW_CFG_TCP_PORT;
+    c->max_clients = GW_CFG_MAX_CLIENTS;
+    c->client_rx_buf = GW_CFG_CLIENT_RX_BUF;
+    c->client_tx_buf = GW_CFG_CLIENT_TX_BUF;
+    c->tx_batch_us = 0;
+
+    c->cap_max_mb = GW_CFG_CAP_MAX_MB;
+    c->cap_max_sec = GW_CFG_CAP_MAX_SEC;
+    c->cap_files = 0;
+    c->cap_block_kb = GW_CFG_CAP_BLOCK_KB;
+
+    c->uart_count = GW_UART_COUNT;
+    uart_defaults(&c->uarts[GW_UART_1], "ttyS1", "/dev/ttyS1");
+    uart_defaults(&c->uarts[GW_UART_4], "ttyS4", "/dev/ttyS4");
+    uart_defaults(&c->uarts[GW_UART_5], "ttyS5", "/dev/ttyS5");
+
+    for (int i = 0; i < GW_ROUTER_NODES; i++) c->node_uart[i] = -1;
+    c->node_uart[ECU_NODE1] = GW_UART_1;
+    c->node_uart[ECU_NODE2] = GW_UART_4;
+    c->node_uart[ECU_NODE3] = GW_UART_5;
+}
+
+static char* trim(char* s)
+{
+    while (*s && isspace((unsigned char)*s)) s++;
+    char* e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) e--;
+    *e = '\0';
+    return s;
+}
+
+static int parse_ulong(const char* v, unsigned long min, unsigned long max, unsigned long* out)
+{
+    if (!v || !*v) return 0;
+    char* end = NULL;
+    errno = 0;
+    unsigned long x = strtoul(v, &end, 0);
+    if (errno != 0 || !end || *end != '\0') return 0;
+    if (x < min || x > max) return 0;
+    *out = x;
+    return 1;
+}
+
+// nodes = 1, 7, 12
+static int parse_nodes(gw_config_t* c, int uart_idx, const char* v)
+{
+    char tmp[256];
+    size_t n = strlen(v);
+    if (n >= sizeof(tmp)) return 0;
+    memcpy(tmp, v, n + 1);
+
+    char* save = NULL;
+    for (char* tok = strtok_r(tmp, ", \t", &save); tok; tok = strtok_r(NULL, ", \t", &save)) {
+        unsigned long node = 0;
+        if (!parse_ulong(tok, 1, ECU_NODE_GW - 1u, &node)) return 0;
+        c->node_uart[node] = (int16_t)uart_idx;
+    }
+    return 1;
+}
+
+// номер ядра или -1
+static int parse_cpu(const char* v, int* out)
+{
+    unsigned long x = 0;
+    if (strcmp(v, "-1") == 0) {
+        *out = -1;
+        return 1;
+    }
+    if (!parse_ulong(v, 0, 1023, &x)) return 0;
+    *out = (int)x;
+    return 1;
+}
+
+static int set_gateway_key(gw_config_t* c, const char* key, const char* val)
+{
+    unsigned long x = 0;
+    if (strcmp(key, "tick_ms") == 0) {
+        if (!parse_ulong(val, 1, 10000, &x)) return 0;
+        c->tick_ms = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "route_age_ms") == 0) {
+        if (!parse_ulong(val, 100, 86400000ul, &x)) return 0;
+        c->route_age_ms = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "threads") == 0) {
+        if (!parse_ulong(val, 0, 1, &x)) return 0;
+        c->threads = (int)x;
+        return 1;
+    }
+    if (strcmp(key, "ring_slots") == 0) {
+        if (!parse_ulong(val, 8, 65536, &x)) return 0;
+        c->ring_slots = (size_t)x;
+        return 1;
+    }
+    if (strcmp(key, "net_cpu") == 0) {
+        return parse_cpu(val, &c->net_cpu);
+    }
+    if (strcmp(key, "backend") == 0) {
+        if (strcasecmp(val, "epoll") == 0) c->backend = GW_BACKEND_EPOLL;
+        else if (strcasecmp(val, "io_uring") == 0) c->backend = GW_BACKEND_IO_URING;
+        else return 0;
+        return 1;
+    }
+    if (strcmp(key, "tap") == 0) {
+        if (strcasecmp(val, "off") == 0) {
+            c->tap_path[0] = '\0';
+            return 1;
+        }
+        if (val[0] != '/' || strlen(val) >= sizeof(c->tap_path)) return 0;
+        snprintf(c->tap_path, sizeof(c->tap_path), "%s", val);
+        return 1;
+    }
+    return -1;
+}
+
+static int set_capture_key(gw_config_t* c, const char* key, const char* val)
+{
+    unsigned long x = 0;
+    if (strcmp(key, "path") == 0) {
+        if (strcasecmp(val, "off") == 0) {
+            c->cap_prefix[0] = '\0';
+            return 1;
+        }
+        if (strlen(val) == 0 || strlen(val) >= sizeof(c->cap_prefix)) return 0;
+        snprintf(c->cap_prefix, sizeof(c->cap_prefix), "%s", val);
+        return 1;
+    }
+    if (strcmp(key, "max_mb") == 0) {
+        if (!parse_ulong(val, 0, 1024 * 1024, &x)) return 0;
+        c->cap_max_mb = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "max_sec") == 0) {
+        if (!parse_ulong(val, 0, 7 * 86400ul, &x)) return 0;
+        c->cap_max_sec = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "files") == 0) {
+        if (!parse_ulong(val, 0, 10000, &x)) return 0;
+        c->cap_files = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "block_kb") == 0) {
+        // кратно странице: блоки пишутся O_DIRECT
+        if (!parse_ulong(val, 4, 4096, &x) || x % 4 != 0) return 0;
+        c->cap_block_kb = (uint32_t)x;
+        return 1;
+    }
+    return -1;
+}
+
+static int set_net_key(gw_config_t* c, const char* key, const char* val)
+{
+    unsigned long x = 0;
+    if (strcmp(key, "port") == 0) {
+        if (!parse_ulong(val, 1, 65535, &x)) return 0;
+        c->tcp_port = (uint16_t)x;
+        return 1;
+    }
+    if (strcmp(key, "max_clients") == 0) {
+        if (!parse_ulong(val, 1, 1024, &x)) return 0;
+        c->max_clients = (int)x;
+        return 1;
+    }
+    if (strcmp(key, "rx_buf") == 0) {
+        // должен вмещать хотя бы один кадр с префиксом длины
+        if (!parse_ulong(val, 4 + ECU_MAX_FRAME_SIZE, 16ul << 20, &x)) return 0;
+        c->client_rx_buf = (size_t)x;
+        return 1;
+    }
+    if (strcmp(key, "tx_buf") == 0) {
+        if (!parse_ulong(val, 4 + ECU_MAX_FRAME_SIZE, 64ul << 20, &x)) return 0;
+        c->client_tx_buf = (size_t)x;
+        return 1;
+    }
+    if (strcmp(key, "tx_batch_us") == 0) {
+        if (!parse_ulong(val, 0, 1000000ul, &x)) return 0;
+        c->tx_batch_us = (uint32_t)x;
+        return 1;
+    }
+    return -1;
+}
+
+static int set_uart_key(gw_config_t* c, int idx, const char* key, const char* val)
+{
+    gw_uart_cfg_t* u = &c->uarts[idx];
+    unsigned long x = 0;
+    if (strcmp(key, "dev") == 0) {
+        if (strlen(val) == 0 || strlen(val) >= sizeof(u->dev_path)) return 0;
+        snprintf(u->dev_path, sizeof(u->dev_path), "%s", val);
+        return 1;
+    }
+    if (strcmp(key, "baud") == 0) {
+        if (!parse_ulong(val, 50, 12000000ul, &x)) return 0;
+        u->baud = (int)x;
+        return 1;
+    }
+    if (strcmp(key, "nodes") == 0) {
+        return parse_nodes(c, idx, val);
+    }
+    if (strcmp(key, "cpu") == 0) {
+        return parse_cpu(val, &u->cpu);
+    }
+    if (strcmp(key, "conflate") == 0) {
+        if (strcasecmp(val, "off") == 0) u->conflate = GW_UART_CONFLATE_OFF;
+        else if (strcasecmp(val, "noack") == 0) u->conflate = GW_UART_CONFLATE_NOACK;
+        else if (strcasecmp(val, "all") == 0) u->conflate = GW_UART_CONFLATE_ALL;
+        else return 0;
+        return 1;
+    }
+    if (strcmp(key, "cmd_rate") == 0) {
+        if (!parse_ulong(val, 0, 10000000ul, &x)) return 0;
+        u->cmd_rate = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "cmd_burst") == 0) {
+        // не меньше одного кадра, иначе он никогда не пройдёт
+        if (!parse_ulong(val, ECU_MAX_FRAME_SIZE, 16ul << 20, &x)) return 0;
+        u->cmd_burst = (uint32_t)x;
+        return 1;
+    }
+    if (strcmp(key, "rx_buf") == 0) {
+        if (!parse_ulong(val, 256, 16ul << 20, &x)) return 0;
+        u->rx_buf = (size_t)x;
+        return 1;
+    }
+    if (strcmp(key, "tx_queue") == 0) {
+        // худший случай SLIP одного кадра: 2 * 1042 + 2
+        if (!parse_ulong(val, 2 * ECU_MAX_FRAME_SIZE + 2, 16ul << 20, &x)) return 0;
+        u->tx_queue = (size_t)x;
+        return 1;
+    }
+    return -1;
+}
+
+int gw_config_load(gw_config_t* c, const char* path, char* err, size_t err_len)
+{
+    if (!c || !path) return -1;
+    if (err && err_len) err[0] = '\0';
+
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        set_err(err, err_len, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    cfg_section_t sec = SEC_NONE;
+    int uart_idx = -1;
+    int uarts_reset = 0;   // первая секция [uart] заменяет список по умолчанию
+    char line[512];
+    int lineno = 0;
+    int rc = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char* p = line;
+        char* hash = strpbrk(p, "#;");
+        if (hash) *hash = '\0';
+        p = trim(p);
+        if (*p == '\0') continue;
+
+        if (*p == '[') {
+            char* close = strchr(p, ']');
+            if (!close) {
+                set_err(err, err_len, "%s:%d: missing ']'", path, lineno);
+                rc = -1;
+                break;
+            }
+            *close = '\0';
+            char* name = trim(p + 1);
+
+            if (strcasecmp(name, "gateway") == 0) {
+                sec = SEC_GATEWAY;
+            } else if (strcasecmp(name, "net") == 0) {
+                sec = SEC_NET;
+            } else if (strcasecmp(name, "capture") == 0) {
+                sec = SEC_CAPTURE;
+            } else if (strncasecmp(name, "uart", 4) == 0 && isspace((unsigned char)name[4])) {
+                char* uname = trim(name + 4);
+                if (*uname == '\0' || strlen(uname) >= GW_CFG_NAME_MAX) {
+                    set_err(err, err_len, "%s:%d: bad uart name", path, lineno);
+                    rc = -1;
+                    break;
+                }
+                if (!uarts_reset) {
+                    uarts_reset = 1;
+                    c->uart_count = 0;
+                    for (int i = 0; i < GW_ROUTER_NODES; i++) c->node_uart[i] = -1;
+                }
+                for (int i = 0; i < c->uart_count; i++) {
+                    if (strcmp(c->uarts[i].name, uname) == 0) {
+                        set_err(err, err_len, "%s:%d: duplicate uart %s", path, lineno, uname);
+                        rc = -1;
+                        break;
+                    }
+                }
+                if (rc < 0) break;
+                if (c->uart_count >= GW_UART_MAX) {
+                    set_err(err, err_len, "%s:%d: too many uarts (max %d)", path, lineno, GW_UART_MAX);
+                    rc = -1;
+                    break;
+                }
+                uart_idx = c->uart_count++;
+                char dev[GW_CFG_PATH_MAX];
+                snprintf(dev, sizeof(dev), "/dev/%s", uname);
+                uart_defaults(&c->uarts[uart_idx], uname, dev);
+                sec = SEC_UART;
+            } else {
+                set_err(err, err_len, "%s:%d: unknown section [%s]", path, lineno, name);
+                rc = -1;
+                break;
+            }
+            continue;
+        }
+
+        char* eq = strchr(p, '=');
+        if (!eq) {
+            set_err(err, err_len, "%s:%d: expected key = value", path, lineno);
+            rc = -1;
+            break;
+        }
+        *eq = '\0';
+        char* key = trim(p);
+        char* val = trim(eq + 1);
+
+        int r = -1;
+        switch (sec) {
+            case SEC_GATEWAY: r = set_gateway_key(c, key, val); break;
+            case SEC_NET:     r = set_net_key(c, key, val); break;
+            case SEC_UART:    r = set_uart_key(c, uart_idx, key, val); break;
+            case SEC_CAPTURE: r = set_capture_key(c, key, val); break;
+            default:
+                set_err(err, err_len, "%s:%d: key outside of section", path, lineno);
+                rc = -1;
+                break;
+        }
+        if (rc < 0) break;
+        if (r < 0) {
+            set_err(err, err_len, "%s:%d: unknown key '%s'", path, lineno, key);
+            rc = -1;
+            break;
+        }
+        if (r == 0) {
+            set_err(err, err_len, "%s:%d: bad value for '%s': %s", path, lineno, key, val);
+            rc = -1;
+            break;
+        }
+    }
+
+    fclose(fp);
+    if (rc == 0 && c->uart_count == 0) {
+        set_err(err, err_len, "%s: no [uart] sections", path);
+        rc = -1;
+    }
+    return rc;
+}
+
+int gw_config_find_uart(const gw_config_t* c, const char* token)
+{
+    if (!c || !token || !*token) return -1;
+
+    for (int i = 0; i < c->uart_count; i++) {
+        const gw_uart_cfg_t* u = &c->uarts[i];
+        if (strcasecmp(token, u->name) == 0 || strcmp(token, u->dev_path) == 0) return i;
+    }
+
+    // номер порта: "1" -> ttyS1 (имя оканчивается этим числом)
+    for (const char* p = token; *p; p++) {
+        if (!isdigit((unsigned char)*p)) return -1;
+    }
+    size_t tl = strlen(token);
+    for (int i = 0; i < c->uart_count; i++) {
+        const char* name = c->uarts[i].name;
+        size_t nl = strlen(name);
+        if (nl <= tl) continue;
+        if (strcmp(name + nl - tl, token) == 0 && !isdigit((unsigned char)name[nl - tl - 1])) return i;
+    }
+    return -1;
+}
+
+uint8_t gw_config_uart_node(const gw_config_t* c, int uart_idx)
+{
+    if (!c) return ECU_NODE_BROADCAST;
+    for (int i = 1; i < (int)ECU_NODE_GW; i++) {
+        if (c->node_uart[i] == uart_idx) return (uint8_t)i;
+    }
+    return ECU_NODE_BROADCAST;
+}
+
+void gw_config_dump(const gw_config_t* c, FILE* out)
+{
+    if (!c || !out) return;
+    fprintf(out, "config: tick_ms=%u route_age_ms=%u threads=%d ring_slots=%zu net_cpu=%d backend=%s tap=%s\n",
+            (unsigned)c->tick_ms, (unsigned)c->route_age_ms, c->threads, c->ring_slots, c->net_cpu,
+            c->backend == GW_BACKEND_IO_URING ? "io_uring" : "epoll", c->tap_path[0] ? c->tap_path : "off");
+    fprintf(out, "config: net port=%u max_clients=%d rx_buf=%zu tx_buf=%zu tx_batch_us=%u\n",
+            (unsigned)c->tcp_port, c->max_clients, c->client_rx_buf, c->client_tx_buf, (unsigned)c->tx_batch_us);
+    if (c->cap_prefix[0]) {
+        fprintf(out, "config: capture path=%s max_mb=%u max_sec=%u files=%u block_kb=%u\n", c->cap_prefix,
+                (unsigned)c->cap_max_mb, (unsigned)c->cap_max_sec, (unsigned)c->cap_files, (unsigned)c->cap_block_kb);
+    }
+    for (int i = 0; i < c->uart_count; i++) {
+        const gw_uart_cfg_t* u = &c->uarts[i];
+        static const char* const conflate[] = { "off", "noack", "all" };
+        fprintf(out, "config: uart %s dev=%s baud=%d rx_buf=%zu tx_queue=%zu cpu=%d conflate=%s "
+                "cmd_rate=%u cmd_burst=%u nodes=", u->name, u->dev_path, u->baud, u->rx_buf, u->tx_queue, u->cpu,
+                conflate[u->conflate], (unsigned)u->cmd_rate, (unsigned)u->cmd_burst);
+        int any = 0;
+        for (int n = 1; n < (int)ECU_NODE_GW; n++) {
+            if (c->node_uart[n] != i) continue;
+            fprintf(out, "%s%d", any ? "," : "", n);
+            any = 1;
+        }
+        fprintf(out, "%s\n", any ? "" : "-");
+    }
+}
@@ -0,0 +1,300 @@
+#include "gw/gw_ctl.h"
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+
+#include <string.h>
+
+#define CTL_EVENT_DATA_MAX (ECU_MAX_PAYLOAD - sizeof(ecu_event_hdr_t))
+
+static int send_to_client(gw_ctl_ctx_t* ctx, int fd, uint8_t msg_type, uint16_t flags,
+                          const uint8_t* payload, size_t payload_len)
+{
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = msg_type;
+    h.src = ECU_NODE_GW;
+    h.dst = ECU_NODE_PC;
+    h.seq = (*ctx->gw_seq)++;
+    h.flags = flags;
+    h.payload_len = (uint16_t)payload_len;
+
+    uint8_t frame[ECU_MAX_FRAME_SIZE];
+    size_t len = ecu_frame_pack(&h, payload, frame, sizeof(frame));
+    if (len == 0) return -1;
+    return gw_net_send_frame(ctx->net, fd, frame, len, ctx->now_us);
+}
+
+static int send_ack(gw_ctl_ctx_t* ctx, int fd, uint16_t ack_seq, uint16_t status)
+{
+    ecu_ack_v1_t ack;
+    ack.ack_seq = ack_seq;
+    ack.status_code = status;
+    uint16_t flags = ECU_F_IS_ACK;
+    if (status != 0) flags |= ECU_F_IS_NACK;
+    return send_to_client(ctx, fd, ECU_MSG_ACK, flags, (const uint8_t*)&ack, sizeof(ack));
+}
+
+static int send_event(gw_ctl_ctx_t* ctx, int fd, uint16_t code, const uint8_t* data, size_t data_len)
+{
+    uint8_t payload[ECU_MAX_PAYLOAD];
+    ecu_event_hdr_t eh;
+    if (data_len > CTL_EVENT_DATA_MAX) return -1;
+    eh.event_code = code;
+    eh.data_len = (uint16_t)data_len;
+    memcpy(payload, &eh, sizeof(eh));
+    if (data_len) memcpy(payload + sizeof(eh), data, data_len);
+    return send_to_client(ctx, fd, ECU_MSG_EVENT, 0, payload, sizeof(eh) + data_len);
+}
+
+static int ctl_get_routes(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    (void)params;
+    (void)params_len;
+    enum { PER_EVENT = CTL_EVENT_DATA_MAX / sizeof(gw_ctl_route_rec_t) };
+    gw_ctl_route_rec_t recs[PER_EVENT];
+    size_t n = 0;
+    int sent = 0;
+
+    for (int i = 0; i < GW_ROUTER_NODES; i++) {
+        const gw_route_t* e = &ctx->router->nodes[i];
+        if ((e->flags & (GW_ROUTE_F_STATIC | GW_ROUTE_F_LEARNED)) == 0) continue;
+
+        gw_ctl_route_rec_t* rec = &recs[n++];
+        memset(rec, 0, sizeof(*rec));
+        rec->node_id = (uint8_t)i;
+        rec->flags = e->flags;
+        if (e->flags & GW_ROUTE_F_LEARNED) {
+            uint64_t age = ctx->now_us / 1000u - e->last_seen_ms;
+            rec->uart = e->learned_uart;
+            rec->age_ms = (age > 0xFFFFFFFEull) ? 0xFFFFFFFEu : (uint32_t)age;
+            rec->rx_frames = e->rx_frames;
+        } else {
+            rec->uart = e->static_uart;
+            rec->age_ms = 0xFFFFFFFFu;
+        }
+
+        if (n == PER_EVENT) {
+            if (send_event(ctx, fd, GW_CTL_GET_ROUTES, (const uint8_t*)recs, n * sizeof(recs[0])) < 0) return -1;
+            n = 0;
+            sent++;
+        }
+    }
+
+    // пустая таблица тоже отвечает одним EVENT без записей
+    if (n > 0 || sent == 0) {
+        if (send_event(ctx, fd, GW_CTL_GET_ROUTES, (const uint8_t*)recs, n * sizeof(recs[0])) < 0) return -1;
+    }
+    return 0;
+}
+
+static int ctl_get_fwd(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    (void)params;
+    (void)params_len;
+    enum { PER_EVENT = CTL_EVENT_DATA_MAX / sizeof(gw_ctl_fwd_rec_t) };
+    gw_ctl_fwd_rec_t recs[PER_EVENT];
+    size_t n = 0;
+    int sent = 0;
+    const gw_router_t* r = ctx->router;
+
+    for (int from = 0; from < r->uart_count; from++) {
+        for (int to = 0; to < r->uart_count; to++) {
+            const gw_fwd_stats_t* st = &r->fwd[from][to];
+            if (st->frames == 0 && st->drops == 0) continue;
+            gw_ctl_fwd_rec_t* rec = &recs[n++];
+            memset(rec, 0, sizeof(*rec));
+            rec->from_uart = (uint8_t)from;
+            rec->to_uart = (uint8_t)to;
+            rec->frames = st->frames;
+            rec->bytes = st->bytes;
+            rec->drops = st->drops;
+
+            if (n == PER_EVENT) {
+                if (send_event(ctx, fd, GW_CTL_GET_FWD, (const uint8_t*)recs, n * sizeof(recs[0])) < 0) return -1;
+                n = 0;
+                sent++;
+            }
+        }
+    }
+
+    if (n > 0 || sent == 0) {
+        if (send_event(ctx, fd, GW_CTL_GET_FWD, (const uint8_t*)recs, n * sizeof(recs[0])) < 0) return -1;
+    }
+    return 0;
+}
+
+// Записи реестра копятся и уходят по EVENT, сколько влезет в один кадр
+typedef struct {
+    gw_ctl_ctx_t*    ctx;
+    int              fd;
+    gw_metrics_rec_t recs[CTL_EVENT_DATA_MAX / sizeof(gw_metrics_rec_t)];
+    size_t           n;
+    int              sent;
+} ctl_stats_batch_t;
+
+static int stats_flush(ctl_stats_batch_t* b)
+{
+    if (send_event(b->ctx, b->fd, GW_CTL_GET_STATS, (const uint8_t*)b->recs, b->n * sizeof(b->recs[0])) < 0) return -1;
+    b->n = 0;
+    b->sent++;
+    return 0;
+}
+
+static int stats_add(void* arg, const gw_metrics_rec_t* rec)
+{
+    ctl_stats_batch_t* b = (ctl_stats_batch_t*)arg;
+    b->recs[b->n++] = *rec;
+    if (b->n == sizeof(b->recs) / sizeof(b->recs[0])) return stats_flush(b);
+    return 0;
+}
+
+static int ctl_get_stats(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    if (!ctx->state) return 3; // INTERNAL_ERROR
+    unsigned kind = params_len >= 1 ? params[0] : 0;
+    if (kind > GW_METRICS_LANE) return 2; // INVALID_PARAM
+
+    ctl_stats_batch_t b;
+    b.ctx = ctx;
+    b.fd = fd;
+    b.n = 0;
+    b.sent = 0;
+    if (gw_metrics_foreach(ctx->state, kind, stats_add, &b) < 0) return -1;
+    if (b.n > 0 || b.sent == 0) {
+        if (stats_flush(&b) < 0) return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    gw_ctl_ctx_t*    ctx;
+    int              fd;
+    gw_latency_rec_t recs[CTL_EVENT_DATA_MAX / sizeof(gw_latency_rec_t)];
+    size_t           n;
+    int              sent;
+} ctl_latency_batch_t;
+
+static int latency_flush(ctl_latency_batch_t* b)
+{
+    if (send_event(b->ctx, b->fd, GW_CTL_GET_LATENCY, (const uint8_t*)b->recs, b->n * sizeof(b->recs[0])) < 0) return -1;
+    b->n = 0;
+    b->sent++;
+    return 0;
+}
+
+static int latency_add(void* arg, const gw_latency_rec_t* rec)
+{
+    ctl_latency_batch_t* b = (ctl_latency_batch_t*)arg;
+    b->recs[b->n++] = *rec;
+    if (b->n == sizeof(b->recs) / sizeof(b->recs[0])) return latency_flush(b);
+    return 0;
+}
+
+static int ctl_get_latency(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    unsigned scope = params_len >= 1 ? params[0] : 0;
+    if (scope > GW_LAT_SCOPE_SCHED) return 2; // INVALID_PARAM
+
+    ctl_latency_batch_t b;
+    b.ctx = ctx;
+    b.fd = fd;
+    b.n = 0;
+    b.sent = 0;
+    if (gw_latency_foreach(scope, latency_add, &b) < 0) return -1;
+    if (b.n > 0 || b.sent == 0) {
+        if (latency_flush(&b) < 0) return -1;
+    }
+    return 0;
+}
+
+static int ctl_reset_latency(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    (void)params;
+    (void)params_len;
+    gw_latency_reset();
+    return send_event(ctx, fd, GW_CTL_RESET_LATENCY, NULL, 0) < 0 ? -1 : 0;
+}
+
+static int ctl_subscribe(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    if (params_len < 1 || params[0] > GW_NET_SUB_LATEST) return 2; // INVALID_PARAM
+    gw_net_client_t* c = gw_net_find_client(ctx->net, fd);
+    if (!c) return 3;
+    // смена режима касается только новых кадров: уже стоящие в очереди уйдут как есть
+    c->sub = params[0];
+    return send_event(ctx, fd, GW_CTL_SUBSCRIBE, &c->sub, 1) < 0 ? -1 : 0;
+}
+
+static int ctl_schedule(gw_ctl_ctx_t* ctx, int fd, const uint8_t* params, size_t params_len)
+{
+    gw_ctl_sched_req_t req;
+    const ecu_hdr_t* fh = NULL;
+    if (params_len < sizeof(req)) return 2; // INVALID_PARAM
+    memcpy(&req, params, sizeof(req));
+    const uint8_t* f = params + sizeof(req);
+    size_t flen = params_len - sizeof(req);
+    // кадр узлу: запросы к самому шлюзу по расписанию не выполняются
+    if (!ecu_frame_validate(f, flen, &fh, NULL) || fh->dst == ECU_NODE_GW) return 2;
+
+    gw_net_client_t* c = gw_net_find_client(ctx->net, fd);
+    if (!c || !ctx->sched) return 3;
+    uint64_t at_us = 0;
+    uint32_t id = 0;
+    if (gw_sched_deadline(req.clock, req.at_ms, ctx->now_us, &at_us) < 0) return 2;
+    if (gw_sched_add(ctx->sched, at_us, c->id, f, flen, &id) < 0) return 3; // очередь полна
+
+    gw_ctl_sched_rec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = id;
+    rec.at_us = at_us;
+    rec.state = GW_CTL_SCHED_QUEUED;
+    rec.pending = (uint16_t)gw_sched_pending(ctx->sched);
+    rec.now_us = ctx->now_us;
+    return send_event(ctx, fd, GW_CTL_SCHEDULE, (const uint8_t*)&rec, sizeof(rec)) < 0 ? -1 : 0;
+}
+
+int gw_ctl_event(gw_ctl_ctx_t* ctx, int client_fd, uint16_t code, const uint8_t* data, size_t data_len)
+{
+    if (!ctx) return -1;
+    return send_event(ctx, client_fd, code, data, data_len);
+}
+
+int gw_ctl_handle(gw_ctl_ctx_t* ctx, int client_fd, const ecu_hdr_t* h, const uint8_t* payload)
+{
+    if (!ctx || !h) return 0;
+    if (h->dst != ECU_NODE_GW || h->msg_type != ECU_MSG_COMMAND) return 0;
+    if (h->payload_len < sizeof(ecu_command_hdr_t)) return 0;
+
+    ecu_command_hdr_t ch;
+    memcpy(&ch, payload, sizeof(ch));
+    if ((size_t)ch.param_len + sizeof(ch) > h->payload_len) {
+        if (h->flags & ECU_F_ACK_REQUIRED) return send_ack(ctx, client_fd, h->seq, 2) < 0 ? -1 : 1;
+        return 1;
+    }
+
+    // обработчик шлёт EVENT ответа и возвращает status_code для ACK, либо -1 при ошибке отправки
+    int (*handler)(gw_ctl_ctx_t*, int, const uint8_t*, size_t) = NULL;
+    switch (ch.command_id) {
+        case GW_CTL_GET_ROUTES:    handler = ctl_get_routes; break;
+        case GW_CTL_GET_FWD:       handler = ctl_get_fwd; break;
+        case GW_CTL_GET_STATS:     handler = ctl_get_stats; break;
+        case GW_CTL_GET_LATENCY:   handler = ctl_get_latency; break;
+        case GW_CTL_RESET_LATENCY: handler = ctl_reset_latency; break;
+        case GW_CTL_SUBSCRIBE:     handler = ctl_subscribe; break;
+        case GW_CTL_SCHEDULE:      handler = ctl_schedule; break;
+        default: break;
+    }
+
+    int status = 1; // UNKNOWN_COMMAND
+    if (handler) {
+        status = handler(ctx, client_fd, payload + sizeof(ch), ch.param_len);
+        if (status < 0) return -1;
+    }
+    if (h->flags & ECU_F_ACK_REQUIRED) {
+        if (send_ack(ctx, client_fd, h->seq, (uint16_t)status) < 0) return -1;
+    }
+    return 1;
+}
@@ -0,0 +1,531 @@
+#include "gw/gw_dispatch.h"
+
+#include "gw/gw_ctl.h"
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void gw_dispatch_trace(gw_state_t* st, unsigned kind, unsigned port, const uint8_t* data, size_t len)
+{
+    // кольцо полно — запись отброшена и посчитана, кадр идёт дальше
+    (void)ecu_log_write(&st->trace, kind, port, gw_clock_now(), data, len);
+}
+
+// CRC кадра после правки заголовка/payload
+static void frame_fix_crc(uint8_t* f, size_t len)
+{
+    uint16_t crc = ecu_crc16_ccitt(f, len - ECU_CRC_SIZE);
+    f[len - 2] = (uint8_t)(crc & 0xFFu);
+    f[len - 1] = (uint8_t)(crc >> 8);
+}
+
+// Кадр в TX UART idx без счётчиков. 0 = OK, 1 = очередь полна (место освободится), -1 = не поставить
+static int uart_enqueue(gw_state_t* st, int idx, const uint8_t* frame, size_t len, const gw_lat_origin_t* o)
+{
+    if (st->threaded) {
+        // этап RX кадра закончится в потоке UART, когда он переложит кадр в очередь порта
+        gw_worker_t* w = &st->workers[idx];
+        if (gw_worker_send(w, frame, len, o) == 0) return 0;
+        return w->running && gw_spsc_count(gw_worker_tx_ring(w, frame, len)) > 0 ? 1 : -1;
+    }
+
+    gw_uart_t* u = &st->uarts[idx];
+    if (gw_uart_send_slip_ex(u, frame, len, o) < 0) {
+        // в пустую очередь кадр не встал — и не встанет
+        return gw_uart_tx_pending(u) > 0 ? 1 : -1;
+    }
+    // запись и EPOLLOUT — один раз в конце такта, сколько бы кадров ни пришло
+    st->uart_tx_dirty |= 1u << idx;
+    gw_latency_rx_done(o->dir, o->node, o->t_read);
+    return 0;
+}
+
+static void uart_count_tx(gw_state_t* st, int idx, const uint8_t* frame, size_t len, int ok)
+{
+    gw_metrics_tx(&st->metrics, (const ecu_hdr_t*)frame, len, ok);
+    gw_counter_add(ok ? &st->uarts[idx].stats.tx_frames : &st->uarts[idx].stats.tx_rejected, 1);
+}
+
+int gw_dispatch_uart_send(gw_state_t* st, int idx, const uint8_t* frame, size_t len, const gw_lat_origin_t* o)
+{
+    int rc = uart_enqueue(st, idx, frame, len, o) == 0 ? 0 : -1;
+    uart_count_tx(st, idx, frame, len, rc == 0);
+    return rc;
+}
+
+// ACK узла на команду клиента с seq шлюза (gw_ackmap) — только отправителю, с его seq.
+// 0 = записи нет, кадр рассылается всем
+static int ack_to_client(gw_state_t* st, const uint8_t* f, size_t flen, uint64_t now, const gw_lat_origin_t* o)
+{
+    const ecu_hdr_t* h = (const ecu_hdr_t*)f;
+    ecu_ack_v1_t ack;
+    if (h->payload_len < sizeof(ack)) return 0;
+    memcpy(&ack, f + ECU_HEADER_SIZE, sizeof(ack));
+
+    uint32_t id = 0;
+    uint16_t cseq = 0;
+    if (!gw_ackmap_take(&st->acks, h->src, ack.ack_seq, &id, &cseq)) {
+        st->acks.unmatched++;
+        return 0;
+    }
+    gw_net_client_t* c = gw_net_find_id(&st->net, id);
+    if (!c) {
+        st->acks.orphaned++;
+        return 1;
+    }
+
+    uint8_t out[ECU_MAX_FRAME_SIZE];
+    memcpy(out, f, flen);
+    ack.ack_seq = cseq;
+    memcpy(out + ECU_HEADER_SIZE, &ack, sizeof(ack));
+    frame_fix_crc(out, flen);
+    st->acks.routed++;
+    if (gw_net_client_send(c, out, flen, now, o) == 0) {
+        gw_latency_rx_done(GW_LAT_TO_NET, h->src, o->t_read);
+    }
+    return 1;
+}
+
+// Проверенный кадр с UART idx: выучить src, переслать узлу на другом UART, разослать клиентам.
+// t_read — такт, в котором кадр прочитан из порта (в режиме threads — такт потока UART)
+static void uart_frame_in(gw_state_t* st, int idx, const uint8_t* f, size_t flen, uint64_t now, uint64_t t_read)
+{
+    const ecu_hdr_t* h = (const ecu_hdr_t*)f;
+    const char* port = st->uarts[idx].dev_path;
+    gw_metrics_rx(&st->metrics, h, flen);
+
+    // выучить привязку узла к UART по src
+    int lr = gw_router_learn(&st->router, h->src, (gw_uart_index_t)idx,
+                             h->msg_type == ECU_MSG_HELLO, now / 1000u);
+    if (lr == GW_ROUTER_LEARN_NEW || lr == GW_ROUTER_LEARN_MOVED) {
+        fprintf(stderr, "router: node %u %s on %s\n", (unsigned)h->src,
+                lr == GW_ROUTER_LEARN_NEW ? "learned" : "moved", port);
+    }
+
+    // кадр другому узлу: сразу в его UART, без круга через PC
+    gw_lat_origin_t o = { (uint32_t)t_read, GW_LAT_UART_UART, h->src };
+    gw_uart_index_t to;
+    if (gw_router_lookup(&st->router, h->dst, &to) && (int)to != idx) {
+        int ok = gw_dispatch_uart_send(st, (int)to, f, flen, &o) >= 0;
+        gw_router_count_fwd(&st->router, (gw_uart_index_t)idx, to, flen, ok);
+        if (ok) {
+            if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_FWD_UART, to, f, flen);
+        } else {
+            fprintf(stderr, "UART %s -> %s: TX queue full (drop)\n", port, st->uarts[to].dev_path);
+        }
+    }
+
+    // отправить на ПК всем клиентам (пересланные узлу кадры тоже — для мониторинга),
+    // ACK на команду клиента — только ему
+    o.dir = GW_LAT_TO_NET;
+    int to_sender = h->msg_type == ECU_MSG_ACK && h->dst == ECU_NODE_PC && ack_to_client(st, f, flen, now, &o);
+    if (!to_sender && gw_net_broadcast_frame(&st->net, f, flen, now, &o) > 0) {
+        gw_latency_rx_done(GW_LAT_TO_NET, h->src, o.t_read);
+    }
+    if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_TX_NET, (unsigned)idx, f, flen);
+}
+
+void gw_dispatch_uart_rx(gw_state_t* st, int idx, uint64_t now)
+{
+    gw_uart_t* u = &st->uarts[idx];
+    for (;;) {
+        const uint8_t* f = NULL;
+        size_t flen = 0;
+        int gr = gw_uart_try_get_slip_frame(u, &f, &flen);
+        if (gr == 0) break;
+        if (gr < 0) continue; // сбойный кадр отброшен, дальше могут идти целые
+
+        if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_RX_UART, (unsigned)idx, f, flen);
+
+        if (!ecu_frame_validate(f, flen, NULL, NULL)) {
+            gw_counter_add(&u->stats.rx_crc_errors, 1);
+            fprintf(stderr, "UART %s: bad ECU frame (drop)\n", u->dev_path);
+            continue;
+        }
+        gw_counter_add(&u->stats.rx_frames, 1);
+        uart_frame_in(st, idx, f, flen, now, now);
+    }
+}
+
+void gw_dispatch_worker_rx(gw_state_t* st, int idx, uint64_t now)
+{
+    gw_worker_t* w = &st->workers[idx];
+    if (!w->uart) return;
+    for (;;) {
+        size_t flen = 0;
+        uint64_t t_read = now;
+        const uint8_t* f = gw_spsc_peek_tag(&w->rx, &flen, &t_read);
+        if (!f) break;
+        if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_RX_UART, (unsigned)idx, f, flen);
+        uart_frame_in(st, idx, f, flen, now, t_read);
+        gw_spsc_pop(&w->rx);
+    }
+}
+
+static void ctl_ctx(gw_state_t* st, uint64_t now, gw_ctl_ctx_t* cctx)
+{
+    cctx->net = &st->net;
+    cctx->router = &st->router;
+    cctx->gw_seq = &st->gw_seq;
+    cctx->state = st;
+    cctx->sched = &st->sched;
+    cctx->now_us = now;
+}
+
+// DRR: квант клиента за круг не меньше наибольшего кадра — любой кадр проходит за один круг
+#define CLIENT_QUANTUM (ECU_MAX_FRAME_SIZE + 4u)
+
+// Пополнить корзину клиента к UART. 1 = need байт есть (берёт вызывающий, когда кадр встал в очередь),
+// 0 = мало токенов, *wait_us — сколько ждать
+static int flow_ready(gw_net_flow_t* fl, const gw_uart_cfg_t* uc, size_t need, uint64_t now, uint64_t* wait_us)
+{
+    if (uc->cmd_rate == 0) return 1;
+    uint64_t cap = (uint64_t)uc->cmd_burst * 1000000u;
+    if (fl->t_fill == 0) fl->tokens = cap;
+    else fl->tokens += (now - fl->t_fill) * uc->cmd_rate;
+    if (fl->tokens > cap) fl->tokens = cap;
+    fl->t_fill = now;
+
+    uint64_t want = (uint64_t)need * 1000000u;
+    if (fl->tokens >= want) return 1;
+    *wait_us = (want - fl->tokens + uc->cmd_rate - 1) / uc->cmd_rate;
+    return 0;
+}
+
+// Ожидание кадров клиента закончилось: время — в счётчик
+static void wait_end(uint64_t* since, uint64_t* total_us, uint64_t now)
+{
+    if (*since == 0) return;
+    *total_us += now - *since;
+    *since = 0;
+}
+
+// Поток кадров клиента в круге: UART и срочный или нет (бит в маске ждущих потоков)
+static uint32_t flow_bit(gw_uart_index_t out, int urgent)
+{
+    return 1u << (2u * (unsigned)out + (urgent ? 1u : 0u));
+}
+
+_Static_assert(2 * GW_UART_MAX <= 32, "flow mask must fit uint32_t");
+
+// Один круг DRR клиента: кадры rx_buf по порядку, пока хватает дефицита, токенов и места в очередях
+// их UART. Кадр, который ждёт, держит только свой поток (UART, срочный или нет): следующие кадры
+// этого потока пропускаются до конца круга (порядок внутри потока сохраняется), кадры в другие UART
+// и срочные идут дальше. Срочные (ECU_F_URGENT) — мимо корзины cmd_rate. Запрос к шлюзу не обгоняет
+// ждущие кадры. Сокет клиента не читается, только если ждущие кадры заняли rx_buf.
+// Возвращает число снятых кадров. *next_us — через сколько ждущий токенов кадр сможет пройти
+static int client_round(gw_state_t* st, gw_net_client_t* c, uint64_t now, long* next_us)
+{
+    unsigned slot = (unsigned)(c - st->net.clients);
+    int done = 0;
+    size_t off = 0;        // начало следующего кадра: до него в rx_buf — ждущие кадры
+    uint32_t held = 0;     // потоки с ждущим кадром (flow_bit)
+    int throttled = 0;     // ждёт токенов
+    int paused = 0;        // ждёт места в TX очереди UART
+    for (;;) {
+        const uint8_t* f = NULL;
+        size_t flen = 0;
+        if (gw_net_client_peek_frame_at(c, off, ECU_MAX_FRAME_SIZE, &f, &flen) <= 0) break;
+
+        const ecu_hdr_t* h = NULL;
+        if (!ecu_frame_validate(f, flen, &h, NULL)) {
+            if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_RX_NET, slot, f, flen);
+            c->stats.rx_crc_errors++;
+            fprintf(stderr, "NET: bad ECU frame (drop)\n");
+            gw_net_client_pop_frame_at(c, off);
+            done++;
+            continue;
+        }
+
+        // запросы к самому шлюзу — без очереди и токенов, но после ждущих кадров клиента
+        if (h->dst == ECU_NODE_GW) {
+            if (held) break;
+            if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_RX_NET, slot, f, flen);
+            gw_ctl_ctx_t cctx;
+            ctl_ctx(st, now, &cctx);
+            if (gw_ctl_handle(&cctx, c->fd, h, f + ECU_HEADER_SIZE) < 0) {
+                fprintf(stderr, "NET: failed to reply to GW request\n");
+            }
+            gw_net_client_pop_frame_at(c, off);
+            done++;
+            continue;
+        }
+
+        // роутинг на UART по dst (выученная привязка, иначе статическая)
+        gw_uart_index_t out;
+        if (!gw_router_lookup(&st->router, h->dst, &out)) {
+            // broadcast / неизвестный узел — пока игнорируем
+            if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_RX_NET, slot, f, flen);
+            c->stats.rx_rejected++;
+            gw_net_client_pop_frame_at(c, off);
+            done++;
+            continue;
+        }
+
+        int urgent = (h->flags & ECU_F_URGENT) != 0;
+        uint32_t bit = flow_bit(out, urgent);
+        if (held & bit) {
+            off += 4u + flen;
+            continue;
+        }
+
+        gw_net_flow_t* fl = &c->flow[out];
+        if (fl->round != st->client_round) {
+            fl->round = st->client_round;
+            if (fl->deficit < flen) fl->deficit += CLIENT_QUANTUM;
+        }
+        if (fl->deficit < flen) {
+            // следующий круг
+            held |= bit;
+            off += 4u + flen;
+            continue;
+        }
+
+        // кадр ждёт в rx_buf, пока не пройдёт
+        const gw_uart_cfg_t* uc = &st->cfg.uarts[out];
+        uint64_t wait_us = 0;
+        if (!urgent && !flow_ready(fl, uc, flen, now, &wait_us)) {
+            throttled = 1;
+            if (*next_us < 0 || (long)wait_us < *next_us) *next_us = (long)wait_us;
+            held |= bit;
+            off += 4u + flen;
+            continue;
+        }
+
+        // команда с ACK уходит с seq шлюза этому узлу: ACK вернётся только отправителю (gw_ackmap)
+        uint8_t tx[ECU_MAX_FRAME_SIZE];
+        const uint8_t* uf = f;
+        uint16_t gw_seq = (h->flags & ECU_F_ACK_REQUIRED) ? gw_ackmap_next(&st->acks, h->dst) : 0;
+        if ((h->flags & ECU_F_ACK_REQUIRED) && gw_seq == 0) {
+            // некуда запомнить отправителя: ACK ушёл бы не тому — кадр не отправляется
+            if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_RX_NET, slot, f, flen);
+            c->stats.rx_rejected++;
+            fprintf(stderr, "NET: ACK map out of memory (drop)\n");
+            gw_net_client_pop_frame_at(c, off);
+            done++;
+            continue;
+        }
+        if (gw_seq != 0) {
+            memcpy(tx, f, flen);
+            ((ecu_hdr_t*)tx)->seq = gw_seq;
+            frame_fix_crc(tx, flen);
+            uf = tx;
+        }
+
+        // отправить на UART (SLIP); очередь полна — ждать места (TCP придержит клиента), а не терять кадр
+        gw_lat_origin_t o = { (uint32_t)now, GW_LAT_TO_UART, h->dst };
+        int qr = uart_enqueue(st, out, uf, flen, &o);
+        if (qr > 0) {
+            paused = 1;
+            held |= bit;
+            off += 4u + flen;
+            continue;
+        }
+        fl->deficit -= (uint32_t)flen;
+        if (qr == 0 && !urgent && uc->cmd_rate != 0) fl->tokens -= (uint64_t)flen * 1000000u;
+        if (qr == 0 && gw_seq != 0) gw_ackmap_put(&st->acks, h->dst, gw_seq, c->id, h->seq);
+        uart_count_tx(st, out, uf, flen, qr == 0);
+        if (qr < 0) c->stats.rx_rejected++;
+        if (st->trace_frames) {
+            gw_dispatch_trace(st, ECU_LOG_RX_NET, slot, f, flen);
+            gw_dispatch_trace(st, ECU_LOG_TX_UART, out, uf, flen);
+        }
+        gw_net_client_pop_frame_at(c, off);
+        done++;
+    }
+
+    // очередь клиента пуста: неизрасходованный дефицит не копится
+    if (c->rx_len == 0) {
+        for (int k = 0; k < GW_UART_MAX; k++) c->flow[k].deficit = 0;
+    }
+    if (!throttled) wait_end(&c->throttled_since, &c->stats.throttled_us, now);
+    else if (c->throttled_since == 0) c->throttled_since = now;
+    if (!paused) wait_end(&c->paused_since, &c->stats.paused_us, now);
+    else if (c->paused_since == 0) c->paused_since = now;
+    // ждущие кадры заняли rx_buf: следующий кадр может не поместиться — сокет пока не читать
+    c->rx_paused = held != 0 && (c->rx_spill_len > 0 || c->rx_cap - c->rx_len < 4u + ECU_MAX_FRAME_SIZE);
+    return done;
+}
+
+long gw_dispatch_clients(gw_state_t* st, uint64_t now)
+{
+    gw_net_t* net = &st->net;
+    int n = net->max_clients;
+    long next_us = -1;
+    if (n <= 0) return -1;
+
+    // круги, пока хоть один клиент что-то поставил; первый клиент круга сдвигается от вызова к вызову
+    int progress = 1;
+    while (progress) {
+        progress = 0;
+        st->client_round++;
+        for (int i = 0; i < n; i++) {
+            gw_net_client_t* c = &net->clients[(st->client_rr + i) % n];
+            if (c->fd < 0 || c->rx_len == 0) continue;
+            if (client_round(st, c, now, &next_us) > 0) progress = 1;
+        }
+    }
+    st->client_rr = (st->client_rr + 1) % n;
+
+    // время ожидания — в счётчики сразу, не только когда кадр пройдёт
+    for (int i = 0; i < n; i++) {
+        gw_net_client_t* c = &net->clients[i];
+        if (c->fd < 0) continue;
+        if (c->throttled_since != 0) {
+            c->stats.throttled_us += now - c->throttled_since;
+            c->throttled_since = now;
+        }
+        if (c->paused_since != 0) {
+            c->stats.paused_us += now - c->paused_since;
+            c->paused_since = now;
+        }
+    }
+    return next_us;
+}
+
+// Кадр задания e — в TX очередь UART out. 0 = поставлен, 1 = очередь полна (кадр не изменён), -1 = не встанет
+static int sched_send(gw_state_t* st, gw_sched_ent_t* e, int out, uint64_t now)
+{
+    // как у команд клиентов: ACK узла вернётся только поставившему, с его seq
+    ecu_hdr_t* h = (ecu_hdr_t*)e->frame;
+    uint16_t cseq = h->seq;
+    uint16_t gw_seq = (h->flags & ECU_F_ACK_REQUIRED) ? gw_ackmap_next(&st->acks, h->dst) : 0;
+    if ((h->flags & ECU_F_ACK_REQUIRED) && gw_seq == 0) return -1;   // нет памяти под запись ACK
+    if (gw_seq != 0) {
+        h->seq = gw_seq;
+        frame_fix_crc(e->frame, e->len);
+    }
+    gw_lat_origin_t o = { (uint32_t)now, GW_LAT_TO_UART, h->dst };
+    int qr = uart_enqueue(st, out, e->frame, e->len, &o);
+    if (qr > 0) {
+        // seq шлюза ещё не занят: при повторе кадр получит его заново
+        if (gw_seq != 0) {
+            h->seq = cseq;
+            frame_fix_crc(e->frame, e->len);
+        }
+        return 1;
+    }
+    uart_count_tx(st, out, e->frame, e->len, qr == 0);
+    if (qr < 0) return -1;
+    if (gw_seq != 0) gw_ackmap_put(&st->acks, h->dst, gw_seq, e->client_id, cseq);
+    if (st->trace_frames) gw_dispatch_trace(st, ECU_LOG_TX_UART, (unsigned)out, e->frame, e->len);
+    return 0;
+}
+
+// Задание e отправлено в UART out (out < 0 — отброшено): счётчики, опоздание и отчёт поставившему.
+// Вызывать до освобождения места задания
+static void sched_done(gw_state_t* st, const gw_sched_ent_t* e, int out, uint64_t now)
+{
+    gw_sched_t* s = &st->sched;
+    gw_ctl_sched_rec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = e->id;
+    rec.at_us = e->at_us;
+    rec.now_us = now;
+    uint64_t late = now > e->at_us ? now - e->at_us : 0;
+    rec.late_us = late > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)late;
+    if (out >= 0) {
+        rec.state = GW_CTL_SCHED_SENT;
+        rec.uart = (uint8_t)out;
+        s->sent++;
+        if (late > GW_SCHED_LATE_US) s->late++;
+        gw_latency_sched_add(rec.late_us);
+    } else {
+        rec.state = GW_CTL_SCHED_DROPPED;
+        s->dropped++;
+        fprintf(stderr, "sched: command %u to node %u dropped\n", (unsigned)e->id,
+                (unsigned)((const ecu_hdr_t*)e->frame)->dst);
+    }
+
+    // отчёт поставившему, если он ещё подключён (само задание ещё не снято)
+    gw_net_client_t* c = gw_net_find_id(&st->net, e->client_id);
+    if (!c) return;
+    rec.pending = (uint16_t)(gw_sched_pending(s) - 1);
+    gw_ctl_ctx_t cctx;
+    ctl_ctx(st, now, &cctx);
+    if (gw_ctl_event(&cctx, c->fd, GW_CTL_SCHEDULE, (const uint8_t*)&rec, sizeof(rec)) < 0) {
+        fprintf(stderr, "NET: failed to report scheduled command\n");
+    }
+}
+
+long gw_dispatch_sched(gw_state_t* st, uint64_t now)
+{
+    gw_sched_t* s = &st->sched;
+    long next_us = -1;
+
+    // задания, ждущие места в своём UART, — первыми и по порядку; полный UART не держит остальные.
+    // Повтор не по таймеру: цикл событий вызывает снова, когда место освобождается
+    for (int u = 0; u < st->uart_count; u++) {
+        gw_sched_ent_t* e;
+        while ((e = gw_sched_waiting(s, (unsigned)u)) != NULL) {
+            int qr = sched_send(st, e, u, now);
+            if (qr > 0) break;
+            sched_done(st, e, qr == 0 ? u : -1, now);
+            gw_sched_unwait(s, (unsigned)u);
+        }
+    }
+
+    for (;;) {
+        gw_sched_ent_t* e = gw_sched_head(s);
+        if (!e) break;
+        if (e->at_us > now) {
+            long us = (long)(e->at_us - now);
+            if (next_us < 0 || us < next_us) next_us = us;
+            break;
+        }
+
+        gw_uart_index_t out;
+        if (!gw_router_lookup(&st->router, ((const ecu_hdr_t*)e->frame)->dst, &out)) {
+            sched_done(st, e, -1, now);
+            gw_sched_pop(s);
+            continue;
+        }
+        // UART уже занят более ранними заданиями — за ними; очередь полна — ждать места
+        int qr = gw_sched_waiting(s, (unsigned)out) ? 1 : sched_send(st, e, (int)out, now);
+        if (qr > 0) {
+            gw_sched_defer(s, (unsigned)out);
+            continue;
+        }
+        sched_done(st, e, qr == 0 ? (int)out : -1, now);
+        gw_sched_pop(s);
+    }
+    return next_us;
+}
+
+void gw_dispatch_age(gw_state_t* st, uint64_t now)
+{
+    uint64_t now_ms = now / 1000u;
+    if (now_ms - st->last_age_ms < 1000u) return;
+    st->last_age_ms = now_ms;
+
+    int expired = gw_router_age(&st->router, now_ms);
+    if (expired > 0) {
+        fprintf(stderr, "router: %d learned binding(s) aged out\n", expired);
+        if (st->show_packets) gw_router_dump(&st->router, now_ms, stderr);
+    }
+}
+
+int gw_dispatch_reload(gw_state_t* st, uint64_t now)
+{
+    fprintf(stderr, "SIGHUP: reloading %s\n", st->config_path);
+    if (st->threaded) {
+        // потоки UART останавливаются на время перестройки, принятое ими — доставить
+        gw_state_stop_workers(st);
+        for (int k = 0; k < st->uart_count; k++) gw_dispatch_worker_rx(st, k, now);
+    }
+    int rc = gw_state_reload(st);
+    // индексы UART могли смениться: ждущие места отложенные команды — снова по сроку
+    gw_sched_requeue(&st->sched);
+    if (st->threaded && gw_state_start_workers(st) < 0) return -1;
+    // индексы UART могли смениться — отложенные записи пересчитает цикл
+    st->uart_tx_dirty = (1u << st->uart_count) - 1u;
+    if (rc == 0 && st->show_packets) {
+        gw_config_dump(&st->cfg, stderr);
+        gw_router_dump(&st->router, now / 1000u, stderr);
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include "gw/gw_latency.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Корзина: 0..7 — само значение, дальше по 8 на степень двойки (старший бит m, 3 бита под ним)
+static unsigned hist_index(uint32_t v)
+{
+    if (v < 8) return v;
+    unsigned m = 31u - (unsigned)__builtin_clz(v);
+    return (m - 2u) * 8u + ((v >> (m - 3u)) & 7u);
+}
+
+static uint32_t hist_lower(unsigned idx)
+{
+    if (idx < 8) return idx;
+    unsigned m = idx / 8u + 2u;
+    return (8u + idx % 8u) << (m - 3u);
+}
+
+static uint32_t hist_upper(unsigned idx)
+{
+    if (idx < 8) return idx;
+    unsigned m = idx / 8u + 2u;
+    return hist_lower(idx) + ((1u << (m - 3u)) - 1u);
+}
+
+void gw_hist_add(gw_hist_t* h, uint32_t us)
+{
+    atomic_fetch_add_explicit(&h->bucket[hist_index(us)], 1u, memory_order_relaxed);
+    unsigned m = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (us > m && !atomic_compare_exchange_weak_explicit(&h->max, &m, us, memory_order_relaxed,
+                                                            memory_order_relaxed)) {
+    }
+}
+
+void gw_hist_reset(gw_hist_t* h)
+{
+    for (unsigned i = 0; i < GW_HIST_BUCKETS; i++) atomic_store_explicit(&h->bucket[i], 0u, memory_order_relaxed);
+    atomic_store_explicit(&h->max, 0u, memory_order_relaxed);
+}
+
+void gw_hist_summary(const gw_hist_t* h, gw_hist_summary_t* out)
+{
+    uint32_t b[GW_HIST_BUCKETS];
+    uint64_t total = 0;
+    memset(out, 0, sizeof(*out));
+
+    // снимок: корзины могут расти во время обхода, считаем по скопированным
+    for (unsigned i = 0; i < GW_HIST_BUCKETS; i++) {
+        b[i] = atomic_load_explicit((atomic_uint*)&h->bucket[i], memory_order_relaxed);
+        total += b[i];
+    }
+    if (total == 0) return;
+    out->count = total > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)total;
+    out->max = atomic_load_explicit((atomic_uint*)&h->max, memory_order_relaxed);
+
+    // ранг перцентиля p (в десятых долях процента), не меньше 1
+    const unsigned pm[4] = { 500, 900, 990, 999 };
+    uint32_t* dst[4] = { &out->p50, &out->p90, &out->p99, &out->p999 };
+    uint64_t rank[4];
+    for (int k = 0; k < 4; k++) {
+        rank[k] = (total * pm[k] + 999u) / 1000u;
+        if (rank[k] == 0) rank[k] = 1;
+    }
+
+    uint64_t acc = 0;
+    int k = 0;
+    int first = 1;
+    for (unsigned i = 0; i < GW_HIST_BUCKETS && k < 4; i++) {
+        if (b[i] == 0) continue;
+        if (first) {
+            out->min = hist_lower(i);
+            first = 0;
+        }
+        acc += b[i];
+        while (k < 4 && acc >= rank[k]) *dst[k++] = hist_upper(i);
+    }
+    // верхняя граница корзины не больше настоящего максимума
+    for (k = 0; k < 4; k++) {
+        if (*dst[k] > out->max) *dst[k] = out->max;
+    }
+}
+
+typedef struct {
+    gw_hist_t stage[GW_LAT_DIRS][GW_LAT_STAGES];
+    gw_hist_t lane[GW_LAT_LANES];
+    gw_hist_t sched;
+    gw_hist_t (*node)[GW_LAT_DIRS];   // [256][направление], только TOTAL; NULL до gw_latency_init
+} gw_latency_t;
+
+static gw_latency_t g_lat;
+
+int gw_latency_init(void)
+{
+    if (g_lat.node) return 0;
+    // ~740 КБ адресного пространства; страницы заполняются только для узлов с трафиком
+    g_lat.node = calloc(256, sizeof(*g_lat.node));
+    return g_lat.node ? 0 : -1;
+}
+
+void gw_latency_free(void)
+{
+    free(g_lat.node);
+    g_lat.node = NULL;
+}
+
+void gw_latency_add(unsigned dir, unsigned stage, uint8_t node, uint32_t us)
+{
+    if (dir >= GW_LAT_DIRS || stage >= GW_LAT_STAGES) return;
+    gw_hist_add(&g_lat.stage[dir][stage], us);
+    if (stage == GW_LAT_TOTAL && g_lat.node) gw_hist_add(&g_lat.node[node][dir], us);
+}
+
+void gw_latency_lane_add(unsigned lane, uint32_t us)
+{
+    if (lane < GW_LAT_LANES) gw_hist_add(&g_lat.lane[lane], us);
+}
+
+void gw_latency_sched_add(uint32_t us)
+{
+    gw_hist_add(&g_lat.sched, us);
+}
+
+void gw_latency_reset(void)
+{
+    for (unsigned d = 0; d < GW_LAT_DIRS; d++) {
+        for (unsigned s = 0; s < GW_LAT_STAGES; s++) gw_hist_reset(&g_lat.stage[d][s]);
+    }
+    for (unsigned k = 0; k < GW_LAT_LANES; k++) gw_hist_reset(&g_lat.lane[k]);
+    gw_hist_reset(&g_lat.sched);
+    if (!g_lat.node) return;
+    for (unsigned n = 0; n < 256; n++) {
+        for (unsigned d = 0; d < GW_LAT_DIRS; d++) {
+            // нетронутые гистограммы не трогаем — страницы узлов без трафика остаются пустыми
+            if (atomic_load_explicit(&g_lat.node[n][d].max, memory_order_relaxed) == 0 &&
+                atomic_load_explicit(&g_lat.node[n][d].bucket[0], memory_order_relaxed) == 0) continue;
+            gw_hist_reset(&g_lat.node[n][d]);
+        }
+    }
+}
+
+void gw_lat_fifo_queued(gw_lat_fifo_t* f, size_t bytes, const gw_lat_origin_t* o, uint64_t now_us)
+{
+    f->queued += (uint32_t)bytes;
+    if (!o || f->head - f->tail >= GW_LAT_MARKS) return;
+
+    gw_lat_mark_t* m = &f->mark[f->head % GW_LAT_MARKS];
+    m->end = f->queued;
+    m->t_read = o->t_read;
+    m->t_enq = (uint32_t)now_us;
+    m->dir = o->dir;
+    m->node = o->node;
+    f->head++;
+}
+
+void gw_lat_fifo_sent(gw_lat_fifo_t* f, size_t bytes, uint64_t now_us)
+{
+    f->sent += (uint32_t)bytes;
+    uint32_t now = (uint32_t)now_us;
+    while (f->tail != f->head) {
+        const gw_lat_mark_t* m = &f->mark[f->tail % GW_LAT_MARKS];
+        if ((int32_t)(f->sent - m->end) < 0) break;
+        gw_latency_add(m->dir, GW_LAT_QUEUE, m->node, now - m->t_enq);
+        gw_latency_add(m->dir, GW_LAT_TOTAL, m->node, now - m->t_read);
+        f->tail++;
+    }
+}
+
+void gw_lat_fifo_skip(gw_lat_fifo_t* f, size_t bytes)
+{
+    f->sent += (uint32_t)bytes;
+    while (f->tail != f->head && (int32_t)(f->sent - f->mark[f->tail % GW_LAT_MARKS].end) >= 0) f->tail++;
+}
+
+void gw_lat_fifo_cut(gw_lat_fifo_t* f, uint32_t at, size_t bytes)
+{
+    uint32_t n = (uint32_t)bytes;
+    uint32_t w = f->tail;
+    for (uint32_t i = f->tail; i != f->head; i++) {
+        gw_lat_mark_t m = f->mark[i % GW_LAT_MARKS];
+        uint32_t rel = m.end - at;   // конец кадра за началом вырезанного
+        if (rel > 0 && rel <= f->queued - at) {
+            if (rel <= n) continue;  // вырезанный кадр
+            m.end -= n;
+        }
+        f->mark[w++ % GW_LAT_MARKS] = m;
+    }
+    f->head = w;
+    f->queued -= n;
+}
+
+void gw_lat_fifo_clear(gw_lat_fifo_t* f)
+{
+    f->tail = f->head;
+    f->sent = f->queued;
+}
+
+static int stage_rec(gw_latency_rec_t* r, unsigned scope, unsigned dir, unsigned stage, unsigned node,
+                     const gw_hist_t* h)
+{
+    gw_hist_summary_t s;
+    gw_hist_summary(h, &s);
+    if (s.count == 0) return 0;
+    r->scope = (uint8_t)scope;
+    r->dir = (uint8_t)dir;
+    r->stage = (uint8_t)stage;
+    r->node = (uint8_t)node;
+    r->count = s.count;
+    r->min = s.min;
+    r->max = s.max;
+    r->p50 = s.p50;
+    r->p90 = s.p90;
+    r->p99 = s.p99;
+    r->p999 = s.p999;
+    return 1;
+}
+
+int gw_latency_foreach(unsigned scope, int (*fn)(void* arg, const gw_latency_rec_t* rec), void* arg)
+{
+    if (!fn) return 0;
+    gw_latency_rec_t r;
+    int rc;
+
+    if (scope == 0 || scope == GW_LAT_SCOPE_STAGE) {
+        for (unsigned d = 0; d < GW_LAT_DIRS; d++) {
+            for (unsigned s = 0; s < GW_LAT_STAGES; s++) {
+                if (!stage_rec(&r, GW_LAT_SCOPE_STAGE, d, s, 0, &g_lat.stage[d][s])) continue;
+                if ((rc = fn(arg, &r)) < 0) return rc;
+            }
+        }
+    }
+    if (scope == 0 || scope == GW_LAT_SCOPE_LANE) {
+        for (unsigned k = 0; k < GW_LAT_LANES; k++) {
+            if (!stage_rec(&r, GW_LAT_SCOPE_LANE, GW_LAT_TO_UART, GW_LAT_QUEUE, k, &g_lat.lane[k])) continue;
+            if ((rc = fn(arg, &r)) < 0) return rc;
+        }
+    }
+    if (scope == 0 || scope == GW_LAT_SCOPE_SCHED) {
+        if (stage_rec(&r, GW_LAT_SCOPE_SCHED, GW_LAT_TO_UART, GW_LAT_RX, 0, &g_lat.sched) &&
+            (rc = fn(arg, &r)) < 0) return rc;
+    }
+    if ((scope == 0 || scope == GW_LAT_SCOPE_NODE) && g_lat.node) {
+        for (unsigned n = 0; n < 256; n++) {
+            for (unsigned d = 0; d < GW_LAT_DIRS; d++) {
+                if (!stage_rec(&r, GW_LAT_SCOPE_NODE, d, GW_LAT_TOTAL, n, &g_lat.node[n][d])) continue;
+                if ((rc = fn(arg, &r)) < 0) return rc;
+            }
+        }
+    }
+    return 0;
+}
+
+static int dump_rec(void* arg, const gw_latency_rec_t* r)
+{
+    static const char* const dirs[GW_LAT_DIRS] = { "uart>net", "net>uart", "uart>uart" };
+    static const char* const stages[GW_LAT_STAGES] = { "rx", "queue", "total" };
+    static const char* const lanes[GW_LAT_LANES] = { "urgent", "ctrl", "bulk" };
+    FILE* out = (FILE*)arg;
+    char id[16];
+    const char* dir = dirs[r->dir];
+    if (r->scope == GW_LAT_SCOPE_NODE) snprintf(id, sizeof(id), "node %u", (unsigned)r->node);
+    else if (r->scope == GW_LAT_SCOPE_LANE) {
+        dir = "uart-lane";
+        snprintf(id, sizeof(id), "%s", lanes[r->node]);
+    } else if (r->scope == GW_LAT_SCOPE_SCHED) {
+        dir = "sched";
+        snprintf(id, sizeof(id), "late");
+    } else snprintf(id, sizeof(id), "%s", stages[r->stage]);
+    fprintf(out, "latency: %-9s %-8s %-9u %-7u %-7u %-7u %-7u %-7u %u\n", dir, id,
+            (unsigned)r->count, (unsigned)r->min, (unsigned)r->p50, (unsigned)r->p90, (unsigned)r->p99,
+            (unsigned)r->p999, (unsigned)r->max);
+    return 0;
+}
+
+void gw_latency_dump(FILE* out)
+{
+    if (!out) return;
+    fprintf(out, "latency: dir       stage    count     min     p50     p90     p99     p99.9   max (us)\n");
+    (void)gw_latency_foreach(0, dump_rec, out);
+    fflush(out);
+}
@@ -0,0 +1,212 @@
+#include "gw/gw_metrics.h"
+
+#include "gw/gw_state.h"
+
+#include <string.h>
+
+static void rec_init(gw_metrics_rec_t* r, unsigned kind, unsigned id)
+{
+    memset(r, 0, sizeof(*r));
+    r->kind = (uint8_t)kind;
+    r->id = (uint8_t)id;
+}
+
+static void rec_uart(gw_metrics_rec_t* r, int idx, const gw_uart_t* u)
+{
+    const gw_uart_stats_t* s = &u->stats;
+    rec_init(r, GW_METRICS_UART, (unsigned)idx);
+    r->frames_in = gw_counter_get(&s->rx_frames);
+    r->bytes_in = gw_counter_get(&s->rx_bytes);
+    r->frames_out = gw_counter_get(&s->tx_frames);
+    r->bytes_out = gw_counter_get(&s->tx_bytes);
+    r->crc_errors = gw_counter_get(&s->rx_crc_errors);
+    r->framing_errors = gw_counter_get(&s->rx_slip_errors) + gw_counter_get(&s->rx_overflows);
+    r->drops = gw_counter_get(&s->rx_dropped);
+    r->hwm = gw_counter_get(&s->tx_hwm);
+    r->rejected = gw_counter_get(&s->tx_rejected);
+}
+
+static void rec_lane(gw_metrics_rec_t* r, int idx, unsigned lane, const gw_uart_t* u)
+{
+    const gw_uart_lane_stats_t* s = &u->stats.lane[lane];
+    rec_init(r, GW_METRICS_LANE, (unsigned)idx * GW_UART_LANES + lane);
+    r->frames_out = gw_counter_get(&s->frames);
+    r->bytes_out = gw_counter_get(&s->bytes);
+    r->hwm = gw_counter_get(&s->hwm);
+    r->conflated = gw_counter_get(&s->conflated);
+}
+
+static void rec_client(gw_metrics_rec_t* r, int slot, const gw_net_client_t* c)
+{
+    const gw_net_client_stats_t* s = &c->stats;
+    rec_init(r, GW_METRICS_CLIENT, (unsigned)slot);
+    r->frames_in = s->rx_frames;
+    r->bytes_in = s->rx_bytes;
+    r->frames_out = s->tx_frames;
+    r->bytes_out = s->tx_bytes;
+    r->crc_errors = s->rx_crc_errors;
+    r->framing_errors = s->rx_len_errors;
+    r->drops = c->tx_drops;
+    r->hwm = s->tx_hwm;
+    r->rejected = s->rx_rejected;
+    r->conflated = s->tx_conflated;
+    r->throttled_ms = (uint32_t)(s->throttled_us / 1000u);
+    r->paused_ms = (uint32_t)(s->paused_us / 1000u);
+}
+
+// 0 = счётчики пусты, запись не нужна
+static int rec_flow(gw_metrics_rec_t* r, unsigned kind, unsigned id, const gw_metrics_flow_t* f)
+{
+    if ((f->rx_frames | f->tx_frames | f->tx_rejected) == 0) return 0;
+    rec_init(r, kind, id);
+    r->frames_in = f->rx_frames;
+    r->bytes_in = f->rx_bytes;
+    r->frames_out = f->tx_frames;
+    r->bytes_out = f->tx_bytes;
+    r->rejected = f->tx_rejected;
+    return 1;
+}
+
+int gw_metrics_foreach(const gw_state_t* st, unsigned kind,
+                       int (*fn)(void* arg, const gw_metrics_rec_t* rec), void* arg)
+{
+    if (!st || !fn) return 0;
+    gw_metrics_rec_t r;
+    int rc;
+
+    if (kind == 0 || kind == GW_METRICS_UART) {
+        for (int i = 0; i < st->uart_count; i++) {
+            rec_uart(&r, i, &st->uarts[i]);
+            if ((rc = fn(arg, &r)) < 0) return rc;
+        }
+    }
+    if (kind == 0 || kind == GW_METRICS_LANE) {
+        for (int i = 0; i < st->uart_count; i++) {
+            for (unsigned k = 0; k < GW_UART_LANES; k++) {
+                rec_lane(&r, i, k, &st->uarts[i]);
+                if ((rc = fn(arg, &r)) < 0) return rc;
+            }
+        }
+    }
+    if (kind == 0 || kind == GW_METRICS_CLIENT) {
+        for (int i = 0; i < st->net.max_clients; i++) {
+            const gw_net_client_t* c = &st->net.clients[i];
+            if (c->fd < 0) continue;
+            rec_client(&r, i, c);
+            if ((rc = fn(arg, &r)) < 0) return rc;
+        }
+    }
+    if (kind == 0 || kind == GW_METRICS_NODE) {
+        for (int i = 0; i < GW_ROUTER_NODES; i++) {
+            if (!rec_flow(&r, GW_METRICS_NODE, (unsigned)i, &st->metrics.node[i])) continue;
+            if ((rc = fn(arg, &r)) < 0) return rc;
+        }
+    }
+    if (kind == 0 || kind == GW_METRICS_MSG) {
+        for (int i = 0; i < GW_METRICS_MSG_TYPES; i++) {
+            if (!rec_flow(&r, GW_METRICS_MSG, (unsigned)i, &st->metrics.msg[i])) continue;
+            if ((rc = fn(arg, &r)) < 0) return rc;
+        }
+    }
+    return 0;
+}
+
+static const char* msg_name(unsigned t)
+{
+    switch (t) {
+        case ECU_MSG_HELLO:     return "HELLO";
+        case ECU_MSG_TELEMETRY: return "TELEMETRY";
+        case ECU_MSG_COMMAND:   return "COMMAND";
+        case ECU_MSG_ACK:       return "ACK";
+        case ECU_MSG_TIME_SYNC: return "TIME_SYNC";
+        case ECU_MSG_EVENT:     return "EVENT";
+        case ECU_MSG_CONFIG:    return "CONFIG";
+        case ECU_MSG_HEARTBEAT: return "HEARTBEAT";
+        default:                return "other";
+    }
+}
+
+typedef struct {
+    const gw_state_t* st;
+    FILE*             out;
+} dump_ctx_t;
+
+static int dump_rec(void* arg, const gw_metrics_rec_t* r)
+{
+    dump_ctx_t* d = (dump_ctx_t*)arg;
+    char id[32];
+    const char* kind = "?";
+    switch (r->kind) {
+        case GW_METRICS_UART:
+            kind = "uart";
+            snprintf(id, sizeof(id), "%s", d->st->router.uart_names[r->id] ? d->st->router.uart_names[r->id] : "?");
+            break;
+        case GW_METRICS_LANE: {
+            static const char* const lanes[GW_UART_LANES] = { "urgent", "ctrl", "bulk" };
+            const char* name = d->st->router.uart_names[r->id / GW_UART_LANES];
+            kind = "lane";
+            snprintf(id, sizeof(id), "%s/%s", name ? name : "?", lanes[r->id % GW_UART_LANES]);
+            break;
+        }
+        case GW_METRICS_CLIENT:
+            kind = "client";
+            snprintf(id, sizeof(id), "#%u fd %d", (unsigned)r->id, d->st->net.clients[r->id].fd);
+            break;
+        case GW_METRICS_NODE:
+            kind = "node";
+            snprintf(id, sizeof(id), "%u", (unsigned)r->id);
+            break;
+        case GW_METRICS_MSG:
+            kind = "msg";
+            snprintf(id, sizeof(id), "%s", msg_name(r->id));
+            break;
+        default:
+            snprintf(id, sizeof(id), "%u", (unsigned)r->id);
+            break;
+    }
+    fprintf(d->out, "stats: %-6s %-10s %-9u %-10u %-10u %-10u %-5u %-7u %-5u %-6u %-8u %-9u %-12u %u\n", kind, id,
+            (unsigned)r->frames_in, (unsigned)r->bytes_in, (unsigned)r->frames_out, (unsigned)r->bytes_out,
+            (unsigned)r->crc_errors, (unsigned)r->framing_errors, (unsigned)r->drops, (unsigned)r->hwm,
+            (unsigned)r->rejected, (unsigned)r->conflated, (unsigned)r->throttled_ms,
+            (unsigned)r->paused_ms);
+    return 0;
+}
+
+void gw_metrics_dump(const gw_state_t* st, FILE* out)
+{
+    if (!st || !out) return;
+    dump_ctx_t d = { st, out };
+    fprintf(out, "stats: kind   id         frames_in bytes_in   frames_out bytes_out  crc   framing drops hwm    rejected conflated throttled_ms paused_ms\n");
+    (void)gw_metrics_foreach(st, 0, dump_rec, &d);
+    if (st->acks.mapped || st->acks.unmatched) {
+        fprintf(out, "acks: %u command(s) with gateway seq, %u ACK(s) to sender, %u to all (no entry), "
+                "%u orphaned (sender gone), %u entry(ies) overwritten before ACK, %u forgotten\n",
+                (unsigned)st->acks.mapped, (unsigned)st->acks.routed, (unsigned)st->acks.unmatched,
+                (unsigned)st->acks.orphaned, (unsigned)st->acks.overwritten, (unsigned)st->acks.forgotten);
+    }
+    if (st->sched.queued) {
+        fprintf(out, "sched: %u command(s) queued, %u pending, %u sent (%u late > %u us), %u dropped, "
+                "%u rejected (queue full)\n",
+                (unsigned)st->sched.queued, (unsigned)gw_sched_pending(&st->sched), (unsigned)st->sched.sent,
+                (unsigned)st->sched.late, (unsigned)GW_SCHED_LATE_US, (unsigned)st->sched.dropped,
+                (unsigned)st->sched.rejected);
+    }
+    if (st->trace.slots) {
+        fprintf(out, "trace: %u record(s) written, %u dropped\n", (unsigned)ecu_log_written(&st->trace),
+                (unsigned)ecu_log_drops(&st->trace));
+        if (st->trace.tap_fd >= 0) {
+            fprintf(out, "tap: %d reader(s), %u record(s) lost by slow readers\n", ecu_log_tap_readers(&st->trace),
+                    (unsigned)ecu_log_tap_drops(&st->trace));
+        }
+    }
+    if (st->capture.blk) {
+        const ecu_cap_t* c = &st->capture;
+        fprintf(out, "capture: %s %u record(s), %u block(s), %u file(s)%s%s\n", c->prefix,
+                (unsigned)atomic_load_explicit(&c->records, memory_order_relaxed),
+                (unsigned)atomic_load_explicit(&c->blocks, memory_order_relaxed),
+                (unsigned)atomic_load_explicit(&c->files, memory_order_relaxed), c->err ? ", stopped: " : "",
+                c->err ? strerror(c->err) : "");
+    }
+    fflush(out);
+    gw_latency_dump(out);
+}
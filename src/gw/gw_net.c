@@ -1,10 +1,13 @@
 #include "gw/gw_net.h"
+#include "ecu/ecu_proto.h"
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
 static int set_nonblock(int fd)
 {
@@ -13,15 +16,35 @@ static int set_nonblock(int fd)
     return fcntl(fd, F_SETFL, fl | O_NONBLOCK);
 }
 
+static void client_reset(gw_net_client_t* c)
+{
+    c->fd = -1;
+    c->id = 0;
+    c->rx_len = 0;
+    free(c->rx_spill);
+    c->rx_spill = NULL;
+    c->rx_spill_len = 0;
+    c->tx_off = 0;
+    c->tx_len = 0;
+    c->tx_first_us = 0;
+    c->tx_drops = 0;
+    c->tx_busy = 0;
+    c->tx_total = 0;
+    c->sub = GW_NET_SUB_ALL;
+    memset(c->tm_pos, 0, sizeof(c->tm_pos));
+    c->ep_events = 0;
+    c->rx_paused = 0;
+    c->throttled_since = 0;
+    c->paused_since = 0;
+    memset(c->flow, 0, sizeof(c->flow));
+    memset(&c->stats, 0, sizeof(c->stats));
+    memset(&c->tx_marks, 0, sizeof(c->tx_marks));
+}
+
 int gw_net_listen_fd(const gw_net_t* n) { return n ? n->listen_fd : -1; }
 
-int gw_net_listen(gw_net_t* n, uint16_t port)
+static int listen_socket(uint16_t port)
 {
-    if (!n) return -1;
-    memset(n, 0, sizeof(*n));
-    n->listen_fd = -1;
-    for (int i = 0; i < GW_NET_MAX_CLIENTS; i++) n->clients[i].fd = -1;
-
     int fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) return -1;
 
@@ -34,47 +57,198 @@ int gw_net_listen(gw_net_t* n, uint16_t port)
     a.sin_addr.s_addr = htonl(INADDR_ANY);
     a.sin_port = htons(port);
 
-    if (bind(fd, (struct sockaddr*)&a, sizeof(a)) < 0) { close(fd); return -1; }
-    if (listen(fd, 8) < 0) { close(fd); return -1; }
-    if (set_nonblock(fd) < 0) { close(fd); return -1; }
+    if (bind(fd, (struct sockaddr*)&a, sizeof(a)) < 0 ||
+        listen(fd, 8) < 0 ||
+        set_nonblock(fd) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+int gw_net_listen(gw_net_t* n, uint16_t port, int max_clients, size_t rx_cap, size_t tx_cap)
+{
+    if (!n) return -1;
+    memset(n, 0, sizeof(*n));
+    n->listen_fd = -1;
 
+    if (max_clients <= 0) max_clients = GW_NET_MAX_CLIENTS;
+    if (rx_cap == 0) rx_cap = GW_NET_RX_BUF_DEFAULT;
+    if (tx_cap == 0) tx_cap = GW_NET_TX_BUF_DEFAULT;
+
+    n->clients = (gw_net_client_t*)calloc((size_t)max_clients, sizeof(gw_net_client_t));
+    if (!n->clients) return -1;
+    n->max_clients = max_clients;
+    for (int i = 0; i < max_clients; i++) {
+        gw_net_client_t* c = &n->clients[i];
+        client_reset(c);
+        c->rx_buf = (uint8_t*)malloc(rx_cap);
+        c->tx_buf = (uint8_t*)malloc(tx_cap);
+        if (!c->rx_buf || !c->tx_buf) { gw_net_close(n); errno = ENOMEM; return -1; }
+        c->rx_cap = rx_cap;
+        c->tx_cap = tx_cap;
+    }
+
+    int fd = listen_socket(port);
+    if (fd < 0) {
+        int e = errno;
+        gw_net_close(n);
+        errno = e;
+        return -1;
+    }
+
+    n->listen_fd = fd;
+    return 0;
+}
+
+int gw_net_relisten(gw_net_t* n, uint16_t port)
+{
+    if (!n) return -1;
+    // сначала новый сокет: если порт занят, продолжаем слушать старый
+    int fd = listen_socket(port);
+    if (fd < 0) return -1;
+    if (n->listen_fd >= 0) close(n->listen_fd);
     n->listen_fd = fd;
     return 0;
 }
 
+static int client_resize(gw_net_client_t* c, size_t rx_cap, size_t tx_cap)
+{
+    size_t pending = c->tx_len - c->tx_off;
+    if (c->rx_len > rx_cap || pending > tx_cap) return -1;
+
+    uint8_t* rx = (uint8_t*)malloc(rx_cap);
+    uint8_t* tx = (uint8_t*)malloc(tx_cap);
+    if (!rx || !tx) {
+        free(rx);
+        free(tx);
+        return -1;
+    }
+    memcpy(rx, c->rx_buf, c->rx_len);
+    memcpy(tx, c->tx_buf + c->tx_off, pending);
+
+    free(c->rx_buf);
+    free(c->tx_buf);
+    c->rx_buf = rx;
+    c->rx_cap = rx_cap;
+    c->tx_buf = tx;
+    c->tx_cap = tx_cap;
+    c->tx_off = 0;
+    c->tx_len = pending;
+    return 0;
+}
+
+int gw_net_reconfigure(gw_net_t* n, int max_clients, size_t rx_cap, size_t tx_cap)
+{
+    if (!n) return -1;
+    if (max_clients <= 0) max_clients = GW_NET_MAX_CLIENTS;
+    if (rx_cap == 0) rx_cap = GW_NET_RX_BUF_DEFAULT;
+    if (tx_cap == 0) tx_cap = GW_NET_TX_BUF_DEFAULT;
+
+    int active = 0;
+    for (int i = 0; i < n->max_clients; i++) {
+        if (n->clients[i].fd >= 0) active++;
+    }
+    int keep = active < max_clients ? active : max_clients;
+
+    gw_net_client_t* nc = (gw_net_client_t*)calloc((size_t)max_clients, sizeof(gw_net_client_t));
+    if (!nc) return -1;
+
+    // сначала буферы свободных слотов: при нехватке памяти ничего не меняем
+    for (int i = keep; i < max_clients; i++) {
+        gw_net_client_t* c = &nc[i];
+        client_reset(c);
+        c->rx_buf = (uint8_t*)malloc(rx_cap);
+        c->tx_buf = (uint8_t*)malloc(tx_cap);
+        c->rx_cap = rx_cap;
+        c->tx_cap = tx_cap;
+        if (!c->rx_buf || !c->tx_buf) {
+            for (int j = keep; j <= i; j++) {
+                free(nc[j].rx_buf);
+                free(nc[j].tx_buf);
+            }
+            free(nc);
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    // подключённые клиенты переезжают в начало нового массива вместе с буферами
+    int k = 0;
+    int dropped = 0;
+    for (int i = 0; i < n->max_clients; i++) {
+        gw_net_client_t* c = &n->clients[i];
+        if (c->fd < 0) continue;
+        if (k == keep) {
+            close(c->fd);
+            if (n->on_close) n->on_close(n->on_close_arg, c->id);
+            client_reset(c);
+            dropped++;
+            continue;
+        }
+        nc[k] = *c;
+        c->rx_buf = c->tx_buf = c->rx_spill = NULL;
+        c->rx_spill_len = 0;
+        // если накопленное не помещается в новый размер, клиент остаётся со старыми буферами
+        if (nc[k].rx_cap != rx_cap || nc[k].tx_cap != tx_cap) (void)client_resize(&nc[k], rx_cap, tx_cap);
+        k++;
+    }
+
+    for (int i = 0; i < n->max_clients; i++) {
+        free(n->clients[i].rx_buf);
+        free(n->clients[i].tx_buf);
+    }
+    free(n->clients);
+    n->clients = nc;
+    n->max_clients = max_clients;
+    return dropped;
+}
+
 void gw_net_close(gw_net_t* n)
 {
     if (!n) return;
     if (n->listen_fd >= 0) close(n->listen_fd);
     n->listen_fd = -1;
 
-    for (int i = 0; i < GW_NET_MAX_CLIENTS; i++) {
-        if (n->clients[i].fd >= 0) close(n->clients[i].fd);
-        n->clients[i].fd = -1;
-        n->clients[i].rx_len = 0;
+    for (int i = 0; n->clients && i < n->max_clients; i++) {
+        gw_net_client_t* c = &n->clients[i];
+        if (c->fd >= 0) close(c->fd);
+        client_reset(c);
+        free(c->rx_buf);
+        free(c->tx_buf);
     }
+    free(n->clients);
+    n->clients = NULL;
+    n->max_clients = 0;
 }
 
 gw_net_client_t* gw_net_find_client(gw_net_t* n, int fd)
 {
-    if (!n) return NULL;
-    for (int i = 0; i < GW_NET_MAX_CLIENTS; i++) {
+    if (!n || fd < 0) return NULL;
+    for (int i = 0; i < n->max_clients; i++) {
         if (n->clients[i].fd == fd) return &n->clients[i];
     }
     return NULL;
 }
 
-void gw_net_remove_client(gw_net_t* n, int fd)
+gw_net_client_t* gw_net_find_id(gw_net_t* n, uint32_t id)
 {
-    if (!n) return;
-    for (int i = 0; i < GW_NET_MAX_CLIENTS; i++) {
-        if (n->clients[i].fd == fd) {
-            close(n->clients[i].fd);
-            n->clients[i].fd = -1;
-            n->clients[i].rx_len = 0;
-            return;
-        }
+    if (!n || id == 0) return NULL;
+    for (int i = 0; i < n->max_clients; i++) {
+        if (n->clients[i].fd >= 0 && n->clients[i].id == id) return &n->clients[i];
     }
+    return NULL;
+}
+
+void gw_net_remove_client(gw_net_t* n, int fd)
+{
+    gw_net_client_t* c = gw_net_find_client(n, fd);
+    if (!c) return;
+    close(c->fd);
+    if (n->on_close) n->on_close(n->on_close_arg, c->id);
+    client_reset(c);
 }
 
 int gw_net_accept(gw_net_t* n)
@@ -89,12 +263,17 @@ int gw_net_accept(gw_net_t* n)
             return -1;
         }
         set_nonblock(c);
+        // кадры небольшие, пачки собираем сами (tx_batch_us)
+        int on = 1;
+        setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
 
         int placed = 0;
-        for (int i = 0; i < GW_NET_MAX_CLIENTS; i++) {
+        for (int i = 0; i < n->max_clients; i++) {
             if (n->clients[i].fd < 0) {
+                client_reset(&n->clients[i]);
                 n->clients[i].fd = c;
-                n->clients[i].rx_len = 0;
+                if (++n->last_id == 0) n->last_id = 1;
+                n->clients[i].id = n->last_id;
                 placed = 1;
                 accepted++;
                 break;
@@ -108,62 +287,280 @@ int gw_net_accept(gw_net_t* n)
 int gw_net_client_read(gw_net_client_t* c)
 {
     if (!c || c->fd < 0) return -1;
-    if (c->rx_len >= sizeof(c->rx_buf)) c->rx_len = 0;
+    if (c->rx_len >= c->rx_cap) {
+        c->rx_len = 0;
+        c->stats.rx_len_errors++;
+    }
 
-    ssize_t r = read(c->fd, c->rx_buf + c->rx_len, sizeof(c->rx_buf) - c->rx_len);
+    ssize_t r = read(c->fd, c->rx_buf + c->rx_len, c->rx_cap - c->rx_len);
     if (r < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
         return -1;
     }
     if (r == 0) return -1; // disconnect
     c->rx_len += (size_t)r;
+    c->stats.rx_bytes += (uint32_t)r;
     return (int)r;
 }
 
+int gw_net_client_feed(gw_net_client_t* c, const uint8_t* data, size_t len)
+{
+    if (!c || c->fd < 0 || !data) return -1;
+    c->stats.rx_bytes += (uint32_t)len;
+    if (c->rx_spill_len == 0 && len <= c->rx_cap - c->rx_len) {
+        memcpy(c->rx_buf + c->rx_len, data, len);
+        c->rx_len += len;
+        return (int)len;
+    }
+
+    // rx_buf полон ждущими кадрами (неполный кадр больше rx_buf сбрасывает разбор): остаток — в rx_spill,
+    // его объём ограничен тем, что успело прийти до отмены приёма
+    size_t fit = c->rx_spill_len == 0 ? c->rx_cap - c->rx_len : 0;
+    uint8_t* sp = c->rx_spill_len + (len - fit) <= GW_NET_RX_SPILL_MAX
+                      ? (uint8_t*)realloc(c->rx_spill, c->rx_spill_len + (len - fit)) : NULL;
+    if (!sp) {
+        // как в gw_net_client_read: переполнение — сброс
+        c->rx_len = 0;
+        c->rx_spill_len = 0;
+        c->stats.rx_len_errors++;
+        if (len > c->rx_cap) {
+            data += len - c->rx_cap;
+            len = c->rx_cap;
+        }
+        memcpy(c->rx_buf, data, len);
+        c->rx_len = len;
+        return (int)len;
+    }
+    memcpy(c->rx_buf + c->rx_len, data, fit);
+    c->rx_len += fit;
+    c->rx_spill = sp;
+    memcpy(c->rx_spill + c->rx_spill_len, data + fit, len - fit);
+    c->rx_spill_len += len - fit;
+    return (int)len;
+}
+
 static uint32_t read_u32_le(const uint8_t* p)
 {
     return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
-int gw_net_client_try_get_frame(gw_net_client_t* c, uint8_t* out_frame, size_t out_cap, size_t* out_len)
+int gw_net_client_peek_frame(gw_net_client_t* c, size_t max_len, const uint8_t** frame, size_t* len)
 {
-    if (!c || !out_frame || !out_len) return -1;
-    *out_len = 0;
+    return gw_net_client_peek_frame_at(c, 0, max_len, frame, len);
+}
 
-    if (c->rx_len < 4) return 0;
+void gw_net_client_pop_frame(gw_net_client_t* c)
+{
+    gw_net_client_pop_frame_at(c, 0);
+}
+
+int gw_net_client_peek_frame_at(gw_net_client_t* c, size_t off, size_t max_len, const uint8_t** frame,
+                                size_t* len)
+{
+    if (!c || !frame || !len) return -1;
+    *frame = NULL;
+    *len = 0;
 
-    uint32_t L = read_u32_le(c->rx_buf);
-    if (L == 0 || L > out_cap) {
-        c->rx_len = 0; // протокольная ошибка — сброс
+    if (off > c->rx_len || c->rx_len - off < 4) return 0;
+
+    uint32_t L = read_u32_le(c->rx_buf + off);
+    if (L == 0 || L > max_len || 4u + (size_t)L > c->rx_cap) {
+        c->rx_len = 0; // протокольная ошибка — сброс (и ждущих кадров перед ней: поток разорван)
+        c->stats.rx_len_errors++;
         return -1;
     }
-    if (c->rx_len < 4u + (size_t)L) return 0;
+    if (c->rx_len - off < 4u + (size_t)L) return 0;   // не весь (хвост — за ждущими кадрами)
 
-    memcpy(out_frame, c->rx_buf + 4, L);
-    *out_len = (size_t)L;
+    *frame = c->rx_buf + off + 4;
+    *len = (size_t)L;
+    return 1;
+}
 
-    size_t remain = c->rx_len - (4u + (size_t)L);
-    memmove(c->rx_buf, c->rx_buf + 4u + (size_t)L, remain);
-    c->rx_len = remain;
+void gw_net_client_pop_frame_at(gw_net_client_t* c, size_t off)
+{
+    if (!c || off > c->rx_len || c->rx_len - off < 4) return;
+    size_t n = 4u + (size_t)read_u32_le(c->rx_buf + off);
+    if (n > c->rx_len - off) return;
+    memmove(c->rx_buf + off, c->rx_buf + off + n, c->rx_len - off - n);
+    c->rx_len -= n;
+    c->stats.rx_frames++;
 
-    return 1;
+    // отложенное в rx_spill — на освободившееся место
+    if (c->rx_spill_len > 0) {
+        size_t m = c->rx_cap - c->rx_len;
+        if (m > c->rx_spill_len) m = c->rx_spill_len;
+        memcpy(c->rx_buf + c->rx_len, c->rx_spill, m);
+        c->rx_len += m;
+        memmove(c->rx_spill, c->rx_spill + m, c->rx_spill_len - m);
+        c->rx_spill_len -= m;
+    }
 }
 
-int gw_net_broadcast_frame(gw_net_t* n, const uint8_t* frame, size_t len)
+// GW_NET_SUB_LATEST: ждущий TELEMETRY того же узла больше не нужен. Последний в очереди кадр
+// той же длины заменяется на месте (1); иначе ждущий вырезается из неотправленной части (TCP поток
+// не умеет пропускать байты), а новый встаёт в конец — за кадрами, поставленными после старого (0)
+static int client_conflate(gw_net_client_t* c, const uint8_t* frame, size_t len)
 {
-    if (!n || !frame || len == 0) return -1;
+    const ecu_hdr_t* h = (const ecu_hdr_t*)frame;
+    // позиции считаются от начала соединения: сдвиг и сброс tx_buf их не меняют
+    size_t pending = c->tx_len - c->tx_off - c->tx_busy;
+    uint32_t pos = c->tm_pos[h->src];
+    uint32_t from = c->tx_total - (uint32_t)pending;
+    if (pos - from >= (uint32_t)pending) return 0;  // отправлен или в записи
 
-    uint8_t hdr[4];
-    hdr[0] = (uint8_t)(len & 0xFF);
-    hdr[1] = (uint8_t)((len >> 8) & 0xFF);
-    hdr[2] = (uint8_t)((len >> 16) & 0xFF);
-    hdr[3] = (uint8_t)((len >> 24) & 0xFF);
+    size_t at = c->tx_len - (size_t)(c->tx_total - pos);
+    if (at + 4 > c->tx_len) return 0;
+    uint8_t* p = c->tx_buf + at;
+    size_t n = 4u + (size_t)read_u32_le(p);
+    const ecu_hdr_t* old = (const ecu_hdr_t*)(p + 4);
+    if (n < 4 + sizeof(ecu_hdr_t) || at + n > c->tx_len) return 0;
+    if (old->msg_type != ECU_MSG_TELEMETRY || old->src != h->src) return 0;
 
-    for (int i = 0; i < GW_NET_MAX_CLIENTS; i++) {
-        int fd = n->clients[i].fd;
-        if (fd < 0) continue;
-        (void)write(fd, hdr, 4);
-        (void)write(fd, frame, len);
+    if (at + n == c->tx_len && n == 4 + len) {
+        memcpy(p + 4, frame, len);
+        c->stats.tx_conflated++;
+        return 1;
     }
+
+    // без места под новый кадр старый остаётся (новый не встанет и так)
+    size_t keep = c->tx_len - n - (c->tx_busy == 0 ? c->tx_off : 0);
+    if (keep + 4 + len > c->tx_cap) return 0;
+
+    memmove(p, p + n, c->tx_len - at - n);
+    c->tx_len -= n;
+    // кадры за вырезанным сдвинулись к началу
+    for (int k = 0; k < GW_NET_NODES; k++) {
+        uint32_t rel = c->tm_pos[k] - pos;
+        if (rel > 0 && rel < c->tx_total - pos) c->tm_pos[k] -= (uint32_t)n;
+    }
+    c->tx_total -= (uint32_t)n;
+    gw_lat_fifo_cut(&c->tx_marks, pos, n);
+    c->stats.tx_conflated++;
+    return 0;
+}
+
+static int client_queue(gw_net_client_t* c, const uint8_t* frame, size_t len, uint64_t now_us,
+                        const gw_lat_origin_t* o)
+{
+    size_t need = 4 + len;
+    int latest = c->sub == GW_NET_SUB_LATEST && len >= sizeof(ecu_hdr_t) &&
+                 ((const ecu_hdr_t*)frame)->msg_type == ECU_MSG_TELEMETRY;
+    if (latest && client_conflate(c, frame, len)) return 0;
+
+    // пока идёт асинхронная запись, её данные не двигаем
+    if (c->tx_len + need > c->tx_cap && c->tx_off > 0 && c->tx_busy == 0) {
+        // сдвинуть неотправленный хвост в начало
+        memmove(c->tx_buf, c->tx_buf + c->tx_off, c->tx_len - c->tx_off);
+        c->tx_len -= c->tx_off;
+        c->tx_off = 0;
+    }
+    if (c->tx_len + need > c->tx_cap) {
+        c->tx_drops++;
+        return -1;
+    }
+
+    uint8_t* p = c->tx_buf + c->tx_len;
+    p[0] = (uint8_t)(len & 0xFF);
+    p[1] = (uint8_t)((len >> 8) & 0xFF);
+    p[2] = (uint8_t)((len >> 16) & 0xFF);
+    p[3] = (uint8_t)((len >> 24) & 0xFF);
+    memcpy(p + 4, frame, len);
+    if (c->tx_len == c->tx_off) c->tx_first_us = now_us;
+    if (latest) c->tm_pos[((const ecu_hdr_t*)frame)->src] = c->tx_total;
+    c->tx_len += need;
+    c->tx_total += (uint32_t)need;
+    c->stats.tx_frames++;
+    gw_lat_fifo_queued(&c->tx_marks, need, o, now_us);
+    if (c->tx_len - c->tx_off > c->stats.tx_hwm) c->stats.tx_hwm = (uint32_t)(c->tx_len - c->tx_off);
     return 0;
 }
+
+int gw_net_send_frame(gw_net_t* n, int fd, const uint8_t* frame, size_t len, uint64_t now_us)
+{
+    if (!n || !frame || len == 0) return -1;
+    gw_net_client_t* c = gw_net_find_client(n, fd);
+    if (!c) return -1;
+    return client_queue(c, frame, len, now_us, NULL);
+}
+
+int gw_net_client_send(gw_net_client_t* c, const uint8_t* frame, size_t len, uint64_t now_us,
+                       const gw_lat_origin_t* o)
+{
+    if (!c || c->fd < 0 || !frame || len == 0) return -1;
+    return client_queue(c, frame, len, now_us, o);
+}
+
+int gw_net_broadcast_frame(gw_net_t* n, const uint8_t* frame, size_t len, uint64_t now_us,
+                           const gw_lat_origin_t* o)
+{
+    if (!n || !frame || len == 0) return -1;
+
+    int queued = 0;
+    for (int i = 0; i < n->max_clients; i++) {
+        gw_net_client_t* c = &n->clients[i];
+        if (c->fd < 0) continue;
+        if (client_queue(c, frame, len, now_us, o) == 0) queued++;
+    }
+    return queued;
+}
+
+size_t gw_net_client_tx_pending(const gw_net_client_t* c)
+{
+    return (c && c->fd >= 0) ? c->tx_len - c->tx_off : 0;
+}
+
+int gw_net_client_flush(gw_net_client_t* c)
+{
+    if (!c || c->fd < 0) return -1;
+    size_t pending = c->tx_len - c->tx_off;
+    if (pending == 0) return 0;
+
+    ssize_t w = send(c->fd, c->tx_buf + c->tx_off, pending, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+        return -1;
+    }
+    c->tx_off += (size_t)w;
+    c->stats.tx_bytes += (uint32_t)w;
+    gw_lat_fifo_sent(&c->tx_marks, (size_t)w, gw_clock_now());
+    if (c->tx_off == c->tx_len) {
+        c->tx_off = 0;
+        c->tx_len = 0;
+    }
+    return (int)w;
+}
+
+void gw_net_client_sent(gw_net_client_t* c, size_t n)
+{
+    if (!c) return;
+    c->tx_busy = 0;
+    c->tx_off += n;
+    c->stats.tx_bytes += (uint32_t)n;
+    gw_lat_fifo_sent(&c->tx_marks, n, gw_clock_now());
+    if (c->tx_off >= c->tx_len) {
+        c->tx_off = 0;
+        c->tx_len = 0;
+    }
+}
+
+long gw_net_flush(gw_net_t* n, uint64_t now_us, uint32_t batch_us, int force)
+{
+    if (!n) return -1;
+    long next = -1;
+
+    for (int i = 0; i < n->max_clients; i++) {
+        gw_net_client_t* c = &n->clients[i];
+        if (c->fd < 0 || c->tx_len == c->tx_off) continue;
+
+        uint64_t waited = now_us - c->tx_first_us;
+        if (!force && batch_us > 0 && waited < batch_us) {
+            long left = (long)(batch_us - waited);
+            if (next < 0 || left < next) next = left;
+            continue;
+        }
+        if (gw_net_client_flush(c) < 0) {
+            gw_net_remove_client(n, c->fd);
+        }
+    }
+    return next;
+}
@@ -1,14 +1,164 @@
 #include "gw/gw_router.h"
 #include "ecu/ecu_limits.h"
 
-int gw_router_node_to_uart(uint8_t node_id, gw_uart_index_t* out_uart)
+#include <string.h>
+
+static const char* uart_name(const gw_router_t* r, uint8_t uart)
+{
+    if (uart < r->uart_count && r->uart_names[uart]) return r->uart_names[uart];
+    return "?";
+}
+
+void gw_router_init(gw_router_t* r, uint32_t age_ms, int uart_count, const char* const* uart_names)
+{
+    if (!r) return;
+    memset(r, 0, sizeof(*r));
+    r->age_ms = age_ms ? age_ms : GW_ROUTER_AGE_MS;
+    if (uart_count < 0) uart_count = 0;
+    if (uart_count > GW_UART_MAX) uart_count = GW_UART_MAX;
+    r->uart_count = uart_count;
+    for (int i = 0; i < uart_count; i++) r->uart_names[i] = uart_names ? uart_names[i] : NULL;
+}
+
+static int node_is_routable(uint8_t node_id)
+{
+    return node_id != ECU_NODE_BROADCAST && node_id != ECU_NODE_GW;
+}
+
+int gw_router_set_static(gw_router_t* r, uint8_t node_id, gw_uart_index_t uart)
 {
-    if (!out_uart) return 0;
+    if (!r || !node_is_routable(node_id) || (int)uart < 0 || (int)uart >= r->uart_count) return -1;
+    gw_route_t* e = &r->nodes[node_id];
+    e->flags |= GW_ROUTE_F_STATIC;
+    e->static_uart = (uint8_t)uart;
+    return 0;
+}
+
+void gw_router_migrate(gw_router_t* r, const gw_router_t* old, const int* uart_map)
+{
+    if (!r || !old || !uart_map) return;
+
+    for (int i = 0; i < GW_ROUTER_NODES; i++) {
+        const gw_route_t* o = &old->nodes[i];
+        if ((o->flags & GW_ROUTE_F_LEARNED) == 0 || o->learned_uart >= old->uart_count) continue;
+        int to = uart_map[o->learned_uart];
+        if (to < 0 || to >= r->uart_count) continue;  // UART убран из конфигурации — узел выучится заново
+
+        gw_route_t* e = &r->nodes[i];
+        e->flags |= (uint8_t)(o->flags & (GW_ROUTE_F_LEARNED | GW_ROUTE_F_HELLO));
+        e->learned_uart = (uint8_t)to;
+        e->last_seen_ms = o->last_seen_ms;
+        e->rx_frames = o->rx_frames;
+        e->moves = o->moves;
+    }
+
+    for (int a = 0; a < old->uart_count; a++) {
+        for (int b = 0; b < old->uart_count; b++) {
+            int na = uart_map[a];
+            int nb = uart_map[b];
+            if (na < 0 || nb < 0 || na >= r->uart_count || nb >= r->uart_count) continue;
+            r->fwd[na][nb] = old->fwd[a][b];
+        }
+    }
+}
+
+int gw_router_learn(gw_router_t* r, uint8_t node_id, gw_uart_index_t uart, int is_hello, uint64_t now_ms)
+{
+    if (!r || !node_is_routable(node_id) || (int)uart < 0 || (int)uart >= r->uart_count) return -1;
+
+    gw_route_t* e = &r->nodes[node_id];
+    int ev = GW_ROUTER_LEARN_REFRESH;
+
+    if ((e->flags & GW_ROUTE_F_LEARNED) == 0) {
+        ev = GW_ROUTER_LEARN_NEW;
+        e->rx_frames = 0;
+        e->flags &= (uint8_t)~GW_ROUTE_F_HELLO;
+    } else if (e->learned_uart != (uint8_t)uart) {
+        // узел переподключили к другому UART (или два узла с одинаковым ID)
+        ev = GW_ROUTER_LEARN_MOVED;
+        e->moves++;
+    }
+
+    e->flags |= GW_ROUTE_F_LEARNED;
+    if (is_hello) e->flags |= GW_ROUTE_F_HELLO;
+    e->learned_uart = (uint8_t)uart;
+    e->last_seen_ms = now_ms;
+    e->rx_frames++;
+    return ev;
+}
+
+int gw_router_age(gw_router_t* r, uint64_t now_ms)
+{
+    if (!r) return 0;
+    int expired = 0;
+    for (int i = 0; i < GW_ROUTER_NODES; i++) {
+        gw_route_t* e = &r->nodes[i];
+        if ((e->flags & GW_ROUTE_F_LEARNED) == 0) continue;
+        if (now_ms - e->last_seen_ms < (uint64_t)r->age_ms) continue;
+        e->flags &= (uint8_t)~(GW_ROUTE_F_LEARNED | GW_ROUTE_F_HELLO);
+        expired++;
+    }
+    return expired;
+}
+
+int gw_router_lookup(const gw_router_t* r, uint8_t node_id, gw_uart_index_t* out_uart)
+{
+    if (!r || !out_uart || !node_is_routable(node_id)) return 0;
+
+    const gw_route_t* e = &r->nodes[node_id];
+    if (e->flags & GW_ROUTE_F_LEARNED) {
+        *out_uart = (gw_uart_index_t)e->learned_uart;
+        return 1;
+    }
+    if (e->flags & GW_ROUTE_F_STATIC) {
+        *out_uart = (gw_uart_index_t)e->static_uart;
+        return 1;
+    }
+    return 0;
+}
+
+void gw_router_count_fwd(gw_router_t* r, gw_uart_index_t from, gw_uart_index_t to, size_t len, int ok)
+{
+    if (!r || (int)from < 0 || (int)from >= r->uart_count || (int)to < 0 || (int)to >= r->uart_count) return;
+    gw_fwd_stats_t* st = &r->fwd[from][to];
+    if (ok) {
+        st->frames++;
+        st->bytes += (uint32_t)len;
+    } else {
+        st->drops++;
+    }
+}
+
+void gw_router_dump(const gw_router_t* r, uint64_t now_ms, FILE* out)
+{
+    if (!r || !out) return;
+    fprintf(out, "router: node  uart   flags  age_ms   rx_frames moves\n");
+    for (int i = 0; i < GW_ROUTER_NODES; i++) {
+        const gw_route_t* e = &r->nodes[i];
+        if ((e->flags & (GW_ROUTE_F_STATIC | GW_ROUTE_F_LEARNED)) == 0) continue;
+
+        int learned = (e->flags & GW_ROUTE_F_LEARNED) != 0;
+        uint8_t uart = learned ? e->learned_uart : e->static_uart;
+        char fl[4];
+        fl[0] = (e->flags & GW_ROUTE_F_STATIC) ? 'S' : '-';
+        fl[1] = learned ? 'L' : '-';
+        fl[2] = (e->flags & GW_ROUTE_F_HELLO) ? 'H' : '-';
+        fl[3] = '\0';
+
+        if (learned) {
+            fprintf(out, "router: %4d  %-5s  %-5s  %-8llu %-9u %u\n", i, uart_name(r, uart), fl,
+                    (unsigned long long)(now_ms - e->last_seen_ms), (unsigned)e->rx_frames, (unsigned)e->moves);
+        } else {
+            fprintf(out, "router: %4d  %-5s  %-5s  %-8s %-9s %u\n", i, uart_name(r, uart), fl, "-", "-", (unsigned)e->moves);
+        }
+    }
 
-    switch (node_id) {
-        case ECU_NODE1: *out_uart = GW_UART_1; return 1; // ttyS1
-        case ECU_NODE2: *out_uart = GW_UART_4; return 1; // ttyS4
-        case ECU_NODE3: *out_uart = GW_UART_5; return 1; // ttyS5
-        default: return 0;
+    for (int from = 0; from < r->uart_count; from++) {
+        for (int to = 0; to < r->uart_count; to++) {
+            const gw_fwd_stats_t* st = &r->fwd[from][to];
+            if (st->frames == 0 && st->drops == 0) continue;
+            fprintf(out, "router: fwd %s -> %s frames=%u bytes=%u drops=%u\n", uart_name(r, (uint8_t)from),
+                    uart_name(r, (uint8_t)to), (unsigned)st->frames, (unsigned)st->bytes, (unsigned)st->drops);
+        }
     }
 }
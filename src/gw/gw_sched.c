@@ -0,0 +1,161 @@
+#include "gw/gw_sched.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int gw_sched_deadline(unsigned clock, uint64_t at_ms, uint64_t now_us, uint64_t* at_us)
+{
+    uint64_t base = now_us;
+    if (clock == GW_SCHED_CLOCK_UNIX) {
+        // срок по настенным часам переводится один раз: последующая подводка часов его не сдвигает
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        base = ((uint64_t)ts.tv_sec * 1000000u) + ((uint64_t)ts.tv_nsec / 1000u);
+    } else if (clock != GW_SCHED_CLOCK_MONO) {
+        return -1;
+    }
+
+    if (at_ms > (UINT64_MAX - GW_SCHED_HORIZON_US) / 1000u) return -1;
+    uint64_t at = at_ms * 1000u;
+    if (at > base + GW_SCHED_HORIZON_US) return -1;
+    // прошедший срок — отправить сразу (опоздание попадёт в статистику)
+    *at_us = at <= base ? now_us : now_us + (at - base);
+    return 0;
+}
+
+// a раньше b: по сроку, при равных — по номеру
+static int ent_before(const gw_sched_t* s, uint16_t a, uint16_t b)
+{
+    const gw_sched_ent_t* ea = &s->ent[a];
+    const gw_sched_ent_t* eb = &s->ent[b];
+    if (ea->at_us != eb->at_us) return ea->at_us < eb->at_us;
+    return (int32_t)(ea->id - eb->id) < 0;
+}
+
+// Место k — в кучу, просеять вверх
+static void heap_push(gw_sched_t* s, uint16_t k)
+{
+    int i = s->count++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (!ent_before(s, k, s->heap[p])) break;
+        s->heap[i] = s->heap[p];
+        i = p;
+    }
+    s->heap[i] = k;
+}
+
+// Снять корень кучи (место не освобождается): последний элемент — на место корня и вниз
+static uint16_t heap_take(gw_sched_t* s)
+{
+    uint16_t root = s->heap[0];
+    uint16_t k = s->heap[--s->count];
+    int n = s->count;
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && ent_before(s, s->heap[c + 1], s->heap[c])) c++;
+        if (!ent_before(s, s->heap[c], k)) break;
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    if (n > 0) s->heap[i] = k;
+    return root;
+}
+
+int gw_sched_add(gw_sched_t* s, uint64_t at_us, uint32_t client_id, const uint8_t* frame, size_t len,
+                 uint32_t* id)
+{
+    if (!s || !frame || len > ECU_MAX_FRAME_SIZE) return -1;
+    if (!s->ent) {
+        s->ent = (gw_sched_ent_t*)malloc(GW_SCHED_MAX * sizeof(*s->ent));
+        if (!s->ent) return -1;
+        for (int i = 0; i < GW_SCHED_MAX; i++) s->spare[i] = (uint16_t)(GW_SCHED_MAX - 1 - i);
+        s->spare_n = GW_SCHED_MAX;
+        s->count = 0;
+        s->waiting = 0;
+        for (int u = 0; u < GW_UART_MAX; u++) s->wait[u].head = s->wait[u].tail = GW_SCHED_NONE;
+    }
+    if (s->spare_n == 0) {
+        s->rejected++;
+        return -1;
+    }
+
+    uint16_t k = s->spare[--s->spare_n];
+    gw_sched_ent_t* e = &s->ent[k];
+    e->at_us = at_us;
+    e->id = ++s->last_id;
+    e->client_id = client_id;
+    e->len = (uint16_t)len;
+    memcpy(e->frame, frame, len);
+    e->next = GW_SCHED_NONE;
+    s->queued++;
+    if (id) *id = e->id;
+    heap_push(s, k);
+    return 0;
+}
+
+gw_sched_ent_t* gw_sched_head(gw_sched_t* s)
+{
+    if (!s || s->count == 0) return NULL;
+    return &s->ent[s->heap[0]];
+}
+
+void gw_sched_pop(gw_sched_t* s)
+{
+    if (!s || s->count == 0) return;
+    s->spare[s->spare_n++] = heap_take(s);
+}
+
+void gw_sched_defer(gw_sched_t* s, unsigned uart)
+{
+    if (!s || s->count == 0 || uart >= GW_UART_MAX) return;
+    uint16_t k = heap_take(s);
+    gw_sched_wait_t* w = &s->wait[uart];
+    s->ent[k].next = GW_SCHED_NONE;
+    if (w->head == GW_SCHED_NONE) w->head = k;
+    else s->ent[w->tail].next = k;
+    w->tail = k;
+    s->waiting++;
+}
+
+gw_sched_ent_t* gw_sched_waiting(gw_sched_t* s, unsigned uart)
+{
+    if (!s || !s->ent || uart >= GW_UART_MAX || s->wait[uart].head == GW_SCHED_NONE) return NULL;
+    return &s->ent[s->wait[uart].head];
+}
+
+void gw_sched_unwait(gw_sched_t* s, unsigned uart)
+{
+    if (!gw_sched_waiting(s, uart)) return;
+    gw_sched_wait_t* w = &s->wait[uart];
+    uint16_t k = w->head;
+    w->head = s->ent[k].next;
+    if (w->head == GW_SCHED_NONE) w->tail = GW_SCHED_NONE;
+    s->spare[s->spare_n++] = k;
+    s->waiting--;
+}
+
+void gw_sched_requeue(gw_sched_t* s)
+{
+    if (!s || !s->ent) return;
+    for (int u = 0; u < GW_UART_MAX; u++) {
+        gw_sched_wait_t* w = &s->wait[u];
+        while (w->head != GW_SCHED_NONE) {
+            uint16_t k = w->head;
+            w->head = s->ent[k].next;
+            heap_push(s, k);
+            s->waiting--;
+        }
+        w->tail = GW_SCHED_NONE;
+    }
+}
+
+void gw_sched_free(gw_sched_t* s)
+{
+    if (!s) return;
+    free(s->ent);
+    memset(s, 0, sizeof(*s));
+}
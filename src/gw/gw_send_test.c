@@ -0,0 +1,466 @@
+#include "gw/gw_send_test.h"
+
+#include "gw/gw_clock.h"
+#include "gw/gw_uart.h"
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_log.h"
+#include "ecu/ecu_proto.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+
+#define ST_BACKLOG_US  100000u   // -send_rate: отставание копится не дольше (иначе залп)
+#define ST_DRAIN_US    2000000u  // после -send_time: дождаться ухода очереди и хвоста приёма
+#define ST_LINGER_US   200000u   // ждать кадры в петле после опустевшей очереди
+
+typedef struct {
+    gw_uart_t u;
+    int       open;
+    int       send;              // порт передаёт
+    int       peer;              // куда приходят его кадры (-send_loop), -1 = не проверяются
+    uint64_t  next_us;
+    uint32_t  seq;               // следующий test_seq
+
+    // передача
+    uint64_t  tx_frames;
+    uint64_t  tx_frame_bytes;    // байт кадров до SLIP
+    uint64_t  tx_full;           // очередь полна в срок кадра (-send_rate выше линии)
+
+    // приём: ожидаемый test_seq и принятые кадры по порту-отправителю
+    uint32_t  rx_next[GW_UART_MAX];
+    uint64_t  rx_from[GW_UART_MAX];
+    uint64_t  rx_gaps;           // пропущено по seq (пришёл кадр дальше ожидаемого)
+    uint64_t  rx_dups;           // seq меньше ожидаемого: повтор/перестановка
+    uint64_t  rx_crc;
+    uint64_t  rx_bad_data;       // CRC верен, содержимое нет
+    uint64_t  rx_other;          // не тестовый кадр
+} st_port_t;
+
+static volatile sig_atomic_t g_st_stop;
+
+static void st_on_signal(int sig)
+{
+    (void)sig;
+    g_st_stop = 1;
+}
+
+static int parse_send_ports(const gw_config_t* cfg, const char* spec, uint8_t* out_mask)
+{
+    if (!cfg || !spec || !out_mask) return -1;
+    *out_mask = 0;
+
+    if (strcasecmp(spec, "all") == 0) {
+        *out_mask = (uint8_t)((1u << cfg->uart_count) - 1u);
+        return 0;
+    }
+
+    char tmp[128];
+    size_t n = strlen(spec);
+    if (n == 0 || n >= sizeof(tmp)) return -1;
+    memcpy(tmp, spec, n + 1);
+
+    char* saveptr = NULL;
+    char* tok = strtok_r(tmp, "_", &saveptr);
+    while (tok) {
+        int idx = gw_config_find_uart(cfg, tok);
+        if (idx < 0) return -1;
+        *out_mask = (uint8_t)(*out_mask | (uint8_t)(1u << idx));
+        tok = strtok_r(NULL, "_", &saveptr);
+    }
+
+    return (*out_mask != 0) ? 0 : -1;
+}
+
+// Один HEARTBEAT на каждый порт и выход
+static int send_once(const gw_config_t* cfg, uint8_t mask, int show_packets)
+{
+    gw_uart_t uarts[GW_UART_MAX];
+    memset(uarts, 0, sizeof(uarts));
+
+    uint16_t seq = 1;
+    int sent_count = 0;
+
+    for (int i = 0; i < cfg->uart_count; i++) {
+        if ((mask & (uint8_t)(1u << i)) == 0) continue;
+        const gw_uart_cfg_t* uc = &cfg->uarts[i];
+
+        if (gw_uart_open_ex(&uarts[i], uc->dev_path, uc->baud, uc->rx_buf, uc->tx_queue) < 0) {
+            perror(uc->dev_path);
+            continue;
+        }
+
+        ecu_hdr_t h;
+        memset(&h, 0, sizeof(h));
+        h.magic = ECU_MAGIC;
+        h.version = ECU_VERSION;
+        h.msg_type = ECU_MSG_HEARTBEAT;
+        h.src = ECU_NODE_GW;
+        h.dst = gw_config_uart_node(cfg, i);
+        h.seq = seq++;
+        h.flags = 0;
+        h.payload_len = 0;
+
+        uint8_t frame[ECU_HEADER_SIZE + ECU_CRC_SIZE];
+        (void)ecu_frame_pack(&h, NULL, frame, sizeof(frame));
+
+        if (show_packets) {
+            ecu_log_rec_t r;
+            memset(&r, 0, sizeof(r));
+            r.ts_us = gw_clock_read_us();
+            r.len = r.cap_len = (uint16_t)sizeof(frame);
+            r.kind = ECU_LOG_TEST;
+            r.port = (uint8_t)i;
+            memcpy(r.data, frame, sizeof(frame));
+            ecu_log_print(stderr, &r);
+        }
+
+        if (gw_uart_send_slip(&uarts[i], frame, sizeof(frame)) < 0) {
+            fprintf(stderr, "Failed to enqueue test frame for %s\n", uc->dev_path);
+            gw_uart_close(&uarts[i]);
+            continue;
+        }
+
+        int ok = 1;
+        for (int tries = 0; tries < 100 && gw_uart_tx_pending(&uarts[i]) > 0; tries++) {
+            int wr = gw_uart_handle_write(&uarts[i]);
+            if (wr < 0) {
+                fprintf(stderr, "Write failed for %s\n", uc->dev_path);
+                ok = 0;
+                break;
+            }
+            if (wr == 0) usleep(5000);
+        }
+
+        if (gw_uart_tx_pending(&uarts[i]) > 0) {
+            fprintf(stderr, "Timeout sending test frame on %s\n", uc->dev_path);
+            ok = 0;
+        }
+
+        if (ok) {
+            fprintf(stderr, "Test frame sent on %s\n", uc->dev_path);
+            sent_count++;
+        }
+
+        gw_uart_close(&uarts[i]);
+    }
+
+    return (sent_count > 0) ? 0 : 1;
+}
+
+// -send_loop: self — каждый порт принимает свои кадры (перемычка TX-RX),
+// A:B[,C:D] — порты соединены попарно (кадры A приходят на B и наоборот)
+static int parse_loop(const gw_config_t* cfg, const char* spec, st_port_t* p)
+{
+    if (strcasecmp(spec, "self") == 0) {
+        for (int i = 0; i < cfg->uart_count; i++) {
+            if (p[i].send) p[i].peer = i;
+        }
+        return 0;
+    }
+
+    char tmp[128];
+    size_t n = strlen(spec);
+    if (n == 0 || n >= sizeof(tmp)) return -1;
+    memcpy(tmp, spec, n + 1);
+
+    char* saveptr = NULL;
+    for (char* pair = strtok_r(tmp, ",", &saveptr); pair; pair = strtok_r(NULL, ",", &saveptr)) {
+        char* colon = strchr(pair, ':');
+        if (!colon) return -1;
+        *colon = '\0';
+        int a = gw_config_find_uart(cfg, pair);
+        int b = gw_config_find_uart(cfg, colon + 1);
+        if (a < 0 || b < 0 || a == b) return -1;
+        if (p[a].send) p[a].peer = b;
+        if (p[b].send) p[b].peer = a;
+    }
+    return 0;
+}
+
+static int queue_frame(const gw_config_t* cfg, st_port_t* p, int idx, unsigned size)
+{
+    uint8_t payload[ECU_MAX_PAYLOAD];
+    ecu_event_hdr_t ev = { GW_SEND_TEST_EVENT, (uint16_t)(size - sizeof(ecu_event_hdr_t)) };
+    gw_send_test_data_t d;
+    memset(&d, 0, sizeof(d));
+    d.test_seq = p->seq;
+    d.port = (uint8_t)idx;
+    memcpy(payload, &ev, sizeof(ev));
+    memcpy(payload + sizeof(ev), &d, sizeof(d));
+    for (unsigned i = sizeof(ev) + sizeof(d); i < size; i++) payload[i] = (uint8_t)(p->seq * 31u + i);
+
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_EVENT;
+    h.src = ECU_NODE_GW;
+    h.dst = gw_config_uart_node(cfg, idx);
+    h.seq = (uint16_t)p->seq;
+    h.payload_len = (uint16_t)size;
+
+    uint8_t frame[ECU_MAX_FRAME_SIZE];
+    size_t len = ecu_frame_pack(&h, payload, frame, sizeof(frame));
+    if (len == 0 || gw_uart_send_slip(&p->u, frame, len) < 0) return -1;
+    p->seq++;
+    p->tx_frames++;
+    p->tx_frame_bytes += len;
+    return 0;
+}
+
+// Принятый кадр на порту rx: проверить CRC, содержимое и порядок по отправителю
+static void check_frame(st_port_t* ports, st_port_t* rx, const uint8_t* f, size_t len)
+{
+    const ecu_hdr_t* h;
+    const uint8_t* pl;
+    if (!ecu_frame_validate(f, len, &h, &pl)) {
+        rx->rx_crc++;
+        return;
+    }
+    ecu_event_hdr_t ev;
+    gw_send_test_data_t d;
+    if (h->msg_type != ECU_MSG_EVENT || h->payload_len < GW_SEND_TEST_SIZE_MIN) {
+        rx->rx_other++;
+        return;
+    }
+    memcpy(&ev, pl, sizeof(ev));
+    memcpy(&d, pl + sizeof(ev), sizeof(d));
+    if (ev.event_code != GW_SEND_TEST_EVENT || d.port >= GW_UART_MAX || !ports[d.port].send) {
+        rx->rx_other++;
+        return;
+    }
+    for (unsigned i = sizeof(ev) + sizeof(d); i < h->payload_len; i++) {
+        if (pl[i] != (uint8_t)(d.test_seq * 31u + i)) {
+            rx->rx_bad_data++;
+            return;
+        }
+    }
+    uint32_t want = rx->rx_next[d.port];
+    if (d.test_seq < want) {
+        rx->rx_dups++;
+        return;
+    }
+    rx->rx_gaps += d.test_seq - want;
+    rx->rx_next[d.port] = d.test_seq + 1;
+    rx->rx_from[d.port]++;
+}
+
+static void port_rx(st_port_t* ports, st_port_t* p)
+{
+    while (gw_uart_handle_read(&p->u) > 0) {
+        for (;;) {
+            const uint8_t* f = NULL;
+            size_t flen = 0;
+            int gr = gw_uart_try_get_slip_frame(&p->u, &f, &flen);
+            if (gr == 0) break;
+            if (gr > 0) check_frame(ports, p, f, flen);
+        }
+    }
+}
+
+// Байт, ещё не ушедших из драйвера в линию
+static size_t driver_outq(const gw_uart_t* u)
+{
+    int q = 0;
+    if (ioctl(gw_uart_fd(u), TIOCOUTQ, &q) < 0 || q < 0) return 0;
+    return (size_t)q;
+}
+
+static void progress(const gw_config_t* cfg, st_port_t* ports, double secs, uint64_t* last_tx, uint64_t* last_rx)
+{
+    fprintf(stderr, "send_test: %5.1f s", secs);
+    for (int i = 0; i < cfg->uart_count; i++) {
+        st_port_t* p = &ports[i];
+        if (!p->open) continue;
+        uint64_t tx = gw_counter_get(&p->u.stats.tx_bytes);
+        uint64_t rx = gw_counter_get(&p->u.stats.rx_bytes);
+        fprintf(stderr, "  %s tx %u B/s rx %u B/s", cfg->uarts[i].name, (unsigned)(uint32_t)(tx - last_tx[i]),
+                (unsigned)(uint32_t)(rx - last_rx[i]));
+        last_tx[i] = tx;
+        last_rx[i] = rx;
+    }
+    fputc('\n', stderr);
+}
+
+static int report(const gw_config_t* cfg, st_port_t* ports, double secs, unsigned size)
+{
+    int bad = 0;
+    fprintf(stderr, "send_test: %.3f s, payload %u byte(s)\n", secs, size);
+    for (int i = 0; i < cfg->uart_count; i++) {
+        st_port_t* p = &ports[i];
+        if (!p->open || !p->send) continue;
+        // 8N1: 10 бит на байт
+        double line = (double)gw_counter_get(&p->u.stats.tx_bytes) - (double)driver_outq(&p->u);
+        double cap = (double)p->u.baud_actual / 10.0;
+        double bps = secs > 0 ? line / secs : 0.0;
+        double slip = p->tx_frame_bytes ? 100.0 * (line / (double)p->tx_frame_bytes - 1.0) : 0.0;
+        fprintf(stderr, "  %-8s tx %llu frame(s), %.0f B/s of %.0f (%.1f%%), SLIP overhead %.1f%%, %.0f frame(s)/s",
+                cfg->uarts[i].name, (unsigned long long)p->tx_frames, bps, cap, cap > 0 ? 100.0 * bps / cap : 0.0,
+                slip, secs > 0 ? (double)p->tx_frames / secs : 0.0);
+        if (p->tx_full) fprintf(stderr, ", queue full %llu", (unsigned long long)p->tx_full);
+        if (p->peer < 0) {
+            fputc('\n', stderr);
+            continue;
+        }
+        st_port_t* r = &ports[p->peer];
+        uint64_t got = r->rx_from[i];
+        uint64_t lost = p->tx_frames > got ? p->tx_frames - got : 0;
+        fprintf(stderr, "\n  %-8s -> %s: received %llu, lost %llu\n", "", cfg->uarts[p->peer].name,
+                (unsigned long long)got, (unsigned long long)lost);
+        bad |= lost > 0;
+    }
+    for (int i = 0; i < cfg->uart_count; i++) {
+        st_port_t* r = &ports[i];
+        if (!r->open) continue;
+        uint32_t slip = gw_counter_get(&r->u.stats.rx_slip_errors);
+        uint32_t ovf = gw_counter_get(&r->u.stats.rx_overflows);
+        if (!(r->rx_crc || r->rx_bad_data || r->rx_dups || r->rx_gaps || slip || ovf || r->rx_other)) continue;
+        fprintf(stderr, "  %-8s rx errors: crc %llu, data %llu, slip %u, overflow %u, seq gaps %llu, dups %llu, other %llu\n",
+                cfg->uarts[i].name, (unsigned long long)r->rx_crc, (unsigned long long)r->rx_bad_data, (unsigned)slip,
+                (unsigned)ovf, (unsigned long long)r->rx_gaps, (unsigned long long)r->rx_dups,
+                (unsigned long long)r->rx_other);
+        bad |= r->rx_crc || r->rx_bad_data || r->rx_dups || slip || ovf;
+    }
+    return bad ? 1 : 0;
+}
+
+// Поток кадров на порты в течение time_s с проверкой приёма в петле
+static int send_stream(const gw_config_t* cfg, uint8_t mask, const gw_send_test_opts_t* o)
+{
+    static st_port_t ports[GW_UART_MAX];
+    memset(ports, 0, sizeof(ports));
+    unsigned size = o->size ? o->size : GW_SEND_TEST_SIZE_DEF;
+    if (size < GW_SEND_TEST_SIZE_MIN || size > ECU_MAX_PAYLOAD) {
+        fprintf(stderr, "-send_size: %u..%u\n", GW_SEND_TEST_SIZE_MIN, ECU_MAX_PAYLOAD);
+        return 2;
+    }
+    for (int i = 0; i < cfg->uart_count; i++) {
+        ports[i].send = (mask >> i) & 1u;
+        ports[i].peer = -1;
+    }
+    if (o->loop && parse_loop(cfg, o->loop, ports) < 0) {
+        fprintf(stderr, "Invalid -send_loop: %s (use self or pairs like ttyS4:ttyS5)\n", o->loop);
+        return 2;
+    }
+
+    int rc = 0;
+    for (int i = 0; i < cfg->uart_count && rc == 0; i++) {
+        int need = ports[i].send;
+        for (int k = 0; k < cfg->uart_count; k++) need |= ports[k].send && ports[k].peer == i;
+        if (!need) continue;
+        const gw_uart_cfg_t* uc = &cfg->uarts[i];
+        if (gw_uart_open_ex(&ports[i].u, uc->dev_path, uc->baud, uc->rx_buf, uc->tx_queue) < 0) {
+            perror(uc->dev_path);
+            rc = 1;
+            break;
+        }
+        ports[i].open = 1;
+        fprintf(stderr, "send_test: %s %s@%d%s\n", ports[i].send ? "send" : "receive", uc->name,
+                ports[i].u.baud_actual, ports[i].peer >= 0 ? "" : (ports[i].send ? " (no loopback)" : ""));
+    }
+
+    signal(SIGINT, st_on_signal);
+    signal(SIGTERM, st_on_signal);
+
+    uint64_t t0 = gw_clock_tick();
+    uint64_t end = t0 + (uint64_t)(o->time_s * 1e6);
+    uint64_t period = o->rate > 0 ? (uint64_t)(1e6 / o->rate) : 0;
+    uint64_t drain_end = 0, idle_since = 0, tick = t0 + 1000000u;
+    uint64_t last_tx[GW_UART_MAX] = { 0 }, last_rx[GW_UART_MAX] = { 0 };
+    for (int i = 0; i < cfg->uart_count; i++) ports[i].next_us = t0;
+
+    while (rc == 0) {
+        uint64_t now = gw_clock_tick();
+        if (!drain_end && (now >= end || g_st_stop)) drain_end = now + ST_DRAIN_US;
+        if (now >= tick) {
+            progress(cfg, ports, (double)(now - t0) / 1e6, last_tx, last_rx);
+            tick += 1000000u;
+        }
+
+        int pending = 0;
+        long hold_us = -1;   // ближайший конец ожидания очереди драйвера
+        struct pollfd pfd[GW_UART_MAX];
+        int idx[GW_UART_MAX], np = 0;
+        for (int i = 0; i < cfg->uart_count; i++) {
+            st_port_t* p = &ports[i];
+            if (!p->open) continue;
+            if (p->send && !drain_end) {
+                if (period) {
+                    if (now > p->next_us + ST_BACKLOG_US) p->next_us = now - ST_BACKLOG_US;
+                    while (p->next_us <= now) {
+                        if (queue_frame(cfg, p, i, size) < 0) p->tx_full++;
+                        p->next_us += period;
+                    }
+                } else {
+                    // сколько примет линия: держать очередь наполовину полной
+                    while (gw_uart_tx_pending(&p->u) < p->u.tx_cap / 2 && queue_frame(cfg, p, i, size) == 0) {
+                    }
+                }
+            }
+            if (gw_uart_tx_pending(&p->u) > 0 && gw_uart_handle_write(&p->u) < 0) {
+                fprintf(stderr, "Write failed for %s: %s\n", cfg->uarts[i].dev_path, strerror(errno));
+                rc = 1;
+            }
+            pending |= gw_uart_tx_pending(&p->u) > 0 || driver_outq(&p->u) > 0;
+            pfd[np].fd = gw_uart_fd(&p->u);
+            long h = gw_uart_tx_hold_us(&p->u, gw_clock_read_us());
+            if (h >= 0 && (hold_us < 0 || h < hold_us)) hold_us = h;
+            pfd[np].events = POLLIN | (gw_uart_tx_pending(&p->u) > 0 && h <= 0 ? POLLOUT : 0);
+            idx[np++] = i;
+        }
+        if (drain_end) {
+            // очередь ушла — подождать хвост петли и закончить
+            if (!pending && !idle_since) idle_since = now;
+            if (now >= drain_end || (idle_since && now - idle_since >= ST_LINGER_US)) break;
+        }
+
+        int timeout = 10;
+        if (period && !drain_end) {
+            uint64_t next = end;
+            for (int i = 0; i < cfg->uart_count; i++) {
+                if (ports[i].send && ports[i].next_us < next) next = ports[i].next_us;
+            }
+            timeout = next > now ? (int)((next - now + 999u) / 1000u) : 0;
+            if (timeout > 10) timeout = 10;
+        }
+        if (hold_us >= 0 && (hold_us + 999) / 1000 < timeout) timeout = (int)((hold_us + 999) / 1000);
+        if (poll(pfd, (nfds_t)np, timeout) < 0 && errno != EINTR) rc = 1;
+        for (int k = 0; k < np; k++) {
+            if (pfd[k].revents & (POLLIN | POLLERR | POLLHUP)) port_rx(ports, &ports[idx[k]]);
+        }
+    }
+
+    if (rc == 0) {
+        // время — до ухода последнего байта, без хвоста ожидания петли
+        uint64_t t_end = idle_since ? idle_since : gw_clock_tick();
+        rc = report(cfg, ports, (double)(t_end - t0) / 1e6, size);
+    }
+    for (int i = 0; i < cfg->uart_count; i++) {
+        if (ports[i].open) gw_uart_close(&ports[i].u);
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    return rc;
+}
+
+int gw_send_test_run(const gw_config_t* cfg, const gw_send_test_opts_t* o)
+{
+    if (!cfg || !o) return 2;
+    uint8_t mask = 0;
+    if (parse_send_ports(cfg, o->ports, &mask) < 0) {
+        fprintf(stderr, "Invalid PORT format for -send_test: %s (use all or list like 1_4_5)\n", o->ports ? o->ports : "");
+        return 2;
+    }
+    if (o->time_s <= 0) return send_once(cfg, mask, o->show_packets);
+    return send_stream(cfg, mask, o);
+}
@@ -0,0 +1,96 @@
+#include "gw/gw_spsc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// заголовок слота: [u32 len][u64 tag]
+#define SLOT_HDR (sizeof(uint32_t) + sizeof(uint64_t))
+
+int gw_spsc_init(gw_spsc_t* q, size_t slots, size_t data_cap)
+{
+    if (!q || slots == 0 || data_cap == 0) return -1;
+    memset(q, 0, sizeof(*q));
+
+    size_t n = 1;
+    while (n < slots) n <<= 1;
+
+    size_t slot_size = SLOT_HDR + data_cap;
+    slot_size = (slot_size + GW_CACHE_LINE - 1) & ~(size_t)(GW_CACHE_LINE - 1);
+
+    q->slots = (uint8_t*)aligned_alloc(GW_CACHE_LINE, n * slot_size);
+    if (!q->slots) return -1;
+    q->mask = n - 1;
+    q->slot_size = slot_size;
+    q->data_cap = data_cap;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+void gw_spsc_free(gw_spsc_t* q)
+{
+    if (!q) return;
+    free(q->slots);
+    q->slots = NULL;
+}
+
+int gw_spsc_push(gw_spsc_t* q, const uint8_t* data, size_t len)
+{
+    return gw_spsc_push_tag(q, data, len, 0);
+}
+
+int gw_spsc_push_tag(gw_spsc_t* q, const uint8_t* data, size_t len, uint64_t tag)
+{
+    if (len > q->data_cap) return -1;
+
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head - q->tail_cache > q->mask) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head - q->tail_cache > q->mask) return -1;
+    }
+
+    uint8_t* slot = q->slots + (head & q->mask) * q->slot_size;
+    uint32_t l = (uint32_t)len;
+    memcpy(slot, &l, sizeof(l));
+    memcpy(slot + sizeof(l), &tag, sizeof(tag));
+    if (len) memcpy(slot + SLOT_HDR, data, len);
+
+    // слот заполнен до публикации индекса
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return 0;
+}
+
+const uint8_t* gw_spsc_peek(gw_spsc_t* q, size_t* len)
+{
+    return gw_spsc_peek_tag(q, len, NULL);
+}
+
+const uint8_t* gw_spsc_peek_tag(gw_spsc_t* q, size_t* len, uint64_t* tag)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail == q->head_cache) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail == q->head_cache) return NULL;
+    }
+
+    const uint8_t* slot = q->slots + (tail & q->mask) * q->slot_size;
+    uint32_t l;
+    memcpy(&l, slot, sizeof(l));
+    if (len) *len = l;
+    if (tag) memcpy(tag, slot + sizeof(l), sizeof(*tag));
+    return slot + SLOT_HDR;
+}
+
+void gw_spsc_pop(gw_spsc_t* q)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    // данные слота прочитаны до того, как писатель увидит его свободным
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+size_t gw_spsc_count(const gw_spsc_t* q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,375 @@
+#include "gw/gw_state.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+static int ep_add(int ep, int fd, uint32_t events)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void gw_state_sched_arm(gw_state_t* st, uint64_t at_us)
+{
+    if (!st || st->sched_fd < 0 || at_us == st->sched_armed_us) return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = (time_t)(at_us / 1000000u);
+    its.it_value.tv_nsec = (long)(at_us % 1000000u) * 1000;
+    if (timerfd_settime(st->sched_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0) st->sched_armed_us = at_us;
+}
+
+uint32_t gw_state_uart_events(const gw_uart_t* u)
+{
+    uint32_t ev = EPOLLIN;
+    if (gw_uart_tx_pending(u) > 0 && gw_uart_tx_hold_us(u, gw_clock_now()) <= 0) ev |= EPOLLOUT;
+    return ev;
+}
+
+// Таблица по st->cfg: статические привязки из конфигурации, имена UART указывают в st->cfg
+static void build_router(gw_router_t* r, const gw_config_t* cfg)
+{
+    const char* names[GW_UART_MAX];
+    for (int i = 0; i < cfg->uart_count; i++) names[i] = cfg->uarts[i].name;
+    gw_router_init(r, cfg->route_age_ms, cfg->uart_count, names);
+    for (int node = 0; node < GW_ROUTER_NODES; node++) {
+        if (cfg->node_uart[node] >= 0) (void)gw_router_set_static(r, (uint8_t)node, (gw_uart_index_t)cfg->node_uart[node]);
+    }
+}
+
+// Клиент отключился: ACK на его команды больше некому отдавать — записи снимаются
+static void client_closed(void* arg, uint32_t id)
+{
+    gw_state_t* st = (gw_state_t*)arg;
+    gw_ackmap_drop_client(&st->acks, id);
+}
+
+int gw_state_open(gw_state_t* st)
+{
+    if (!st) return -1;
+    st->uart_count = 0;
+    memset(&st->net, 0, sizeof(st->net));
+    st->net.listen_fd = -1;
+    st->ep = -1;
+    st->sig_fd = -1;
+    st->sched_fd = -1;
+    st->sched_armed_us = 0;
+    if (st->gw_seq == 0) st->gw_seq = 1;
+    st->threaded = st->cfg.threads;
+
+    if (gw_latency_init() < 0) {
+        fprintf(stderr, "latency histograms: out of memory\n");
+        return -1;
+    }
+
+    // 1) UARTs
+    for (int i = 0; i < st->cfg.uart_count; i++) {
+        const gw_uart_cfg_t* uc = &st->cfg.uarts[i];
+        if (gw_uart_open_ex(&st->uarts[i], uc->dev_path, uc->baud, uc->rx_buf, uc->tx_queue) < 0) {
+            fprintf(stderr, "open %s: %s\n", uc->dev_path, strerror(errno));
+            gw_state_close(st);
+            return -1;
+        }
+        st->uarts[i].conflate = uc->conflate;
+        st->uart_count = i + 1;
+    }
+
+    // 2) NET listen
+    if (gw_net_listen(&st->net, st->cfg.tcp_port, st->cfg.max_clients,
+                      st->cfg.client_rx_buf, st->cfg.client_tx_buf) < 0) {
+        perror("gw_net_listen");
+        gw_state_close(st);
+        return -1;
+    }
+    st->net.on_close = client_closed;
+    st->net.on_close_arg = st;
+
+    // 3) epoll: listen fd + uart fds
+    st->ep = epoll_create1(0);
+    if (st->ep < 0) {
+        perror("epoll_create1");
+        gw_state_close(st);
+        return -1;
+    }
+    if (ep_add(st->ep, gw_net_listen_fd(&st->net), EPOLLIN) < 0) {
+        perror("epoll add listen");
+        gw_state_close(st);
+        return -1;
+    }
+    for (int i = 0; !st->threaded && i < st->uart_count; i++) {
+        gw_uart_t* u = &st->uarts[i];
+        if (ep_add(st->ep, gw_uart_fd(u), gw_state_uart_events(u)) < 0) {
+            perror("epoll add uart");
+            gw_state_close(st);
+            return -1;
+        }
+        u->ep_events = gw_state_uart_events(u);
+    }
+
+    // 4) SIGHUP и SIGUSR1 через signalfd — перечитать конфигурацию / дамп статистики в цикле событий
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0 ||
+        (st->sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0 ||
+        ep_add(st->ep, st->sig_fd, EPOLLIN) < 0) {
+        perror("signalfd");
+        gw_state_close(st);
+        return -1;
+    }
+
+    // 5) таймер отложенных команд: срок с точностью до мкс, а не до мс таймаута epoll_wait
+    st->sched_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (st->sched_fd < 0 || ep_add(st->ep, st->sched_fd, EPOLLIN) < 0) {
+        perror("timerfd");
+        gw_state_close(st);
+        return -1;
+    }
+
+    // 6) routing table (static bindings from config + learning)
+    build_router(&st->router, &st->cfg);
+
+    // 7) потоки UART; сетевой поток привязывается к net_cpu после того, как запомнена общая маска
+    if (st->threaded) {
+        (void)sched_getaffinity(0, sizeof(st->cpu_default), &st->cpu_default);
+        if (gw_state_start_workers(st) < 0) {
+            gw_state_close(st);
+            return -1;
+        }
+        if (gw_worker_set_affinity(st->cfg.net_cpu) < 0) {
+            fprintf(stderr, "threads: net_cpu %d: affinity not set\n", st->cfg.net_cpu);
+        }
+    }
+    return 0;
+}
+
+int gw_state_start_workers(gw_state_t* st)
+{
+    if (!st) return -1;
+    for (int i = 0; i < GW_UART_MAX; i++) gw_worker_free(&st->workers[i]);
+
+    for (int i = 0; i < st->uart_count; i++) {
+        gw_worker_t* w = &st->workers[i];
+        if (gw_worker_start(w, &st->uarts[i], i, st->cfg.ring_slots, st->cfg.uarts[i].cpu,
+                            &st->cpu_default, st->preview_raw ? &st->trace : NULL) < 0 ||
+            ep_add(st->ep, w->rx_efd, EPOLLIN) < 0) {
+            fprintf(stderr, "threads: worker %s: %s\n", st->cfg.uarts[i].name, strerror(errno));
+            for (int k = 0; k <= i; k++) gw_worker_free(&st->workers[k]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void gw_state_stop_workers(gw_state_t* st)
+{
+    if (!st) return;
+    for (int i = 0; i < GW_UART_MAX; i++) gw_worker_stop(&st->workers[i]);
+}
+
+void gw_state_close(gw_state_t* st)
+{
+    if (!st) return;
+    for (int i = 0; i < GW_UART_MAX; i++) gw_worker_free(&st->workers[i]);
+    if (st->sig_fd >= 0) close(st->sig_fd);
+    st->sig_fd = -1;
+    if (st->sched_fd >= 0) close(st->sched_fd);
+    st->sched_fd = -1;
+    if (st->ep >= 0) close(st->ep);
+    st->ep = -1;
+    gw_net_close(&st->net);
+    for (int i = 0; i < st->uart_count; i++) gw_uart_close(&st->uarts[i]);
+    st->uart_count = 0;
+    gw_ackmap_free(&st->acks);
+    gw_sched_free(&st->sched);
+    gw_latency_free();
+}
+
+int gw_state_read_signals(gw_state_t* st)
+{
+    if (!st || st->sig_fd < 0) return 0;
+    int sig = 0;
+    struct signalfd_siginfo si;
+    while (read(st->sig_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+        if (si.ssi_signo == SIGHUP) sig |= GW_SIG_HUP;
+        if (si.ssi_signo == SIGUSR1) sig |= GW_SIG_USR1;
+    }
+    return sig;
+}
+
+int gw_state_reload(gw_state_t* st)
+{
+    if (!st || !st->config_path) return -1;
+
+    gw_config_t nc;
+    char err[256];
+    gw_config_defaults(&nc);
+    if (gw_config_load(&nc, st->config_path, err, sizeof(err)) < 0) {
+        fprintf(stderr, "reload: %s (configuration unchanged)\n", err);
+        return -1;
+    }
+
+    // сопоставить UART по имени и устройству: from[новый] = старый, map[старый] = новый
+    int from[GW_UART_MAX];
+    int map[GW_UART_MAX];
+    for (int i = 0; i < GW_UART_MAX; i++) from[i] = map[i] = -1;
+    for (int i = 0; i < nc.uart_count; i++) {
+        for (int j = 0; j < st->uart_count; j++) {
+            if (map[j] >= 0) continue;
+            if (strcmp(nc.uarts[i].name, st->cfg.uarts[j].name) != 0) continue;
+            if (strcmp(nc.uarts[i].dev_path, st->cfg.uarts[j].dev_path) != 0) continue;
+            from[i] = j;
+            map[j] = i;
+            break;
+        }
+    }
+
+    // 1) всё, что может не получиться, — до первого изменения
+    gw_uart_t nu[GW_UART_MAX];
+    memset(nu, 0, sizeof(nu));
+    for (int i = 0; i < GW_UART_MAX; i++) nu[i].fd = -1;
+
+    for (int i = 0; i < nc.uart_count; i++) {
+        if (from[i] >= 0) continue;
+        const gw_uart_cfg_t* uc = &nc.uarts[i];
+        if (gw_uart_open_ex(&nu[i], uc->dev_path, uc->baud, uc->rx_buf, uc->tx_queue) < 0) {
+            fprintf(stderr, "reload: open %s: %s (configuration unchanged)\n", uc->dev_path, strerror(errno));
+            for (int k = 0; k < i; k++) {
+                if (nu[k].fd >= 0) gw_uart_close(&nu[k]);
+            }
+            return -1;
+        }
+    }
+
+    if (nc.tcp_port != st->cfg.tcp_port) {
+        if (gw_net_relisten(&st->net, nc.tcp_port) < 0) {
+            fprintf(stderr, "reload: listen :%u: %s (configuration unchanged)\n", (unsigned)nc.tcp_port, strerror(errno));
+            for (int k = 0; k < nc.uart_count; k++) {
+                if (nu[k].fd >= 0) gw_uart_close(&nu[k]);
+            }
+            return -1;
+        }
+        // старый сокет закрыт и сам ушёл из epoll
+        if (ep_add(st->ep, gw_net_listen_fd(&st->net), EPOLLIN) < 0) perror("reload: epoll add listen");
+        fprintf(stderr, "reload: TCP :%u -> :%u (clients kept)\n", (unsigned)st->cfg.tcp_port, (unsigned)nc.tcp_port);
+    }
+
+    // 2) UART: убранные закрыть, оставшиеся перенастроить на месте
+    for (int j = 0; j < st->uart_count; j++) {
+        if (map[j] >= 0) continue;
+        size_t lost = gw_uart_tx_pending(&st->uarts[j]);
+        fprintf(stderr, "reload: uart %s (%s) closed, %zu TX byte(s) dropped\n",
+                st->cfg.uarts[j].name, st->cfg.uarts[j].dev_path, lost);
+        gw_uart_close(&st->uarts[j]);
+    }
+
+    for (int i = 0; i < nc.uart_count; i++) {
+        const gw_uart_cfg_t* n = &nc.uarts[i];
+        if (from[i] < 0) {
+            nu[i].conflate = n->conflate;
+            fprintf(stderr, "reload: uart %s opened on %s @%d (driver %d)\n", n->name, n->dev_path, n->baud, nu[i].baud_actual);
+            // в режиме threads новый порт получит поток в gw_state_start_workers()
+            if (!st->threaded) {
+                if (ep_add(st->ep, gw_uart_fd(&nu[i]), gw_state_uart_events(&nu[i])) < 0) perror("reload: epoll add uart");
+                else nu[i].ep_events = gw_state_uart_events(&nu[i]);
+            }
+            continue;
+        }
+
+        const gw_uart_cfg_t* o = &st->cfg.uarts[from[i]];
+        gw_uart_move(&nu[i], &st->uarts[from[i]]);
+        nu[i].conflate = n->conflate;
+
+        if (n->baud != o->baud) {
+            if (gw_uart_set_baud(&nu[i], n->baud) < 0) {
+                fprintf(stderr, "reload: uart %s baud %d: %s (kept %d)\n", n->name, n->baud, strerror(errno), o->baud);
+            } else {
+                fprintf(stderr, "reload: uart %s baud %d -> %d (driver %d)\n", n->name, o->baud, n->baud, nu[i].baud_actual);
+            }
+        }
+        if (n->rx_buf != o->rx_buf || n->tx_queue != o->tx_queue) {
+            if (gw_uart_resize(&nu[i], n->rx_buf, n->tx_queue) < 0) {
+                fprintf(stderr, "reload: uart %s queues: %s (kept rx %zu / tx %zu)\n",
+                        n->name, strerror(errno), nu[i].rx_cap, nu[i].tx_cap);
+            } else {
+                fprintf(stderr, "reload: uart %s queues rx %zu / tx %zu\n", n->name, n->rx_buf, n->tx_queue);
+            }
+        }
+    }
+
+    for (int i = 0; i < nc.uart_count; i++) gw_uart_move(&st->uarts[i], &nu[i]);
+    st->uart_count = nc.uart_count;
+
+    // 3) NET лимиты
+    if (nc.max_clients != st->cfg.max_clients ||
+        nc.client_rx_buf != st->cfg.client_rx_buf ||
+        nc.client_tx_buf != st->cfg.client_tx_buf) {
+        int dropped = gw_net_reconfigure(&st->net, nc.max_clients, nc.client_rx_buf, nc.client_tx_buf);
+        if (dropped < 0) {
+            fprintf(stderr, "reload: client limits: %s (kept)\n", strerror(errno));
+            nc.max_clients = st->cfg.max_clients;
+            nc.client_rx_buf = st->cfg.client_rx_buf;
+            nc.client_tx_buf = st->cfg.client_tx_buf;
+        } else if (dropped > 0) {
+            fprintf(stderr, "reload: max_clients %d, %d client(s) disconnected\n", nc.max_clients, dropped);
+        }
+    }
+
+    // индексы UART могли смениться: корзины токенов и дефициты клиентов — с нуля (полные)
+    for (int k = 0; k < st->net.max_clients; k++) {
+        memset(st->net.clients[k].flow, 0, sizeof(st->net.clients[k].flow));
+    }
+
+    if (nc.threads != st->threaded) {
+        fprintf(stderr, "reload: threads = %d takes effect after restart\n", nc.threads);
+    }
+    nc.threads = st->threaded;
+    if (nc.backend != st->cfg.backend) {
+        fprintf(stderr, "reload: backend takes effect after restart\n");
+    }
+    nc.backend = st->cfg.backend;
+    if (strcmp(nc.tap_path, st->cfg.tap_path) != 0) {
+        fprintf(stderr, "reload: tap takes effect after restart\n");
+    }
+    memcpy(nc.tap_path, st->cfg.tap_path, sizeof(nc.tap_path));
+    if (strcmp(nc.cap_prefix, st->cfg.cap_prefix) != 0 || nc.cap_max_mb != st->cfg.cap_max_mb ||
+        nc.cap_max_sec != st->cfg.cap_max_sec || nc.cap_files != st->cfg.cap_files ||
+        nc.cap_block_kb != st->cfg.cap_block_kb) {
+        fprintf(stderr, "reload: [capture] takes effect after restart\n");
+    }
+    memcpy(nc.cap_prefix, st->cfg.cap_prefix, sizeof(nc.cap_prefix));
+    nc.cap_max_mb = st->cfg.cap_max_mb;
+    nc.cap_max_sec = st->cfg.cap_max_sec;
+    nc.cap_files = st->cfg.cap_files;
+    nc.cap_block_kb = st->cfg.cap_block_kb;
+
+    // 4) новая конфигурация; dev_path UART и имена в таблице маршрутов указывают в st->cfg
+    // (то, что не удалось применить, остаётся в cfg со старыми значениями)
+    for (int i = 0; i < nc.uart_count; i++) {
+        nc.uarts[i].baud = st->uarts[i].baud;
+        nc.uarts[i].rx_buf = st->uarts[i].rx_cap;
+        nc.uarts[i].tx_queue = st->uarts[i].tx_cap;
+    }
+    st->cfg = nc;
+    for (int i = 0; i < st->uart_count; i++) st->uarts[i].dev_path = st->cfg.uarts[i].dev_path;
+
+    // 5) таблица маршрутов: построить заново и заменить одним присваиванием между событиями
+    gw_router_t nr;
+    build_router(&nr, &st->cfg);
+    gw_router_migrate(&nr, &st->router, map);
+    st->router = nr;
+
+    fprintf(stderr, "reload: applied %s\n", st->config_path);
+    return 0;
+}
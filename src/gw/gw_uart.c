@@ -1,4 +1,7 @@
 #include "gw/gw_uart.h"
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
 #include "ecu/ecu_slip.h"
 #include <errno.h>
 #include <fcntl.h>
@@ -6,7 +9,39 @@
 #include <termios.h>
 #include <unistd.h>
 #include <stdio.h>
-
+#include <stdlib.h>
+#include <sys/ioctl.h>
+
+// termios2 (Linux): произвольная скорость через BOTHER, если для неё нет константы Bxxx.
+// Своя копия структуры ядра: <asm/termbits.h> конфликтует с <termios.h>.
+// Раскладка совпадает у arm/arm64/x86 (у powerpc/mips/sparc своя — там только Bxxx).
+#if defined(__linux__) && (defined(__arm__) || defined(__aarch64__) || defined(__i386__) || defined(__x86_64__))
+#define GW_UART_HAVE_TERMIOS2 1
+
+typedef struct {
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t     c_line;
+    cc_t     c_cc[19];
+    speed_t  c_ispeed;
+    speed_t  c_ospeed;
+} gw_termios2_t;
+
+#define GW_TCGETS2  _IOR('T', 0x2A, gw_termios2_t)
+#define GW_TCSETS2  _IOW('T', 0x2B, gw_termios2_t)
+#define GW_TCSETSW2 _IOW('T', 0x2C, gw_termios2_t)
+
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT 16
+#endif
+#endif
+
+// Константа Bxxx для стандартной скорости, 0 = нет такой
 static speed_t baud_to_termios(int baud)
 {
     switch (baud) {
@@ -16,11 +51,77 @@ static speed_t baud_to_termios(int baud)
         case 57600: return B57600;
         case 115200: return B115200;
         case 230400: return B230400;
-        default: return B115200;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B500000
+        case 500000: return B500000;
+#endif
+#ifdef B576000
+        case 576000: return B576000;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+#ifdef B1000000
+        case 1000000: return B1000000;
+#endif
+#ifdef B1500000
+        case 1500000: return B1500000;
+#endif
+#ifdef B2000000
+        case 2000000: return B2000000;
+#endif
+        default: return 0;
     }
 }
 
-static int setup_raw_8n1(int fd, int baud)
+// Скорость, которую драйвер записал в termios после настройки (он округляет/ограничивает запрошенную)
+static int uart_actual_baud(int fd, int requested)
+{
+#ifdef GW_UART_HAVE_TERMIOS2
+    gw_termios2_t t2;
+    if (ioctl(fd, GW_TCGETS2, &t2) == 0 && t2.c_ospeed > 0) return (int)t2.c_ospeed;
+#else
+    (void)fd;
+#endif
+    return requested;
+}
+
+// Установить скорость; drain = дождаться передачи уже записанного. Возвращает фактическую скорость или -1
+static int uart_apply_baud(int fd, int baud, int drain)
+{
+    if (baud <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    speed_t sp = baud_to_termios(baud);
+    if (sp != 0) {
+        struct termios tio;
+        if (tcgetattr(fd, &tio) < 0) return -1;
+        cfsetispeed(&tio, sp);
+        cfsetospeed(&tio, sp);
+        if (tcsetattr(fd, drain ? TCSADRAIN : TCSANOW, &tio) < 0) return -1;
+        return uart_actual_baud(fd, baud);
+    }
+
+#ifdef GW_UART_HAVE_TERMIOS2
+    gw_termios2_t t2;
+    if (ioctl(fd, GW_TCGETS2, &t2) < 0) return -1;
+    t2.c_cflag &= ~(tcflag_t)(CBAUD | (CBAUD << IBSHIFT));
+    t2.c_cflag |= (tcflag_t)(BOTHER | (BOTHER << IBSHIFT));
+    t2.c_ispeed = (speed_t)baud;
+    t2.c_ospeed = (speed_t)baud;
+    if (ioctl(fd, drain ? GW_TCSETSW2 : GW_TCSETS2, &t2) < 0) return -1;
+    return uart_actual_baud(fd, baud);
+#else
+    errno = EINVAL;
+    return -1;
+#endif
+}
+
+static int setup_raw_8n1(int fd)
 {
     struct termios tio;
     if (tcgetattr(fd, &tio) < 0) return -1;
@@ -41,43 +142,134 @@ static int setup_raw_8n1(int fd, int baud)
     tio.c_cc[VMIN]  = 0;
     tio.c_cc[VTIME] = 0;
 
-    speed_t sp = baud_to_termios(baud);
-    cfsetispeed(&tio, sp);
-    cfsetospeed(&tio, sp);
-
     if (tcsetattr(fd, TCSANOW, &tio) < 0) return -1;
-    tcflush(fd, TCIOFLUSH);
+    return 0;
+}
+
+// Бюджет очереди драйвера: GW_UART_INFLIGHT_US передачи (10 бит на байт 8N1)
+static size_t tx_inflight(int baud)
+{
+    size_t n = (size_t)((uint64_t)(baud > 0 ? baud : 0) / 10u * GW_UART_INFLIGHT_US / 1000000u);
+    return n < GW_UART_INFLIGHT_MIN ? GW_UART_INFLIGHT_MIN : n;
+}
+
+_Static_assert(GW_UART_LANES == GW_LAT_LANES, "uart lanes must match latency lanes");
+
+// Кадров в полосе: не меньше, чем кадров минимального размера помещается в кольцо
+static size_t tx_frm_cap(size_t tx_cap)
+{
+    return tx_cap / (ECU_HEADER_SIZE + ECU_CRC_SIZE) + 1;
+}
+
+// Кольца и списки кадров полос новой памятью (содержимое не переносится)
+static int tx_alloc(gw_uart_t* u, size_t tx_cap)
+{
+    size_t frm_cap = tx_frm_cap(tx_cap);
+    size_t frm_bytes = frm_cap * sizeof(gw_uart_txf_t);
+    uint8_t* mem = (uint8_t*)malloc(GW_UART_LANES * (frm_bytes + tx_cap));
+    if (!mem) return -1;
+    memset(u->tx_lane, 0, sizeof(u->tx_lane));
+    for (unsigned k = 0; k < GW_UART_LANES; k++) {
+        // списки кадров первыми: выравнивание gw_uart_txf_t
+        u->tx_lane[k].frm = (gw_uart_txf_t*)(mem + k * frm_bytes);
+        u->tx_lane[k].buf = mem + GW_UART_LANES * frm_bytes + k * tx_cap;
+    }
+    u->tx_mem = mem;
+    u->tx_cap = tx_cap;
+    u->tx_frm_cap = frm_cap;
+    u->tx_pending = 0;
+    u->tx_cur = 0;
+    u->tx_out = 0;
     return 0;
 }
 
 int gw_uart_open(gw_uart_t* u, const char* dev_path, int baud)
 {
-    if (!u || !dev_path) return -1;
+    return gw_uart_open_ex(u, dev_path, baud, GW_UART_RX_BUF_DEFAULT, GW_UART_TX_QUEUE_DEFAULT);
+}
+
+int gw_uart_open_ex(gw_uart_t* u, const char* dev_path, int baud, size_t rx_cap, size_t tx_cap)
+{
+    if (!u || !dev_path || rx_cap == 0 || tx_cap < 2) return -1;
     memset(u, 0, sizeof(*u));
     u->fd = -1;
     u->dev_path = dev_path;
     u->baud = baud;
 
-    int fd = open(dev_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd < 0) return -1;
+    u->rx_buf = (uint8_t*)malloc(rx_cap);
+    if (!u->rx_buf || tx_alloc(u, tx_cap) < 0) {
+        free(u->rx_buf);
+        u->rx_buf = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+    u->rx_cap = rx_cap;
 
-    if (setup_raw_8n1(fd, baud) < 0) {
-        close(fd);
+    int fd = open(dev_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    int actual = -1;
+    if (fd >= 0 && setup_raw_8n1(fd) == 0) actual = uart_apply_baud(fd, baud, 0);
+    if (actual < 0) {
+        int e = errno;
+        if (fd >= 0) close(fd);
+        free(u->rx_buf);
+        free(u->tx_mem);
+        u->rx_buf = u->tx_mem = NULL;
+        u->rx_cap = u->tx_cap = 0;
+        errno = e;
         return -1;
     }
 
+    tcflush(fd, TCIOFLUSH);
     u->fd = fd;
+    u->baud_actual = actual;
+    u->tx_inflight = tx_inflight(actual);
     slip_rx_init(&u->slip, u->slip_frame, sizeof(u->slip_frame));
     return 0;
 }
 
+void gw_uart_move(gw_uart_t* dst, gw_uart_t* src)
+{
+    if (!dst || !src || dst == src) return;
+    memcpy(dst, src, sizeof(*dst));
+    // декодер SLIP пишет во встроенный slip_frame — перенаправить на новую копию
+    dst->slip.out = dst->slip_frame;
+
+    src->fd = -1;
+    src->rx_buf = src->tx_mem = NULL;
+    src->rx_cap = src->tx_cap = 0;
+    src->rx_len = 0;
+    memset(src->tx_lane, 0, sizeof(src->tx_lane));
+    src->tx_pending = 0;
+    src->tx_out = 0;
+}
+
 void gw_uart_close(gw_uart_t* u)
 {
     if (!u) return;
     if (u->fd >= 0) close(u->fd);
     u->fd = -1;
     u->rx_len = 0;
-    u->tx_head = u->tx_tail = 0;
+    free(u->rx_buf);
+    free(u->tx_mem);
+    u->rx_buf = u->tx_mem = NULL;
+    u->rx_cap = u->tx_cap = 0;
+    // отметки измеряемых кадров выбрасываются вместе с очередью
+    memset(u->tx_lane, 0, sizeof(u->tx_lane));
+    u->tx_pending = 0;
+    u->tx_out = 0;
+}
+
+int gw_uart_set_baud(gw_uart_t* u, int baud)
+{
+    if (!u || u->fd < 0) return -1;
+    // уже переданное в драйвер уходит на старой скорости, очереди не сбрасываем
+    int actual = uart_apply_baud(u->fd, baud, 1);
+    if (actual < 0) return -1;
+    u->baud = baud;
+    u->baud_actual = actual;
+    u->tx_inflight = tx_inflight(actual);
+    u->tx_drv_trusted = 0;
+    return 0;
 }
 
 int gw_uart_fd(const gw_uart_t* u)
@@ -85,65 +277,386 @@ int gw_uart_fd(const gw_uart_t* u)
     return u ? u->fd : -1;
 }
 
-static size_t ring_used(const gw_uart_t* u)
+static size_t lane_used(const gw_uart_t* u, const gw_uart_lane_t* l)
 {
-    if (u->tx_head >= u->tx_tail) return u->tx_head - u->tx_tail;
-    return sizeof(u->tx_buf) - (u->tx_tail - u->tx_head);
+    if (l->head >= l->tail) return l->head - l->tail;
+    return u->tx_cap - (l->tail - l->head);
 }
 
-static size_t ring_free(const gw_uart_t* u)
+static size_t lane_free(const gw_uart_t* u, const gw_uart_lane_t* l)
 {
     // оставляем 1 байт, чтобы отличать full/empty
-    return (sizeof(u->tx_buf) - 1) - ring_used(u);
+    return (u->tx_cap - 1) - lane_used(u, l);
 }
 
-int gw_uart_queue_tx(gw_uart_t* u, const uint8_t* data, size_t len)
+static size_t lane_frames(const gw_uart_lane_t* l)
+{
+    return l->frm_head - l->frm_tail;
+}
+
+static int resize_rx(gw_uart_t* u, size_t rx_cap)
+{
+    if (rx_cap == u->rx_cap) return 0;
+    uint8_t* rx = (uint8_t*)malloc(rx_cap);
+    if (!rx) return -1;
+    memcpy(rx, u->rx_buf, u->rx_len);
+    free(u->rx_buf);
+    u->rx_buf = rx;
+    u->rx_cap = rx_cap;
+    return 0;
+}
+
+int gw_uart_resize(gw_uart_t* u, size_t rx_cap, size_t tx_cap)
+{
+    if (!u || rx_cap == 0 || tx_cap < 2) return -1;
+    if (rx_cap == u->rx_cap && tx_cap == u->tx_cap) return 0;
+
+    size_t frm_cap = tx_frm_cap(tx_cap);
+    if (u->rx_len > rx_cap) {
+        errno = ENOSPC;
+        return -1;
+    }
+    for (unsigned k = 0; k < GW_UART_LANES; k++) {
+        const gw_uart_lane_t* l = &u->tx_lane[k];
+        if (lane_used(u, l) > tx_cap - 1 || lane_frames(l) > frm_cap) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+
+    gw_uart_t old = *u;
+    if (tx_cap != u->tx_cap && tx_alloc(u, tx_cap) < 0) {
+        *u = old;
+        errno = ENOMEM;
+        return -1;
+    }
+    if (resize_rx(u, rx_cap) < 0) {
+        if (u->tx_mem != old.tx_mem) free(u->tx_mem);
+        *u = old;
+        errno = ENOMEM;
+        return -1;
+    }
+    if (u->tx_mem == old.tx_mem) return 0;
+
+    // содержимое колец полос выкладываем в начало новых
+    for (unsigned k = 0; k < GW_UART_LANES; k++) {
+        const gw_uart_lane_t* o = &old.tx_lane[k];
+        gw_uart_lane_t* l = &u->tx_lane[k];
+        size_t used = lane_used(&old, o);
+        for (size_t i = 0; i < used; i++) l->buf[i] = o->buf[(o->tail + i) % old.tx_cap];
+        l->head = used;
+        size_t nf = lane_frames(o);
+        size_t pos = (tx_cap - o->sent) % tx_cap;   // начало головного кадра (начатого — до tail)
+        for (size_t i = 0; i < nf; i++) {
+            l->frm[i] = o->frm[(o->frm_tail + i) % old.tx_frm_cap];
+            l->frm[i].off = (uint32_t)pos;
+            pos = (pos + l->frm[i].len) % tx_cap;
+        }
+        l->frm_head = nf;
+        l->sent = o->sent;
+        l->dead = o->dead;
+        l->marks = o->marks;
+    }
+    u->tx_pending = old.tx_pending;
+    u->tx_cur = old.tx_cur;
+    u->tx_out = 0;
+    free(old.tx_mem);
+    return 0;
+}
+
+// Скопировать len байт в кольцо полосы с позиции pos (с переходом через конец)
+static void lane_put(const gw_uart_t* u, gw_uart_lane_t* l, size_t pos, const uint8_t* data, size_t len)
+{
+    size_t first = u->tx_cap - pos;
+    if (first > len) first = len;
+    memcpy(&l->buf[pos], data, first);
+    memcpy(l->buf, data + first, len - first);
+}
+
+// key — признаки команды для слияния (NULL — обычный кадр)
+static int queue_lane(gw_uart_t* u, unsigned lane, const uint8_t* data, size_t len, const gw_lat_origin_t* o,
+                      const gw_uart_txf_t* key)
 {
     if (!u || !data || len == 0) return 0;
-    if (len > ring_free(u)) return -1;
+    gw_uart_lane_t* l = &u->tx_lane[lane];
+    if (!u->tx_mem || len > lane_free(u, l) || lane_frames(l) == u->tx_frm_cap) return -1;
+
+    lane_put(u, l, l->head, data, len);
+
+    uint64_t now = gw_clock_now();
+    gw_uart_txf_t* f = &l->frm[l->frm_head % u->tx_frm_cap];
+    f->len = (uint32_t)len;
+    f->t_enq = (uint32_t)now;
+    f->off = (uint32_t)l->head;
+    f->cmd = key ? key->cmd : 0;
+    f->dst = key ? key->dst : 0;
+    f->flags = key ? key->flags : 0;
+    l->head = (l->head + len) % u->tx_cap;
+    l->frm_head++;
+    u->tx_pending += len;
+
+    gw_uart_lane_stats_t* ls = &u->stats.lane[lane];
+    gw_counter_add(&ls->frames, 1);
+    gw_counter_add(&ls->bytes, (uint32_t)len);
+    gw_counter_max(&ls->hwm, (uint32_t)lane_used(u, l));
+    gw_counter_max(&u->stats.tx_hwm, (uint32_t)u->tx_pending);
+    gw_lat_fifo_queued(&l->marks, len, o, now);
+    return (int)len;
+}
 
-    for (size_t i = 0; i < len; i++) {
-        u->tx_buf[u->tx_head] = data[i];
-        u->tx_head = (u->tx_head + 1) % sizeof(u->tx_buf);
+// Команду можно сливать: признаки в key (flags = GW_UART_TXF_CMD), 1 = да
+static int conflate_key(const gw_uart_t* u, const uint8_t* frame, size_t frame_len, gw_uart_txf_t* key)
+{
+    if (u->conflate == GW_UART_CONFLATE_OFF) return 0;
+    if (frame_len < ECU_HEADER_SIZE + sizeof(ecu_command_hdr_t) + ECU_CRC_SIZE) return 0;
+    const ecu_hdr_t* h = (const ecu_hdr_t*)frame;
+    if (h->msg_type != ECU_MSG_COMMAND) return 0;
+    if ((h->flags & ECU_F_ACK_REQUIRED) && u->conflate != GW_UART_CONFLATE_ALL) return 0;
+    const ecu_command_hdr_t* ch = (const ecu_command_hdr_t*)(frame + ECU_HEADER_SIZE);
+    memset(key, 0, sizeof(*key));
+    key->cmd = ch->command_id;
+    key->dst = h->dst;
+    key->flags = GW_UART_TXF_CMD;
+    return 1;
+}
+
+// Последняя ждущая команда полосы с тем же (dst, cmd), которую ещё можно заменить; NULL = нет.
+// Начатый кадр и байты куска, отданного на запись (tx_out), не трогаем
+static gw_uart_txf_t* conflate_find(gw_uart_t* u, unsigned lane, const gw_uart_txf_t* key)
+{
+    gw_uart_lane_t* l = &u->tx_lane[lane];
+    for (size_t i = l->frm_head; i != l->frm_tail; i--) {
+        gw_uart_txf_t* f = &l->frm[(i - 1) % u->tx_frm_cap];
+        if (f->flags != GW_UART_TXF_CMD || f->dst != key->dst || f->cmd != key->cmd) continue;
+        if (i - 1 == l->frm_tail && l->sent > 0) return NULL;
+        if (lane == u->tx_cur && u->tx_out > 0 && (f->off + u->tx_cap - l->tail) % u->tx_cap < u->tx_out) return NULL;
+        return f;
     }
+    return NULL;
+}
+
+// Заменить ждущую команду. Возвращает len, 0 = заменять нечего, -1 = новый кадр не поместился
+static int conflate_lane(gw_uart_t* u, unsigned lane, const uint8_t* data, size_t len, const gw_lat_origin_t* o,
+                         const gw_uart_txf_t* key)
+{
+    gw_uart_txf_t* f = conflate_find(u, lane, key);
+    if (!f) return 0;
+    gw_uart_lane_t* l = &u->tx_lane[lane];
+    if (f->len == len) {
+        // на месте: кадр сохраняет очередь и отметку задержки старого
+        lane_put(u, l, f->off, data, len);
+    } else {
+        if (queue_lane(u, lane, data, len, o, key) < 0) return -1;
+        f->flags = GW_UART_TXF_DEAD;
+        l->dead++;
+    }
+    gw_counter_add(&u->stats.lane[lane].conflated, 1);
     return (int)len;
 }
 
+int gw_uart_queue_tx(gw_uart_t* u, const uint8_t* data, size_t len)
+{
+    return queue_lane(u, GW_UART_LANE_BULK, data, len, NULL, NULL);
+}
+
 size_t gw_uart_tx_pending(const gw_uart_t* u)
 {
-    return u ? ring_used(u) : 0;
+    return u ? u->tx_pending : 0;
 }
 
-int gw_uart_handle_write(gw_uart_t* u)
+unsigned gw_uart_lane_of(const uint8_t* frame, size_t frame_len)
 {
-    if (!u || u->fd < 0) return -1;
-    size_t used = ring_used(u);
-    if (used == 0) return 0;
+    if (!frame || frame_len < sizeof(ecu_hdr_t)) return GW_UART_LANE_BULK;
+    const ecu_hdr_t* h = (const ecu_hdr_t*)frame;
+    if (h->flags & ECU_F_URGENT) return GW_UART_LANE_URGENT;
+    switch (h->msg_type) {
+        case ECU_MSG_ACK:
+        case ECU_MSG_COMMAND:
+        case ECU_MSG_TIME_SYNC:
+        case ECU_MSG_HEARTBEAT:
+            return GW_UART_LANE_CTRL;
+        default:
+            return GW_UART_LANE_BULK;
+    }
+}
 
-    // Пишем непрерывный кусок от tail до конца буфера (или до head)
-    size_t tail = u->tx_tail;
-    size_t head = u->tx_head;
+// Снять с начала полосы выброшенные при слиянии кадры
+static void lane_skip_dead(gw_uart_t* u, gw_uart_lane_t* l)
+{
+    while (l->dead > 0 && l->sent == 0 && lane_frames(l) > 0) {
+        const gw_uart_txf_t* f = &l->frm[l->frm_tail % u->tx_frm_cap];
+        if (f->flags != GW_UART_TXF_DEAD) break;
+        l->tail = (l->tail + f->len) % u->tx_cap;
+        u->tx_pending -= f->len;
+        gw_lat_fifo_skip(&l->marks, f->len);
+        l->frm_tail++;
+        l->dead--;
+    }
+}
 
-    size_t chunk = (head > tail) ? (head - tail) : (sizeof(u->tx_buf) - tail);
+static uint64_t tx_baud(const gw_uart_t* u)
+{
+    return u->baud_actual > 0 ? (uint64_t)u->baud_actual : 9600u;
+}
 
-    ssize_t w = write(u->fd, &u->tx_buf[tail], chunk);
-    if (w < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
-        return -1;
+// Оценка очереди драйвера на now: записанное минус ушедшее в линию (10 бит на байт 8N1)
+static size_t tx_drv_queued(const gw_uart_t* u, uint64_t now)
+{
+    if (now <= u->tx_drv_t) return u->tx_drv_est;
+    uint64_t gone = (now - u->tx_drv_t) * tx_baud(u) / 10000000u;
+    return gone >= u->tx_drv_est ? 0 : u->tx_drv_est - (size_t)gone;
+}
+
+// Очередь драйвера не меньше бюджета: новый кадр младшей полосы ждёт, пока она не уйдёт в линию
+// до бюджета (tx_hold_until). Очередь — по оценке; TIOCOUTQ спрашивается, только когда оценка
+// держит кадр: каждый раз, пока драйвер её не подтвердил (pty, драйвер без TIOCOUTQ — не
+// ограничиваются), затем раз в GW_UART_OUTQ_SYNC_US — линия медленнее baud_actual. 1 = ждать
+static int tx_held(gw_uart_t* u)
+{
+    if (u->tx_inflight == 0) return 0;
+    uint64_t now = gw_clock_read_us();
+    if (u->tx_hold_until) {
+        if (now < u->tx_hold_until) return 1;
+        u->tx_hold_until = 0;
     }
-    u->tx_tail = (u->tx_tail + (size_t)w) % sizeof(u->tx_buf);
-    return (int)w;
+    size_t q = tx_drv_queued(u, now);
+    if (q < u->tx_inflight) return 0;
+    if (!u->tx_drv_trusted || now - u->tx_drv_sync >= GW_UART_OUTQ_SYNC_US) {
+        int outq = 0;
+        if (ioctl(u->fd, TIOCOUTQ, &outq) < 0 || outq < 0) outq = 0;
+        u->tx_drv_sync = now;
+        u->tx_drv_trusted = (size_t)outq >= u->tx_inflight;
+        // драйвер отстаёт от оценки или очереди у него нет — оценка с его числа
+        if (!u->tx_drv_trusted || (size_t)outq > q) {
+            q = (size_t)outq;
+            u->tx_drv_est = q;
+            u->tx_drv_t = now;
+        }
+        if (q < u->tx_inflight) return 0;
+    }
+    u->tx_hold_until = now + ((uint64_t)q - u->tx_inflight + 1) * 10000000u / tx_baud(u);
+    return 1;
+}
+
+long gw_uart_tx_hold_us(const gw_uart_t* u, uint64_t now)
+{
+    if (!u || u->tx_hold_until == 0 || u->tx_pending == 0) return -1;
+    // срочный или начатый кадр пишется и во время ожидания
+    if (u->tx_lane[GW_UART_LANE_URGENT].frm_head != u->tx_lane[GW_UART_LANE_URGENT].frm_tail) return -1;
+    for (unsigned k = 0; k < GW_UART_LANES; k++) {
+        if (u->tx_lane[k].sent > 0) return -1;
+    }
+    return now >= u->tx_hold_until ? 0 : (long)(u->tx_hold_until - now);
+}
+
+size_t gw_uart_tx_chunk(gw_uart_t* u, const uint8_t** data)
+{
+    if (!u) return 0;
+    u->tx_out = 0;
+    if (u->tx_pending == 0) return 0;
+
+    // начатый кадр дописывается первым (он может быть только в одной полосе),
+    // иначе — первая непустая полоса по приоритету
+    unsigned cur = GW_UART_LANES;
+    unsigned best = GW_UART_LANES;
+    for (unsigned k = 0; k < GW_UART_LANES; k++) {
+        gw_uart_lane_t* l = &u->tx_lane[k];
+        lane_skip_dead(u, l);
+        if (lane_frames(l) == 0) continue;
+        if (best == GW_UART_LANES) best = k;
+        if (l->sent > 0) cur = k;
+    }
+    if (cur == GW_UART_LANES) cur = best;
+    if (cur == GW_UART_LANES) return 0;
+
+    const gw_uart_lane_t* l = &u->tx_lane[cur];
+    if (cur != GW_UART_LANE_URGENT && l->sent == 0 && tx_held(u)) return 0;
+    size_t chunk = (l->head > l->tail) ? (l->head - l->tail) : (u->tx_cap - l->tail);
+    if (cur != GW_UART_LANE_URGENT) {
+        // младшая полоса — не больше одного кадра: срочный кадр, поставленный следом, ждёт не всю полосу
+        size_t left = l->frm[l->frm_tail % u->tx_frm_cap].len - l->sent;
+        if (chunk > left) chunk = left;
+    } else if (l->dead > 0) {
+        // кусок кончается перед выброшенным кадром
+        size_t live = 0;
+        for (size_t i = l->frm_tail; i != l->frm_head && live < chunk; i++) {
+            const gw_uart_txf_t* f = &l->frm[i % u->tx_frm_cap];
+            if (f->flags == GW_UART_TXF_DEAD) break;
+            live += f->len - (i == l->frm_tail ? l->sent : 0);
+        }
+        if (chunk > live) chunk = live;
+    }
+    u->tx_cur = cur;
+    u->tx_out = chunk;
+    if (data) *data = &l->buf[l->tail];
+    return chunk;
+}
+
+void gw_uart_tx_advance(gw_uart_t* u, size_t n)
+{
+    if (!u || n == 0 || u->tx_cur >= GW_UART_LANES) return;
+    gw_uart_lane_t* l = &u->tx_lane[u->tx_cur];
+    uint64_t now = gw_clock_now();
+    u->tx_out = 0;
+    l->tail = (l->tail + n) % u->tx_cap;
+    u->tx_pending -= n;
+    gw_counter_add(&u->stats.tx_bytes, (uint32_t)n);
+    // оценка очереди драйвера: время такта, вне цикла событий (такта нет) — часы
+    uint64_t t = now ? now : gw_clock_read_us();
+    u->tx_drv_est = tx_drv_queued(u, t) + n;
+    if (t > u->tx_drv_t) u->tx_drv_t = t;
+    gw_lat_fifo_sent(&l->marks, n, now);
+
+    // границы кадров: ожидание в полосе — от постановки до первого записанного байта
+    while (n > 0 && lane_frames(l) > 0) {
+        const gw_uart_txf_t* f = &l->frm[l->frm_tail % u->tx_frm_cap];
+        if (l->sent == 0) gw_latency_lane_add(u->tx_cur, (uint32_t)now - f->t_enq);
+        size_t take = f->len - l->sent;
+        if (take > n) take = n;
+        l->sent += take;
+        n -= take;
+        if (l->sent == f->len) {
+            l->sent = 0;
+            l->frm_tail++;
+        }
+    }
+}
+
+int gw_uart_handle_write(gw_uart_t* u)
+{
+    if (!u || u->fd < 0) return -1;
+    // срочные кадры — кусок за куском, пока драйвер берёт всё; кадр младшей полосы — один за вызов
+    // (следующий — после того, как цикл событий поставит пришедшие срочные)
+    int total = 0;
+    for (;;) {
+        const uint8_t* p = NULL;
+        size_t chunk = gw_uart_tx_chunk(u, &p);
+        if (chunk == 0) break;
+
+        ssize_t w = write(u->fd, p, chunk);
+        if (w < 0) {
+            u->tx_out = 0;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return total > 0 ? total : -1;
+        }
+        unsigned lane = u->tx_cur;
+        gw_uart_tx_advance(u, (size_t)w);
+        total += (int)w;
+        if ((size_t)w < chunk || lane != GW_UART_LANE_URGENT) break;
+    }
+    return total;
 }
 
 int gw_uart_handle_read(gw_uart_t* u)
 {
     if (!u || u->fd < 0) return -1;
-    if (u->rx_len >= sizeof(u->rx_buf)) {
+    if (u->rx_len >= u->rx_cap) {
         // RX overflow: сбросим буфер (на следующем шаге сделаем нормальную стратегию)
         u->rx_len = 0;
+        gw_counter_add(&u->stats.rx_overflows, 1);
     }
 
-    ssize_t r = read(u->fd, &u->rx_buf[u->rx_len], sizeof(u->rx_buf) - u->rx_len);
+    ssize_t r = read(u->fd, &u->rx_buf[u->rx_len], u->rx_cap - u->rx_len);
     if (r < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
         return -1;
@@ -151,9 +664,28 @@ int gw_uart_handle_read(gw_uart_t* u)
     if (r == 0) return 0;
 
     u->rx_len += (size_t)r;
+    gw_counter_add(&u->stats.rx_bytes, (uint32_t)r);
     return (int)r;
 }
 
+int gw_uart_feed(gw_uart_t* u, const uint8_t* data, size_t len)
+{
+    if (!u || !u->rx_buf || !data) return -1;
+    if (len > u->rx_cap - u->rx_len) {
+        // RX overflow: как в gw_uart_handle_read — сброс накопленного
+        u->rx_len = 0;
+        gw_counter_add(&u->stats.rx_overflows, 1);
+        if (len > u->rx_cap) {
+            data += len - u->rx_cap;
+            len = u->rx_cap;
+        }
+    }
+    memcpy(&u->rx_buf[u->rx_len], data, len);
+    u->rx_len += len;
+    gw_counter_add(&u->stats.rx_bytes, (uint32_t)len);
+    return (int)len;
+}
+
 void gw_uart_rx_consume(gw_uart_t* u, size_t n)
 {
     if (!u || n == 0) return;
@@ -175,41 +707,36 @@ int gw_uart_try_get_slip_frame(gw_uart_t* u, const uint8_t** data, size_t* len)
 
     size_t frame_len = 0;
     int r = slip_rx_push(&u->slip, u->rx_buf, u->rx_len, &frame_len);
+    // снять с накопителя только обработанное: за кадром в том же read() могут идти следующие
+    gw_uart_rx_consume(u, u->slip.consumed);
 
     if (r == 1) {
-        // Важно: slip_rx_push вернул кадр и уже сбросил внутренний out_len,
-        // но сам кадр находится в u->slip_frame[0..frame_len-1].
-        // Теперь нужно "вычесть" из rx_buf то количество входных байт, которые были реально потреблены.
-        // Мы сделали упрощение: отдаём по одному кадру за вызов и потребляем ВСЁ rx_len.
-        // Чтобы было корректно по байтам, сделаем по-простому: после обработки вычищаем rx_len.
-        // (В большинстве случаев нормально, потому что мы обрабатываем часто; но лучше точно.)
-        //
-        // Надёжный вариант: в slip_rx_push добавить счётчик consumed_bytes. Но пока упростим:
-        u->rx_len = 0;
-
+        // кадр в u->slip_frame[0..frame_len-1] (до следующего вызова)
         *data = u->slip_frame;
         *len  = frame_len;
         return 1;
     }
 
+    // r < 0: мусор/overflow — декодер сбросил кадр, продолжим с оставшихся байт
     if (r < 0) {
-        // мусор/overflow — сбросим накопленное
-        u->rx_len = 0;
+        gw_counter_add(&u->stats.rx_slip_errors, 1);
         return -1;
     }
-
-    // кадр не завершён, но мы уже прогнали данные через декодер — rx_buf можно очистить
-    u->rx_len = 0;
     return 0;
 }
 
 int gw_uart_send_slip(gw_uart_t* u, const uint8_t* frame, size_t frame_len)
+{
+    return gw_uart_send_slip_ex(u, frame, frame_len, NULL);
+}
+
+int gw_uart_send_slip_ex(gw_uart_t* u, const uint8_t* frame, size_t frame_len, const gw_lat_origin_t* o)
 {
     if (!u || !frame || frame_len == 0) return -1;
 
     // оценим худший случай: каждый байт станет 2 + BEGIN/END
     size_t worst = 2 + frame_len * 2 + 1;
-    if (worst > 2048 && worst > sizeof(u->tx_buf)) {
+    if (worst > 2048 && worst > u->tx_cap) {
         // слишком большой кадр для нашей очереди
         return -1;
     }
@@ -218,5 +745,12 @@ int gw_uart_send_slip(gw_uart_t* u, const uint8_t* frame, size_t frame_len)
     size_t enc = slip_encode(frame, frame_len, tmp, sizeof(tmp));
     if (enc == 0) return -1;
 
-    return gw_uart_queue_tx(u, tmp, enc);
+    unsigned lane = gw_uart_lane_of(frame, frame_len);
+    gw_uart_txf_t key;
+    if (conflate_key(u, frame, frame_len, &key)) {
+        int r = conflate_lane(u, lane, tmp, enc, o, &key);
+        if (r != 0) return r;
+        return queue_lane(u, lane, tmp, enc, o, &key);
+    }
+    return queue_lane(u, lane, tmp, enc, o, NULL);
 }
@@ -0,0 +1,271 @@
+#include "gw/gw_uring.h"
+
+#ifdef GW_HAVE_IO_URING
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, const void* arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_register(int fd, unsigned op, void* arg, unsigned nr)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+// Кольцо с самыми выгодными флагами, которые знает ядро:
+// SINGLE_ISSUER|DEFER_TASKRUN (6.1) — завершения обрабатываются только внутри нашего io_uring_enter,
+// COOP_TASKRUN (5.19) — без межпроцессорных прерываний, иначе обычное
+static int ring_setup(unsigned entries, struct io_uring_params* p)
+{
+    static const unsigned tries[] = {
+#if defined(IORING_SETUP_SINGLE_ISSUER) && defined(IORING_SETUP_DEFER_TASKRUN)
+        IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+#endif
+        IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN,
+        0
+    };
+    for (size_t i = 0; i < sizeof(tries) / sizeof(tries[0]); i++) {
+        memset(p, 0, sizeof(*p));
+        p->flags = tries[i] | IORING_SETUP_CQSIZE;
+        p->cq_entries = entries * 8;
+        int fd = sys_setup(entries, p);
+        if (fd >= 0) return fd;
+        if (errno != EINVAL) return -1;
+    }
+    return -1;
+}
+
+static int ring_probe(gw_uring_t* r)
+{
+    size_t sz = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* pr = (struct io_uring_probe*)calloc(1, sz);
+    if (!pr) return -1;
+    int rc = sys_register(r->fd, IORING_REGISTER_PROBE, pr, 256);
+    if (rc == 0) {
+        for (unsigned i = 0; i < pr->ops_len && i < 256; i++) {
+            if (pr->ops[i].flags & IO_URING_OP_SUPPORTED) {
+                unsigned op = pr->ops[i].op;
+                if (op / 8 < sizeof(r->ops)) r->ops[op / 8] |= (uint8_t)(1u << (op % 8));
+            }
+        }
+    }
+    free(pr);
+    return rc;
+}
+
+static int ring_bufs(gw_uring_t* r, unsigned count, unsigned size)
+{
+    r->br_map = (size_t)count * sizeof(struct io_uring_buf);
+    void* br = mmap(NULL, r->br_map, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (br == MAP_FAILED) return -1;
+    r->br = (struct io_uring_buf_ring*)br;
+
+    r->bufs = (uint8_t*)malloc((size_t)count * size);
+    if (!r->bufs) {
+        errno = ENOMEM;
+        return -1;
+    }
+    r->buf_count = count;
+    r->buf_size = size;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)r->br;
+    reg.ring_entries = count;
+    reg.bgid = 0;
+    if (sys_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return -1;
+
+    for (unsigned i = 0; i < count; i++) gw_uring_buf_put(r, i);
+    return 0;
+}
+
+int gw_uring_init(gw_uring_t* r, unsigned entries, unsigned buf_count, unsigned buf_size)
+{
+    if (!r || entries == 0 || buf_count == 0 || (buf_count & (buf_count - 1)) != 0 || buf_count > 32768) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+
+    struct io_uring_params p;
+    r->fd = ring_setup(entries, &p);
+    if (r->fd < 0) return -1;
+    r->features = p.features;
+    r->flags = p.flags;
+
+    // таймаут ожидания передаётся прямо в io_uring_enter (5.11); без него цикл не построить
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        gw_uring_free(r);
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    r->sq_map = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_map > r->sq_map) r->sq_map = r->cq_map;
+        r->cq_map = 0;
+    }
+
+    void* sq = mmap(NULL, r->sq_map, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        r->sq_map = 0;
+        gw_uring_free(r);
+        return -1;
+    }
+    r->sq_ptr = (uint8_t*)sq;
+    if (r->cq_map) {
+        void* cq = mmap(NULL, r->cq_map, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            r->cq_map = 0;
+            gw_uring_free(r);
+            return -1;
+        }
+        r->cq_ptr = (uint8_t*)cq;
+    } else {
+        r->cq_ptr = r->sq_ptr;
+    }
+
+    r->sqes_map = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, r->sqes_map, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        r->sqes_map = 0;
+        gw_uring_free(r);
+        return -1;
+    }
+    r->sqes = (struct io_uring_sqe*)sqes;
+
+    r->sq_head = (unsigned*)(r->sq_ptr + p.sq_off.head);
+    r->sq_tail = (unsigned*)(r->sq_ptr + p.sq_off.tail);
+    r->sq_array = (unsigned*)(r->sq_ptr + p.sq_off.array);
+    r->sq_mask = *(unsigned*)(r->sq_ptr + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->sq_local = *r->sq_tail;
+    // запись SQE i всегда в слоте i
+    for (unsigned i = 0; i < p.sq_entries; i++) r->sq_array[i] = i;
+
+    r->cq_head = (unsigned*)(r->cq_ptr + p.cq_off.head);
+    r->cq_tail = (unsigned*)(r->cq_ptr + p.cq_off.tail);
+    r->cq_mask = *(unsigned*)(r->cq_ptr + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(r->cq_ptr + p.cq_off.cqes);
+
+    if (ring_probe(r) < 0 || ring_bufs(r, buf_count, buf_size) < 0) {
+        int e = errno;
+        gw_uring_free(r);
+        errno = e;
+        return -1;
+    }
+    return 0;
+}
+
+void gw_uring_free(gw_uring_t* r)
+{
+    if (!r) return;
+    // закрытие кольца снимает регистрацию пула и отменяет незавершённые запросы
+    if (r->fd >= 0) close(r->fd);
+    r->fd = -1;
+    if (r->sqes_map) munmap(r->sqes, r->sqes_map);
+    if (r->cq_map) munmap(r->cq_ptr, r->cq_map);
+    if (r->sq_map) munmap(r->sq_ptr, r->sq_map);
+    if (r->br_map && r->br) munmap(r->br, r->br_map);
+    free(r->bufs);
+    r->sqes_map = r->cq_map = r->sq_map = r->br_map = 0;
+    r->br = NULL;
+    r->bufs = NULL;
+}
+
+int gw_uring_has_op(const gw_uring_t* r, unsigned op)
+{
+    if (!r || op / 8 >= sizeof(r->ops)) return 0;
+    return (r->ops[op / 8] >> (op % 8)) & 1u;
+}
+
+// Отдать ядру подготовленные SQE (без ожидания)
+static int ring_submit(gw_uring_t* r)
+{
+    unsigned n = r->sq_local - *r->sq_tail;
+    __atomic_store_n(r->sq_tail, r->sq_local, __ATOMIC_RELEASE);
+    if (n == 0) return 0;
+    r->enters++;
+    return sys_enter(r->fd, n, 0, 0, NULL, 0);
+}
+
+struct io_uring_sqe* gw_uring_sqe(gw_uring_t* r)
+{
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local - head >= r->sq_entries) {
+        (void)ring_submit(r);
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (r->sq_local - head >= r->sq_entries) return NULL;
+    }
+    struct io_uring_sqe* sqe = &r->sqes[r->sq_local & r->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_local++;
+    return sqe;
+}
+
+int gw_uring_submit_wait(gw_uring_t* r, long timeout_us)
+{
+    unsigned n = r->sq_local - *r->sq_tail;
+    __atomic_store_n(r->sq_tail, r->sq_local, __ATOMIC_RELEASE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_us >= 0) {
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    // уже есть завершения — только отдать SQE, не ждать
+    unsigned want = (__atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE) != *r->cq_head) ? 0 : 1;
+
+    r->enters++;
+    int rc = sys_enter(r->fd, n, want, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (rc < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) return -1;
+    return 0;
+}
+
+struct io_uring_cqe* gw_uring_cqe(gw_uring_t* r)
+{
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &r->cqes[head & r->cq_mask];
+}
+
+void gw_uring_cqe_seen(gw_uring_t* r)
+{
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+uint8_t* gw_uring_buf(gw_uring_t* r, unsigned bid)
+{
+    return r->bufs + (size_t)bid * r->buf_size;
+}
+
+void gw_uring_buf_put(gw_uring_t* r, unsigned bid)
+{
+    struct io_uring_buf* b = &r->br->bufs[r->br_tail & (r->buf_count - 1)];
+    b->addr = (uint64_t)(uintptr_t)gw_uring_buf(r, bid);
+    b->len = r->buf_size;
+    b->bid = (uint16_t)bid;
+    r->br_tail++;
+    // tail лежит на месте resv первого элемента
+    __atomic_store_n(&r->br->tail, r->br_tail, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,644 @@
+#include "gw/gw_uring.h"
+
+#include "gw/gw_clock.h"
+#include "gw/gw_dispatch.h"
+
+#include <stdio.h>
+
+#ifndef GW_HAVE_IO_URING
+
+int gw_uring_run(gw_state_t* st)
+{
+    (void)st;
+    fprintf(stderr, "io_uring: not supported by this build\n");
+    return GW_URING_UNAVAILABLE;
+}
+
+#else
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define URING_ENTRIES   256
+#define URING_BUFS      64
+#define URING_BUF_SIZE  4096
+
+// user_data: вид запроса | индекс << 8 | поколение << 24
+enum {
+    REQ_SIG = 1,      // poll signalfd
+    REQ_ACCEPT,       // poll listen-сокета
+    REQ_WORKER,       // poll eventfd потока UART (threads)
+    REQ_UART_RX,      // multishot read UART / poll UART
+    REQ_UART_TX,      // write UART
+    REQ_UART_TXWAIT,  // poll POLLOUT: драйвер не принял запись
+    REQ_CLIENT_RX,    // multishot recv клиента / poll клиента
+    REQ_CLIENT_TX,    // send клиенту
+    REQ_CANCEL
+};
+
+typedef struct {
+    int      rx_armed;
+    int      rx_poll;       // чтение по готовности (poll + read), без multishot read
+    uint64_t rx_retry_us;   // после ошибки чтения — не раньше
+    size_t   tx_busy;       // байт в незавершённой записи
+    int      tx_wait;       // ждём POLLOUT
+} uring_uart_t;
+
+typedef struct {
+    int      fd;            // клиент, для которого взведены запросы (-1 = слот не наш)
+    uint32_t gen;
+    int      rx_armed;
+    int      rx_cancel;     // приём отменяется: кадр клиента ждёт (rx_paused)
+    int      tx_busy;
+    int      dying;         // запросы отменяются, после их завершения клиент удаляется
+} uring_client_t;
+
+typedef struct {
+    gw_state_t*     st;
+    gw_uring_t      ring;
+    int             inflight;    // запросов, по которым ещё будут завершения
+    int             quiesce;     // перед перечитыванием конфигурации: ничего не взводить
+    int             uart_mshot;  // IORING_OP_READ_MULTISHOT есть
+    int             client_mshot;// multishot recv есть (иначе poll + read)
+
+    int             sig_armed;
+    int             accept_armed;
+    int             accept_fd;
+    int             worker_armed[GW_UART_MAX];
+    uring_uart_t    uarts[GW_UART_MAX];
+    uring_client_t* clients;
+    int             client_slots;
+    uint32_t        client_gen;
+    uint32_t        gen;         // меняется при перечитывании конфигурации
+} uring_loop_t;
+
+static uint64_t ud_make(unsigned kind, unsigned idx, uint32_t gen)
+{
+    return (uint64_t)kind | ((uint64_t)(idx & 0xFFFFu) << 8) | ((uint64_t)gen << 24);
+}
+
+static unsigned ud_kind(uint64_t ud) { return (unsigned)(ud & 0xFFu); }
+static unsigned ud_idx(uint64_t ud) { return (unsigned)((ud >> 8) & 0xFFFFu); }
+static uint32_t ud_gen(uint64_t ud) { return (uint32_t)(ud >> 24); }
+
+static struct io_uring_sqe* loop_sqe(uring_loop_t* L, unsigned kind, unsigned idx, uint32_t gen)
+{
+    struct io_uring_sqe* sqe = gw_uring_sqe(&L->ring);
+    if (!sqe) return NULL;
+    sqe->user_data = ud_make(kind, idx, gen);
+    L->inflight++;
+    return sqe;
+}
+
+static int arm_poll(uring_loop_t* L, int fd, unsigned events, int multi, unsigned kind, unsigned idx, uint32_t gen)
+{
+    struct io_uring_sqe* sqe = loop_sqe(L, kind, idx, gen);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    if (multi) sqe->len = IORING_POLL_ADD_MULTI;
+    return 0;
+}
+
+static int arm_cancel(uring_loop_t* L, uint64_t target, unsigned flags)
+{
+    struct io_uring_sqe* sqe = loop_sqe(L, REQ_CANCEL, 0, 0);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->cancel_flags = flags;
+    return 0;
+}
+
+// ---- UART ----
+
+static void arm_uart_rx(uring_loop_t* L, int i, uint64_t now)
+{
+    uring_uart_t* uu = &L->uarts[i];
+    if (uu->rx_armed || now < uu->rx_retry_us) return;
+    int fd = gw_uart_fd(&L->st->uarts[i]);
+
+    if (!uu->rx_poll) {
+        struct io_uring_sqe* sqe = loop_sqe(L, REQ_UART_RX, (unsigned)i, L->gen);
+        if (!sqe) return;
+        sqe->opcode = GW_IORING_OP_READ_MULTISHOT;
+        sqe->fd = fd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        uu->rx_armed = 1;
+        return;
+    }
+    if (arm_poll(L, fd, POLLIN, 1, REQ_UART_RX, (unsigned)i, L->gen) == 0) uu->rx_armed = 1;
+}
+
+static void uart_read_error(uring_loop_t* L, int i, int err, uint64_t now)
+{
+    fprintf(stderr, "UART read error on %s: %s\n", L->st->uarts[i].dev_path, strerror(err));
+    // не крутиться на постоянной ошибке (порт пропал) — следующая попытка через такт
+    L->uarts[i].rx_retry_us = now + (uint64_t)L->st->cfg.tick_ms * 1000u;
+}
+
+static void uart_data(uring_loop_t* L, int i, const uint8_t* data, size_t len, uint64_t now)
+{
+    gw_state_t* st = L->st;
+    gw_uart_t* u = &st->uarts[i];
+    if (st->preview_raw) gw_dispatch_trace(st, ECU_LOG_RAW_UART, (unsigned)i, data, len);
+    gw_uart_feed(u, data, len);
+    gw_dispatch_uart_rx(st, i, now);
+}
+
+static void on_uart_rx(uring_loop_t* L, int i, const struct io_uring_cqe* cqe, uint64_t now)
+{
+    uring_uart_t* uu = &L->uarts[i];
+    gw_state_t* st = L->st;
+    if (!(cqe->flags & IORING_CQE_F_MORE)) uu->rx_armed = 0;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe->res > 0) uart_data(L, i, gw_uring_buf(&L->ring, bid), (size_t)cqe->res, now);
+        gw_uring_buf_put(&L->ring, bid);
+        return;
+    }
+
+    if (uu->rx_poll) {
+        if (cqe->res < 0) {
+            if (cqe->res != -ECANCELED) uart_read_error(L, i, -cqe->res, now);
+            return;
+        }
+        // poll: вычитать всё, что есть; неполное чтение — tty пуст, новое пробуждение придёт само
+        gw_uart_t* u = &st->uarts[i];
+        for (;;) {
+            size_t space = (u->rx_len < u->rx_cap) ? u->rx_cap - u->rx_len : u->rx_cap;
+            int rr = gw_uart_handle_read(u);
+            if (rr < 0) {
+                uart_read_error(L, i, errno, now);
+                break;
+            }
+            if (rr == 0) break;
+            if (st->preview_raw && (size_t)rr <= u->rx_len) {
+                gw_dispatch_trace(st, ECU_LOG_RAW_UART, (unsigned)i, &u->rx_buf[u->rx_len - (size_t)rr], (size_t)rr);
+            }
+            gw_dispatch_uart_rx(st, i, now);
+            if ((size_t)rr < space) break;
+        }
+        return;
+    }
+
+    if (cqe->res == 0 || cqe->res == -EINVAL || cqe->res == -EBADFD || cqe->res == -EOPNOTSUPP) {
+        // драйвер не умеет multishot read (tty отвечает 0 без данных) — дальше по готовности, на всех UART
+        if (L->uart_mshot) fprintf(stderr, "io_uring: %s: multishot read not supported, using poll\n", st->uarts[i].dev_path);
+        L->uart_mshot = 0;
+        for (int k = 0; k < GW_UART_MAX; k++) L->uarts[k].rx_poll = 1;
+        return;
+    }
+    // -ENOBUFS: пул исчерпан, перевзвести после возврата буферов
+    if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED && cqe->res != -EAGAIN) {
+        uart_read_error(L, i, -cqe->res, now);
+    }
+}
+
+static void arm_uart_tx(uring_loop_t* L, int i)
+{
+    uring_uart_t* uu = &L->uarts[i];
+    gw_uart_t* u = &L->st->uarts[i];
+    if (uu->tx_busy || uu->tx_wait) return;
+
+    const uint8_t* p = NULL;
+    size_t chunk = gw_uart_tx_chunk(u, &p);
+    if (chunk == 0) return;
+
+    struct io_uring_sqe* sqe = loop_sqe(L, REQ_UART_TX, (unsigned)i, L->gen);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = gw_uart_fd(u);
+    sqe->addr = (uint64_t)(uintptr_t)p;
+    sqe->len = (unsigned)chunk;
+    uu->tx_busy = chunk;
+}
+
+static void on_uart_tx(uring_loop_t* L, int i, const struct io_uring_cqe* cqe)
+{
+    uring_uart_t* uu = &L->uarts[i];
+    gw_uart_t* u = &L->st->uarts[i];
+    uu->tx_busy = 0;
+    if (cqe->res > 0) {
+        gw_uart_tx_advance(u, (size_t)cqe->res);
+        return;
+    }
+    if (cqe->res == -EAGAIN || cqe->res == 0) {
+        // драйвер занят (fd неблокирующий): дождаться POLLOUT
+        if (!L->quiesce && arm_poll(L, gw_uart_fd(u), POLLOUT, 0, REQ_UART_TXWAIT, (unsigned)i, L->gen) == 0) uu->tx_wait = 1;
+        return;
+    }
+    if (cqe->res != -ECANCELED) fprintf(stderr, "UART write error on %s: %s\n", u->dev_path, strerror(-cqe->res));
+}
+
+// ---- клиенты ----
+
+static void client_kill(uring_loop_t* L, int k)
+{
+    uring_client_t* cs = &L->clients[k];
+    if (cs->dying) return;
+    cs->dying = 1;
+    // multishot recv/poll сам не завершится, пока сокет открыт
+    if (cs->rx_armed) (void)arm_cancel(L, ud_make(REQ_CLIENT_RX, (unsigned)k, cs->gen), 0);
+}
+
+// Клиент, по которому больше не будет завершений, — закрыть
+static void client_reap(uring_loop_t* L, int k)
+{
+    uring_client_t* cs = &L->clients[k];
+    if (!cs->dying || cs->rx_armed || cs->tx_busy) return;
+    gw_net_remove_client(&L->st->net, cs->fd);
+    cs->fd = -1;
+    cs->dying = 0;
+}
+
+static void arm_client_rx(uring_loop_t* L, int k)
+{
+    uring_client_t* cs = &L->clients[k];
+    if (cs->rx_armed || cs->dying || L->st->net.clients[k].rx_paused) return;
+
+    if (L->client_mshot) {
+#ifdef IORING_RECV_MULTISHOT
+        struct io_uring_sqe* sqe = loop_sqe(L, REQ_CLIENT_RX, (unsigned)k, cs->gen);
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = cs->fd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        cs->rx_armed = 1;
+        return;
+#else
+        L->client_mshot = 0;
+#endif
+    }
+    if (arm_poll(L, cs->fd, POLLIN, 1, REQ_CLIENT_RX, (unsigned)k, cs->gen) == 0) cs->rx_armed = 1;
+}
+
+static void on_client_rx(uring_loop_t* L, int k, const struct io_uring_cqe* cqe, uint64_t now)
+{
+    uring_client_t* cs = &L->clients[k];
+    gw_state_t* st = L->st;
+    gw_net_client_t* c = &st->net.clients[k];
+    if (!(cqe->flags & IORING_CQE_F_MORE)) cs->rx_armed = cs->rx_cancel = 0;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe->res > 0 && !cs->dying) {
+            const uint8_t* data = gw_uring_buf(&L->ring, bid);
+            if (st->preview_raw) gw_dispatch_trace(st, ECU_LOG_RAW_NET, (unsigned)k, data, (size_t)cqe->res);
+            // кадры уходят в UART в конце такта (gw_dispatch_clients); что не поместилось — в rx_spill
+            gw_net_client_feed(c, data, (size_t)cqe->res);
+        }
+        gw_uring_buf_put(&L->ring, bid);
+        return;
+    }
+
+    if (!L->client_mshot) {
+        if (cqe->res < 0) {
+            if (cqe->res != -ECANCELED) client_kill(L, k);
+            return;
+        }
+        // read() при полном rx_buf сбрасывает его: кадры разбираются после каждого чтения
+        for (;;) {
+            if (cs->dying || c->rx_paused) break;
+            int rr = gw_net_client_read(c);
+            if (rr < 0) {
+                client_kill(L, k);
+                break;
+            }
+            if (rr == 0) break;
+            if (st->preview_raw && (size_t)rr <= c->rx_len) {
+                gw_dispatch_trace(st, ECU_LOG_RAW_NET, (unsigned)k, &c->rx_buf[c->rx_len - (size_t)rr], (size_t)rr);
+            }
+            (void)gw_dispatch_clients(st, now);
+        }
+        return;
+    }
+
+    if (cqe->res == -ENOBUFS || cqe->res == -ECANCELED) return;
+    if (cqe->res == -EINVAL && !(cqe->flags & IORING_CQE_F_MORE)) {
+        // ядро без multishot recv (< 6.0): дальше по готовности
+        fprintf(stderr, "io_uring: multishot recv not supported, using poll\n");
+        L->client_mshot = 0;
+        return;
+    }
+    client_kill(L, k); // 0 = соединение закрыто, <0 = ошибка
+}
+
+static void arm_client_tx(uring_loop_t* L, int k)
+{
+    uring_client_t* cs = &L->clients[k];
+    gw_net_client_t* c = &L->st->net.clients[k];
+    if (cs->tx_busy || cs->dying) return;
+
+    size_t pending = gw_net_client_tx_pending(c);
+    struct io_uring_sqe* sqe = loop_sqe(L, REQ_CLIENT_TX, (unsigned)k, cs->gen);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(c->tx_buf + c->tx_off);
+    sqe->len = (unsigned)pending;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    c->tx_busy = pending;
+    cs->tx_busy = 1;
+}
+
+static void on_client_tx(uring_loop_t* L, int k, const struct io_uring_cqe* cqe)
+{
+    uring_client_t* cs = &L->clients[k];
+    gw_net_client_t* c = &L->st->net.clients[k];
+    cs->tx_busy = 0;
+    gw_net_client_sent(c, cqe->res > 0 ? (size_t)cqe->res : 0);
+    if (cqe->res < 0 && cqe->res != -EAGAIN && cqe->res != -EINTR && cqe->res != -ECANCELED) client_kill(L, k);
+}
+
+// Кадры клиентов — в очереди UART. Клиентам, чей кадр ждёт токенов или места, приём отменяется
+// (взводится снова в loop_arm, когда кадр пройдёт). Микросекунд до появления токенов, -1 = никто не ждёт
+static long clients_dispatch(uring_loop_t* L, uint64_t now)
+{
+    long next = gw_dispatch_clients(L->st, now);
+    for (int k = 0; k < L->client_slots; k++) {
+        uring_client_t* cs = &L->clients[k];
+        if (cs->fd < 0 || cs->dying || !cs->rx_armed || cs->rx_cancel) continue;
+        if (!L->st->net.clients[k].rx_paused) continue;
+        if (arm_cancel(L, ud_make(REQ_CLIENT_RX, (unsigned)k, cs->gen), 0) == 0) cs->rx_cancel = 1;
+    }
+    return next;
+}
+
+// Клиентам, у которых подошёл срок пачки, — send. Микросекунд до следующего срока, -1 = нет
+static long clients_flush(uring_loop_t* L, uint64_t now)
+{
+    uint32_t batch_us = L->st->cfg.tx_batch_us;
+    long next = -1;
+    for (int k = 0; k < L->client_slots; k++) {
+        uring_client_t* cs = &L->clients[k];
+        gw_net_client_t* c = &L->st->net.clients[k];
+        if (cs->fd < 0 || cs->dying || cs->tx_busy) continue;
+        if (c->tx_len - c->tx_off == 0) continue;
+
+        uint64_t waited = now - c->tx_first_us;
+        if (batch_us > 0 && waited < batch_us) {
+            long left = (long)(batch_us - waited);
+            if (next < 0 || left < next) next = left;
+            continue;
+        }
+        arm_client_tx(L, k);
+    }
+    return next;
+}
+
+// ---- состояние цикла ----
+
+static int loop_clients_init(uring_loop_t* L)
+{
+    free(L->clients);
+    L->client_slots = L->st->net.max_clients;
+    L->clients = (uring_client_t*)calloc((size_t)L->client_slots, sizeof(uring_client_t));
+    if (!L->clients) return -1;
+    for (int k = 0; k < L->client_slots; k++) L->clients[k].fd = -1;
+    return 0;
+}
+
+// Взвести всё, что не взведено: вызывается перед каждым ожиданием
+static void loop_arm(uring_loop_t* L, uint64_t now)
+{
+    gw_state_t* st = L->st;
+    if (L->quiesce) return;
+
+    if (!L->sig_armed && arm_poll(L, st->sig_fd, POLLIN, 1, REQ_SIG, 0, L->gen) == 0) L->sig_armed = 1;
+
+    int lfd = gw_net_listen_fd(&st->net);
+    if ((!L->accept_armed || L->accept_fd != lfd) && lfd >= 0) {
+        if (arm_poll(L, lfd, POLLIN, 1, REQ_ACCEPT, 0, L->gen) == 0) {
+            L->accept_armed = 1;
+            L->accept_fd = lfd;
+        }
+    }
+
+    for (int i = 0; i < st->uart_count; i++) {
+        if (st->threaded) {
+            gw_worker_t* w = &st->workers[i];
+            if (w->uart && !L->worker_armed[i] &&
+                arm_poll(L, w->rx_efd, POLLIN, 1, REQ_WORKER, (unsigned)i, L->gen) == 0) {
+                L->worker_armed[i] = 1;
+            }
+            continue;
+        }
+        arm_uart_rx(L, i, now);
+    }
+
+    for (int k = 0; k < L->client_slots; k++) {
+        uring_client_t* cs = &L->clients[k];
+        gw_net_client_t* c = &st->net.clients[k];
+        if (c->fd >= 0 && cs->fd != c->fd) {
+            // новый клиент в слоте
+            cs->fd = c->fd;
+            cs->gen = ++L->client_gen;
+            cs->rx_armed = cs->rx_cancel = cs->tx_busy = cs->dying = 0;
+        }
+        if (cs->fd >= 0) arm_client_rx(L, k);
+    }
+}
+
+static void loop_complete(uring_loop_t* L, const struct io_uring_cqe* cqe, uint64_t now)
+{
+    gw_state_t* st = L->st;
+    uint64_t ud = cqe->user_data;
+    unsigned kind = ud_kind(ud);
+    unsigned idx = ud_idx(ud);
+    if (!(cqe->flags & IORING_CQE_F_MORE)) L->inflight--;
+
+    switch (kind) {
+    case REQ_SIG:
+        if (!(cqe->flags & IORING_CQE_F_MORE)) L->sig_armed = 0;
+        break;
+    case REQ_ACCEPT:
+        if (!(cqe->flags & IORING_CQE_F_MORE)) L->accept_armed = 0;
+        if (cqe->res > 0 && gw_net_accept(&st->net) < 0) perror("accept");
+        break;
+    case REQ_WORKER:
+        if (!(cqe->flags & IORING_CQE_F_MORE)) L->worker_armed[idx] = 0;
+        if (cqe->res > 0 && idx < (unsigned)st->uart_count) {
+            gw_worker_ack(&st->workers[idx]);
+            gw_dispatch_worker_rx(st, (int)idx, now);
+        }
+        break;
+    case REQ_UART_RX:
+        if (idx < (unsigned)st->uart_count && ud_gen(ud) == L->gen) on_uart_rx(L, (int)idx, cqe, now);
+        else if (cqe->flags & IORING_CQE_F_BUFFER) gw_uring_buf_put(&L->ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        break;
+    case REQ_UART_TX:
+        if (idx < (unsigned)st->uart_count) on_uart_tx(L, (int)idx, cqe);
+        break;
+    case REQ_UART_TXWAIT:
+        if (idx < (unsigned)st->uart_count) L->uarts[idx].tx_wait = 0;
+        break;
+    case REQ_CLIENT_RX:
+    case REQ_CLIENT_TX:
+        if (idx >= (unsigned)L->client_slots || L->clients[idx].gen != ud_gen(ud)) {
+            if (cqe->flags & IORING_CQE_F_BUFFER) gw_uring_buf_put(&L->ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            break;
+        }
+        if (kind == REQ_CLIENT_RX) on_client_rx(L, (int)idx, cqe, now);
+        else on_client_tx(L, (int)idx, cqe);
+        client_reap(L, (int)idx);
+        break;
+    default:
+        break;
+    }
+}
+
+// Разобрать все завершения (SIGUSR1 — дамп статистики сразу). 1 = пришёл SIGHUP
+static int loop_reap(uring_loop_t* L, uint64_t now)
+{
+    int hup = 0;
+    struct io_uring_cqe* cqe;
+    while ((cqe = gw_uring_cqe(&L->ring)) != NULL) {
+        struct io_uring_cqe c = *cqe;
+        gw_uring_cqe_seen(&L->ring);
+        if (ud_kind(c.user_data) == REQ_SIG && c.res > 0) {
+            int sig = gw_state_read_signals(L->st);
+            if (sig & GW_SIG_USR1) gw_metrics_dump(L->st, stderr);
+            if (sig & GW_SIG_HUP) hup = 1;
+        }
+        loop_complete(L, &c, now);
+    }
+    return hup;
+}
+
+// SIGHUP: отменить все запросы (буферы клиентов и UART при перестройке освобождаются),
+// дождаться их завершения, перечитать конфигурацию и взвести всё заново
+static int loop_reload(uring_loop_t* L)
+{
+    gw_state_t* st = L->st;
+    L->quiesce = 1;
+    (void)arm_cancel(L, 0, IORING_ASYNC_CANCEL_ANY);
+    while (L->inflight > 0) {
+        if (gw_uring_submit_wait(&L->ring, 100000) < 0) {
+            perror("io_uring_enter");
+            return -1;
+        }
+        (void)loop_reap(L, gw_clock_tick());
+        for (int k = 0; k < L->client_slots; k++) client_reap(L, k);
+    }
+    L->quiesce = 0;
+
+    uint64_t now = gw_clock_tick();
+    if (gw_dispatch_reload(st, now) < 0) return -1;
+
+    // индексы UART и слоты клиентов могли смениться — всё с нуля
+    L->gen++;
+    L->sig_armed = L->accept_armed = 0;
+    memset(L->worker_armed, 0, sizeof(L->worker_armed));
+    for (int i = 0; i < GW_UART_MAX; i++) {
+        int poll_mode = L->uarts[i].rx_poll;
+        memset(&L->uarts[i], 0, sizeof(L->uarts[i]));
+        L->uarts[i].rx_poll = poll_mode || !L->uart_mshot;
+    }
+    for (int k = 0; k < st->net.max_clients; k++) st->net.clients[k].tx_busy = 0;
+    return loop_clients_init(L);
+}
+
+int gw_uring_run(gw_state_t* st)
+{
+    static uring_loop_t L;
+    memset(&L, 0, sizeof(L));
+    L.st = st;
+
+    if (gw_uring_init(&L.ring, URING_ENTRIES, URING_BUFS, URING_BUF_SIZE) < 0) {
+        fprintf(stderr, "io_uring: %s\n", strerror(errno));
+        return GW_URING_UNAVAILABLE;
+    }
+    if (!gw_uring_has_op(&L.ring, IORING_OP_RECV) || !gw_uring_has_op(&L.ring, IORING_OP_SEND) ||
+        !gw_uring_has_op(&L.ring, IORING_OP_WRITE) || !gw_uring_has_op(&L.ring, IORING_OP_POLL_ADD) ||
+        !gw_uring_has_op(&L.ring, IORING_OP_ASYNC_CANCEL)) {
+        fprintf(stderr, "io_uring: required operations not supported\n");
+        gw_uring_free(&L.ring);
+        return GW_URING_UNAVAILABLE;
+    }
+    if (loop_clients_init(&L) < 0) {
+        gw_uring_free(&L.ring);
+        return GW_URING_UNAVAILABLE;
+    }
+
+    L.uart_mshot = gw_uring_has_op(&L.ring, GW_IORING_OP_READ_MULTISHOT);
+    L.client_mshot = 1; // проверяется первым же recv
+    for (int i = 0; i < GW_UART_MAX; i++) L.uarts[i].rx_poll = !L.uart_mshot;
+    L.accept_fd = -1;
+    st->backend = GW_BACKEND_IO_URING;
+
+    fprintf(stderr, "ecu-gw: io_uring backend (%s, UART read %s)\n",
+#ifdef IORING_SETUP_DEFER_TASKRUN
+            (L.ring.flags & IORING_SETUP_DEFER_TASKRUN) ? "defer taskrun" :
+#endif
+            (L.ring.flags & IORING_SETUP_COOP_TASKRUN) ? "coop taskrun" : "basic",
+            L.uart_mshot ? "multishot" : "poll");
+
+    int rc = 0;
+    long timeout_us = (long)st->cfg.tick_ms * 1000;
+    for (;;) {
+        uint64_t now = gw_clock_tick();
+        loop_arm(&L, now);
+
+        // всё подготовленное за такт (записи в UART и клиентам, перевзводы) уходит вместе с ожиданием
+        if (gw_uring_submit_wait(&L.ring, timeout_us) < 0) {
+            perror("io_uring_enter");
+            rc = -1;
+            break;
+        }
+
+        now = gw_clock_tick();
+        gw_dispatch_age(st, now);
+        if (loop_reap(&L, now)) {
+            if (loop_reload(&L) < 0) {
+                rc = -1;
+                break;
+            }
+            continue;
+        }
+
+        // отложенные команды — первыми, затем поставленные клиентами за такт;
+        // до следующего срока — таймаут ожидания (мкс)
+        (void)gw_dispatch_sched(st, now);
+        long client_us = clients_dispatch(&L, now);
+        long sched_us = gw_dispatch_sched(st, now);
+        if (sched_us >= 0 && (client_us < 0 || sched_us < client_us)) client_us = sched_us;
+
+        // кадры, поставленные за такт: потокам UART — eventfd, UART — запись, клиентам — send.
+        // UART, очередь драйвера которого не ушла до бюджета, ждёт до конца ожидания (таймаут)
+        long hold_us = -1;
+        if (st->threaded) {
+            for (int k = 0; k < st->uart_count; k++) gw_worker_kick(&st->workers[k]);
+        } else {
+            st->uart_tx_dirty = 0;
+            for (int i = 0; i < st->uart_count; i++) {
+                arm_uart_tx(&L, i);
+                long h = gw_uart_tx_hold_us(&st->uarts[i], now);
+                if (h >= 0 && (hold_us < 0 || h < hold_us)) hold_us = h;
+            }
+        }
+        long next_us = clients_flush(&L, gw_clock_tick());
+        if (client_us >= 0 && (next_us < 0 || client_us < next_us)) next_us = client_us;
+        if (hold_us >= 0 && (next_us < 0 || hold_us < next_us)) next_us = hold_us;
+
+        timeout_us = (long)st->cfg.tick_ms * 1000;
+        if (next_us >= 0 && next_us < timeout_us) timeout_us = next_us;
+    }
+
+    // закрытие кольца отменяет всё незавершённое
+    gw_uring_free(&L.ring);
+    free(L.clients);
+    L.clients = NULL;
+    return rc;
+}
+
+#endif
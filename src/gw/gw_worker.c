@@ -0,0 +1,298 @@
+#include "gw/gw_worker.h"
+
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+static void efd_signal(int fd)
+{
+    uint64_t one = 1;
+    ssize_t r = write(fd, &one, sizeof(one));
+    (void)r;
+}
+
+static void efd_drain(int fd)
+{
+    uint64_t v;
+    ssize_t r = read(fd, &v, sizeof(v));
+    (void)r;
+}
+
+int gw_worker_set_affinity(int cpu)
+{
+    if (cpu < 0) return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+// Переложить кадры кольца q в очередь UART; кадр, который не поместился, ждёт в кольце
+static int drain_ring(gw_worker_t* w, gw_spsc_t* q)
+{
+    int moved = 0;
+    for (;;) {
+        size_t len = 0;
+        uint64_t tag = 0;
+        const uint8_t* f = gw_spsc_peek_tag(q, &len, &tag);
+        if (!f) break;
+        gw_lat_origin_t o = gw_lat_origin_unpack(tag);
+        if (gw_uart_send_slip_ex(w->uart, f, len, &o) < 0) break;
+        gw_latency_rx_done(o.dir, o.node, o.t_read);
+        gw_spsc_pop(q);
+        atomic_fetch_add_explicit(&w->tx_frames, 1, memory_order_relaxed);
+        moved++;
+    }
+    return moved;
+}
+
+// Срочные — первыми: они встают в свою полосу, даже если кольцо tx ждёт места в младших
+static int drain_tx_ring(gw_worker_t* w)
+{
+    int moved = drain_ring(w, &w->tx_urgent);
+    return moved + drain_ring(w, &w->tx);
+}
+
+static size_t tx_ring_count(const gw_worker_t* w)
+{
+    return gw_spsc_count(&w->tx_urgent) + gw_spsc_count(&w->tx);
+}
+
+static int read_uart(gw_worker_t* w)
+{
+    gw_uart_t* u = w->uart;
+    int pushed = 0;
+
+    int rr = gw_uart_handle_read(u);
+    if (rr < 0) {
+        fprintf(stderr, "UART read error on %s\n", u->dev_path);
+        return 0;
+    }
+    if (w->raw_log && rr > 0 && (size_t)rr <= u->rx_len) {
+        (void)ecu_log_write(w->raw_log, ECU_LOG_RAW_UART, (unsigned)w->idx, gw_clock_now(),
+                            &u->rx_buf[u->rx_len - (size_t)rr], (size_t)rr);
+    }
+
+    for (;;) {
+        const uint8_t* f = NULL;
+        size_t flen = 0;
+        int gr = gw_uart_try_get_slip_frame(u, &f, &flen);
+        if (gr == 0) break;
+        if (gr < 0) continue; // сбойный кадр отброшен, дальше могут идти целые
+
+        if (!ecu_frame_validate(f, flen, NULL, NULL)) {
+            atomic_fetch_add_explicit(&w->rx_bad, 1, memory_order_relaxed);
+            gw_counter_add(&u->stats.rx_crc_errors, 1);
+            fprintf(stderr, "UART %s: bad ECU frame (drop)\n", u->dev_path);
+            continue;
+        }
+        gw_counter_add(&u->stats.rx_frames, 1);
+        // тег — такт чтения: задержку до постановки в очереди считает сетевой поток
+        if (gw_spsc_push_tag(&w->rx, f, flen, gw_clock_now()) < 0) {
+            atomic_fetch_add_explicit(&w->rx_ring_drops, 1, memory_order_relaxed);
+            gw_counter_add(&u->stats.rx_dropped, 1);
+            continue;
+        }
+        atomic_fetch_add_explicit(&w->rx_frames, 1, memory_order_relaxed);
+        pushed++;
+    }
+    return pushed;
+}
+
+static void* worker_main(void* arg)
+{
+    gw_worker_t* w = (gw_worker_t*)arg;
+    gw_uart_t* u = w->uart;
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(w->cpu_mask), &w->cpu_mask) != 0 && w->cpu >= 0) {
+        fprintf(stderr, "worker %s: cpu %d: affinity not set\n", u->dev_path, w->cpu);
+    }
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) {
+        perror("worker epoll_create1");
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = w->tx_efd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, w->tx_efd, &ev);
+
+    uint32_t uart_mask = EPOLLIN | (gw_uart_tx_pending(u) ? EPOLLOUT : 0u);
+    ev.events = uart_mask;
+    ev.data.fd = u->fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, u->fd, &ev);
+
+    int timeout_ms = -1;
+    while (!atomic_load_explicit(&w->stop, memory_order_acquire)) {
+        struct epoll_event evs[4];
+        int n = epoll_wait(ep, evs, 4, timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("worker epoll_wait");
+            break;
+        }
+        gw_clock_tick();
+
+        int pushed = 0;
+        for (int i = 0; i < n; i++) {
+            if (evs[i].data.fd == w->tx_efd) {
+                efd_drain(w->tx_efd);
+                continue;
+            }
+            if (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) pushed += read_uart(w);
+            if (evs[i].events & EPOLLOUT) {
+                if (gw_uart_handle_write(u) < 0) fprintf(stderr, "UART write error on %s\n", u->dev_path);
+            }
+        }
+
+        // новые кадры из сети (или освободилось место в очереди UART). Запись, освободившая место,
+        // сразу же перекладывает ждущие в кольце: иначе при опустевшей очереди их никто не разбудит
+        int moved = 0;
+        for (;;) {
+            moved += drain_tx_ring(w);
+            if (gw_uart_tx_pending(u) == 0) break;
+            if (gw_uart_handle_write(u) <= 0 || tx_ring_count(w) == 0) break;
+        }
+
+        // сетевой поток ждёт места в кольце tx (кадры клиентов не теряются, а ждут) — разбудить
+        int wake = pushed > 0;
+        if (moved > 0) {
+            atomic_thread_fence(memory_order_seq_cst);
+            if (atomic_exchange_explicit(&w->tx_wait, 0, memory_order_relaxed)) wake = 1;
+        }
+        if (wake) efd_signal(w->rx_efd);
+
+        // очередь драйвера не ушла до бюджета: EPOLLOUT не нужен, следующий кадр — по таймауту
+        long hold_us = gw_uart_tx_hold_us(u, gw_clock_read_us());
+        timeout_ms = hold_us > 0 ? (int)((hold_us + 999) / 1000) : -1;
+        uint32_t want = EPOLLIN | (gw_uart_tx_pending(u) && hold_us <= 0 ? EPOLLOUT : 0u);
+        if (want != uart_mask) {
+            ev.events = want;
+            ev.data.fd = u->fd;
+            if (epoll_ctl(ep, EPOLL_CTL_MOD, u->fd, &ev) == 0) uart_mask = want;
+        }
+    }
+
+    close(ep);
+    return NULL;
+}
+
+int gw_worker_start(gw_worker_t* w, gw_uart_t* u, int idx, size_t ring_slots,
+                    int cpu, const cpu_set_t* any_mask, ecu_log_t* raw_log)
+{
+    if (!w || !u || u->fd < 0) return -1;
+    memset(w, 0, sizeof(*w));
+    w->uart = u;
+    w->idx = idx;
+    w->cpu = cpu;
+    w->raw_log = raw_log;
+    w->rx_efd = w->tx_efd = -1;
+    if (cpu >= 0) {
+        CPU_ZERO(&w->cpu_mask);
+        CPU_SET(cpu, &w->cpu_mask);
+    } else if (any_mask) {
+        w->cpu_mask = *any_mask;
+    } else {
+        (void)sched_getaffinity(0, sizeof(w->cpu_mask), &w->cpu_mask);
+    }
+    atomic_init(&w->stop, 0);
+    atomic_init(&w->tx_wait, 0);
+
+    size_t urgent_slots = ring_slots / 4 < 8 ? 8 : ring_slots / 4;
+    if (gw_spsc_init(&w->rx, ring_slots, ECU_MAX_FRAME_SIZE) < 0 ||
+        gw_spsc_init(&w->tx, ring_slots, ECU_MAX_FRAME_SIZE) < 0 ||
+        gw_spsc_init(&w->tx_urgent, urgent_slots, ECU_MAX_FRAME_SIZE) < 0) {
+        gw_worker_free(w);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    w->rx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    w->tx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (w->rx_efd < 0 || w->tx_efd < 0) {
+        gw_worker_free(w);
+        return -1;
+    }
+
+    int rc = pthread_create(&w->thread, NULL, worker_main, w);
+    if (rc != 0) {
+        gw_worker_free(w);
+        errno = rc;
+        return -1;
+    }
+    w->running = 1;
+    return 0;
+}
+
+void gw_worker_stop(gw_worker_t* w)
+{
+    if (!w || !w->running) return;
+    atomic_store_explicit(&w->stop, 1, memory_order_release);
+    efd_signal(w->tx_efd);
+    pthread_join(w->thread, NULL);
+    w->running = 0;
+
+    // поток завершён — кольца tx можно вычитать отсюда
+    drain_tx_ring(w);
+    size_t left = 0;
+    while (gw_spsc_peek(&w->tx_urgent, NULL)) {
+        gw_spsc_pop(&w->tx_urgent);
+        left++;
+    }
+    while (gw_spsc_peek(&w->tx, NULL)) {
+        gw_spsc_pop(&w->tx);
+        left++;
+    }
+    if (left) atomic_fetch_add_explicit(&w->tx_ring_drops, (unsigned)left, memory_order_relaxed);
+}
+
+void gw_worker_free(gw_worker_t* w)
+{
+    if (!w || !w->uart) return;
+    gw_worker_stop(w);
+    gw_spsc_free(&w->rx);
+    gw_spsc_free(&w->tx);
+    gw_spsc_free(&w->tx_urgent);
+    if (w->rx_efd >= 0) close(w->rx_efd);
+    if (w->tx_efd >= 0) close(w->tx_efd);
+    w->rx_efd = w->tx_efd = -1;
+    w->uart = NULL;
+}
+
+int gw_worker_send(gw_worker_t* w, const uint8_t* frame, size_t len, const gw_lat_origin_t* o)
+{
+    if (!w || !w->running) return -1;
+    uint64_t tag = gw_lat_origin_pack(o);
+    gw_spsc_t* q = gw_worker_tx_ring(w, frame, len);
+    if (gw_spsc_push_tag(q, frame, len, tag) < 0) {
+        // кольцо полно: поток разбудит сетевой (rx_efd), когда заберёт кадры.
+        // Место могло освободиться до флага — ещё одна попытка после него
+        atomic_store_explicit(&w->tx_wait, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (gw_spsc_push_tag(q, frame, len, tag) < 0) return -1;
+    }
+    w->tx_kick = 1;
+    return 0;
+}
+
+void gw_worker_kick(gw_worker_t* w)
+{
+    if (!w || !w->tx_kick) return;
+    w->tx_kick = 0;
+    efd_signal(w->tx_efd);
+}
+
+void gw_worker_ack(gw_worker_t* w)
+{
+    if (w && w->rx_efd >= 0) efd_drain(w->rx_efd);
+}
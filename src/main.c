@@ -1,48 +1,90 @@
 #include "gw/gw_app.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-config FILE] [-show] [-prev_show] [-send_test PORT] [-cmd_ui PORT] [-trace FILE]\n", argv0);
+    fprintf(stderr, "       -send_test PORT [-send_time SEC] [-send_rate HZ] [-send_size BYTES] [-send_loop self|A:B,...]\n");
+}
+
 int main(int argc, char** argv)
 {
-    int show_packets = 0;
-    int preview_raw = 0;
-    const char* send_test_ports = NULL;
-    const char* cmd_ui_port = NULL;
+    gw_app_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    int send_opts = 0;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-show") == 0) {
-            show_packets = 1;
+            opts.show_packets = 1;
             continue;
         }
         if (strcmp(argv[i], "-prev_show") == 0) {
-            preview_raw = 1;
+            opts.preview_raw = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-config") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            opts.config_path = argv[++i];
             continue;
         }
         if (strcmp(argv[i], "-send_test") == 0) {
             if (i + 1 >= argc) {
-                fprintf(stderr, "Usage: %s [-show] [-prev_show] [-send_test PORT] [-cmd_ui PORT]\n", argv[0]);
+                usage(argv[0]);
                 return 2;
             }
-            send_test_ports = argv[++i];
+            opts.send_test_ports = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "-send_time") == 0 || strcmp(argv[i], "-send_rate") == 0 ||
+            strcmp(argv[i], "-send_size") == 0 || strcmp(argv[i], "-send_loop") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            const char* k = argv[i] + 6;
+            const char* v = argv[++i];
+            if (strcmp(k, "time") == 0) opts.send_time_s = atof(v);
+            else if (strcmp(k, "rate") == 0) opts.send_rate = atof(v);
+            else if (strcmp(k, "size") == 0) opts.send_size = (unsigned)strtoul(v, NULL, 10);
+            else opts.send_loop = v;
+            send_opts = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-trace") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            opts.trace_path = argv[++i];
             continue;
         }
         if (strcmp(argv[i], "-cmd_ui") == 0) {
             if (i + 1 >= argc) {
-                fprintf(stderr, "Usage: %s [-show] [-prev_show] [-send_test PORT] [-cmd_ui PORT]\n", argv[0]);
+                usage(argv[0]);
                 return 2;
             }
-            cmd_ui_port = argv[++i];
+            opts.cmd_ui_port = argv[++i];
             continue;
         }
 
-        fprintf(stderr, "Usage: %s [-show] [-prev_show] [-send_test PORT] [-cmd_ui PORT]\n", argv[0]);
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (send_opts && !opts.send_test_ports) {
+        fprintf(stderr, "Options -send_time/-send_rate/-send_size/-send_loop require -send_test\n");
         return 2;
     }
 
-    if (send_test_ports && cmd_ui_port) {
+    if (opts.send_test_ports && opts.cmd_ui_port) {
         fprintf(stderr, "Options -send_test and -cmd_ui are mutually exclusive\n");
         return 2;
     }
 
-    return gw_app_run(show_packets, preview_raw, send_test_ports, cmd_ui_port);
+    return gw_app_run(&opts);
 }
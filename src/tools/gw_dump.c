@@ -0,0 +1,942 @@
+// gw_dump — читатель tap сокета ecu_gw ([gateway] tap), двоичных журналов (-trace FILE)
+// и файлов записи трафика ([capture], *.ecap — с поиском по времени через индекс блоков).
+// Печатает записи (кадры — с разобранным заголовком ECU) или сохраняет поток в файл
+// в том же формате, что -trace: его потом можно разобрать через --read.
+// --record пишет поток tap в файлы capture без перезапуска шлюза, --analyze разбирает capture
+// целиком: SLIP и CRC каждого кадра, статистика по узлам и типам, пропуски seq, ошибки по
+// времени, телеметрия в CSV — файл отображается в память и делится на части по потокам.
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ecu/ecu_cap.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_log.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+#include "ecu/ecu_telemetry.h"
+
+#define DUMP_TAP_DEFAULT "/run/ecu_gw.tap"
+#define DUMP_PKT_MAX     (64 * 1024)   // больше пакета tap
+#define DUMP_REC_UARTS   8             // --record без --uarts: имена U0..U7
+#define DUMP_GAPS_SHOW   20
+
+typedef struct {
+    const char* tap;
+    const char* read_path;
+    const char* write_path;
+    uint32_t    kinds;      // ECU_LOG_KIND_BIT()
+    int         port;       // -1 = все
+    int         hex;        // кадры ещё и байтами
+    int         quiet;
+    double      from_s;     // capture: с секунды от начала файла
+    double      to_s;       // capture: до секунды (< 0 = до конца)
+    const char* record;     // --record PREFIX: tap -> файлы capture
+    const char* uarts;      // имена UART для заголовка capture, через запятую
+    unsigned    max_mb;
+    unsigned    max_sec;
+    unsigned    files;
+    const char* analyze;    // --analyze FILE.ecap
+    int         threads;    // 0 = по числу ядер
+    double      bucket_s;   // шаг шкалы ошибок
+    const char* csv;        // телеметрия в CSV
+    int         gaps;       // пропусков seq напечатать
+} args_t;
+
+typedef struct {
+    FILE*      out;         // --write
+    ecu_cap_t* cap;         // --record
+    uint64_t   records;
+    uint64_t   lost;
+    uint64_t   bytes;
+} dump_stat_t;
+
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static const char* msg_name(unsigned t)
+{
+    switch (t) {
+        case ECU_MSG_HELLO:     return "HELLO";
+        case ECU_MSG_TELEMETRY: return "TELEMETRY";
+        case ECU_MSG_COMMAND:   return "COMMAND";
+        case ECU_MSG_ACK:       return "ACK";
+        case ECU_MSG_TIME_SYNC: return "TIME_SYNC";
+        case ECU_MSG_EVENT:     return "EVENT";
+        case ECU_MSG_CONFIG:    return "CONFIG";
+        case ECU_MSG_HEARTBEAT: return "HEARTBEAT";
+        default:                return "?";
+    }
+}
+
+static int is_raw(unsigned kind)
+{
+    return (ECU_LOG_KINDS_RAW & ECU_LOG_KIND_BIT(kind)) != 0;
+}
+
+static void print_rec(const args_t* a, const ecu_log_rec_t* r)
+{
+    if (r->kind == ECU_LOG_LOST) return;
+    if (is_raw(r->kind)) {
+        ecu_log_print(stdout, r);
+        return;
+    }
+
+    const ecu_hdr_t* h = NULL;
+    const uint8_t* payload = NULL;
+    char port[8] = "";
+    if (r->port != ECU_LOG_PORT_NONE) snprintf(port, sizeof(port), " [%u]", (unsigned)r->port);
+    if (r->cap_len == r->len && ecu_frame_validate(r->data, r->cap_len, &h, &payload)) {
+        printf("%llu.%06llu %s%s %s %u->%u seq=%u flags=0x%04X len=%u\n",
+               (unsigned long long)(r->ts_us / 1000000u), (unsigned long long)(r->ts_us % 1000000u),
+               ecu_log_kind_name(r->kind), port, msg_name(h->msg_type), (unsigned)h->src, (unsigned)h->dst,
+               (unsigned)h->seq, (unsigned)h->flags, (unsigned)h->payload_len);
+        if (a->hex) ecu_log_print(stdout, r);
+    } else {
+        printf("%llu.%06llu %s%s bad frame len=%u\n", (unsigned long long)(r->ts_us / 1000000u),
+               (unsigned long long)(r->ts_us % 1000000u), ecu_log_kind_name(r->kind), port, (unsigned)r->len);
+        ecu_log_print(stdout, r);
+    }
+}
+
+static void handle_rec(const args_t* a, dump_stat_t* st, const ecu_log_rec_t* r)
+{
+    if (r->kind == ECU_LOG_LOST) {
+        uint32_t n = 0;
+        if (r->cap_len >= sizeof(n)) memcpy(&n, r->data, sizeof(n));
+        st->lost += n;
+        if (!a->quiet) printf("--- %u record(s) lost: reader too slow\n", (unsigned)n);
+        return;
+    }
+    if (!(a->kinds & ECU_LOG_KIND_BIT(r->kind))) return;
+    if (a->port >= 0 && r->port != (unsigned)a->port) return;
+
+    st->records++;
+    st->bytes += r->len;
+    if (st->cap) {
+        unsigned port, dir, flags;
+        if (ecu_log_cap_port(r->kind, r->port, &port, &dir, &flags) == 0 &&
+            ecu_cap_write(st->cap, r->ts_us * 1000u, port, dir, flags, r->data, r->cap_len) < 0) {
+            fprintf(stderr, "%s: %s\n", st->cap->path, strerror(st->cap->err));
+            g_stop = 1;
+        }
+    } else if (st->out) {
+        if (fwrite(r, 1, ECU_LOG_REC_HDR + r->cap_len, st->out) != ECU_LOG_REC_HDR + r->cap_len) {
+            perror("write");
+            g_stop = 1;
+        }
+    } else if (!a->quiet) {
+        print_rec(a, r);
+    }
+}
+
+// Пакет tap: целые записи подряд. 0 = OK, -1 = пакет испорчен
+static int handle_packet(const args_t* a, dump_stat_t* st, const uint8_t* p, size_t len)
+{
+    static ecu_log_rec_t r;
+    size_t off = 0;
+    while (off < len) {
+        if (len - off < ECU_LOG_REC_HDR) return -1;
+        memcpy(&r, p + off, ECU_LOG_REC_HDR);
+        if (r.cap_len > ECU_LOG_SNAP || len - off - ECU_LOG_REC_HDR < r.cap_len) return -1;
+        memcpy(r.data, p + off + ECU_LOG_REC_HDR, r.cap_len);
+        handle_rec(a, st, &r);
+        off += ECU_LOG_REC_HDR + r.cap_len;
+    }
+    return 0;
+}
+
+static int run_tap(const args_t* a, dump_stat_t* st)
+{
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (strlen(a->tap) >= sizeof(sa.sun_path)) {
+        fprintf(stderr, "tap path too long\n");
+        return -1;
+    }
+    memcpy(sa.sun_path, a->tap, strlen(a->tap));
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (const struct sockaddr*)&sa, sizeof(sa)) < 0) {
+        fprintf(stderr, "connect %s: %s\n", a->tap, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    // буфер приёма побольше: меньше потерь на всплесках
+    int sz = 1024 * 1024;
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+
+    uint8_t* buf = (uint8_t*)malloc(DUMP_PKT_MAX);
+    if (!buf) {
+        close(fd);
+        return -1;
+    }
+    int rc = 0;
+    time_t synced = time(NULL);
+    while (!g_stop) {
+        ssize_t n = recv(fd, buf, DUMP_PKT_MAX, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("recv");
+            rc = -1;
+            break;
+        }
+        if (n == 0) {
+            fprintf(stderr, "gw_dump: gateway closed the tap\n");
+            break;
+        }
+        if (handle_packet(a, st, buf, (size_t)n) < 0) fprintf(stderr, "gw_dump: malformed packet (%zd bytes)\n", n);
+        if (st->cap) {
+            // неполный блок на диск раз в секунду: при обрыве теряется не больше
+            time_t now = time(NULL);
+            if (now != synced) {
+                (void)ecu_cap_sync(st->cap);
+                synced = now;
+            }
+        } else if (st->out) {
+            fflush(st->out);
+        } else {
+            fflush(stdout);
+        }
+    }
+    free(buf);
+    close(fd);
+    return rc;
+}
+
+// Запись capture в запись журнала: дальше общие фильтры, печать и --write
+static void cap_to_log(const ecu_cap_rec_t* c, ecu_log_rec_t* r)
+{
+    unsigned net = c->port != ECU_CAP_PORT_NET_ALL && c->port != ECU_CAP_PORT_NONE && (c->port & ECU_CAP_PORT_NET);
+    memset(r, 0, ECU_LOG_REC_HDR);
+    r->ts_us = c->ts_ns / 1000u;
+    r->len = c->len;
+    r->cap_len = c->len < ECU_LOG_SNAP ? c->len : ECU_LOG_SNAP;
+    r->port = net ? (uint8_t)(c->port & 0x7Fu) : c->port;
+    if (c->port == ECU_CAP_PORT_NET_ALL) r->port = ECU_LOG_PORT_NONE;
+    if (c->flags & ECU_CAP_F_RAW) r->kind = net ? ECU_LOG_RAW_NET : ECU_LOG_RAW_UART;
+    else if (c->dir == ECU_CAP_RX) r->kind = net ? ECU_LOG_RX_NET : ECU_LOG_RX_UART;
+    else if (c->port == ECU_CAP_PORT_NET_ALL) r->kind = ECU_LOG_TX_NET;
+    else r->kind = (c->flags & ECU_CAP_F_FWD) ? ECU_LOG_FWD_UART : ECU_LOG_TX_UART;
+    memcpy(r->data, c + 1, r->cap_len);
+}
+
+static int run_cap(const args_t* a, dump_stat_t* st)
+{
+    ecu_cap_reader_t rd;
+    if (ecu_cap_reader_open(&rd, a->read_path) < 0) return -1;
+
+    time_t t0 = (time_t)(rd.hdr.real_ns / 1000000000u);
+    struct tm tm;
+    char when[32];
+    localtime_r(&t0, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(stderr, "gw_dump: capture #%u started %s, %u block(s) of %u KB, uarts:", (unsigned)rd.hdr.file_no, when,
+            (unsigned)rd.blocks, (unsigned)(rd.hdr.block_size / 1024u));
+    for (int i = 0; i < ECU_CAP_PORTS && rd.hdr.uart[i][0]; i++) fprintf(stderr, " %d=%.16s", i, rd.hdr.uart[i]);
+    fputc('\n', stderr);
+
+    uint8_t* blk = (uint8_t*)malloc(rd.hdr.block_size);
+    if (!blk) {
+        ecu_cap_reader_close(&rd);
+        return -1;
+    }
+    static ecu_log_rec_t r;
+    // записи старше заголовка файла (ждали в кольце до его открытия) — тоже «с начала»
+    uint64_t from = a->from_s > 0 ? rd.hdr.mono_ns + (uint64_t)(a->from_s * 1e9) : 0;
+    uint64_t to = a->to_s < 0 ? UINT64_MAX : rd.hdr.mono_ns + (uint64_t)(a->to_s * 1e9);
+    int done = 0;
+    // индекс блоков: сразу к нужному времени, не читая записи до него
+    for (uint32_t b = ecu_cap_seek(&rd, from); b < rd.blocks && !done && !g_stop; b++) {
+        if (ecu_cap_read_block(&rd, b, blk) < 0) {
+            fprintf(stderr, "%s: block %u damaged, stopping\n", a->read_path, (unsigned)b);
+            break;
+        }
+        uint32_t off = sizeof(ecu_cap_block_t);
+        const ecu_cap_rec_t* c;
+        while ((c = ecu_cap_next(blk, rd.hdr.block_size, &off)) != NULL) {
+            if (c->ts_ns < from) continue;
+            if (c->ts_ns > to) {
+                done = 1;
+                break;
+            }
+            cap_to_log(c, &r);
+            handle_rec(a, st, &r);
+        }
+    }
+    free(blk);
+    ecu_cap_reader_close(&rd);
+    return 0;
+}
+
+static int run_file(const args_t* a, dump_stat_t* st)
+{
+    ecu_cap_reader_t probe;
+    if (strcmp(a->read_path, "-") != 0 && ecu_cap_reader_open(&probe, a->read_path) == 0) {
+        ecu_cap_reader_close(&probe);
+        return run_cap(a, st);
+    }
+
+    FILE* in = strcmp(a->read_path, "-") == 0 ? stdin : fopen(a->read_path, "rb");
+    if (!in) {
+        fprintf(stderr, "%s: %s\n", a->read_path, strerror(errno));
+        return -1;
+    }
+    static ecu_log_rec_t r;
+    int rc = 0;
+    while (!g_stop && fread(&r, 1, ECU_LOG_REC_HDR, in) == ECU_LOG_REC_HDR) {
+        if (r.cap_len > ECU_LOG_SNAP || fread(r.data, 1, r.cap_len, in) != r.cap_len) {
+            fprintf(stderr, "%s: truncated or corrupt record\n", a->read_path);
+            rc = -1;
+            break;
+        }
+        handle_rec(a, st, &r);
+    }
+    if (in != stdin) fclose(in);
+    return rc;
+}
+
+// ---- --analyze: разбор capture целиком ----
+//
+// Части файла (диапазоны блоков) разбираются параллельно. Блоки — границы записей, а поток
+// каждого UART синхронизируется по SLIP END: часть начинает разбор с начала своего диапазона,
+// её первый кадр на порту может оказаться хвостом кадра предыдущей части — такой не считается,
+// если не сошёлся. Предыдущая часть, в свою очередь, дочитывает начатые кадры из следующих блоков.
+
+typedef struct {
+    uint64_t frames;
+    uint64_t bytes;
+} an_count_t;
+
+typedef struct {
+    uint64_t raw_bytes;
+    uint64_t frames;       // кадров с верным CRC
+    uint64_t crc;          // заголовок цел, CRC не сошёлся
+    uint64_t framing;      // не кадр ECU: заголовок, длина
+    uint64_t slip;         // ошибка SLIP: escape, переполнение
+} an_port_t;
+
+enum { AN_ERR_CRC, AN_ERR_FRAMING, AN_ERR_SLIP };
+
+typedef struct {
+    uint64_t ts_ns;
+    uint8_t  port;
+    uint8_t  kind;         // AN_ERR_*
+} an_err_t;
+
+typedef struct {
+    uint64_t ts_ns;
+    uint16_t from;         // последний seq до пропуска
+    uint16_t to;           // первый после
+    uint8_t  node;
+} an_gap_t;
+
+typedef struct {
+    int      seen;
+    uint16_t first;
+    uint16_t last;
+    uint64_t first_ns;
+    uint64_t gaps;
+    uint64_t missed;
+    uint64_t dups;
+    uint64_t back;         // seq назад: перезапуск узла или переупорядочивание
+} an_seq_t;
+
+// Растущий массив
+typedef struct {
+    void*  p;
+    size_t n;
+    size_t cap;
+} an_vec_t;
+
+typedef struct {
+    const ecu_cap_reader_t* rd;
+    uint32_t   b0, b1;              // блоки [b0, b1)
+    uint64_t   from_ns, to_ns;
+    FILE*      csv;                 // телеметрия части (tmpfile)
+
+    slip_rx_t  slip[ECU_CAP_PORTS];
+    uint8_t    buf[ECU_CAP_PORTS][ECU_MAX_FRAME_SIZE];
+    uint8_t    head[ECU_CAP_PORTS]; // до первого END части: кадр может быть чужим хвостом
+
+    uint64_t   records;
+    uint32_t   bad_blocks;
+    an_port_t  port[ECU_CAP_PORTS];
+    an_count_t node[256];
+    an_count_t type[256];
+    an_seq_t   seq[256];
+    an_vec_t   gaps;                // an_gap_t
+    an_vec_t   errs;                // an_err_t
+    int        oom;
+} an_part_t;
+
+static int vec_push(an_vec_t* v, const void* item, size_t size)
+{
+    if (v->n == v->cap) {
+        size_t cap = v->cap ? v->cap * 2 : 1024;
+        void* p = realloc(v->p, cap * size);
+        if (!p) return -1;
+        v->p = p;
+        v->cap = cap;
+    }
+    memcpy((uint8_t*)v->p + v->n * size, item, size);
+    v->n++;
+    return 0;
+}
+
+static void an_error(an_part_t* p, unsigned port, uint64_t ts, unsigned kind)
+{
+    an_port_t* s = &p->port[port];
+    if (kind == AN_ERR_CRC) s->crc++;
+    else if (kind == AN_ERR_FRAMING) s->framing++;
+    else s->slip++;
+    an_err_t e = { ts, (uint8_t)port, (uint8_t)kind };
+    if (vec_push(&p->errs, &e, sizeof(e)) < 0) p->oom = 1;
+}
+
+// Следующий seq узла: пропуски, повторы, шаги назад
+static int seq_step(an_seq_t* q, an_vec_t* gaps, unsigned node, uint16_t seq, uint64_t ts)
+{
+    uint16_t d = (uint16_t)(seq - q->last);
+    int rc = 0;
+    if (d == 0) {
+        q->dups++;
+    } else if (d >= 0x8000u) {
+        q->back++;
+    } else if (d > 1) {
+        q->gaps++;
+        q->missed += d - 1u;
+        an_gap_t g = { ts, q->last, seq, (uint8_t)node };
+        rc = vec_push(gaps, &g, sizeof(g));
+    }
+    q->last = seq;
+    return rc;
+}
+
+// Секунды от начала файла; записи, ждавшие в кольце до его открытия, — с минусом
+static double rel_s(const ecu_cap_reader_t* rd, uint64_t ts_ns)
+{
+    return (double)(int64_t)(ts_ns - rd->hdr.mono_ns) / 1e9;
+}
+
+static void an_frame(an_part_t* p, unsigned port, uint64_t ts, const uint8_t* f, size_t len, int head)
+{
+    int kind = -1;
+    ecu_hdr_t h;
+    if (len < ECU_HEADER_SIZE + ECU_CRC_SIZE) {
+        kind = AN_ERR_FRAMING;
+    } else {
+        memcpy(&h, f, sizeof(h));
+        if (!ecu_hdr_validate(&h) || len != ECU_HEADER_SIZE + (size_t)h.payload_len + ECU_CRC_SIZE) {
+            kind = AN_ERR_FRAMING;
+        } else {
+            uint16_t crc = (uint16_t)(f[len - 2] | (f[len - 1] << 8));
+            if (!ecu_frame_check_crc(&h, f + ECU_HEADER_SIZE, crc)) kind = AN_ERR_CRC;
+        }
+    }
+    if (kind >= 0) {
+        if (!head) an_error(p, port, ts, (unsigned)kind);
+        return;
+    }
+
+    p->port[port].frames++;
+    p->node[h.src].frames++;
+    p->node[h.src].bytes += len;
+    p->type[h.msg_type].frames++;
+    p->type[h.msg_type].bytes += len;
+
+    an_seq_t* q = &p->seq[h.src];
+    if (!q->seen) {
+        q->seen = 1;
+        q->first = q->last = h.seq;
+        q->first_ns = ts;
+    } else if (seq_step(q, &p->gaps, h.src, h.seq, ts) < 0) {
+        p->oom = 1;
+    }
+
+    if (p->csv && h.msg_type == ECU_MSG_TELEMETRY && h.payload_len >= sizeof(ecu_telemetry_v1_t)) {
+        ecu_telemetry_v1_t t;
+        memcpy(&t, f + ECU_HEADER_SIZE, sizeof(t));
+        fprintf(p->csv, "%.6f,%.16s,%u,%u,%u,0x%04X,%u,%g,%g,%g,%g\n", rel_s(p->rd, ts), p->rd->hdr.uart[port],
+                (unsigned)h.src, (unsigned)h.seq, (unsigned)t.uptime_ms, (unsigned)t.status_flags, (unsigned)t.error_code, (double)t.voltage, (double)t.current,
+                (double)t.temperature, (double)t.rpm);
+    }
+}
+
+static int is_uart_raw(const ecu_cap_rec_t* r)
+{
+    return r->port < ECU_CAP_PORTS && r->dir == ECU_CAP_RX && (r->flags & ECU_CAP_F_RAW);
+}
+
+static void an_feed(an_part_t* p, const ecu_cap_rec_t* r)
+{
+    unsigned port = r->port;
+    slip_rx_t* s = &p->slip[port];
+    const uint8_t* d = (const uint8_t*)(r + 1);
+    size_t off = 0;
+    p->port[port].raw_bytes += r->len;
+    while (off < r->len) {
+        size_t flen = 0;
+        int rc = slip_rx_push(s, d + off, r->len - off, &flen);
+        int sync = p->head[port] && memchr(d + off, SLIP_END, s->consumed) != NULL;
+        off += s->consumed;
+        if (rc == 1) an_frame(p, port, r->ts_ns, s->out, flen, p->head[port]);
+        else if (rc < 0 && !p->head[port]) an_error(p, port, r->ts_ns, AN_ERR_SLIP);
+        if (sync) p->head[port] = 0;
+    }
+}
+
+// Кадры, начатые в своей части, дочитываются из следующих блоков (только до их END)
+static void an_finish(an_part_t* p)
+{
+    uint32_t pending = 0;
+    for (unsigned i = 0; i < ECU_CAP_PORTS; i++) {
+        if (p->slip[i].out_len > 0 || p->slip[i].esc) pending |= 1u << i;
+    }
+    for (uint32_t b = p->b1; pending && b < p->rd->blocks; b++) {
+        const uint8_t* blk = ecu_cap_block_at(p->rd, b);
+        if (!blk) break;
+        uint32_t off = sizeof(ecu_cap_block_t);
+        const ecu_cap_rec_t* r;
+        while (pending && (r = ecu_cap_next(blk, p->rd->hdr.block_size, &off)) != NULL) {
+            if (!is_uart_raw(r) || !(pending & (1u << r->port))) continue;
+            slip_rx_t* s = &p->slip[r->port];
+            size_t flen = 0;
+            int rc = slip_rx_push(s, (const uint8_t*)(r + 1), r->len, &flen);
+            if (rc == 0) continue;
+            if (rc == 1) an_frame(p, r->port, r->ts_ns, s->out, flen, 0);
+            else an_error(p, r->port, r->ts_ns, AN_ERR_SLIP);
+            pending &= ~(1u << r->port);
+        }
+    }
+}
+
+static void* an_worker(void* arg)
+{
+    an_part_t* p = (an_part_t*)arg;
+    for (unsigned i = 0; i < ECU_CAP_PORTS; i++) {
+        slip_rx_init(&p->slip[i], p->buf[i], sizeof(p->buf[i]));
+        p->slip[i].in_frame = 1;
+        p->head[i] = 1;
+    }
+    for (uint32_t b = p->b0; b < p->b1 && !g_stop; b++) {
+        const uint8_t* blk = ecu_cap_block_at(p->rd, b);
+        if (!blk) {
+            p->bad_blocks++;
+            continue;
+        }
+        uint32_t off = sizeof(ecu_cap_block_t);
+        const ecu_cap_rec_t* r;
+        while ((r = ecu_cap_next(blk, p->rd->hdr.block_size, &off)) != NULL) {
+            p->records++;
+            if (!is_uart_raw(r) || r->ts_ns < p->from_ns || r->ts_ns > p->to_ns) continue;
+            an_feed(p, r);
+        }
+    }
+    an_finish(p);
+    return NULL;
+}
+
+static int cmp_err(const void* a, const void* b)
+{
+    const an_err_t* x = (const an_err_t*)a;
+    const an_err_t* y = (const an_err_t*)b;
+    return x->ts_ns < y->ts_ns ? -1 : x->ts_ns > y->ts_ns;
+}
+
+static const char* err_name(unsigned kind)
+{
+    return kind == AN_ERR_CRC ? "crc" : kind == AN_ERR_FRAMING ? "framing" : "slip";
+}
+
+static int64_t bucket_of(const ecu_cap_reader_t* rd, uint64_t ts_ns, int64_t bn)
+{
+    int64_t d = (int64_t)(ts_ns - rd->hdr.mono_ns);
+    return d >= 0 ? d / bn : -((-d + bn - 1) / bn);
+}
+
+// Ошибки по корзинам времени: строка на корзину, где они были
+static void an_timeline(FILE* out, const ecu_cap_reader_t* rd, an_err_t* e, size_t n, double bucket_s)
+{
+    if (n == 0) return;
+    qsort(e, n, sizeof(*e), cmp_err);
+    int64_t bn = (int64_t)(bucket_s * 1e9);
+    fprintf(out, "errors by time (%g s):\n", bucket_s);
+    size_t i = 0;
+    while (i < n) {
+        int64_t b = bucket_of(rd, e[i].ts_ns, bn);
+        uint32_t cnt[ECU_CAP_PORTS][3];
+        memset(cnt, 0, sizeof(cnt));
+        for (; i < n && bucket_of(rd, e[i].ts_ns, bn) == b; i++) cnt[e[i].port][e[i].kind]++;
+        fprintf(out, "  %+-11.3f", (double)(b * bn) / 1e9);
+        for (unsigned port = 0; port < ECU_CAP_PORTS; port++) {
+            if ((cnt[port][0] | cnt[port][1] | cnt[port][2]) == 0) continue;
+            fprintf(out, " %.16s:", rd->hdr.uart[port]);
+            for (unsigned k = 0; k < 3; k++) {
+                if (cnt[port][k]) fprintf(out, " %s %u", err_name(k), (unsigned)cnt[port][k]);
+            }
+        }
+        fputc('\n', out);
+    }
+}
+
+static int run_analyze(const args_t* a)
+{
+    ecu_cap_reader_t rd;
+    if (ecu_cap_reader_open(&rd, a->analyze) < 0 || ecu_cap_map(&rd) < 0) {
+        fprintf(stderr, "%s: %s\n", a->analyze, errno == EINVAL ? "not a capture file" : strerror(errno));
+        if (rd.fd >= 0) ecu_cap_reader_close(&rd);
+        return -1;
+    }
+    // записи старше заголовка файла (ждали в кольце до его открытия) — тоже «с начала»
+    uint64_t from = a->from_s > 0 ? rd.hdr.mono_ns + (uint64_t)(a->from_s * 1e9) : 0;
+    uint64_t to = a->to_s < 0 ? UINT64_MAX : rd.hdr.mono_ns + (uint64_t)(a->to_s * 1e9);
+    uint32_t b0 = ecu_cap_seek(&rd, from);
+    uint32_t b1 = to == UINT64_MAX ? rd.blocks : ecu_cap_seek(&rd, to);
+    if (b1 < rd.blocks) b1++;   // в нём ещё записи до to
+    if (b1 < b0) b1 = b0;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned parts = a->threads > 0 ? (unsigned)a->threads : (cpus > 0 ? (unsigned)cpus : 1u);
+    if (parts > b1 - b0) parts = b1 - b0 > 0 ? b1 - b0 : 1u;
+
+    an_part_t* part = (an_part_t*)calloc(parts, sizeof(*part));
+    pthread_t* th = (pthread_t*)calloc(parts, sizeof(*th));
+    if (!part || !th) {
+        free(part);
+        free(th);
+        ecu_cap_reader_close(&rd);
+        return -1;
+    }
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int rc = 0;
+    for (unsigned i = 0; i < parts; i++) {
+        an_part_t* p = &part[i];
+        p->rd = &rd;
+        p->b0 = b0 + (uint32_t)((uint64_t)(b1 - b0) * i / parts);
+        p->b1 = b0 + (uint32_t)((uint64_t)(b1 - b0) * (i + 1) / parts);
+        p->from_ns = from;
+        p->to_ns = to;
+        if (a->csv && (p->csv = tmpfile()) == NULL) rc = -1;
+    }
+    unsigned started = 0;
+    for (; rc == 0 && started < parts; started++) {
+        if (pthread_create(&th[started], NULL, an_worker, &part[started]) != 0) rc = -1;
+    }
+    for (unsigned i = 0; i < started; i++) pthread_join(th[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (rc < 0) perror("analyze");
+
+    // Сведение частей по порядку: seq на стыках частей — как внутри части
+    an_part_t* tot = (an_part_t*)calloc(1, sizeof(*tot));
+    an_vec_t gaps = { 0 }, errs = { 0 };
+    uint64_t raw = 0;
+    for (unsigned i = 0; rc == 0 && tot && i < parts; i++) {
+        an_part_t* p = &part[i];
+        tot->records += p->records;
+        tot->bad_blocks += p->bad_blocks;
+        tot->oom |= p->oom;
+        for (unsigned k = 0; k < ECU_CAP_PORTS; k++) {
+            tot->port[k].raw_bytes += p->port[k].raw_bytes;
+            tot->port[k].frames += p->port[k].frames;
+            tot->port[k].crc += p->port[k].crc;
+            tot->port[k].framing += p->port[k].framing;
+            tot->port[k].slip += p->port[k].slip;
+            raw += p->port[k].raw_bytes;
+        }
+        for (unsigned k = 0; k < 256; k++) {
+            tot->node[k].frames += p->node[k].frames;
+            tot->node[k].bytes += p->node[k].bytes;
+            tot->type[k].frames += p->type[k].frames;
+            tot->type[k].bytes += p->type[k].bytes;
+            an_seq_t* q = &tot->seq[k];
+            const an_seq_t* ps = &p->seq[k];
+            if (!ps->seen) continue;
+            if (!q->seen) {
+                *q = *ps;
+            } else {
+                if (seq_step(q, &gaps, k, ps->first, ps->first_ns) < 0) tot->oom = 1;
+                q->gaps += ps->gaps;
+                q->missed += ps->missed;
+                q->dups += ps->dups;
+                q->back += ps->back;
+                q->last = ps->last;
+            }
+        }
+        const an_gap_t* g = (const an_gap_t*)p->gaps.p;
+        for (size_t k = 0; k < p->gaps.n; k++) tot->oom |= vec_push(&gaps, &g[k], sizeof(*g)) < 0;
+        const an_err_t* e = (const an_err_t*)p->errs.p;
+        for (size_t k = 0; k < p->errs.n; k++) tot->oom |= vec_push(&errs, &e[k], sizeof(*e)) < 0;
+    }
+
+    // CSV в stdout — отчёт в stderr
+    FILE* rep = a->csv && strcmp(a->csv, "-") == 0 ? stderr : stdout;
+    if (rc == 0 && tot) {
+        double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+        ecu_cap_block_t first, last;
+        double span = 0;
+        if (b1 > b0 && ecu_cap_read_block_hdr(&rd, b0, &first) == 0 &&
+            ecu_cap_read_block_hdr(&rd, b1 - 1, &last) == 0) {
+            span = (double)(last.last_ns - first.first_ns) / 1e9;
+        }
+        fprintf(rep, "capture %s: blocks %u-%u of %u (%u damaged), %.3f s of traffic, %llu record(s)\n", a->analyze,
+                (unsigned)b0, (unsigned)(b1 > b0 ? b1 - 1 : b0), (unsigned)rd.blocks, (unsigned)tot->bad_blocks, span,
+                (unsigned long long)tot->records);
+        fprintf(rep, "analyzed %.1f MB of UART bytes in %.3f s (%.1f MB/s file), %u thread(s)\n",
+                (double)raw / 1e6, secs, secs > 0 ? (double)((uint64_t)(b1 - b0) * rd.hdr.block_size) / 1e6 / secs : 0.0, parts);
+
+        fprintf(rep, "port     raw_bytes    frames       crc      framing  slip\n");
+        for (unsigned k = 0; k < ECU_CAP_PORTS; k++) {
+            const an_port_t* s = &tot->port[k];
+            if (!rd.hdr.uart[k][0] && s->raw_bytes == 0) continue;
+            fprintf(rep, "%-8.16s %-12llu %-12llu %-8llu %-8llu %llu\n", rd.hdr.uart[k],
+                    (unsigned long long)s->raw_bytes, (unsigned long long)s->frames, (unsigned long long)s->crc, (unsigned long long)s->framing,
+                    (unsigned long long)s->slip);
+        }
+        fprintf(rep, "node  frames       bytes        seq_gaps  missed    dups      back\n");
+        for (unsigned k = 0; k < 256; k++) {
+            if (tot->node[k].frames == 0) continue;
+            const an_seq_t* q = &tot->seq[k];
+            fprintf(rep, "%-5u %-12llu %-12llu %-9llu %-9llu %-9llu %llu\n", k, (unsigned long long)tot->node[k].frames,
+                    (unsigned long long)tot->node[k].bytes, (unsigned long long)q->gaps, (unsigned long long)q->missed,
+                    (unsigned long long)q->dups, (unsigned long long)q->back);
+        }
+        fprintf(rep, "type        frames       bytes\n");
+        for (unsigned k = 0; k < 256; k++) {
+            if (tot->type[k].frames == 0) continue;
+            fprintf(rep, "%-11s %-12llu %llu\n", msg_name(k), (unsigned long long)tot->type[k].frames,
+                    (unsigned long long)tot->type[k].bytes);
+        }
+        if (gaps.n > 0) {
+            size_t show = gaps.n < (size_t)a->gaps ? gaps.n : (size_t)a->gaps;
+            fprintf(rep, "seq gaps (%zu of %zu):\n", show, gaps.n);
+            const an_gap_t* g = (const an_gap_t*)gaps.p;
+            for (size_t k = 0; k < show; k++) {
+                fprintf(rep, "  %+-11.6f node %u: %u -> %u (%u missed)\n", rel_s(&rd, g[k].ts_ns),
+                        (unsigned)g[k].node, (unsigned)g[k].from, (unsigned)g[k].to,
+                        (unsigned)(uint16_t)(g[k].to - g[k].from - 1u));
+            }
+        }
+        an_timeline(rep, &rd, (an_err_t*)errs.p, errs.n, a->bucket_s);
+        if (tot->oom) fprintf(stderr, "gw_dump: out of memory, gap/error lists incomplete\n");
+    }
+
+    if (rc == 0 && a->csv) {
+        FILE* out = strcmp(a->csv, "-") == 0 ? stdout : fopen(a->csv, "w");
+        if (!out) {
+            fprintf(stderr, "%s: %s\n", a->csv, strerror(errno));
+            rc = -1;
+        } else {
+            fprintf(out, "time_s,port,src,seq,uptime_ms,status_flags,error_code,voltage,current,temperature,rpm\n");
+            char buf[65536];
+            for (unsigned i = 0; i < parts; i++) {
+                rewind(part[i].csv);
+                size_t n;
+                while ((n = fread(buf, 1, sizeof(buf), part[i].csv)) > 0) fwrite(buf, 1, n, out);
+            }
+            if (out != stdout && fclose(out) != 0) rc = -1;
+        }
+    }
+
+    for (unsigned i = 0; i < parts; i++) {
+        if (part[i].csv) fclose(part[i].csv);
+        free(part[i].gaps.p);
+        free(part[i].errs.p);
+    }
+    free(gaps.p);
+    free(errs.p);
+    free(tot);
+    free(part);
+    free(th);
+    ecu_cap_reader_close(&rd);
+    return rc;
+}
+
+// ---- --record: tap -> capture ----
+
+static int record_open(const args_t* a, ecu_cap_t* cap)
+{
+    if (ecu_cap_open(cap, a->record, 64, (uint64_t)a->max_mb * 1024u * 1024u, a->max_sec, a->files) < 0) {
+        fprintf(stderr, "%s: %s\n", a->record, strerror(errno));
+        return -1;
+    }
+    // имена UART в заголовке нужны gw_replay; tap их не передаёт
+    if (a->uarts) {
+        char names[256];
+        snprintf(names, sizeof(names), "%s", a->uarts);
+        unsigned i = 0;
+        char* save = NULL;
+        for (char* n = strtok_r(names, ",", &save); n && i < ECU_CAP_PORTS; n = strtok_r(NULL, ",", &save)) {
+            ecu_cap_set_uart(cap, i++, n);
+        }
+    } else {
+        for (unsigned i = 0; i < DUMP_REC_UARTS; i++) {
+            char n[8];
+            snprintf(n, sizeof(n), "U%u", i);
+            ecu_cap_set_uart(cap, i, n);
+        }
+    }
+    return 0;
+}
+
+static void print_usage(const char* argv0)
+{
+    printf("Usage: %s [--tap PATH | --read FILE | --analyze FILE.ecap] [options]\n", argv0);
+    printf("  --tap PATH     tap socket of ecu_gw (default %s)\n", DUMP_TAP_DEFAULT);
+    printf("  --read FILE    parse saved records (--write, ecu_gw -trace or .ecap capture), '-' = stdin\n");
+    printf("  --from S       capture: start S seconds after the file start\n");
+    printf("  --to S         capture: stop S seconds after the file start\n");
+    printf("  --write FILE   save records to FILE instead of printing\n");
+    printf("  --raw          raw UART/TCP bytes only\n");
+    printf("  --frames       decoded frames only\n");
+    printf("  --port N       UART index / client slot N only\n");
+    printf("  --hex          print frame bytes too\n");
+    printf("  --quiet        print summary only\n");
+    printf("  --record PREFIX  save the tap stream to capture files PREFIX-YYYYMMDD-HHMMSS.ecap\n");
+    printf("    --uarts A,B    UART names for the capture header (default U0..U%d)\n", DUMP_REC_UARTS - 1);
+    printf("    --max-mb N, --max-sec N, --files N   rotation as in [capture]\n");
+    printf("  --analyze FILE   statistics of a whole capture (with --from/--to: of a window)\n");
+    printf("    --threads N    worker threads (default: CPUs)\n");
+    printf("    --bucket S     error timeline step, seconds (default 1)\n");
+    printf("    --csv FILE     decoded telemetry v1 to CSV ('-' = stdout)\n");
+    printf("    --gaps N       sequence gaps to list (default %d)\n", DUMP_GAPS_SHOW);
+}
+
+static int parse_uint(const char* s, unsigned* out)
+{
+    char* end = NULL;
+    unsigned long v = strtoul(s, &end, 10);
+    if (!end || *end != '\0' || *s == '-' || v > 0xFFFFFFFFul) return -1;
+    *out = (unsigned)v;
+    return 0;
+}
+
+static int parse_args(int argc, char** argv, args_t* a)
+{
+    memset(a, 0, sizeof(*a));
+    a->tap = DUMP_TAP_DEFAULT;
+    a->kinds = ECU_LOG_KINDS_ALL;
+    a->port = -1;
+    a->to_s = -1;
+    a->bucket_s = 1.0;
+    a->gaps = DUMP_GAPS_SHOW;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tap") == 0 && i + 1 < argc) {
+            a->tap = argv[++i];
+        } else if (strcmp(argv[i], "--read") == 0 && i + 1 < argc) {
+            a->read_path = argv[++i];
+        } else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+            a->write_path = argv[++i];
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            a->kinds = ECU_LOG_KINDS_RAW;
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            a->kinds = ECU_LOG_KINDS_FRAMES;
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            char* end = NULL;
+            long v = strtol(argv[++i], &end, 10);
+            if (!end || *end != '\0' || v < 0 || v >= (long)ECU_LOG_PORT_NONE) return -1;
+            a->port = (int)v;
+        } else if ((strcmp(argv[i], "--from") == 0 || strcmp(argv[i], "--to") == 0) && i + 1 < argc) {
+            char* end = NULL;
+            double v = strtod(argv[i + 1], &end);
+            if (!end || *end != '\0' || v < 0) return -1;
+            if (argv[i][2] == 'f') a->from_s = v;
+            else a->to_s = v;
+            i++;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            a->record = argv[++i];
+        } else if (strcmp(argv[i], "--uarts") == 0 && i + 1 < argc) {
+            a->uarts = argv[++i];
+        } else if (strcmp(argv[i], "--max-mb") == 0 && i + 1 < argc) {
+            if (parse_uint(argv[++i], &a->max_mb) < 0) return -1;
+        } else if (strcmp(argv[i], "--max-sec") == 0 && i + 1 < argc) {
+            if (parse_uint(argv[++i], &a->max_sec) < 0) return -1;
+        } else if (strcmp(argv[i], "--files") == 0 && i + 1 < argc) {
+            if (parse_uint(argv[++i], &a->files) < 0) return -1;
+        } else if (strcmp(argv[i], "--analyze") == 0 && i + 1 < argc) {
+            a->analyze = argv[++i];
+        } else if ((strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "--gaps") == 0) && i + 1 < argc) {
+            unsigned v;
+            if (parse_uint(argv[i + 1], &v) < 0 || v > 100000) return -1;
+            if (argv[i][2] == 't') a->threads = (int)v;
+            else a->gaps = (int)v;
+            i++;
+        } else if (strcmp(argv[i], "--bucket") == 0 && i + 1 < argc) {
+            char* end = NULL;
+            a->bucket_s = strtod(argv[++i], &end);
+            if (!end || *end != '\0' || a->bucket_s < 0.001) return -1;
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            a->csv = argv[++i];
+        } else if (strcmp(argv[i], "--hex") == 0) {
+            a->hex = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            a->quiet = 1;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    args_t a;
+    if (parse_args(argc, argv, &a) != 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // Ctrl-C прерывает recv (без SA_RESTART) — итог печатается
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (a.analyze) return run_analyze(&a) < 0 ? 1 : 0;
+
+    dump_stat_t st;
+    memset(&st, 0, sizeof(st));
+    static ecu_cap_t cap;
+    if (a.record) {
+        if (a.read_path || record_open(&a, &cap) < 0) {
+            if (a.read_path) print_usage(argv[0]);
+            return 2;
+        }
+        st.cap = &cap;
+    } else if (a.write_path) {
+        st.out = strcmp(a.write_path, "-") == 0 ? stdout : fopen(a.write_path, "ab");
+        if (!st.out) {
+            fprintf(stderr, "%s: %s\n", a.write_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    int rc = a.read_path ? run_file(&a, &st) : run_tap(&a, &st);
+
+    if (st.out && st.out != stdout) fclose(st.out);
+    if (st.cap) {
+        ecu_cap_close(st.cap);
+        fprintf(stderr, "gw_dump: capture %u file(s), last %s\n", (unsigned)atomic_load(&cap.files), cap.path);
+    }
+    fprintf(stderr, "gw_dump: %llu record(s), %llu byte(s), %llu lost\n", (unsigned long long)st.records,
+            (unsigned long long)st.bytes, (unsigned long long)st.lost);
+    return rc < 0 ? 1 : 0;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -176,6 +177,89 @@ static int read_exact_timeout(int fd, uint8_t *buf, size_t len, uint32_t timeout
     return 0;
 }
 
+/* termios2/BOTHER: arbitrary rates on Linux. Local copy of the kernel struct
+ * because <asm/termbits.h> clashes with <termios.h> (arm/arm64/x86 layout). */
+#if defined(__linux__) && (defined(__arm__) || defined(__aarch64__) || defined(__i386__) || defined(__x86_64__))
+#define HAVE_TERMIOS2 1
+
+typedef struct {
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+} termios2_t;
+
+#define T2_TCGETS2 _IOR('T', 0x2A, termios2_t)
+#define T2_TCSETS2 _IOW('T', 0x2B, termios2_t)
+
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT 16
+#endif
+#endif
+
+static speed_t baud_to_speed(int baud)
+{
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+#ifdef B1000000
+        case 1000000: return B1000000;
+#endif
+        default: return 0;
+    }
+}
+
+static int set_speed_other(int fd, int baud)
+{
+#ifdef HAVE_TERMIOS2
+    termios2_t t2;
+    if (baud <= 0 || ioctl(fd, T2_TCGETS2, &t2) != 0) {
+        return -1;
+    }
+    t2.c_cflag &= ~(tcflag_t)(CBAUD | (CBAUD << IBSHIFT));
+    t2.c_cflag |= (tcflag_t)(BOTHER | (BOTHER << IBSHIFT));
+    t2.c_ispeed = (speed_t)baud;
+    t2.c_ospeed = (speed_t)baud;
+    return ioctl(fd, T2_TCSETS2, &t2) == 0 ? 0 : -1;
+#else
+    (void)fd;
+    (void)baud;
+    errno = EINVAL;
+    return -1;
+#endif
+}
+
+/* Rate the driver actually programmed (it may round or clamp the request). */
+static int get_actual_speed(int fd, int requested)
+{
+#ifdef HAVE_TERMIOS2
+    termios2_t t2;
+    if (ioctl(fd, T2_TCGETS2, &t2) == 0 && t2.c_ospeed > 0) {
+        return (int)t2.c_ospeed;
+    }
+#else
+    (void)fd;
+#endif
+    return requested;
+}
+
 static int set_serial_raw(int fd, int baud)
 {
     struct termios tio;
@@ -192,27 +276,24 @@ static int set_serial_raw(int fd, int baud)
     tio.c_cflag &= ~CRTSCTS;
     tio.c_iflag &= ~(IXON | IXOFF | IXANY);
 
-    speed_t spd = B115200;
-    switch (baud) {
-        case 115200: spd = B115200; break;
-        case 230400: spd = B230400; break;
-#ifdef B460800
-        case 460800: spd = B460800; break;
-#endif
-#ifdef B921600
-        case 921600: spd = B921600; break;
-#endif
-        default:
+    speed_t spd = baud_to_speed(baud);
+    if (spd != 0) {
+        if (cfsetispeed(&tio, spd) != 0 || cfsetospeed(&tio, spd) != 0) {
             return -1;
+        }
     }
-
-    if (cfsetispeed(&tio, spd) != 0 || cfsetospeed(&tio, spd) != 0) {
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
         return -1;
     }
-    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    if (spd == 0 && set_speed_other(fd, baud) != 0) {
         return -1;
     }
     tcflush(fd, TCIOFLUSH);
+
+    int actual = get_actual_speed(fd, baud);
+    if (actual != baud) {
+        fprintf(stderr, "serial: requested %d baud, driver set %d\n", baud, actual);
+    }
     return 0;
 }
 
@@ -467,7 +548,7 @@ static void print_usage(const char *argv0)
 {
     printf("Usage: %s --port /dev/ttyS1 [options]\n", argv0);
     printf("Options:\n");
-    printf("  --baud <n>           (default 115200)\n");
+    printf("  --baud <n>           (default 115200, any rate incl. 460800/921600)\n");
     printf("  --firmware <path>    app image file\n");
     printf("  --chunk <n>          write chunk size (default 1024)\n");
     printf("  --boot-wait-ms <n>   wait BL after ENTER_BOOT (default 5000)\n");
@@ -0,0 +1,521 @@
+// Системных вызовов ecu_gw на пересланный кадр: epoll против io_uring.
+//
+// ecu_gw запускается под ptrace на pty вместо UART; отдельный поток гонит трафик
+// UART -> TCP (кадр с pty рассылается всем клиентам) и TCP -> UART (COMMAND узлу),
+// каждый раз дожидаясь доставки, и считаются входы в системные вызовы всех потоков шлюза.
+//
+//   bench_syscalls [-gw PATH] [-backend epoll|io_uring|both] [-frames N] [-clients K]
+//                  [-uarts U] [-burst B] [-threads 0|1] [-v]
+//
+// -burst B — кадров одной записью в pty (B > 1 моделирует пачки, 1 — кадры поодиночке).
+
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define BENCH_UARTS_MAX   8
+#define BENCH_CLIENTS_MAX 32
+#define BENCH_NR_MAX      1024
+
+enum { PHASE_IDLE = 0, PHASE_UART_NET, PHASE_NET_UART, PHASE_COUNT };
+
+typedef struct {
+    const char* gw_path;
+    const char* backend;
+    int         frames;
+    int         clients;
+    int         uarts;
+    int         burst;
+    int         threads;
+    int         verbose;
+    uint16_t    port;
+} bench_opts_t;
+
+typedef struct {
+    const bench_opts_t* o;
+    int       pty_master[BENCH_UARTS_MAX];
+    char      pty_name[BENCH_UARTS_MAX][64];
+    pid_t     gw_pid;
+
+    atomic_int phase;
+    atomic_int done;
+    int        failed;
+
+    uint64_t  total[PHASE_COUNT];
+    uint64_t  by_nr[PHASE_COUNT][BENCH_NR_MAX];
+    int       frames_done[PHASE_COUNT];
+    double    seconds[PHASE_COUNT];
+} bench_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static const char* sys_name(long nr)
+{
+    switch (nr) {
+#ifdef SYS_read
+    case SYS_read: return "read";
+#endif
+#ifdef SYS_write
+    case SYS_write: return "write";
+#endif
+#ifdef SYS_recvfrom
+    case SYS_recvfrom: return "recvfrom";
+#endif
+#ifdef SYS_sendto
+    case SYS_sendto: return "sendto";
+#endif
+#ifdef SYS_epoll_wait
+    case SYS_epoll_wait: return "epoll_wait";
+#endif
+#ifdef SYS_epoll_pwait
+    case SYS_epoll_pwait: return "epoll_pwait";
+#endif
+#ifdef SYS_epoll_ctl
+    case SYS_epoll_ctl: return "epoll_ctl";
+#endif
+#ifdef SYS_io_uring_enter
+    case SYS_io_uring_enter: return "io_uring_enter";
+#endif
+#ifdef SYS_clock_gettime
+    case SYS_clock_gettime: return "clock_gettime";
+#endif
+#ifdef SYS_futex
+    case SYS_futex: return "futex";
+#endif
+#ifdef SYS_accept
+    case SYS_accept: return "accept";
+#endif
+#ifdef SYS_accept4
+    case SYS_accept4: return "accept4";
+#endif
+#ifdef SYS_fcntl
+    case SYS_fcntl: return "fcntl";
+#endif
+#ifdef SYS_ioctl
+    case SYS_ioctl: return "ioctl";
+#endif
+#ifdef SYS_setsockopt
+    case SYS_setsockopt: return "setsockopt";
+#endif
+#ifdef SYS_getpeername
+    case SYS_getpeername: return "getpeername";
+#endif
+    default: return NULL;
+    }
+}
+
+// ---- трафик ----
+
+static int open_pty(char* name, size_t name_len)
+{
+    int m = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m < 0 || grantpt(m) < 0 || unlockpt(m) < 0) return -1;
+    const char* sn = ptsname(m);
+    if (!sn) return -1;
+    snprintf(name, name_len, "%s", sn);
+
+    struct termios t;
+    if (tcgetattr(m, &t) == 0) {
+        cfmakeraw(&t);
+        tcsetattr(m, TCSANOW, &t);
+    }
+    return m;
+}
+
+static size_t make_slip(uint8_t msg_type, uint8_t src, uint8_t dst, uint16_t seq, uint8_t* out, size_t out_cap)
+{
+    uint8_t payload[24];
+    memset(payload, 0x5A, sizeof(payload));
+
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = msg_type;
+    h.src = src;
+    h.dst = dst;
+    h.seq = seq;
+    h.payload_len = sizeof(payload);
+
+    uint8_t frame[ECU_MAX_FRAME_SIZE];
+    size_t len = ecu_frame_pack(&h, payload, frame, sizeof(frame));
+    if (len == 0) return 0;
+    if (!out) return len;
+    return slip_encode(frame, len, out, out_cap);
+}
+
+static int tcp_connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    a.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+// Дочитать из fd ровно n байт (или ошибка по таймауту)
+static int read_exact(int fd, size_t n, int timeout_ms)
+{
+    uint8_t buf[65536];
+    while (n > 0) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, timeout_ms) <= 0) return -1;
+        ssize_t r = read(fd, buf, n < sizeof(buf) ? n : sizeof(buf));
+        if (r <= 0) return -1;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static void* traffic_main(void* arg)
+{
+    bench_t* b = (bench_t*)arg;
+    const bench_opts_t* o = b->o;
+    int cl[BENCH_CLIENTS_MAX];
+    int ncl = 0;
+
+    // дождаться listen-сокета шлюза
+    for (int tries = 0; tries < 100 && ncl == 0; tries++) {
+        usleep(50000);
+        int fd = tcp_connect(o->port);
+        if (fd >= 0) cl[ncl++] = fd;
+    }
+    while (ncl > 0 && ncl < o->clients) {
+        int fd = tcp_connect(o->port);
+        if (fd < 0) break;
+        cl[ncl++] = fd;
+    }
+    if (ncl < o->clients) {
+        fprintf(stderr, "bench: cannot connect to ecu_gw on :%u\n", (unsigned)o->port);
+        b->failed = 1;
+        goto out;
+    }
+
+    uint8_t slip[ECU_MAX_FRAME_SIZE * 2 + 2];
+    size_t frame_len = make_slip(ECU_MSG_TELEMETRY, 1, ECU_NODE_PC, 0, NULL, 0);
+    size_t wire_len = 4 + frame_len; // TCP: u32 длина + кадр
+
+    // прогрев: шлюз выучит узлы (HELLO от каждого UART), клиенты точно зарегистрированы
+    for (int u = 0; u < o->uarts; u++) {
+        size_t n = make_slip(ECU_MSG_HELLO, (uint8_t)(u + 1), ECU_NODE_GW, 1, slip, sizeof(slip));
+        if (write(b->pty_master[u], slip, n) != (ssize_t)n) b->failed = 1;
+        for (int k = 0; k < ncl; k++) {
+            if (read_exact(cl[k], wire_len, 2000) < 0) b->failed = 1;
+        }
+    }
+    if (b->failed) {
+        fprintf(stderr, "bench: warm-up failed\n");
+        goto out;
+    }
+    usleep(200000);
+
+    // 1) UART -> TCP: burst кадров одной записью в pty, ждём их у всех клиентов
+    double t0 = now_s();
+    atomic_store(&b->phase, PHASE_UART_NET);
+    int sent = 0;
+    uint8_t batch[(ECU_MAX_FRAME_SIZE * 2 + 2) * 16];
+    while (sent < o->frames) {
+        int u = (sent / o->burst) % o->uarts;
+        size_t off = 0;
+        int nb = 0;
+        for (; nb < o->burst && sent + nb < o->frames; nb++) {
+            off += make_slip(ECU_MSG_TELEMETRY, (uint8_t)(u + 1), ECU_NODE_PC, (uint16_t)(sent + nb),
+                             batch + off, sizeof(batch) - off);
+        }
+        if (write(b->pty_master[u], batch, off) != (ssize_t)off) {
+            b->failed = 1;
+            break;
+        }
+        for (int k = 0; k < ncl; k++) {
+            if (read_exact(cl[k], wire_len * (size_t)nb, 2000) < 0) {
+                fprintf(stderr, "bench: client %d: frames lost after %d\n", k, sent);
+                b->failed = 1;
+                break;
+            }
+        }
+        if (b->failed) break;
+        sent += nb;
+    }
+    atomic_store(&b->phase, PHASE_IDLE);
+    b->frames_done[PHASE_UART_NET] = sent;
+    b->seconds[PHASE_UART_NET] = now_s() - t0;
+    usleep(100000);
+
+    // 2) TCP -> UART: COMMAND узлу u+1 от клиента k, ждём SLIP кадр на pty
+    t0 = now_s();
+    atomic_store(&b->phase, PHASE_NET_UART);
+    sent = 0;
+    while (!b->failed && sent < o->frames) {
+        int u = (sent / o->burst) % o->uarts;
+        int k = (sent / o->burst) % ncl;
+        uint8_t tx[(4 + ECU_MAX_FRAME_SIZE) * 16];
+        size_t off = 0, slip_total = 0;
+        int nb = 0;
+        for (; nb < o->burst && sent + nb < o->frames; nb++) {
+            uint8_t frame[ECU_MAX_FRAME_SIZE];
+            ecu_hdr_t h;
+            memset(&h, 0, sizeof(h));
+            h.magic = ECU_MAGIC;
+            h.version = ECU_VERSION;
+            h.msg_type = ECU_MSG_COMMAND;
+            h.src = ECU_NODE_PC;
+            h.dst = (uint8_t)(u + 1);
+            h.seq = (uint16_t)(sent + nb);
+            uint8_t payload[4] = { 1, 0, 0, 0 };
+            h.payload_len = sizeof(payload);
+            size_t fl = ecu_frame_pack(&h, payload, frame, sizeof(frame));
+            uint32_t L = (uint32_t)fl;
+            memcpy(tx + off, &L, 4);
+            memcpy(tx + off + 4, frame, fl);
+            off += 4 + fl;
+            slip_total += slip_encode(frame, fl, slip, sizeof(slip));
+        }
+        if (write(cl[k], tx, off) != (ssize_t)off || read_exact(b->pty_master[u], slip_total, 2000) < 0) {
+            fprintf(stderr, "bench: uart %d: frames lost after %d\n", u, sent);
+            b->failed = 1;
+            break;
+        }
+        sent += nb;
+    }
+    atomic_store(&b->phase, PHASE_IDLE);
+    b->frames_done[PHASE_NET_UART] = sent;
+    b->seconds[PHASE_NET_UART] = now_s() - t0;
+
+out:
+    for (int k = 0; k < ncl; k++) close(cl[k]);
+    atomic_store(&b->done, 1);
+    kill(b->gw_pid, SIGTERM);
+    return NULL;
+}
+
+// ---- ptrace ----
+
+static int write_config(const bench_t* b, char* path, size_t path_len)
+{
+    const bench_opts_t* o = b->o;
+    snprintf(path, path_len, "/tmp/bench_gw_%d.conf", (int)getpid());
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "[gateway]\nthreads = %d\n", o->threads);
+    if (strcmp(o->backend, "epoll") != 0) fprintf(f, "backend = %s\n", o->backend);
+    fprintf(f, "[net]\nport = %u\nmax_clients = %d\n", (unsigned)o->port, o->clients + 1);
+    for (int u = 0; u < o->uarts; u++) {
+        fprintf(f, "[uart U%d]\ndev = %s\nnodes = %d\n", u, b->pty_name[u], u + 1);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int run_traced(bench_t* b, const char* conf)
+{
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        if (!b->o->verbose) {
+            int nul = open("/dev/null", O_WRONLY);
+            if (nul >= 0) dup2(nul, STDERR_FILENO);
+        }
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        execl(b->o->gw_path, b->o->gw_path, "-config", conf, (char*)NULL);
+        _exit(127);
+    }
+    b->gw_pid = pid;
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) return -1;
+    ptrace(PTRACE_SETOPTIONS, pid, NULL,
+           (void*)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL));
+    ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, traffic_main, b) != 0) {
+        kill(pid, SIGKILL);
+        return -1;
+    }
+
+    // все потоки шлюза: считаем входы в системные вызовы текущей фазы
+    for (;;) {
+        pid_t t = waitpid(-1, &status, __WALL);
+        if (t < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            if (t == pid) break;
+            continue;
+        }
+        if (!WIFSTOPPED(status)) continue;
+
+        int sig = WSTOPSIG(status);
+        int deliver = 0;
+        if (sig == (SIGTRAP | 0x80)) {
+            int phase = atomic_load(&b->phase);
+#ifdef PTRACE_GET_SYSCALL_INFO
+            struct __ptrace_syscall_info si;
+            if (phase != PHASE_IDLE &&
+                ptrace(PTRACE_GET_SYSCALL_INFO, t, (void*)sizeof(si), &si) > 0 &&
+                si.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                b->total[phase]++;
+                if (si.entry.nr < BENCH_NR_MAX) b->by_nr[phase][si.entry.nr]++;
+            }
+#else
+            // без разбивки: вход и выход — две остановки
+            if (phase != PHASE_IDLE) b->total[phase]++;
+#endif
+        } else if (sig == SIGTRAP || sig == SIGSTOP) {
+            // событие clone / остановка нового потока
+        } else {
+            deliver = sig;
+        }
+        ptrace(PTRACE_SYSCALL, t, NULL, (void*)(long)deliver);
+    }
+
+    pthread_join(th, NULL);
+#ifndef PTRACE_GET_SYSCALL_INFO
+    for (int p = 0; p < PHASE_COUNT; p++) b->total[p] /= 2;
+#endif
+    return b->failed ? -1 : 0;
+}
+
+static void report(const bench_t* b)
+{
+    static const char* names[PHASE_COUNT] = { "", "UART->TCP", "TCP->UART" };
+    const bench_opts_t* o = b->o;
+    for (int p = PHASE_UART_NET; p < PHASE_COUNT; p++) {
+        int n = b->frames_done[p];
+        if (n == 0) continue;
+        printf("%-9s %-8s %6d frames  %8llu syscalls  %6.2f per frame  (%.0f frames/s under ptrace)\n",
+               o->backend, names[p], n, (unsigned long long)b->total[p], (double)b->total[p] / n,
+               b->seconds[p] > 0 ? n / b->seconds[p] : 0.0);
+        for (int nr = 0; nr < BENCH_NR_MAX; nr++) {
+            // ioctl (TIOCOUTQ очереди драйвера UART) — всегда, и нулём
+#ifdef SYS_ioctl
+            if (b->by_nr[p][nr] == 0 && nr != SYS_ioctl) continue;
+#else
+            if (b->by_nr[p][nr] == 0) continue;
+#endif
+            const char* sn = sys_name(nr);
+            char tmp[16];
+            if (!sn) {
+                snprintf(tmp, sizeof(tmp), "nr %d", nr);
+                sn = tmp;
+            }
+            printf("            %-16s %6.2f\n", sn, (double)b->by_nr[p][nr] / n);
+        }
+    }
+}
+
+static int bench_one(bench_opts_t* o, const char* backend)
+{
+    static bench_t b;
+    memset(&b, 0, sizeof(b));
+    bench_opts_t oo = *o;
+    oo.backend = backend;
+    b.o = &oo;
+
+    for (int u = 0; u < o->uarts; u++) {
+        b.pty_master[u] = open_pty(b.pty_name[u], sizeof(b.pty_name[u]));
+        if (b.pty_master[u] < 0) {
+            perror("pty");
+            return -1;
+        }
+    }
+
+    char conf[128];
+    int rc = write_config(&b, conf, sizeof(conf));
+    if (rc == 0) rc = run_traced(&b, conf);
+    if (rc == 0) report(&b);
+    else fprintf(stderr, "bench: %s failed\n", backend);
+
+    unlink(conf);
+    for (int u = 0; u < o->uarts; u++) close(b.pty_master[u]);
+    o->port++;
+    return rc;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-gw PATH] [-backend epoll|io_uring|both] [-frames N] [-clients K] "
+                    "[-uarts U] [-burst B] [-threads 0|1] [-v]\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    bench_opts_t o;
+    memset(&o, 0, sizeof(o));
+    o.gw_path = "./ecu_gw";
+    o.backend = "both";
+    o.frames = 2000;
+    o.clients = 4;
+    o.uarts = 3;
+    o.burst = 1;
+    o.port = 19600;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "-v") == 0) { o.verbose = 1; continue; }
+        if (!v) { usage(argv[0]); return 2; }
+        if (strcmp(a, "-gw") == 0) o.gw_path = v;
+        else if (strcmp(a, "-backend") == 0) o.backend = v;
+        else if (strcmp(a, "-frames") == 0) o.frames = atoi(v);
+        else if (strcmp(a, "-clients") == 0) o.clients = atoi(v);
+        else if (strcmp(a, "-uarts") == 0) o.uarts = atoi(v);
+        else if (strcmp(a, "-burst") == 0) o.burst = atoi(v);
+        else if (strcmp(a, "-threads") == 0) o.threads = atoi(v);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (o.frames <= 0 || o.clients <= 0 || o.clients > BENCH_CLIENTS_MAX ||
+        o.uarts <= 0 || o.uarts > BENCH_UARTS_MAX || o.burst <= 0 || o.burst > 16) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("ecu_gw %s: %d UART(s), %d client(s), burst %d, threads %d\n",
+           o.gw_path, o.uarts, o.clients, o.burst, o.threads);
+    int rc = 0;
+    if (strcmp(o.backend, "both") == 0) {
+        rc |= bench_one(&o, "epoll");
+        rc |= bench_one(&o, "io_uring");
+    } else {
+        rc = bench_one(&o, o.backend);
+    }
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,631 @@
+// Эмулятор узлов Arduino Due на pty: нагрузка и длительные прогоны ecu_gw без плат.
+//
+// Каждый узел — пара pty; шлюз открывает ведомую сторону как обычный UART (dev = путь).
+// Узел говорит по protocol_v1_0.md: HELLO при старте (до ACK — повтор раз в -hello мс), TELEMETRY с частотой -rate (max — сколько
+// примет линия), HEARTBEAT, на COMMAND с ACK_REQUIRED — ACK с задержкой/потерей (-ack_*),
+// -corrupt портит исходящие кадры (CRC). -baud ограничивает поток узла скоростью линии
+// (10 бит на байт), без него pty отдаёт столько, сколько шлюз успевает читать.
+//
+//   due_emu [-nodes N] [-first ID] [-link PATTERN] [-conf FILE] [-rate HZ|max] [-baud B] [-hb MS]
+//           [-hello MS] [-ack_delay MS] [-ack_jitter MS] [-ack_loss PCT] [-corrupt PCT] [-time SEC]
+//           [-stats SEC] [-seed S] [-v]
+//
+// -link /tmp/ttyDue%d — символические ссылки на pty (номер — id узла), их и указывать в dev;
+// -conf FILE — готовые секции [uart dueN] для шлюза (dev и nodes).
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+#include "ecu/ecu_telemetry.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EMU_NODES_MAX 8              // как GW_UART_MAX: узел на UART
+#define EMU_PEND      (64 * 1024)    // очередь передачи узла (буфер USART + кольцо прошивки)
+#define EMU_LOW       1024           // -rate max: досыпать кадры, пока в очереди меньше
+#define EMU_ACKS      64             // ACK в ожидании задержки
+#define EMU_FW        0x00010000u    // fw_version в HELLO
+#define EMU_BOOT_MS   200            // ENTER_BOOT: «перезагрузка» до нового HELLO
+
+typedef struct {
+    int         nodes;
+    int         first;
+    const char* link;
+    const char* conf;
+    double      rate;        // Гц на узел, < 0 = max
+    unsigned    baud;        // 0 = без ограничения
+    unsigned    hb_ms;
+    unsigned    hello_ms;    // повтор HELLO до ACK (0 = один раз)
+    unsigned    ack_delay_ms;
+    unsigned    ack_jitter_ms;
+    double      ack_loss;    // доля 0..1
+    double      corrupt;     // доля 0..1
+    double      time_s;
+    double      stats_s;
+    unsigned    seed;
+    int         verbose;
+} emu_opts_t;
+
+typedef struct {
+    uint64_t due_ns;
+    uint16_t seq;
+    uint16_t status;
+    uint8_t  dst;
+} emu_ack_t;
+
+typedef struct {
+    uint8_t   id;
+    int       master;
+    int       slave;                      // держим открытой: без неё master получает EIO/HUP
+    char      pts[64];
+    char      link[128];
+    slip_rx_t rx;
+    uint8_t   rx_buf[ECU_MAX_FRAME_SIZE];
+    uint8_t   pend[EMU_PEND];
+    size_t    pend_len;
+    double    tokens;                     // -baud: байт можно отдать
+    uint64_t  tokens_ns;
+
+    uint16_t  seq;
+    uint64_t  boot_ns;                    // uptime_ms считается от него
+    uint64_t  hello_ns;                   // следующий HELLO (0 = подтверждён или без повторов)
+    uint16_t  hello_seq;
+    int       hello_acked;
+    uint64_t  reboot_ns;                  // ENTER_BOOT: молчит до этого момента (0 = работает)
+    uint64_t  next_tel_ns;
+    uint64_t  next_hb_ns;
+    uint16_t  status_flags;               // bit0 ARM
+    uint16_t  error_code;
+    uint8_t   mode;
+    float     rpm;
+    float     rpm_target;
+    float     current_limit;
+    emu_ack_t acks[EMU_ACKS];
+    unsigned  ack_head;
+    unsigned  ack_n;
+
+    // счётчики
+    uint64_t  tx_frames[9];               // по msg_type
+    uint64_t  tx_bytes;                   // байт SLIP отдано в pty
+    uint64_t  late;                       // отсчётов TELEMETRY пропущено: очередь полна
+    uint64_t  corrupted;
+    uint64_t  acks_lost;
+    uint64_t  acks_over;                  // очередь ACK полна — ответ сразу
+    uint64_t  rx_frames[9];
+    uint64_t  rx_bad;                     // CRC/заголовок
+    uint64_t  rx_slip;                    // ошибки SLIP
+    uint64_t  rx_other;                   // кадр другому узлу
+    uint64_t  cmds_unknown;
+} emu_node_t;
+
+typedef struct {
+    const emu_opts_t* o;
+    emu_node_t node[EMU_NODES_MAX];
+    uint64_t   t0_ns;
+    uint64_t   rnd;
+} emu_t;
+
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*: воспроизводимо по -seed
+static uint32_t rnd_u32(emu_t* e)
+{
+    e->rnd ^= e->rnd >> 12;
+    e->rnd ^= e->rnd << 25;
+    e->rnd ^= e->rnd >> 27;
+    return (uint32_t)((e->rnd * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static double rnd_unit(emu_t* e)
+{
+    return (double)rnd_u32(e) / 4294967296.0;
+}
+
+// ---- передача ----
+
+static void node_flush(emu_t* e, emu_node_t* n, uint64_t now)
+{
+    size_t lim = n->pend_len;
+    if (e->o->baud) {
+        // линия: baud / 10 байт/с, запас не больше 10 мс — иначе после простоя пачка
+        double rate = (double)e->o->baud / 10.0;
+        n->tokens += (double)(now - n->tokens_ns) * rate / 1e9;
+        n->tokens_ns = now;
+        double burst = rate / 100.0 > 64.0 ? rate / 100.0 : 64.0;
+        if (n->tokens > burst) n->tokens = burst;
+        if (n->tokens < 1.0) return;
+        if ((double)lim > n->tokens) lim = (size_t)n->tokens;
+    }
+    size_t done = 0;
+    while (done < lim) {
+        ssize_t w = write(n->master, n->pend + done, lim - done);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        done += (size_t)w;
+    }
+    if (done == 0) return;
+    memmove(n->pend, n->pend + done, n->pend_len - done);
+    n->pend_len -= done;
+    n->tx_bytes += done;
+    if (e->o->baud) n->tokens -= (double)done;
+}
+
+// Кадр в очередь узла. 0 = OK, -1 = очередь полна (кадр не отправлен)
+static int node_send(emu_t* e, emu_node_t* n, uint8_t type, uint8_t dst, uint16_t flags, const void* pl,
+                     uint16_t pl_len)
+{
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = type;
+    h.src = n->id;
+    h.dst = dst;
+    h.seq = n->seq;
+    h.flags = flags;
+    h.payload_len = pl_len;
+
+    uint8_t f[ECU_MAX_FRAME_SIZE];
+    size_t len = ecu_frame_pack(&h, (const uint8_t*)pl, f, sizeof(f));
+    if (len == 0 || n->pend_len + 2 * len + 2 > sizeof(n->pend)) return -1;
+    if (e->o->corrupt > 0 && rnd_unit(e) < e->o->corrupt) {
+        f[rnd_u32(e) % len] ^= (uint8_t)(1u << (rnd_u32(e) & 7));
+        n->corrupted++;
+    }
+    n->pend_len += slip_encode(f, len, n->pend + n->pend_len, sizeof(n->pend) - n->pend_len);
+    n->seq++;
+    if (type < 9) n->tx_frames[type]++;
+    return 0;
+}
+
+static void send_hello(emu_t* e, emu_node_t* n)
+{
+    ecu_hello_v1_t hp;
+    hp.node_id = n->id;
+    hp.fw_version = EMU_FW;
+    hp.build_time = (uint32_t)time(NULL);
+    hp.capabilities_mask = 0;
+    (void)node_send(e, n, ECU_MSG_HELLO, ECU_NODE_GW, ECU_F_ACK_REQUIRED, &hp, sizeof(hp));
+}
+
+static int send_telemetry(emu_t* e, emu_node_t* n, uint64_t now)
+{
+    // обороты тянутся к цели, ток — от оборотов, температура — медленно за током
+    float step = n->rpm_target - n->rpm;
+    n->rpm += step * 0.02f;
+    ecu_telemetry_v1_t t;
+    t.uptime_ms = (uint32_t)((now - n->boot_ns) / 1000000u);
+    t.status_flags = n->status_flags;
+    t.error_code = n->error_code;
+    t.voltage = 12.0f + (float)(rnd_unit(e) - 0.5) * 0.2f;
+    t.current = n->rpm * 0.002f + (float)rnd_unit(e) * 0.05f;
+    if (n->current_limit > 0 && t.current > n->current_limit) t.current = n->current_limit;
+    t.temperature = 25.0f + n->rpm * 0.004f;
+    t.rpm = n->rpm;
+    return node_send(e, n, ECU_MSG_TELEMETRY, ECU_NODE_PC, 0, &t, sizeof(t));
+}
+
+// ---- приём ----
+
+static void queue_ack(emu_t* e, emu_node_t* n, const ecu_hdr_t* h, uint16_t status, uint64_t now)
+{
+    if (e->o->ack_loss > 0 && rnd_unit(e) < e->o->ack_loss) {
+        n->acks_lost++;
+        return;
+    }
+    uint64_t d = (uint64_t)e->o->ack_delay_ms * 1000000u;
+    if (e->o->ack_jitter_ms) d += (uint64_t)(rnd_u32(e) % (e->o->ack_jitter_ms * 1000u)) * 1000u;
+    emu_ack_t a = { now + d, h->seq, status, h->src };
+    if (n->ack_n == EMU_ACKS) {
+        // прошивка не копит ответы: отвечаем сразу, порядок ACK при этом может нарушиться
+        n->acks_over++;
+        ecu_ack_v1_t ap = { a.seq, a.status };
+        (void)node_send(e, n, ECU_MSG_ACK, a.dst, ECU_F_IS_ACK, &ap, sizeof(ap));
+        return;
+    }
+    n->acks[(n->ack_head + n->ack_n) % EMU_ACKS] = a;
+    n->ack_n++;
+}
+
+// COMMAND узлу. Статус ACK как у прошивки: неизвестная команда — 1, неверные параметры — 2
+static uint16_t on_command(emu_node_t* n, const uint8_t* pl, uint16_t len, uint64_t now)
+{
+    ecu_command_hdr_t ch;
+    if (len < sizeof(ch)) return 2;
+    memcpy(&ch, pl, sizeof(ch));
+    if ((size_t)ch.param_len + sizeof(ch) > len) return 2;
+    const uint8_t* p = pl + sizeof(ch);
+    float f;
+    switch (ch.command_id) {
+        case 1:   // SET_MODE
+            if (ch.param_len != 1) return 2;
+            n->mode = p[0];
+            return 0;
+        case 2:   // SET_TARGET_RPM
+            if (ch.param_len != sizeof(f)) return 2;
+            memcpy(&f, p, sizeof(f));
+            if (!isfinite(f) || f < 0) return 2;
+            n->rpm_target = f;
+            return 0;
+        case 3:   // SET_LIMIT_CURRENT
+            if (ch.param_len != sizeof(f)) return 2;
+            memcpy(&f, p, sizeof(f));
+            if (!isfinite(f) || f < 0) return 2;
+            n->current_limit = f;
+            return 0;
+        case 4:   // ARM
+            n->status_flags |= 1u;
+            return 0;
+        case 5:   // DISARM
+            n->status_flags &= (uint16_t)~1u;
+            n->rpm_target = 0;
+            return 0;
+        case 6:   // RESET_FAULT
+            n->error_code = 0;
+            return 0;
+        case 7:   // PING
+            return 0;
+        case 8:   // ENTER_BOOT: ACK уходит, затем узел «перезагружается» и снова шлёт HELLO
+            n->reboot_ns = now + (uint64_t)EMU_BOOT_MS * 1000000u;
+            return 0;
+        default:
+            n->cmds_unknown++;
+            return 1;
+    }
+}
+
+static void on_frame(emu_t* e, emu_node_t* n, size_t flen, uint64_t now)
+{
+    const ecu_hdr_t* h;
+    const uint8_t* pl;
+    if (!ecu_frame_validate(n->rx_buf, flen, &h, &pl)) {
+        n->rx_bad++;
+        return;
+    }
+    if (h->dst != n->id && h->dst != ECU_NODE_BROADCAST) {
+        n->rx_other++;
+        return;
+    }
+    if (h->msg_type < 9) n->rx_frames[h->msg_type]++;
+    if (n->reboot_ns) return;   // в загрузчике протокол не слышит
+    if (h->msg_type == ECU_MSG_ACK && h->payload_len >= sizeof(ecu_ack_v1_t)) {
+        ecu_ack_v1_t ack;
+        memcpy(&ack, pl, sizeof(ack));
+        if (ack.ack_seq == n->hello_seq && !n->hello_acked) {
+            n->hello_acked = 1;
+            n->hello_ns = 0;
+        }
+        return;
+    }
+    if (h->msg_type != ECU_MSG_COMMAND) return;
+    uint16_t st = on_command(n, pl, h->payload_len, now);
+    if ((h->flags & ECU_F_ACK_REQUIRED) && h->dst == n->id) queue_ack(e, n, h, st, now);
+}
+
+static void node_read(emu_t* e, emu_node_t* n, uint64_t now)
+{
+    uint8_t buf[4096];
+    for (;;) {
+        ssize_t r = read(n->master, buf, sizeof(buf));
+        if (r <= 0) return;
+        size_t off = 0;
+        while (off < (size_t)r) {
+            size_t flen = 0;
+            int rc = slip_rx_push(&n->rx, buf + off, (size_t)r - off, &flen);
+            off += n->rx.consumed;
+            if (rc == 1) on_frame(e, n, flen, now);
+            else if (rc < 0) n->rx_slip++;
+        }
+    }
+}
+
+// ---- узлы ----
+
+static int open_pty(emu_node_t* n)
+{
+    n->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (n->master < 0 || grantpt(n->master) < 0 || unlockpt(n->master) < 0) return -1;
+    const char* sn = ptsname(n->master);
+    if (!sn) return -1;
+    snprintf(n->pts, sizeof(n->pts), "%s", sn);
+
+    // ведомая сторона сразу raw: до открытия шлюзом без этого line discipline вернёт эхо
+    n->slave = open(n->pts, O_RDWR | O_NOCTTY);
+    if (n->slave < 0) return -1;
+    struct termios t;
+    if (tcgetattr(n->slave, &t) == 0) {
+        cfmakeraw(&t);
+        tcsetattr(n->slave, TCSANOW, &t);
+    }
+    fcntl(n->master, F_SETFL, fcntl(n->master, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+static int node_init(emu_t* e, emu_node_t* n, int id, uint64_t now)
+{
+    const emu_opts_t* o = e->o;
+    memset(n, 0, sizeof(*n));
+    n->id = (uint8_t)id;
+    n->master = n->slave = -1;
+    if (open_pty(n) < 0) {
+        fprintf(stderr, "due_emu: pty: %s\n", strerror(errno));
+        return -1;
+    }
+    if (o->link) {
+        snprintf(n->link, sizeof(n->link), o->link, id);
+        unlink(n->link);
+        if (symlink(n->pts, n->link) < 0) {
+            fprintf(stderr, "due_emu: %s: %s\n", n->link, strerror(errno));
+            n->link[0] = '\0';
+            return -1;
+        }
+    }
+    slip_rx_init(&n->rx, n->rx_buf, sizeof(n->rx_buf));
+    n->tokens_ns = now;
+    n->boot_ns = now;
+    n->hello_ns = now;
+    n->seq = 1;
+    // узлы не в фазе: иначе телеметрия всех приходит одной пачкой
+    uint64_t period = o->rate > 0 ? (uint64_t)(1e9 / o->rate) : 0;
+    n->next_tel_ns = now + (period ? rnd_u32(e) % period : 0);
+    n->next_hb_ns = now + (uint64_t)o->hb_ms * 1000000u;
+    return 0;
+}
+
+static void node_close(emu_node_t* n)
+{
+    if (n->link[0]) unlink(n->link);
+    if (n->slave >= 0) close(n->slave);
+    if (n->master >= 0) close(n->master);
+}
+
+static const char* node_dev(const emu_node_t* n)
+{
+    return n->link[0] ? n->link : n->pts;
+}
+
+static int write_conf(const emu_t* e, const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    for (int i = 0; i < e->o->nodes; i++) {
+        const emu_node_t* n = &e->node[i];
+        fprintf(f, "[uart due%u]\ndev = %s\n", (unsigned)n->id, node_dev(n));
+        if (e->o->baud) fprintf(f, "baud = %u\n", e->o->baud);
+        fprintf(f, "nodes = %u\n", (unsigned)n->id);
+    }
+    fclose(f);
+    return 0;
+}
+
+// Один шаг узла: HELLO, ACK по сроку, HEARTBEAT, TELEMETRY. Возврат — ближайший срок
+static uint64_t node_tick(emu_t* e, emu_node_t* n, uint64_t now)
+{
+    const emu_opts_t* o = e->o;
+    uint64_t next = now + 100000000u;
+
+    while (n->ack_n && n->acks[n->ack_head].due_ns <= now) {
+        const emu_ack_t* a = &n->acks[n->ack_head];
+        ecu_ack_v1_t ap = { a->seq, a->status };
+        if (node_send(e, n, ECU_MSG_ACK, a->dst, ECU_F_IS_ACK, &ap, sizeof(ap)) < 0) break;
+        n->ack_head = (n->ack_head + 1) % EMU_ACKS;
+        n->ack_n--;
+    }
+    if (n->ack_n && n->acks[n->ack_head].due_ns < next) next = n->acks[n->ack_head].due_ns;
+
+    if (n->reboot_ns) {
+        if (n->reboot_ns > now) return n->reboot_ns < next ? n->reboot_ns : next;
+        n->reboot_ns = 0;
+        n->boot_ns = now;
+        n->seq = 1;
+        n->rpm = n->rpm_target = 0;
+        n->status_flags = 0;
+        n->mode = 0;
+        n->hello_acked = 0;
+        n->hello_ns = now;
+    }
+
+    // HELLO до первого ACK: шлюз сбрасывает буфер порта при открытии, первый HELLO мог пропасть
+    if (n->hello_ns && n->hello_ns <= now) {
+        n->hello_seq = n->seq;
+        send_hello(e, n);
+        n->hello_ns = o->hello_ms ? now + (uint64_t)o->hello_ms * 1000000u : 0;
+    }
+    if (n->hello_ns && n->hello_ns < next) next = n->hello_ns;
+
+    if (o->hb_ms) {
+        if (n->next_hb_ns <= now) {
+            (void)node_send(e, n, ECU_MSG_HEARTBEAT, ECU_NODE_GW, 0, NULL, 0);
+            n->next_hb_ns += (uint64_t)o->hb_ms * 1000000u;
+            if (n->next_hb_ns <= now) n->next_hb_ns = now + (uint64_t)o->hb_ms * 1000000u;
+        }
+        if (n->next_hb_ns < next) next = n->next_hb_ns;
+    }
+
+    if (o->rate < 0) {
+        while (n->pend_len < EMU_LOW && send_telemetry(e, n, now) == 0) {
+        }
+    } else if (o->rate > 0) {
+        uint64_t period = (uint64_t)(1e9 / o->rate);
+        if (period == 0) period = 1;
+        while (n->next_tel_ns <= now) {
+            // как у прошивки: линия не успевает — отсчёт пропадает, а не копится
+            if (n->pend_len > EMU_PEND / 2 || send_telemetry(e, n, now) < 0) n->late++;
+            n->next_tel_ns += period;
+        }
+        if (n->next_tel_ns < next) next = n->next_tel_ns;
+    }
+    return next;
+}
+
+// ---- отчёт ----
+
+static void report(const emu_t* e, uint64_t now, int final)
+{
+    double secs = (double)(now - e->t0_ns) / 1e9;
+    uint64_t tel = 0, bytes = 0;
+    for (int i = 0; i < e->o->nodes; i++) {
+        tel += e->node[i].tx_frames[ECU_MSG_TELEMETRY];
+        bytes += e->node[i].tx_bytes;
+    }
+    printf("%s %.1f s: %llu telemetry (%.0f/s), %.1f KB/s to gateway\n", final ? "total" : "stats", secs,
+           (unsigned long long)tel, secs > 0 ? (double)tel / secs : 0.0, secs > 0 ? (double)bytes / 1024.0 / secs : 0.0);
+    if (!final && !e->o->verbose) return;
+    printf("node dev                      telemetry  hb     hello  late     bytes        cmds   acks   lost   "
+           "corrupt  rx_bad  rx_other\n");
+    for (int i = 0; i < e->o->nodes; i++) {
+        const emu_node_t* n = &e->node[i];
+        printf("%-4u %-25s %-10llu %-6llu %-6llu %-8llu %-12llu %-6llu %-6llu %-6llu %-8llu %-7llu %llu\n",
+               (unsigned)n->id, node_dev(n), (unsigned long long)n->tx_frames[ECU_MSG_TELEMETRY],
+               (unsigned long long)n->tx_frames[ECU_MSG_HEARTBEAT], (unsigned long long)n->tx_frames[ECU_MSG_HELLO],
+               (unsigned long long)n->late, (unsigned long long)n->tx_bytes,
+               (unsigned long long)n->rx_frames[ECU_MSG_COMMAND], (unsigned long long)n->tx_frames[ECU_MSG_ACK],
+               (unsigned long long)n->acks_lost, (unsigned long long)n->corrupted,
+               (unsigned long long)(n->rx_bad + n->rx_slip), (unsigned long long)n->rx_other);
+    }
+    fflush(stdout);
+}
+
+static int run(emu_t* e)
+{
+    const emu_opts_t* o = e->o;
+    struct pollfd pfd[EMU_NODES_MAX];
+    uint64_t end_ns = o->time_s > 0 ? e->t0_ns + (uint64_t)(o->time_s * 1e9) : 0;
+    uint64_t stats_ns = o->stats_s > 0 ? e->t0_ns + (uint64_t)(o->stats_s * 1e9) : 0;
+
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        if (end_ns && now >= end_ns) break;
+        if (stats_ns && now >= stats_ns) {
+            report(e, now, 0);
+            stats_ns += (uint64_t)(o->stats_s * 1e9);
+        }
+
+        uint64_t next = end_ns ? end_ns : now + 100000000u;
+        if (stats_ns && stats_ns < next) next = stats_ns;
+        for (int i = 0; i < o->nodes; i++) {
+            emu_node_t* n = &e->node[i];
+            uint64_t t = node_tick(e, n, now);
+            if (t < next) next = t;
+            node_flush(e, n, now);
+            // -baud: остаток ждёт токенов, а не POLLOUT
+            if (o->baud && n->pend_len && now + 1000000u < next) next = now + 1000000u;
+            pfd[i].fd = n->master;
+            // -rate max: досыпать, как только pty примет ещё
+            pfd[i].events = POLLIN | ((n->pend_len || o->rate < 0) && !o->baud ? POLLOUT : 0);
+            pfd[i].revents = 0;
+        }
+        int timeout = next > now ? (int)((next - now + 999999u) / 1000000u) : 0;
+        if (poll(pfd, (nfds_t)o->nodes, timeout) < 0 && errno != EINTR) return -1;
+
+        now = now_ns();
+        for (int i = 0; i < o->nodes; i++) {
+            if (pfd[i].revents & POLLIN) node_read(e, &e->node[i], now);
+            if (pfd[i].revents & POLLOUT) node_flush(e, &e->node[i], now);
+        }
+    }
+    report(e, now_ns(), 1);
+    return 0;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-nodes N] [-first ID] [-link PATTERN] [-conf FILE] [-rate HZ|max] [-baud B] [-hb MS]\n"
+            "          [-hello MS] [-ack_delay MS] [-ack_jitter MS] [-ack_loss PCT] [-corrupt PCT] [-time SEC]\n"
+            "          [-stats SEC] [-seed S] [-v]\n",
+            argv0);
+}
+
+int main(int argc, char** argv)
+{
+    emu_opts_t o;
+    memset(&o, 0, sizeof(o));
+    o.nodes = 3;
+    o.first = ECU_NODE1;
+    o.rate = 50;
+    o.hb_ms = 1000;
+    o.hello_ms = 1000;
+    o.seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "-nodes") == 0 && v) { o.nodes = atoi(v); i++; }
+        else if (strcmp(a, "-first") == 0 && v) { o.first = atoi(v); i++; }
+        else if (strcmp(a, "-link") == 0 && v) { o.link = v; i++; }
+        else if (strcmp(a, "-conf") == 0 && v) { o.conf = v; i++; }
+        else if (strcmp(a, "-rate") == 0 && v) { o.rate = strcmp(v, "max") == 0 ? -1.0 : atof(v); i++; }
+        else if (strcmp(a, "-baud") == 0 && v) { o.baud = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-hb") == 0 && v) { o.hb_ms = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-hello") == 0 && v) { o.hello_ms = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-ack_delay") == 0 && v) { o.ack_delay_ms = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-ack_jitter") == 0 && v) { o.ack_jitter_ms = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-ack_loss") == 0 && v) { o.ack_loss = atof(v) / 100.0; i++; }
+        else if (strcmp(a, "-corrupt") == 0 && v) { o.corrupt = atof(v) / 100.0; i++; }
+        else if (strcmp(a, "-time") == 0 && v) { o.time_s = atof(v); i++; }
+        else if (strcmp(a, "-stats") == 0 && v) { o.stats_s = atof(v); i++; }
+        else if (strcmp(a, "-seed") == 0 && v) { o.seed = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-v") == 0) o.verbose = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (o.nodes < 1 || o.nodes > EMU_NODES_MAX || o.first < 1 || o.first + o.nodes - 1 >= (int)ECU_NODE_GW) {
+        fprintf(stderr, "due_emu: -nodes 1..%d, ids %d..%d must be 1..254\n", EMU_NODES_MAX, o.first,
+                o.first + o.nodes - 1);
+        return 2;
+    }
+
+    static emu_t e;
+    e.o = &o;
+    e.rnd = 0x9E3779B97F4A7C15ull ^ o.seed;
+    e.t0_ns = now_ns();
+    for (int i = 0; i < o.nodes; i++) e.node[i].master = e.node[i].slave = -1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int rc = 0;
+    for (int i = 0; i < o.nodes && rc == 0; i++) rc = node_init(&e, &e.node[i], o.first + i, e.t0_ns);
+    if (rc == 0 && o.conf && write_conf(&e, o.conf) < 0) {
+        fprintf(stderr, "due_emu: %s: %s\n", o.conf, strerror(errno));
+        rc = -1;
+    }
+    if (rc == 0) {
+        for (int i = 0; i < o.nodes; i++) printf("node %u: %s\n", (unsigned)e.node[i].id, node_dev(&e.node[i]));
+        fflush(stdout);
+        rc = run(&e);
+    }
+    for (int i = 0; i < o.nodes; i++) node_close(&e.node[i]);
+    return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,538 @@
+// Нагрузка на путь PC -> шлюз -> UART -> узел -> шлюз -> PC: COMMAND по TCP с заданным темпом,
+// ACK сопоставляются по (узел, ack_seq), в конце — достигнутый темп, потери и задержка ACK.
+//
+// M соединений, команды узлам по кругу; seq общий на узел для всех соединений. ACK от узла
+// шлюз отдаёт только соединению, откуда пришла команда; ответ засчитывается по первому
+// пришедшему, копии в других соединениях («copies») — ACK, разосланные всем без записи в шлюзе. Без -rate команды идут без пауз, но не больше -window
+// неподтверждённых на соединение (с -rate тоже, -window 0 — без окна). Нет ACK за -timeout мс —
+// потеря; ACK, пришедший позже, — ещё и «late».
+//
+//   gw_load [-host ADDR] [-port P] [-conns M] [-nodes 1,2,3] [-rate N] [-window N] [-time SEC]
+//           [-cmd ID] [-param BYTES] [-timeout MS] [-v]
+//
+// -v — темп по секундам.
+// Узлы — платы или due_emu (tests/due_emu.c).
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define LD_CONNS_MAX 64
+#define LD_NODES_MAX 32
+#define LD_RX        (256 * 1024)
+#define LD_TX        (64 * 1024)
+#define LD_RING_BITS 20              // отправленные в порядке отправки: 1M
+
+typedef struct {
+    const char* host;
+    uint16_t    port;
+    int         conns;
+    uint8_t     nodes[LD_NODES_MAX];
+    int         node_count;
+    double      rate;        // команд/с всего (0 = без пауз, по окну)
+    unsigned    window;      // неподтверждённых на соединение (0 = без ограничения)
+    double      time_s;
+    uint16_t    cmd;
+    unsigned    param;
+    unsigned    timeout_ms;
+    int         verbose;
+} ld_opts_t;
+
+enum { LD_FREE, LD_SENT, LD_ACKED, LD_EXPIRED };
+
+typedef struct {
+    uint64_t t_ns;   // отправлена
+    uint8_t  conn;
+    uint8_t  state;  // LD_*
+} ld_slot_t;
+
+typedef struct {
+    uint8_t  node;   // индекс в opts.nodes
+    uint16_t seq;
+    uint64_t t_ns;   // совпадает со слотом — иначе слот уже переиспользован
+} ld_ring_t;
+
+typedef struct {
+    int      fd;
+    uint8_t  rx[LD_RX];
+    size_t   rx_len;
+    uint8_t  tx[LD_TX];
+    size_t   tx_len;
+    unsigned in_flight;
+} ld_conn_t;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t acked;
+    uint64_t lost;
+    uint64_t status_err;   // ACK с status_code != 0
+    uint16_t seq;
+    ld_slot_t* slot;       // 65536 по seq
+} ld_node_t;
+
+typedef struct {
+    const ld_opts_t* o;
+    ld_conn_t* conn;
+    ld_node_t  node[LD_NODES_MAX];
+    ld_ring_t* ring;
+    uint32_t   ring_head;
+    uint32_t   ring_tail;
+    int        next_conn;
+    int        next_node;
+
+    uint32_t*  lat;        // мкс
+    size_t     lat_n;
+    size_t     lat_cap;
+
+    uint64_t   sent;
+    uint64_t   acked;
+    uint64_t   lost;
+    uint64_t   late;       // ACK пришёл после -timeout (уже в lost)
+    uint64_t   copies;
+    uint64_t   other;      // не ACK на наши команды (телеметрия узлов и т.п.)
+    uint64_t   bad;        // битые кадры
+    uint64_t   seq_busy;   // seq узла ещё в пути — отправка отложена
+    uint64_t   tx_full;    // буфер соединения полон — отправка отложена
+} ld_t;
+
+#define LD_RING_MASK ((1u << LD_RING_BITS) - 1u)
+
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int tcp_connect(const char* host, uint16_t port)
+{
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &a.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void lat_add(ld_t* ld, uint64_t ns)
+{
+    if (ld->lat_n == ld->lat_cap) {
+        size_t cap = ld->lat_cap ? ld->lat_cap * 2 : 65536;
+        uint32_t* p = (uint32_t*)realloc(ld->lat, cap * sizeof(*p));
+        if (!p) return;
+        ld->lat = p;
+        ld->lat_cap = cap;
+    }
+    uint64_t us = ns / 1000u;
+    ld->lat[ld->lat_n++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+// ---- отправка ----
+
+static void conn_flush(ld_conn_t* c)
+{
+    size_t off = 0;
+    while (off < c->tx_len) {
+        ssize_t w = send(c->fd, c->tx + off, c->tx_len - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += (size_t)w;
+    }
+    memmove(c->tx, c->tx + off, c->tx_len - off);
+    c->tx_len -= off;
+}
+
+// Одна команда следующему узлу по кругу. 1 = отправлена, 0 = некуда (окно, буфер, seq)
+static int send_one(ld_t* ld, uint64_t now)
+{
+    const ld_opts_t* o = ld->o;
+    ld_conn_t* c = NULL;
+    for (int k = 0; k < o->conns; k++) {
+        ld_conn_t* x = &ld->conn[(ld->next_conn + k) % o->conns];
+        if (x->fd < 0 || (o->window && x->in_flight >= o->window)) continue;
+        c = x;
+        ld->next_conn = (ld->next_conn + k + 1) % o->conns;
+        break;
+    }
+    if (!c || ld->ring_head - ld->ring_tail > LD_RING_MASK) return 0;
+    if (c->tx_len + 4 + ECU_MAX_FRAME_SIZE > sizeof(c->tx)) {
+        ld->tx_full++;
+        return 0;
+    }
+
+    int ni = ld->next_node;
+    ld_node_t* n = &ld->node[ni];
+    uint16_t seq = (uint16_t)(n->seq + 1);
+    if (seq == 0) seq = 1;
+    if (n->slot[seq].state == LD_SENT) {
+        ld->seq_busy++;
+        return 0;
+    }
+    ld->next_node = (ni + 1) % o->node_count;
+    n->seq = seq;
+
+    uint8_t payload[sizeof(ecu_command_hdr_t) + ECU_MAX_PAYLOAD];
+    ecu_command_hdr_t ch = { o->cmd, (uint16_t)o->param };
+    memcpy(payload, &ch, sizeof(ch));
+    memset(payload + sizeof(ch), 0, o->param);
+
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.src = ECU_NODE_PC;
+    h.dst = o->nodes[ni];
+    h.seq = seq;
+    h.flags = ECU_F_ACK_REQUIRED;
+    h.payload_len = (uint16_t)(sizeof(ch) + o->param);
+
+    size_t len = ecu_frame_pack(&h, payload, c->tx + c->tx_len + 4, sizeof(c->tx) - c->tx_len - 4);
+    uint32_t l = (uint32_t)len;
+    memcpy(c->tx + c->tx_len, &l, 4);
+    c->tx_len += 4 + len;
+
+    n->slot[seq].t_ns = now;
+    n->slot[seq].conn = (uint8_t)(c - ld->conn);
+    n->slot[seq].state = LD_SENT;
+    n->sent++;
+    c->in_flight++;
+    ld->sent++;
+    ld_ring_t* r = &ld->ring[ld->ring_head++ & LD_RING_MASK];
+    r->node = (uint8_t)ni;
+    r->seq = seq;
+    r->t_ns = now;
+    return 1;
+}
+
+// Потери по таймауту: кольцо в порядке отправки, голова — самая старая
+static void expire(ld_t* ld, uint64_t now, int all)
+{
+    uint64_t to = (uint64_t)ld->o->timeout_ms * 1000000u;
+    while (ld->ring_tail != ld->ring_head) {
+        ld_ring_t* r = &ld->ring[ld->ring_tail & LD_RING_MASK];
+        ld_node_t* n = &ld->node[r->node];
+        ld_slot_t* s = &n->slot[r->seq];
+        if (s->state == LD_SENT && s->t_ns == r->t_ns) {
+            if (!all && now - r->t_ns < to) break;
+            n->lost++;
+            ld->lost++;
+            ld->conn[s->conn].in_flight--;
+            s->state = LD_EXPIRED;
+        }
+        ld->ring_tail++;
+    }
+}
+
+// ---- приём ----
+
+static int node_index(const ld_t* ld, uint8_t id)
+{
+    for (int i = 0; i < ld->o->node_count; i++) {
+        if (ld->o->nodes[i] == id) return i;
+    }
+    return -1;
+}
+
+static void on_frame(ld_t* ld, const uint8_t* f, size_t len, uint64_t now)
+{
+    const ecu_hdr_t* h;
+    const uint8_t* pl;
+    if (!ecu_frame_validate(f, len, &h, &pl)) {
+        ld->bad++;
+        return;
+    }
+    int ni = h->msg_type == ECU_MSG_ACK && h->dst == ECU_NODE_PC ? node_index(ld, h->src) : -1;
+    if (ni < 0 || h->payload_len < sizeof(ecu_ack_v1_t)) {
+        ld->other++;
+        return;
+    }
+    ecu_ack_v1_t ack;
+    memcpy(&ack, pl, sizeof(ack));
+    ld_node_t* n = &ld->node[ni];
+    ld_slot_t* s = &n->slot[ack.ack_seq];
+    if (s->state != LD_SENT) {
+        // уже подтверждена (копия в другом соединении) или списана по таймауту
+        if (s->state == LD_ACKED) ld->copies++;
+        else if (s->state == LD_EXPIRED) ld->late++;
+        else ld->other++;
+        return;
+    }
+    lat_add(ld, now - s->t_ns);
+    if (ack.status_code != 0) n->status_err++;
+    n->acked++;
+    ld->acked++;
+    ld->conn[s->conn].in_flight--;
+    s->state = LD_ACKED;
+}
+
+// Кадры соединения (u32 LE длина + кадр). -1 = соединение закрыто
+static int conn_read(ld_t* ld, ld_conn_t* c, uint64_t now)
+{
+    for (;;) {
+        ssize_t r = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+        if (r == 0) return -1;
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        c->rx_len += (size_t)r;
+        size_t off = 0;
+        while (c->rx_len - off >= 4) {
+            uint32_t l;
+            memcpy(&l, c->rx + off, 4);
+            if (l > ECU_MAX_FRAME_SIZE) return -1;
+            if (c->rx_len - off < 4 + l) break;
+            on_frame(ld, c->rx + off + 4, l, now);
+            off += 4 + l;
+        }
+        memmove(c->rx, c->rx + off, c->rx_len - off);
+        c->rx_len -= off;
+    }
+}
+
+// ---- отчёт ----
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(ld_t* ld, double secs)
+{
+    const ld_opts_t* o = ld->o;
+    printf("load: %d connection(s), %d node(s), command %u, %u byte(s) param, ", o->conns, o->node_count,
+           (unsigned)o->cmd, o->param);
+    if (o->rate > 0) printf("target %.0f/s\n", o->rate);
+    else printf("window %u\n", o->window);
+    printf("  sent      %llu in %.3f s (%.0f/s), acked %llu (%.0f/s), lost %llu (%.3f%%), late %llu\n",
+           (unsigned long long)ld->sent, secs, secs > 0 ? (double)ld->sent / secs : 0.0,
+           (unsigned long long)ld->acked, secs > 0 ? (double)ld->acked / secs : 0.0, (unsigned long long)ld->lost,
+           ld->sent ? 100.0 * (double)ld->lost / (double)ld->sent : 0.0, (unsigned long long)ld->late);
+    printf("  received  %llu copies, %llu other, %llu bad; held back: seq busy %llu, send buffer full %llu\n",
+           (unsigned long long)ld->copies, (unsigned long long)ld->other, (unsigned long long)ld->bad,
+           (unsigned long long)ld->seq_busy, (unsigned long long)ld->tx_full);
+    for (int i = 0; i < o->node_count; i++) {
+        const ld_node_t* n = &ld->node[i];
+        printf("  node %-4u sent %llu, acked %llu, lost %llu, status != 0: %llu\n", (unsigned)o->nodes[i],
+               (unsigned long long)n->sent, (unsigned long long)n->acked, (unsigned long long)n->lost,
+               (unsigned long long)n->status_err);
+    }
+    if (ld->lat_n > 0) {
+        qsort(ld->lat, ld->lat_n, sizeof(*ld->lat), cmp_u32);
+        const double q[] = { 0.5, 0.9, 0.99, 0.999 };
+        uint32_t v[4];
+        for (int i = 0; i < 4; i++) {
+            size_t k = (size_t)(q[i] * (double)ld->lat_n);
+            v[i] = ld->lat[k < ld->lat_n ? k : ld->lat_n - 1];
+        }
+        printf("  latency   us: min %u p50 %u p90 %u p99 %u p99.9 %u max %u\n", (unsigned)ld->lat[0], (unsigned)v[0],
+               (unsigned)v[1], (unsigned)v[2], (unsigned)v[3], (unsigned)ld->lat[ld->lat_n - 1]);
+    }
+}
+
+static int run(ld_t* ld)
+{
+    const ld_opts_t* o = ld->o;
+    struct pollfd pfd[LD_CONNS_MAX];
+    uint64_t t0 = now_ns();
+    uint64_t end_ns = t0 + (uint64_t)(o->time_s * 1e9);
+    uint64_t period = o->rate > 0 ? (uint64_t)(1e9 / o->rate) : 0;
+    uint64_t next_ns = t0;
+    uint64_t drain_ns = 0;   // после -time ждём ответы на отправленное
+    uint64_t tick_ns = t0 + 1000000000u;
+    uint64_t tick_sent = 0, tick_acked = 0;
+
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        if (!drain_ns && now >= end_ns) drain_ns = now + (uint64_t)o->timeout_ms * 1000000u;
+        if (drain_ns && (now >= drain_ns || ld->ring_tail == ld->ring_head)) break;
+        expire(ld, now, 0);
+        if (o->verbose && now >= tick_ns) {
+            printf("  %5.1f s: sent %llu/s, acked %llu/s, lost %llu total\n", (double)(now - t0) / 1e9,
+                   (unsigned long long)(ld->sent - tick_sent), (unsigned long long)(ld->acked - tick_acked),
+                   (unsigned long long)ld->lost);
+            fflush(stdout);
+            tick_sent = ld->sent;
+            tick_acked = ld->acked;
+            tick_ns += 1000000000u;
+        }
+
+        if (!drain_ns) {
+            if (period) {
+                // отставание копится не дольше 100 мс, иначе после паузы — залп
+                if (now > next_ns + 100000000u) next_ns = now - 100000000u;
+                while (next_ns <= now && send_one(ld, now)) next_ns += period;
+            } else {
+                for (int k = 0; k < 256 && send_one(ld, now); k++) {
+                }
+            }
+        }
+
+        int timeout = 10;
+        if (period && !drain_ns) {
+            timeout = next_ns > now ? (int)((next_ns - now) / 1000000u) : 0;
+            if (timeout > 10) timeout = 10;
+        }
+        for (int i = 0; i < o->conns; i++) {
+            ld_conn_t* c = &ld->conn[i];
+            if (c->tx_len) conn_flush(c);
+            pfd[i].fd = c->fd;
+            pfd[i].events = POLLIN | (c->tx_len ? POLLOUT : 0);
+            pfd[i].revents = 0;
+        }
+        if (poll(pfd, (nfds_t)o->conns, timeout) < 0 && errno != EINTR) return -1;
+        now = now_ns();
+        for (int i = 0; i < o->conns; i++) {
+            ld_conn_t* c = &ld->conn[i];
+            if (c->fd < 0) continue;
+            if ((pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) && conn_read(ld, c, now) < 0) {
+                fprintf(stderr, "gw_load: connection %d closed by gateway\n", i);
+                close(c->fd);
+                c->fd = -1;
+                continue;
+            }
+            if (pfd[i].revents & POLLOUT) conn_flush(c);
+        }
+    }
+    expire(ld, now_ns(), 1);
+    report(ld, (double)(now_ns() - t0) / 1e9);
+    return 0;
+}
+
+// "1,2,3" -> opts.nodes
+static int parse_nodes(ld_opts_t* o, const char* v)
+{
+    o->node_count = 0;
+    while (*v) {
+        char* end;
+        unsigned long x = strtoul(v, &end, 10);
+        if (end == v || x == ECU_NODE_PC || x >= ECU_NODE_GW || o->node_count == LD_NODES_MAX) return -1;
+        o->nodes[o->node_count++] = (uint8_t)x;
+        v = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return o->node_count > 0 ? 0 : -1;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-host ADDR] [-port P] [-conns M] [-nodes 1,2,3] [-rate N] [-window N] [-time SEC]\n"
+            "          [-cmd ID] [-param BYTES] [-timeout MS] [-v]\n",
+            argv0);
+}
+
+int main(int argc, char** argv)
+{
+    ld_opts_t o;
+    memset(&o, 0, sizeof(o));
+    o.host = "127.0.0.1";
+    o.port = 9100;
+    o.conns = 1;
+    o.window = 16;
+    o.time_s = 10;
+    o.cmd = 7;   // PING
+    o.timeout_ms = 1000;
+    parse_nodes(&o, "1,2,3");
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "-host") == 0 && v) { o.host = v; i++; }
+        else if (strcmp(a, "-port") == 0 && v) { o.port = (uint16_t)atoi(v); i++; }
+        else if (strcmp(a, "-conns") == 0 && v) { o.conns = atoi(v); i++; }
+        else if (strcmp(a, "-nodes") == 0 && v) {
+            if (parse_nodes(&o, v) < 0) {
+                fprintf(stderr, "gw_load: bad -nodes '%s'\n", v);
+                return 2;
+            }
+            i++;
+        }
+        else if (strcmp(a, "-rate") == 0 && v) { o.rate = atof(v); i++; }
+        else if (strcmp(a, "-window") == 0 && v) { o.window = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-time") == 0 && v) { o.time_s = atof(v); i++; }
+        else if (strcmp(a, "-cmd") == 0 && v) { o.cmd = (uint16_t)strtoul(v, NULL, 0); i++; }
+        else if (strcmp(a, "-param") == 0 && v) { o.param = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-timeout") == 0 && v) { o.timeout_ms = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-v") == 0) o.verbose = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (o.conns < 1 || o.conns > LD_CONNS_MAX || o.param > ECU_MAX_PAYLOAD - sizeof(ecu_command_hdr_t) ||
+        (o.rate <= 0 && o.window == 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    static ld_t ld;
+    ld.o = &o;
+    ld.conn = (ld_conn_t*)calloc((size_t)o.conns, sizeof(ld_conn_t));
+    ld.ring = (ld_ring_t*)calloc(LD_RING_MASK + 1u, sizeof(ld_ring_t));
+    int rc = ld.conn && ld.ring ? 0 : -1;
+    for (int i = 0; i < o.node_count && rc == 0; i++) {
+        ld.node[i].slot = (ld_slot_t*)calloc(65536, sizeof(ld_slot_t));
+        if (!ld.node[i].slot) rc = -1;
+    }
+    for (int i = 0; i < o.conns && rc == 0; i++) {
+        ld.conn[i].fd = tcp_connect(o.host, o.port);
+        if (ld.conn[i].fd < 0) {
+            fprintf(stderr, "gw_load: %s:%u: %s\n", o.host, (unsigned)o.port, strerror(errno));
+            rc = -1;
+        }
+    }
+    if (rc == 0) rc = run(&ld);
+
+    for (int i = 0; ld.conn && i < o.conns; i++) {
+        if (ld.conn[i].fd >= 0) close(ld.conn[i].fd);
+    }
+    for (int i = 0; i < o.node_count; i++) free(ld.node[i].slot);
+    free(ld.conn);
+    free(ld.ring);
+    free(ld.lat);
+    return rc == 0 ? 0 : 1;
+}
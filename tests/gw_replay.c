@@ -0,0 +1,866 @@
+// Повтор записанного трафика через ecu_gw: нагрузочный тест из настоящей сессии.
+//
+// Файл capture ([capture] шлюза, include/ecu/ecu_cap.h) содержит сырые куски байт каждого UART
+// с метками времени. ecu_gw запускается на pty вместо UART (имена портов — из заголовка файла,
+// nodes — по src кадров в записи), куски пишутся в pty с исходными интервалами, в -speed X раз
+// быстрее или без пауз (-fast); с -net кадры клиентов из записи отправляются по TCP. Каждый целый
+// кадр, отданный шлюзу, ждём там, куда его должен отправить маршрут: на pty UART узла dst или
+// у TCP клиента; появление на другом выходе (копия клиенту при пересылке) — «copies».
+// В конце — пропускная способность, недоставленные кадры, задержка «запись в pty -> выход»
+// и счётчики ошибок/потерь самого шлюза (GW_CTL_GET_STATS).
+//
+//   gw_replay -cap FILE.ecap [-gw PATH] [-speed X | -fast] [-loop N] [-net] [-backend epoll|io_uring]
+//             [-threads 0|1] [-port P] [-linger MS] [-extra FILE] [-v]
+//
+// -extra FILE — дописать FILE в конфигурацию шлюза (сравнение настроек на одной и той же записи).
+
+#include "ecu/ecu_cap.h"
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+#include "gw/gw_ctl.h"
+#include "gw/gw_metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define RP_PEND       (64 * 1024)   // байт в очереди записи pty на порт
+#define RP_MATCH_BITS 18            // таблица кадров в пути: 256K
+#define RP_NET_RX     (256 * 1024)
+#define RP_GRACE_MS   50            // ждать копий после последней доставки
+
+typedef struct {
+    const char* cap_path;
+    const char* gw_path;
+    const char* backend;
+    const char* extra;
+    double      speed;
+    int         fast;
+    int         loops;
+    int         net;
+    int         threads;
+    int         linger_ms;
+    int         verbose;
+    uint16_t    port;
+} rp_opts_t;
+
+typedef struct {
+    int       master;
+    char      name[64];
+    slip_rx_t sent;                          // наш поток в шлюз: где кончаются кадры
+    uint8_t   sent_buf[ECU_MAX_FRAME_SIZE];
+    slip_rx_t got;                           // поток из шлюза в этот порт
+    uint8_t   got_buf[ECU_MAX_FRAME_SIZE];
+    uint8_t   pend[RP_PEND];
+    size_t    pend_len;
+} rp_port_t;
+
+typedef struct {
+    uint64_t key;     // 0 = свободно
+    uint64_t t_ns;    // отдан шлюзу
+    uint64_t done_ns; // доставлен (0 = в пути)
+    int      to_uart; // ждём на UART узла dst, иначе у клиента
+} rp_slot_t;
+
+typedef struct {
+    const rp_opts_t* o;
+    ecu_cap_reader_t rd;
+    uint8_t*  blk;
+    uint32_t  blk_idx;
+    uint32_t  blk_off;
+    int       blk_ok;
+    int       loop;
+    uint64_t  t0_ns;          // метка первой записи
+    uint64_t  last_ns;        // последней прочитанной (длина круга для -loop)
+    uint64_t  shift_ns;       // сдвиг меток на следующем круге
+    uint64_t  wall0_ns;
+
+    rp_port_t port[ECU_CAP_PORTS];
+    int       ports;
+    uint8_t   node_port[256];  // узел -> индекс UART + 1 (0 = не встречался)
+    int       sock;
+    uint8_t*  net_rx;
+    size_t    net_rx_len;
+    uint16_t  net_seq;
+    pid_t     gw_pid;
+
+    rp_slot_t* match;         // отданные кадры: открытая адресация, RP_MATCH_BITS
+    rp_slot_t* sweep;         // для match_sweep
+    uint32_t   used;
+    uint32_t   in_flight;     // ещё не доставлены
+
+    uint32_t* lat;            // мкс доставленных кадров
+    size_t    lat_n;
+    size_t    lat_cap;
+
+    uint64_t  chunks;
+    uint64_t  bytes;
+    uint64_t  frames_uart;    // целых кадров отдано в pty
+    uint64_t  frames_net;     // отправлено по TCP
+    uint64_t  bad_frames;     // битые кадры в записи (шлюз должен отбросить)
+    uint64_t  untracked;      // таблица полна — кадр не отслеживается
+    uint64_t  got_net;        // доставлено клиенту
+    uint64_t  got_uart;       // доставлено в pty
+    uint64_t  copies;         // тот же кадр на втором выходе (пересылка + копия клиенту)
+    uint64_t  other;          // на выходе, но не из записи (ответы шлюза и т.п.)
+    uint64_t  pty_full;       // ожиданий свободного места в pty
+} rp_t;
+
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ---- кадры в пути ----
+
+// Ключ кадра: CRC, seq, src, тип и длина — шлюз пересылает кадры без изменений
+static uint64_t frame_key(const uint8_t* f, size_t len)
+{
+    const ecu_hdr_t* h = (const ecu_hdr_t*)f;
+    uint64_t crc = (uint64_t)f[len - 2] | ((uint64_t)f[len - 1] << 8);
+    return crc | ((uint64_t)h->seq << 16) | ((uint64_t)h->src << 32) | ((uint64_t)h->msg_type << 40) |
+           ((uint64_t)(len & 0x7FFFu) << 48) | (1ull << 63);
+}
+
+static uint32_t slot_of(uint64_t key)
+{
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> (64 - RP_MATCH_BITS));
+}
+
+#define RP_MATCH_MASK ((1u << RP_MATCH_BITS) - 1u)
+#define RP_COPY_NS    1000000000ull   // сколько помнить доставленный кадр (его копии на других выходах)
+
+static void match_put(rp_t* rp, const rp_slot_t* s)
+{
+    uint32_t i = slot_of(s->key);
+    while (rp->match[i].key) i = (i + 1) & RP_MATCH_MASK;
+    rp->match[i] = *s;
+    rp->used++;
+}
+
+// Забыть доставленные давно: таблица собирается заново из оставшихся (удаления по одному нет)
+static void match_sweep(rp_t* rp, uint64_t now)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i <= RP_MATCH_MASK; i++) {
+        const rp_slot_t* s = &rp->match[i];
+        if (s->key && (s->done_ns == 0 || now - s->done_ns < RP_COPY_NS)) rp->sweep[n++] = *s;
+    }
+    memset(rp->match, 0, (RP_MATCH_MASK + 1u) * sizeof(*rp->match));
+    rp->used = 0;
+    for (uint32_t i = 0; i < n; i++) match_put(rp, &rp->sweep[i]);
+}
+
+static void match_add(rp_t* rp, const uint8_t* f, size_t len, uint64_t t, int to_uart)
+{
+    if (rp->used >= RP_MATCH_MASK / 2) match_sweep(rp, t);
+    if (rp->used >= RP_MATCH_MASK / 2) {
+        rp->untracked++;
+        return;
+    }
+    rp_slot_t s = { frame_key(f, len), t, 0, to_uart };
+    match_put(rp, &s);
+    rp->in_flight++;
+}
+
+// 1 = доставка туда, где кадр ждали (*t — время отправки), 2 = копия (другой выход или повтор),
+// 0 = не из записи. Одинаковые ключи (круги -loop) — берётся ещё не доставленный
+static int match_take(rp_t* rp, const uint8_t* f, size_t len, int to_net, uint64_t now, uint64_t* t)
+{
+    uint64_t key = frame_key(f, len);
+    int copy = 0;
+    for (uint32_t i = slot_of(key); rp->match[i].key; i = (i + 1) & RP_MATCH_MASK) {
+        rp_slot_t* s = &rp->match[i];
+        if (s->key != key) continue;
+        if (s->done_ns || s->to_uart == to_net) {
+            copy = 1;
+            continue;
+        }
+        s->done_ns = now;
+        *t = s->t_ns;
+        rp->in_flight--;
+        return 1;
+    }
+    return copy ? 2 : 0;
+}
+
+static void delivered(rp_t* rp, const uint8_t* f, size_t len, int to_net)
+{
+    const ecu_hdr_t* h;
+    const uint8_t* pl;
+    uint64_t now = now_ns(), t = 0;
+    int rc = ecu_frame_validate(f, len, &h, &pl) ? match_take(rp, f, len, to_net, now, &t) : 0;
+    if (rc == 0) {
+        rp->other++;
+        return;
+    }
+    if (rc == 2) {
+        rp->copies++;
+        return;
+    }
+    if (to_net) rp->got_net++;
+    else rp->got_uart++;
+    if (rp->lat_n == rp->lat_cap) {
+        size_t cap = rp->lat_cap ? rp->lat_cap * 2 : 65536;
+        uint32_t* p = (uint32_t*)realloc(rp->lat, cap * sizeof(*p));
+        if (!p) return;
+        rp->lat = p;
+        rp->lat_cap = cap;
+    }
+    uint64_t us = (now - t) / 1000u;
+    rp->lat[rp->lat_n++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+// ---- порты ----
+
+static int open_pty(char* name, size_t name_len)
+{
+    int m = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m < 0 || grantpt(m) < 0 || unlockpt(m) < 0) return -1;
+    const char* sn = ptsname(m);
+    if (!sn) return -1;
+    snprintf(name, name_len, "%s", sn);
+
+    struct termios t;
+    if (tcgetattr(m, &t) == 0) {
+        cfmakeraw(&t);
+        tcsetattr(m, TCSANOW, &t);
+    }
+    fcntl(m, F_SETFL, fcntl(m, F_GETFL) | O_NONBLOCK);
+    return m;
+}
+
+static void port_flush(rp_t* rp, rp_port_t* p)
+{
+    while (p->pend_len > 0) {
+        ssize_t w = write(p->master, p->pend, p->pend_len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) rp->pty_full++;
+            return;
+        }
+        memmove(p->pend, p->pend + w, p->pend_len - (size_t)w);
+        p->pend_len -= (size_t)w;
+    }
+}
+
+static void port_read(rp_t* rp, rp_port_t* p)
+{
+    uint8_t buf[8192];
+    for (;;) {
+        ssize_t r = read(p->master, buf, sizeof(buf));
+        if (r <= 0) return;
+        size_t off = 0;
+        while (off < (size_t)r) {
+            size_t flen = 0;
+            int rc = slip_rx_push(&p->got, buf + off, (size_t)r - off, &flen);
+            off += p->got.consumed;
+            if (rc == 1) delivered(rp, p->got_buf, flen, 0);
+        }
+    }
+}
+
+// ---- TCP ----
+
+static int tcp_connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    a.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+static int tcp_send_frame(int fd, const uint8_t* f, size_t len)
+{
+    uint8_t buf[4 + ECU_MAX_FRAME_SIZE];
+    uint32_t l = (uint32_t)len;
+    memcpy(buf, &l, 4);
+    memcpy(buf + 4, f, len);
+    size_t off = 0;
+    while (off < len + 4) {
+        ssize_t w = send(fd, buf + off, len + 4 - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                struct pollfd p = { fd, POLLOUT, 0 };
+                poll(&p, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+// Кадры из буфера TCP (u32 LE длина + кадр); fn = NULL — только счёт. -1 = соединение закрыто
+static int net_read(rp_t* rp, int (*fn)(void* arg, const uint8_t* f, size_t len), void* arg)
+{
+    for (;;) {
+        ssize_t r = recv(rp->sock, rp->net_rx + rp->net_rx_len, RP_NET_RX - rp->net_rx_len, MSG_DONTWAIT);
+        if (r == 0) return -1;
+        if (r < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        rp->net_rx_len += (size_t)r;
+
+        size_t off = 0;
+        while (rp->net_rx_len - off >= 4) {
+            uint32_t l;
+            memcpy(&l, rp->net_rx + off, 4);
+            if (l > ECU_MAX_FRAME_SIZE) return -1;
+            if (rp->net_rx_len - off - 4 < l) break;
+            if (fn) fn(arg, rp->net_rx + off + 4, l);
+            else delivered(rp, rp->net_rx + off + 4, l, 1);
+            off += 4 + l;
+        }
+        memmove(rp->net_rx, rp->net_rx + off, rp->net_rx_len - off);
+        rp->net_rx_len -= off;
+    }
+}
+
+// ---- запись ----
+
+// Следующая запись для повтора (сырые байты UART, с -net — кадры клиентов). NULL = конец
+static const ecu_cap_rec_t* next_rec(rp_t* rp)
+{
+    for (;;) {
+        if (!rp->blk_ok) {
+            if (rp->blk_idx >= rp->rd.blocks || ecu_cap_read_block(&rp->rd, rp->blk_idx, rp->blk) < 0) {
+                // конец файла (или испорченный хвост) — следующий круг
+                if (++rp->loop >= rp->o->loops) return NULL;
+                rp->shift_ns += rp->last_ns - rp->t0_ns + 1000000u;
+                rp->blk_idx = 0;
+                if (ecu_cap_read_block(&rp->rd, 0, rp->blk) < 0) return NULL;
+            }
+            rp->blk_ok = 1;
+            rp->blk_off = sizeof(ecu_cap_block_t);
+        }
+        const ecu_cap_rec_t* r = ecu_cap_next(rp->blk, rp->rd.hdr.block_size, &rp->blk_off);
+        if (!r) {
+            rp->blk_ok = 0;
+            rp->blk_idx++;
+            continue;
+        }
+        if (rp->t0_ns == 0) rp->t0_ns = r->ts_ns;
+        if (rp->loop == 0) rp->last_ns = r->ts_ns;
+        int uart = r->port < ECU_CAP_PORT_NET && r->port < rp->ports;
+        int net = r->port != ECU_CAP_PORT_NET_ALL && r->port != ECU_CAP_PORT_NONE && (r->port & ECU_CAP_PORT_NET);
+        if (r->dir != ECU_CAP_RX) continue;
+        if (uart && (r->flags & ECU_CAP_F_RAW)) return r;
+        if (net && rp->o->net && (r->flags & ECU_CAP_F_FRAME)) return r;
+    }
+}
+
+static uint64_t due_ns(const rp_t* rp, const ecu_cap_rec_t* r)
+{
+    if (rp->o->fast) return 0;
+    double rel = (double)(r->ts_ns - rp->t0_ns + rp->shift_ns) / rp->o->speed;
+    return rp->wall0_ns + (uint64_t)rel;
+}
+
+// Отдать запись шлюзу. 0 = очередь порта полна, подождать
+static int inject(rp_t* rp, const ecu_cap_rec_t* r, uint64_t now)
+{
+    const uint8_t* data = (const uint8_t*)(r + 1);
+    if (r->flags & ECU_CAP_F_FRAME) {
+        const ecu_hdr_t* h;
+        const uint8_t* pl;
+        if (!ecu_frame_validate(data, r->len, &h, &pl)) {
+            rp->bad_frames++;
+            return 1;
+        }
+        // кадр клиента уходит в UART узла dst; узлы вне записи (шлюз и т.п.) не отслеживаются
+        if (rp->node_port[h->dst]) match_add(rp, data, r->len, now, 1);
+        if (tcp_send_frame(rp->sock, data, r->len) < 0) g_stop = 1;
+        rp->frames_net++;
+        return 1;
+    }
+
+    rp_port_t* p = &rp->port[r->port];
+    if (p->pend_len + r->len > RP_PEND) {
+        port_flush(rp, p);
+        if (p->pend_len + r->len > RP_PEND) return 0;
+    }
+    memcpy(p->pend + p->pend_len, data, r->len);
+    p->pend_len += r->len;
+    rp->chunks++;
+    rp->bytes += r->len;
+
+    // целые кадры в отданных байтах — их и ждём на выходе
+    size_t off = 0;
+    while (off < r->len) {
+        size_t flen = 0;
+        int rc = slip_rx_push(&p->sent, data + off, r->len - off, &flen);
+        off += p->sent.consumed;
+        if (rc != 1) continue;
+        const ecu_hdr_t* h;
+        const uint8_t* pl;
+        if (!ecu_frame_validate(p->sent_buf, flen, &h, &pl)) {
+            rp->bad_frames++;
+            continue;
+        }
+        unsigned np = rp->node_port[h->dst];
+        match_add(rp, p->sent_buf, flen, now, np != 0 && np != r->port + 1u);
+        rp->frames_uart++;
+    }
+    port_flush(rp, p);
+    return 1;
+}
+
+// ---- шлюз ----
+
+// Узлы за каждым UART — src кадров в записи. Без nodes = шлюз узнаёт узел по первому кадру
+// от него, и пересылки к узлу до этого теряются — при повторе их быть не должно
+static void scan_nodes(rp_t* rp)
+{
+    for (uint32_t b = 0; b < rp->rd.blocks; b++) {
+        if (ecu_cap_read_block(&rp->rd, b, rp->blk) < 0) break;
+        uint32_t off = sizeof(ecu_cap_block_t);
+        const ecu_cap_rec_t* r;
+        while ((r = ecu_cap_next(rp->blk, rp->rd.hdr.block_size, &off)) != NULL) {
+            if (r->port >= rp->ports || r->dir != ECU_CAP_RX || !(r->flags & ECU_CAP_F_RAW)) continue;
+            rp_port_t* p = &rp->port[r->port];
+            const uint8_t* data = (const uint8_t*)(r + 1);
+            size_t pos = 0;
+            while (pos < r->len) {
+                size_t flen = 0;
+                int rc = slip_rx_push(&p->sent, data + pos, r->len - pos, &flen);
+                pos += p->sent.consumed;
+                const ecu_hdr_t* h;
+                const uint8_t* pl;
+                if (rc != 1 || !ecu_frame_validate(p->sent_buf, flen, &h, &pl)) continue;
+                if (h->src == ECU_NODE_PC || h->src == ECU_NODE_GW || rp->node_port[h->src]) continue;
+                rp->node_port[h->src] = (uint8_t)(r->port + 1);
+            }
+        }
+    }
+    for (int i = 0; i < rp->ports; i++) slip_rx_init(&rp->port[i].sent, rp->port[i].sent_buf, sizeof(rp->port[i].sent_buf));
+}
+
+// Заголовок секции -extra: 1 = [uart NAME] (имя в name), 0 = другая секция, -1 = не заголовок
+static int extra_section(const char* line, char* name, size_t name_len)
+{
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line != '[') return -1;
+    if (strncasecmp(line + 1, "uart", 4) != 0 || (line[5] != ' ' && line[5] != '\t')) return 0;
+    const char* p = line + 5;
+    while (*p == ' ' || *p == '\t') p++;
+    size_t n = strcspn(p, " \t]");
+    if (n >= name_len) n = name_len - 1;
+    memcpy(name, p, n);
+    name[n] = '\0';
+    return 1;
+}
+
+static int is_cap_uart(const rp_t* rp, const char* name)
+{
+    for (int u = 0; u < rp->ports; u++) {
+        if (strncmp(rp->rd.hdr.uart[u], name, ECU_CAP_NAME_MAX) == 0) return 1;
+    }
+    return 0;
+}
+
+// Строки -extra: uart < 0 — всё, кроме секций UART из записи; иначе тело секции [uart <uart>].
+// Секции UART из записи сливаются с нашими: иначе «duplicate uart», а порядок (индексы) — как в записи
+static void extra_copy(const rp_t* rp, FILE* x, FILE* f, int uart)
+{
+    char line[512], name[ECU_CAP_NAME_MAX + 1];
+    int in = 0;   // внутри секции UART из записи
+    rewind(x);
+    while (fgets(line, sizeof(line), x)) {
+        int sec = extra_section(line, name, sizeof(name));
+        if (sec >= 0) {
+            in = sec == 1 && is_cap_uart(rp, name);
+            if (in && uart >= 0) in = strncmp(rp->rd.hdr.uart[uart], name, ECU_CAP_NAME_MAX) == 0 ? 2 : 1;
+            if (uart < 0 && !in) fputs(line, f);
+            continue;
+        }
+        if (uart < 0 ? !in : in == 2) fputs(line, f);
+    }
+}
+
+static int write_config(const rp_t* rp, char* path, size_t path_len)
+{
+    const rp_opts_t* o = rp->o;
+    FILE* x = NULL;
+    if (o->extra && (x = fopen(o->extra, "r")) == NULL) return -1;
+    snprintf(path, path_len, "/tmp/gw_replay_%d.conf", (int)getpid());
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        if (x) fclose(x);
+        return -1;
+    }
+    fprintf(f, "[gateway]\nthreads = %d\nbackend = %s\n", o->threads, o->backend);
+    fprintf(f, "[net]\nport = %u\n", (unsigned)o->port);
+    for (int u = 0; u < rp->ports; u++) {
+        fprintf(f, "[uart %.16s]\ndev = %s\n", rp->rd.hdr.uart[u], rp->port[u].name);
+        const char* sep = "nodes = ";
+        for (int n = 0; n < 256; n++) {
+            if (rp->node_port[n] != u + 1) continue;
+            fprintf(f, "%s%d", sep, n);
+            sep = ", ";
+        }
+        if (sep[0] == ',') fputc('\n', f);
+        if (x) extra_copy(rp, x, f, u);
+    }
+    if (x) {
+        extra_copy(rp, x, f, -1);
+        fclose(x);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int start_gw(rp_t* rp, const char* conf)
+{
+    // порт ещё слушает прошлый шлюз: кольцо io_uring закрывается ядром уже после выхода процесса
+    for (int i = 0; i < 300; i++) {
+        int fd = tcp_connect(rp->o->port);
+        if (fd < 0) break;
+        close(fd);
+        usleep(10000);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        if (!rp->o->verbose) {
+            int nul = open("/dev/null", O_WRONLY);
+            if (nul >= 0) dup2(nul, STDERR_FILENO);
+        }
+        execl(rp->o->gw_path, rp->o->gw_path, "-config", conf, (char*)NULL);
+        _exit(127);
+    }
+    rp->gw_pid = pid;
+
+    // шлюз открывает UART до TCP: когда принял соединение, pty уже читаются
+    for (int i = 0; i < 300; i++) {
+        rp->sock = tcp_connect(rp->o->port);
+        if (rp->sock >= 0) return 0;
+        if (waitpid(pid, NULL, WNOHANG) == pid) {
+            rp->gw_pid = 0;
+            return -1;
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+typedef struct {
+    rp_t*    rp;
+    uint16_t seq;
+    int      acked;
+} stats_ctx_t;
+
+static int on_stats_frame(void* arg, const uint8_t* f, size_t len)
+{
+    stats_ctx_t* c = (stats_ctx_t*)arg;
+    const ecu_hdr_t* h;
+    const uint8_t* pl;
+    if (!ecu_frame_validate(f, len, &h, &pl) || h->src != ECU_NODE_GW) return 0;
+    if (h->msg_type == ECU_MSG_ACK) {
+        ecu_ack_v1_t ack;
+        if (h->payload_len >= sizeof(ack)) {
+            memcpy(&ack, pl, sizeof(ack));
+            if (ack.ack_seq == c->seq) c->acked = 1;
+        }
+        return 0;
+    }
+    if (h->msg_type != ECU_MSG_EVENT || h->payload_len < sizeof(ecu_event_hdr_t)) return 0;
+    ecu_event_hdr_t ev;
+    memcpy(&ev, pl, sizeof(ev));
+    if (ev.event_code != GW_CTL_GET_STATS) return 0;
+    for (size_t off = sizeof(ev); off + sizeof(gw_metrics_rec_t) <= sizeof(ev) + ev.data_len; off += sizeof(gw_metrics_rec_t)) {
+        gw_metrics_rec_t m;
+        memcpy(&m, pl + off, sizeof(m));
+        if (m.kind != GW_METRICS_UART || m.id >= c->rp->ports) continue;
+        printf("  gateway %-8.16s in %u frame(s), crc %u, framing %u, drops %u, rejected %u\n", c->rp->rd.hdr.uart[m.id],
+               (unsigned)m.frames_in, (unsigned)m.crc_errors, (unsigned)m.framing_errors, (unsigned)m.drops,
+               (unsigned)m.rejected);
+    }
+    return 0;
+}
+
+// Счётчики UART шлюза: потери и ошибки с его стороны
+static void gw_stats(rp_t* rp)
+{
+    uint8_t payload[sizeof(ecu_command_hdr_t) + 1];
+    ecu_command_hdr_t ch = { GW_CTL_GET_STATS, 1 };
+    memcpy(payload, &ch, sizeof(ch));
+    payload[sizeof(ch)] = GW_METRICS_UART;
+
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.src = ECU_NODE_PC;
+    h.dst = ECU_NODE_GW;
+    h.seq = ++rp->net_seq;
+    h.flags = ECU_F_ACK_REQUIRED;
+    h.payload_len = sizeof(payload);
+    uint8_t f[ECU_MAX_FRAME_SIZE];
+    size_t len = ecu_frame_pack(&h, payload, f, sizeof(f));
+    if (len == 0 || tcp_send_frame(rp->sock, f, len) < 0) return;
+
+    stats_ctx_t c = { rp, h.seq, 0 };
+    uint64_t end = now_ns() + 1000000000u;
+    while (!c.acked && now_ns() < end) {
+        struct pollfd p = { rp->sock, POLLIN, 0 };
+        if (poll(&p, 1, 100) <= 0) continue;
+        if (net_read(rp, on_stats_frame, &c) < 0) break;
+    }
+}
+
+// ---- отчёт ----
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(rp_t* rp, double secs)
+{
+    const rp_opts_t* o = rp->o;
+    printf("replay: %s, %d loop(s), ", o->cap_path, o->loops);
+    if (o->fast) printf("as fast as possible\n");
+    else printf("speed x%g\n", o->speed);
+    printf("  sent      %llu chunk(s), %llu byte(s) in %.3f s (%.1f KB/s), %llu frame(s) to UARTs, %llu to TCP\n",
+           (unsigned long long)rp->chunks, (unsigned long long)rp->bytes, secs,
+           secs > 0 ? (double)rp->bytes / 1024.0 / secs : 0.0, (unsigned long long)rp->frames_uart,
+           (unsigned long long)rp->frames_net);
+    printf("  delivered %llu to client, %llu to UARTs, %u not delivered, %llu copies, %llu other, %llu bad in capture\n",
+           (unsigned long long)rp->got_net, (unsigned long long)rp->got_uart, (unsigned)rp->in_flight,
+           (unsigned long long)rp->copies, (unsigned long long)rp->other, (unsigned long long)rp->bad_frames);
+    if (o->verbose && rp->in_flight) {
+        // какие кадры потерялись: src/тип/seq из ключа
+        unsigned shown = 0;
+        for (uint32_t i = 0; i <= RP_MATCH_MASK && shown < 20; i++) {
+            const rp_slot_t* s = &rp->match[i];
+            if (!s->key || s->done_ns) continue;
+            printf("  lost      src %u type 0x%02x seq %u len %u\n", (unsigned)((s->key >> 32) & 0xFF),
+                   (unsigned)((s->key >> 40) & 0xFF), (unsigned)((s->key >> 16) & 0xFFFF),
+                   (unsigned)((s->key >> 48) & 0x7FFF));
+            shown++;
+        }
+    }
+    if (rp->untracked || rp->pty_full) {
+        printf("  untracked %llu frame(s), pty full %llu time(s)\n", (unsigned long long)rp->untracked,
+               (unsigned long long)rp->pty_full);
+    }
+    if (rp->lat_n > 0) {
+        qsort(rp->lat, rp->lat_n, sizeof(*rp->lat), cmp_u32);
+        const double q[] = { 0.5, 0.9, 0.99, 0.999 };
+        uint32_t v[4];
+        for (int i = 0; i < 4; i++) {
+            size_t k = (size_t)(q[i] * (double)rp->lat_n);
+            v[i] = rp->lat[k < rp->lat_n ? k : rp->lat_n - 1];
+        }
+        printf("  latency   us: min %u p50 %u p90 %u p99 %u p99.9 %u max %u\n", (unsigned)rp->lat[0], (unsigned)v[0],
+               (unsigned)v[1], (unsigned)v[2], (unsigned)v[3], (unsigned)rp->lat[rp->lat_n - 1]);
+    }
+}
+
+static int run(rp_t* rp)
+{
+    const rp_opts_t* o = rp->o;
+    int np = 0;
+    struct pollfd pfd[ECU_CAP_PORTS + 1];
+
+    rp->wall0_ns = now_ns();
+    const ecu_cap_rec_t* r = next_rec(rp);
+    uint64_t end_ns = 0;
+
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        while (r && (o->fast || due_ns(rp, r) <= now)) {
+            if (!inject(rp, r, now)) break;
+            r = next_rec(rp);
+        }
+        int pending = 0;
+        for (int i = 0; i < rp->ports; i++) pending |= rp->port[i].pend_len > 0;
+        if (!r && !pending && end_ns == 0) end_ns = now + (uint64_t)o->linger_ms * 1000000u;
+        // всё доставлено — остаток linger только на копии (RP_GRACE_MS)
+        if (end_ns && rp->in_flight == 0 && end_ns > now + RP_GRACE_MS * 1000000ull) {
+            end_ns = now + RP_GRACE_MS * 1000000ull;
+        }
+        if (end_ns && now >= end_ns) break;
+
+        int timeout = 100;
+        if (r && !o->fast) {
+            uint64_t d = due_ns(rp, r);
+            timeout = d > now ? (int)((d - now + 999999u) / 1000000u) : 0;
+            if (timeout > 100) timeout = 100;
+        } else if (end_ns) {
+            timeout = (int)((end_ns - now) / 1000000u) + 1;
+        }
+
+        np = 0;
+        for (int i = 0; i < rp->ports; i++) {
+            pfd[np].fd = rp->port[i].master;
+            pfd[np].events = POLLIN | (rp->port[i].pend_len ? POLLOUT : 0);
+            np++;
+        }
+        pfd[np].fd = rp->sock;
+        pfd[np].events = POLLIN;
+        np++;
+        if (poll(pfd, (nfds_t)np, timeout) < 0 && errno != EINTR) return -1;
+
+        for (int i = 0; i < rp->ports; i++) {
+            if (pfd[i].revents & POLLIN) port_read(rp, &rp->port[i]);
+            if (pfd[i].revents & POLLOUT) port_flush(rp, &rp->port[i]);
+        }
+        if ((pfd[np - 1].revents & (POLLIN | POLLHUP | POLLERR)) && net_read(rp, NULL, NULL) < 0) {
+            fprintf(stderr, "gw_replay: gateway closed the connection\n");
+            return -1;
+        }
+        if (waitpid(rp->gw_pid, NULL, WNOHANG) == rp->gw_pid) {
+            rp->gw_pid = 0;
+            fprintf(stderr, "gw_replay: gateway exited\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+            "Usage: %s -cap FILE.ecap [-gw PATH] [-speed X | -fast] [-loop N] [-net] [-backend epoll|io_uring]\n"
+            "          [-threads 0|1] [-port P] [-linger MS] [-extra FILE] [-v]\n",
+            argv0);
+}
+
+int main(int argc, char** argv)
+{
+    rp_opts_t o;
+    memset(&o, 0, sizeof(o));
+    o.gw_path = "./ecu_gw";
+    o.backend = "epoll";
+    o.speed = 1.0;
+    o.loops = 1;
+    o.linger_ms = 2000;
+    o.port = 19300;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "-cap") == 0 && v) { o.cap_path = v; i++; }
+        else if (strcmp(a, "-gw") == 0 && v) { o.gw_path = v; i++; }
+        else if (strcmp(a, "-speed") == 0 && v) { o.speed = atof(v); i++; }
+        else if (strcmp(a, "-fast") == 0) o.fast = 1;
+        else if (strcmp(a, "-loop") == 0 && v) { o.loops = atoi(v); i++; }
+        else if (strcmp(a, "-net") == 0) o.net = 1;
+        else if (strcmp(a, "-backend") == 0 && v) { o.backend = v; i++; }
+        else if (strcmp(a, "-threads") == 0 && v) { o.threads = atoi(v); i++; }
+        else if (strcmp(a, "-port") == 0 && v) { o.port = (uint16_t)atoi(v); i++; }
+        else if (strcmp(a, "-linger") == 0 && v) { o.linger_ms = atoi(v); i++; }
+        else if (strcmp(a, "-extra") == 0 && v) { o.extra = v; i++; }
+        else if (strcmp(a, "-v") == 0) o.verbose = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!o.cap_path || o.speed <= 0 || o.loops < 1 || o.linger_ms < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    static rp_t rp;
+    rp.o = &o;
+    rp.sock = -1;
+    if (ecu_cap_reader_open(&rp.rd, o.cap_path) < 0) {
+        fprintf(stderr, "%s: %s\n", o.cap_path, errno == EINVAL ? "not a capture file" : strerror(errno));
+        return 1;
+    }
+    while (rp.ports < ECU_CAP_PORTS && rp.rd.hdr.uart[rp.ports][0]) rp.ports++;
+    rp.blk = (uint8_t*)malloc(rp.rd.hdr.block_size);
+    rp.match = (rp_slot_t*)calloc(RP_MATCH_MASK + 1u, sizeof(*rp.match));
+    rp.sweep = (rp_slot_t*)malloc((RP_MATCH_MASK / 2 + 1u) * sizeof(*rp.sweep));
+    rp.net_rx = (uint8_t*)malloc(RP_NET_RX);
+    if (!rp.blk || !rp.match || !rp.sweep || !rp.net_rx || rp.ports == 0) {
+        fprintf(stderr, "gw_replay: %s\n", rp.ports == 0 ? "no UARTs in capture" : "out of memory");
+        return 1;
+    }
+    for (int i = 0; i < rp.ports; i++) {
+        rp_port_t* p = &rp.port[i];
+        p->master = open_pty(p->name, sizeof(p->name));
+        if (p->master < 0) {
+            perror("pty");
+            return 1;
+        }
+        slip_rx_init(&p->sent, p->sent_buf, sizeof(p->sent_buf));
+        slip_rx_init(&p->got, p->got_buf, sizeof(p->got_buf));
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    scan_nodes(&rp);
+    char conf[64];
+    if (write_config(&rp, conf, sizeof(conf)) < 0) {
+        perror("config");
+        return 1;
+    }
+    int rc = start_gw(&rp, conf);
+    if (rc < 0) {
+        fprintf(stderr, "gw_replay: %s did not start\n", o.gw_path);
+    } else {
+        fcntl(rp.sock, F_SETFL, fcntl(rp.sock, F_GETFL) | O_NONBLOCK);
+        uint64_t t0 = now_ns();
+        rc = run(&rp);
+        double secs = (double)(now_ns() - t0) / 1e9;
+        report(&rp, secs);
+        if (rp.gw_pid) gw_stats(&rp);
+    }
+
+    if (rp.sock >= 0) close(rp.sock);
+    if (rp.gw_pid) {
+        kill(rp.gw_pid, SIGTERM);
+        waitpid(rp.gw_pid, NULL, 0);
+    }
+    unlink(conf);
+    ecu_cap_reader_close(&rp.rd);
+    return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,1044 @@
+// Длительный прогон ecu_gw без плат: шлюз на pty узлов due_emu, несколько TCP подписчиков и
+// отправителей команд. Тест для CTest: код выхода 0 — все проверки пройдены.
+//
+// Проверки:
+//  - ноль потерь: у каждого соединения seq кадров каждого узла идёт подряд (узел нумерует все
+//    свои кадры одним счётчиком; ACK шлюз отдаёт только соединению, откуда пришла команда, —
+//    пропуск засчитывается, если кадр с этим seq пришёл как ACK в другое соединение), нет битых
+//    кадров, каждая команда получила ACK со status 0 и с seq этой команды;
+//  - темп: телеметрия каждого узла приходит не медленнее -min_rate от заданного -rate;
+//  - память: рост VmRSS шлюза после прогрева (-warmup) не больше -max_rss КБ;
+//  - задержка: p99 ACK команды (PC -> шлюз -> узел -> шлюз -> PC) не больше -max_p99 мкс;
+//  - дескрипторы: после отключения всех клиентов у шлюза столько же fd, сколько до подключения
+//    (с -churn подписчики ещё и переподключаются по ходу прогона);
+//  - счётчики UART шлюза (GW_CTL_GET_STATS): нет ошибок CRC/SLIP, сбросов и отказов очереди.
+//
+//   gw_soak -gw PATH -emu PATH [-backend epoll|io_uring] [-threads 0|1] [-nodes N] [-rate HZ]
+//           [-subs N] [-senders N] [-cmd_rate N] [-time SEC] [-warmup SEC] [-churn SEC]
+//           [-min_rate F] [-max_p99 US] [-max_rss KB] [-timeout MS] [-keep] [-v]
+//
+// Рабочий каталог /tmp/gw_soak.XXXXXX (конфигурация, вывод due_emu и stderr шлюза) удаляется
+// после успешного прогона и остаётся при ошибке или с -keep.
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "gw/gw_ctl.h"
+#include "gw/gw_metrics.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define SK_CONNS_MAX 32
+#define SK_NODES_MAX 8               // как у due_emu
+#define SK_RX        (256 * 1024)
+#define SK_TX        (64 * 1024)
+#define SK_RING_BITS 16              // команды в пути, в порядке отправки
+#define SK_SAMPLE_NS 250000000u      // опрос /proc шлюза
+
+typedef struct {
+    const char* gw_path;
+    const char* emu_path;
+    const char* backend;
+    int         threads;
+    int         nodes;
+    double      rate;        // телеметрия узла, Гц
+    int         subs;        // только приём
+    int         senders;     // приём + команды
+    double      cmd_rate;    // команд/с всего
+    double      time_s;
+    double      warmup_s;
+    double      churn_s;     // переподключение подписчика раз в N с (0 = нет)
+    double      min_rate;    // доля -rate
+    unsigned    max_p99_us;
+    unsigned    max_rss_kb;
+    unsigned    timeout_ms;
+    int         keep;
+    int         verbose;
+} sk_opts_t;
+
+enum { SK_FREE, SK_SENT, SK_ACKED, SK_EXPIRED };
+
+typedef struct {
+    uint64_t t_ns;
+    uint8_t  conn;
+    uint8_t  state;  // SK_*
+} sk_slot_t;
+
+typedef struct {
+    uint8_t  node;
+    uint16_t seq;
+    uint64_t t_ns;
+} sk_ring_t;
+
+// Пропущенный в соединении seq узла: прощается, только если это ACK команды другого соединения,
+// дошедший до него (шлюз отдаёт ACK только отправителю команды)
+typedef struct {
+    uint8_t  node;
+    uint16_t seq;
+    uint64_t t_ns;
+} sk_skip_t;
+
+// ACK идёт в другое соединение примерно тогда же, когда в этом виден пропуск (seq узла не
+// успевает пройти круг)
+#define SK_SKIP_WINDOW_NS 2000000000ull
+
+// Поток кадров одного узла в одном соединении
+typedef struct {
+    int      have;
+    uint16_t last;
+    uint64_t frames;
+    uint64_t telemetry;
+    uint64_t gaps;     // пропущено seq
+    uint64_t dups;     // повтор или шаг назад
+} sk_flow_t;
+
+typedef struct {
+    int       fd;
+    int       sender;
+    uint8_t   rx[SK_RX];
+    size_t    rx_len;
+    uint8_t   tx[SK_TX];
+    size_t    tx_len;
+    sk_flow_t flow[SK_NODES_MAX];
+    sk_skip_t* skip;     // пропуски seq, проверяются в report()
+    size_t    skip_n;
+    size_t    skip_cap;
+    uint64_t  bad;
+    unsigned  reconnects;
+} sk_conn_t;
+
+typedef struct {
+    uint16_t   seq;
+    uint64_t   sent;
+    uint64_t   acked;
+    uint64_t   lost;
+    uint64_t   status_err;
+    sk_slot_t* slot;       // 65536 по seq
+    uint64_t*  ack_t_ns;   // 65536 по seq кадра ACK узла: когда пришёл к отправителю команды
+    uint8_t*   ack_conn;   // 65536 по seq кадра ACK узла: какому соединению (отправитель)
+} sk_node_t;
+
+typedef struct {
+    const sk_opts_t* o;
+    char       dir[64];
+    uint16_t   port;
+    pid_t      gw_pid;
+    pid_t      emu_pid;
+
+    sk_conn_t* conn;
+    int        conns;
+    sk_node_t  node[SK_NODES_MAX];
+    sk_ring_t* ring;
+    uint32_t   ring_head;
+    uint32_t   ring_tail;
+    int        next_conn;
+    int        next_node;
+    int        next_churn;
+    uint16_t   ctl_seq;
+
+    uint32_t*  lat;        // мкс
+    size_t     lat_n;
+    size_t     lat_cap;
+
+    uint64_t   sent;
+    uint64_t   acked;
+    uint64_t   lost;
+    uint64_t   held;       // seq узла ещё в пути или буфер полон — команда пропущена
+
+    long       fd_base;    // fd шлюза без клиентов
+    long       fd_max;
+    long       fd_end;
+    long       rss_warm;   // КБ после прогрева
+    long       rss_max;
+    long       rss_end;
+
+    gw_metrics_rec_t uart[SK_NODES_MAX];
+    int        uart_n;
+    int        stats_done;
+
+    int        failed;
+} sk_t;
+
+#define SK_RING_MASK ((1u << SK_RING_BITS) - 1u)
+
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void fail(sk_t* sk, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void fail(sk_t* sk, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    printf("  FAIL      ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+    sk->failed = 1;
+}
+
+// ---- процессы ----
+
+static pid_t spawn(char* const argv[], const char* out, const char* err)
+{
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int in = open("/dev/null", O_RDONLY);
+        int o1 = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int o2 = open(err, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (in >= 0) dup2(in, STDIN_FILENO);
+        if (o1 >= 0) dup2(o1, STDOUT_FILENO);
+        if (o2 >= 0) dup2(o2, STDERR_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+// SIGTERM, через 3 с — SIGKILL. Возврат — статус waitpid или -1
+static int stop_child(pid_t* pid)
+{
+    if (*pid <= 0) return -1;
+    int status = -1;
+    kill(*pid, SIGTERM);
+    for (int i = 0; i < 300; i++) {
+        if (waitpid(*pid, &status, WNOHANG) == *pid) {
+            *pid = 0;
+            return status;
+        }
+        usleep(10000);
+    }
+    kill(*pid, SIGKILL);
+    waitpid(*pid, &status, 0);
+    *pid = 0;
+    return -1;
+}
+
+static int child_exited(pid_t* pid)
+{
+    if (*pid <= 0) return 1;
+    if (waitpid(*pid, NULL, WNOHANG) != *pid) return 0;
+    *pid = 0;
+    return 1;
+}
+
+static int count_lines(const char* path, const char* prefix)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    char line[256];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, prefix, strlen(prefix)) == 0) n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static void print_file(const char* path, const char* title)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+    char line[512];
+    int n = 0;
+    while (fgets(line, sizeof(line), f) && n < 40) {
+        if (n++ == 0) printf("  --- %s\n", title);
+        printf("  | %s", line);
+    }
+    fclose(f);
+}
+
+static long proc_rss_kb(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %ld", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static long proc_fds(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+    DIR* d = opendir(path);
+    if (!d) return -1;
+    long n = 0;
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] != '.') n++;
+    }
+    closedir(d);
+    return n;
+}
+
+// Свободный порт: bind(0) и сразу закрыть (шлюз займёт его следом)
+static uint16_t free_port(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t al = sizeof(a);
+    uint16_t port = 0;
+    if (bind(fd, (struct sockaddr*)&a, sizeof(a)) == 0 && getsockname(fd, (struct sockaddr*)&a, &al) == 0) {
+        port = ntohs(a.sin_port);
+    }
+    close(fd);
+    return port;
+}
+
+static int tcp_connect(uint16_t port)
+{
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void path_in(const sk_t* sk, char* out, size_t out_len, const char* name)
+{
+    snprintf(out, out_len, "%s/%s", sk->dir, name);
+}
+
+// due_emu с -conf, затем ecu_gw на его pty. 0 = шлюз принимает соединения
+static int start(sk_t* sk)
+{
+    const sk_opts_t* o = sk->o;
+    char emu_conf[96], emu_out[96], link[96], gw_conf[96], gw_out[96], err[96];
+    path_in(sk, emu_conf, sizeof(emu_conf), "due.conf");
+    path_in(sk, emu_out, sizeof(emu_out), "due_emu.out");
+    path_in(sk, link, sizeof(link), "due%d");
+    path_in(sk, gw_conf, sizeof(gw_conf), "gw.conf");
+    path_in(sk, gw_out, sizeof(gw_out), "ecu_gw.out");
+    path_in(sk, err, sizeof(err), "stderr");
+
+    char nodes[16], rate[32];
+    snprintf(nodes, sizeof(nodes), "%d", o->nodes);
+    snprintf(rate, sizeof(rate), "%g", o->rate);
+    char* emu_argv[] = { (char*)o->emu_path, "-nodes", nodes, "-link", link, "-conf", emu_conf, "-rate", rate,
+                         NULL };
+    sk->emu_pid = spawn(emu_argv, emu_out, err);
+    if (sk->emu_pid < 0) return -1;
+    for (int i = 0; count_lines(emu_out, "node ") < o->nodes; i++) {
+        if (i == 500 || child_exited(&sk->emu_pid)) {
+            fprintf(stderr, "gw_soak: %s did not start\n", o->emu_path);
+            return -1;
+        }
+        usleep(10000);
+    }
+
+    sk->port = free_port();
+    FILE* f = fopen(gw_conf, "w");
+    FILE* x = fopen(emu_conf, "r");
+    if (!f || !x || sk->port == 0) {
+        if (f) fclose(f);
+        if (x) fclose(x);
+        fprintf(stderr, "gw_soak: %s: %s\n", gw_conf, strerror(errno));
+        return -1;
+    }
+    fprintf(f, "[gateway]\nthreads = %d\nbackend = %s\n", o->threads, o->backend);
+    // +1: при -churn новое соединение может прийти раньше, чем шлюз закроет старое
+    fprintf(f, "[net]\nport = %u\nmax_clients = %d\n", (unsigned)sk->port, sk->conns + 1);
+    char line[256];
+    while (fgets(line, sizeof(line), x)) fputs(line, f);
+    fclose(x);
+    fclose(f);
+
+    char* gw_argv[] = { (char*)o->gw_path, "-config", gw_conf, NULL };
+    sk->gw_pid = spawn(gw_argv, gw_out, err);
+    if (sk->gw_pid < 0) return -1;
+    // шлюз открывает UART до TCP: принял соединение — pty уже читаются
+    for (int i = 0; i < 500; i++) {
+        int fd = tcp_connect(sk->port);
+        if (fd >= 0) {
+            close(fd);
+            return 0;
+        }
+        if (child_exited(&sk->gw_pid)) break;
+        usleep(10000);
+    }
+    fprintf(stderr, "gw_soak: %s did not start\n", o->gw_path);
+    return -1;
+}
+
+// fd шлюза: ждём want (до 3 с) или, при want < 0, пока число не держится 200 мс
+static long settle_fds(sk_t* sk, long want)
+{
+    long n = -1, prev = -1;
+    int same = 0;
+    for (int i = 0; i < 300; i++) {
+        n = proc_fds(sk->gw_pid);
+        if (want >= 0 ? n == want : (n == prev && ++same >= 20)) break;
+        if (n != prev) same = 0;
+        prev = n;
+        usleep(10000);
+    }
+    return n;
+}
+
+// ---- соединения ----
+
+static int conn_open(sk_t* sk, sk_conn_t* c)
+{
+    c->fd = tcp_connect(sk->port);
+    c->rx_len = 0;
+    c->tx_len = 0;
+    for (int i = 0; i < SK_NODES_MAX; i++) c->flow[i].have = 0;
+    return c->fd < 0 ? -1 : 0;
+}
+
+static void conn_close(sk_conn_t* c)
+{
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+}
+
+static void conn_flush(sk_conn_t* c)
+{
+    size_t off = 0;
+    while (off < c->tx_len) {
+        ssize_t w = send(c->fd, c->tx + off, c->tx_len - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += (size_t)w;
+    }
+    memmove(c->tx, c->tx + off, c->tx_len - off);
+    c->tx_len -= off;
+}
+
+static int conn_queue(sk_conn_t* c, const ecu_hdr_t* h, const uint8_t* payload)
+{
+    if (c->tx_len + 4 + ECU_MAX_FRAME_SIZE > sizeof(c->tx)) return -1;
+    size_t len = ecu_frame_pack(h, payload, c->tx + c->tx_len + 4, sizeof(c->tx) - c->tx_len - 4);
+    if (len == 0) return -1;
+    uint32_t l = (uint32_t)len;
+    memcpy(c->tx + c->tx_len, &l, 4);
+    c->tx_len += 4 + len;
+    return 0;
+}
+
+static void lat_add(sk_t* sk, uint64_t ns)
+{
+    if (sk->lat_n == sk->lat_cap) {
+        size_t cap = sk->lat_cap ? sk->lat_cap * 2 : 65536;
+        uint32_t* p = (uint32_t*)realloc(sk->lat, cap * sizeof(*p));
+        if (!p) return;
+        sk->lat = p;
+        sk->lat_cap = cap;
+    }
+    uint64_t us = ns / 1000u;
+    sk->lat[sk->lat_n++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+// PING следующему узлу по кругу от следующего отправителя
+static void send_cmd(sk_t* sk, uint64_t now)
+{
+    const sk_opts_t* o = sk->o;
+    sk_conn_t* c = &sk->conn[sk->next_conn];
+    sk->next_conn = (sk->next_conn + 1) % o->senders;
+    int ni = sk->next_node;
+    sk->next_node = (ni + 1) % o->nodes;
+    sk_node_t* n = &sk->node[ni];
+    uint16_t seq = (uint16_t)(n->seq + 1);
+    if (seq == 0) seq = 1;
+    if (c->fd < 0 || n->slot[seq].state == SK_SENT || sk->ring_head - sk->ring_tail > SK_RING_MASK) {
+        sk->held++;
+        return;
+    }
+
+    ecu_command_hdr_t ch = { 7, 0 };   // PING
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.src = ECU_NODE_PC;
+    h.dst = (uint8_t)(1 + ni);
+    h.seq = seq;
+    h.flags = ECU_F_ACK_REQUIRED;
+    h.payload_len = sizeof(ch);
+    if (conn_queue(c, &h, (const uint8_t*)&ch) < 0) {
+        sk->held++;
+        return;
+    }
+
+    n->seq = seq;
+    n->slot[seq].t_ns = now;
+    n->slot[seq].conn = (uint8_t)(c - sk->conn);
+    n->slot[seq].state = SK_SENT;
+    n->sent++;
+    sk->sent++;
+    sk_ring_t* r = &sk->ring[sk->ring_head++ & SK_RING_MASK];
+    r->node = (uint8_t)ni;
+    r->seq = seq;
+    r->t_ns = now;
+}
+
+static void expire(sk_t* sk, uint64_t now, int all)
+{
+    uint64_t to = (uint64_t)sk->o->timeout_ms * 1000000u;
+    while (sk->ring_tail != sk->ring_head) {
+        sk_ring_t* r = &sk->ring[sk->ring_tail & SK_RING_MASK];
+        sk_node_t* n = &sk->node[r->node];
+        sk_slot_t* s = &n->slot[r->seq];
+        if (s->state == SK_SENT && s->t_ns == r->t_ns) {
+            if (!all && now - r->t_ns < to) break;
+            n->lost++;
+            sk->lost++;
+            s->state = SK_EXPIRED;
+        }
+        sk->ring_tail++;
+    }
+}
+
+// Ответ шлюза на GW_CTL_GET_STATS: записи UART
+static void on_ctl(sk_t* sk, const ecu_hdr_t* h, const uint8_t* pl)
+{
+    if (h->msg_type == ECU_MSG_ACK) {
+        ecu_ack_v1_t ack;
+        if (h->payload_len < sizeof(ack)) return;
+        memcpy(&ack, pl, sizeof(ack));
+        if (ack.ack_seq == sk->ctl_seq) sk->stats_done = 1;
+        return;
+    }
+    if (h->msg_type != ECU_MSG_EVENT || h->payload_len < sizeof(ecu_event_hdr_t)) return;
+    ecu_event_hdr_t ev;
+    memcpy(&ev, pl, sizeof(ev));
+    if (ev.event_code != GW_CTL_GET_STATS) return;
+    for (size_t off = sizeof(ev); off + sizeof(gw_metrics_rec_t) <= sizeof(ev) + ev.data_len &&
+                                  sk->uart_n < SK_NODES_MAX;
+         off += sizeof(gw_metrics_rec_t)) {
+        gw_metrics_rec_t m;
+        memcpy(&m, pl + off, sizeof(m));
+        if (m.kind == GW_METRICS_UART) sk->uart[sk->uart_n++] = m;
+    }
+}
+
+static void skip_add(sk_conn_t* c, int ni, uint16_t seq, uint64_t now)
+{
+    if (c->skip_n == c->skip_cap) {
+        size_t cap = c->skip_cap ? c->skip_cap * 2 : 1024;
+        sk_skip_t* p = (sk_skip_t*)realloc(c->skip, cap * sizeof(*p));
+        if (!p) {
+            c->flow[ni].gaps++;
+            return;
+        }
+        c->skip = p;
+        c->skip_cap = cap;
+    }
+    sk_skip_t* s = &c->skip[c->skip_n++];
+    s->node = (uint8_t)ni;
+    s->seq = seq;
+    s->t_ns = now;
+}
+
+static void on_frame(sk_t* sk, sk_conn_t* c, const uint8_t* f, size_t len, uint64_t now)
+{
+    const ecu_hdr_t* h;
+    const uint8_t* pl;
+    if (!ecu_frame_validate(f, len, &h, &pl)) {
+        c->bad++;
+        return;
+    }
+    if (h->src == ECU_NODE_GW) {
+        if (h->dst == ECU_NODE_PC && c == &sk->conn[0]) on_ctl(sk, h, pl);
+        return;
+    }
+    int ni = (int)h->src - 1;
+    if (ni < 0 || ni >= sk->o->nodes) return;
+
+    sk_flow_t* fl = &c->flow[ni];
+    fl->frames++;
+    if (h->msg_type == ECU_MSG_TELEMETRY) fl->telemetry++;
+    if (!fl->have) {
+        fl->have = 1;
+        fl->last = h->seq;
+    } else {
+        uint16_t d = (uint16_t)(h->seq - fl->last);
+        if (d == 0 || d >= 0x8000u) {
+            fl->dups++;
+        } else {
+            for (uint16_t k = 1; k < d; k++) skip_add(c, ni, (uint16_t)(fl->last + k), now);
+            fl->last = h->seq;
+        }
+    }
+
+    // ACK засчитываем в соединении, откуда ушла команда
+    if (h->msg_type != ECU_MSG_ACK || h->dst != ECU_NODE_PC || h->payload_len < sizeof(ecu_ack_v1_t)) return;
+    ecu_ack_v1_t ack;
+    memcpy(&ack, pl, sizeof(ack));
+    sk_node_t* n = &sk->node[ni];
+    sk_slot_t* s = &n->slot[ack.ack_seq];
+    if (s->state == SK_FREE || s->conn != (uint8_t)(c - sk->conn)) return;
+    // ACK своей команды: в остальных соединениях этот seq узла — не потеря
+    n->ack_t_ns[h->seq] = now;
+    n->ack_conn[h->seq] = s->conn;
+    if (s->state != SK_SENT) return;
+    lat_add(sk, now - s->t_ns);
+    if (ack.status_code != 0) n->status_err++;
+    n->acked++;
+    sk->acked++;
+    s->state = SK_ACKED;
+}
+
+// Кадры соединения (u32 LE длина + кадр). -1 = соединение закрыто
+static int conn_read(sk_t* sk, sk_conn_t* c, uint64_t now)
+{
+    for (;;) {
+        ssize_t r = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+        if (r == 0) return -1;
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        c->rx_len += (size_t)r;
+        size_t off = 0;
+        while (c->rx_len - off >= 4) {
+            uint32_t l;
+            memcpy(&l, c->rx + off, 4);
+            if (l > ECU_MAX_FRAME_SIZE) return -1;
+            if (c->rx_len - off < 4 + l) break;
+            on_frame(sk, c, c->rx + off + 4, l, now);
+            off += 4 + l;
+        }
+        memmove(c->rx, c->rx + off, c->rx_len - off);
+        c->rx_len -= off;
+    }
+}
+
+static void request_stats(sk_t* sk)
+{
+    uint8_t payload[sizeof(ecu_command_hdr_t) + 1];
+    ecu_command_hdr_t ch = { GW_CTL_GET_STATS, 1 };
+    memcpy(payload, &ch, sizeof(ch));
+    payload[sizeof(ch)] = GW_METRICS_UART;
+
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.src = ECU_NODE_PC;
+    h.dst = ECU_NODE_GW;
+    h.seq = ++sk->ctl_seq;
+    h.flags = ECU_F_ACK_REQUIRED;
+    h.payload_len = sizeof(payload);
+    sk->uart_n = 0;
+    sk->stats_done = 0;
+    if (conn_queue(&sk->conn[0], &h, payload) < 0) sk->stats_done = -1;
+}
+
+// ---- прогон ----
+
+static void sample(sk_t* sk, uint64_t now, uint64_t warm_ns)
+{
+    long rss = proc_rss_kb(sk->gw_pid);
+    long fds = proc_fds(sk->gw_pid);
+    if (fds > sk->fd_max) sk->fd_max = fds;
+    if (now < warm_ns || rss < 0) return;
+    if (sk->rss_warm < 0) sk->rss_warm = rss;
+    if (rss > sk->rss_max) sk->rss_max = rss;
+}
+
+static int run(sk_t* sk)
+{
+    const sk_opts_t* o = sk->o;
+    struct pollfd pfd[SK_CONNS_MAX];
+    uint64_t t0 = now_ns();
+    uint64_t warm_ns = t0 + (uint64_t)(o->warmup_s * 1e9);
+    uint64_t end_ns = t0 + (uint64_t)(o->time_s * 1e9);
+    uint64_t period = o->cmd_rate > 0 && o->senders > 0 ? (uint64_t)(1e9 / o->cmd_rate) : 0;
+    uint64_t next_ns = t0;
+    uint64_t sample_ns = t0;
+    uint64_t churn_ns = o->churn_s > 0 ? t0 + (uint64_t)(o->churn_s * 1e9) : UINT64_MAX;
+    uint64_t tick_ns = t0 + 1000000000u;
+    uint64_t drain_ns = 0;   // после -time ждём ACK на отправленное и ответ GET_STATS
+    uint64_t tick_frames = 0;
+
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        if (!drain_ns && now >= end_ns) {
+            drain_ns = now + (uint64_t)o->timeout_ms * 1000000u;
+            request_stats(sk);
+        }
+        if (drain_ns && (now >= drain_ns || (sk->ring_tail == sk->ring_head && sk->stats_done))) break;
+        expire(sk, now, 0);
+
+        if (now >= sample_ns) {
+            sample(sk, now, warm_ns);
+            sample_ns += SK_SAMPLE_NS;
+            if (child_exited(&sk->gw_pid)) {
+                fail(sk, "gateway exited during the run");
+                return -1;
+            }
+            if (child_exited(&sk->emu_pid)) {
+                fail(sk, "due_emu exited during the run");
+                return -1;
+            }
+        }
+        if (o->verbose && now >= tick_ns) {
+            uint64_t frames = 0;
+            for (int i = 0; i < o->nodes; i++) frames += sk->conn[0].flow[i].frames;
+            printf("  %5.1f s: %llu frame(s)/s, commands sent %llu, acked %llu, lost %llu, gateway rss %ld KB, "
+                   "fds %ld\n",
+                   (double)(now - t0) / 1e9, (unsigned long long)(frames - tick_frames),
+                   (unsigned long long)sk->sent, (unsigned long long)sk->acked, (unsigned long long)sk->lost,
+                   proc_rss_kb(sk->gw_pid), proc_fds(sk->gw_pid));
+            fflush(stdout);
+            tick_frames = frames;
+            tick_ns += 1000000000u;
+        }
+
+        // подписчик (кроме соединения 0, по нему меряется темп) отключается и подключается заново
+        if (now >= churn_ns && !drain_ns) {
+            churn_ns += (uint64_t)(o->churn_s * 1e9);
+            int first = o->senders > 0 ? o->senders : 1;
+            if (first < sk->conns) {
+                sk_conn_t* c = &sk->conn[first + sk->next_churn % (sk->conns - first)];
+                sk->next_churn++;
+                conn_close(c);
+                if (conn_open(sk, c) < 0) {
+                    fail(sk, "reconnect: %s", strerror(errno));
+                    return -1;
+                }
+                c->reconnects++;
+            }
+        }
+
+        if (period && !drain_ns) {
+            if (now > next_ns + 100000000u) next_ns = now - 100000000u;
+            while (next_ns <= now) {
+                send_cmd(sk, now);
+                next_ns += period;
+            }
+        }
+
+        int timeout = 10;
+        if (period && !drain_ns) {
+            timeout = next_ns > now ? (int)((next_ns - now) / 1000000u) : 0;
+            if (timeout > 10) timeout = 10;
+        }
+        for (int i = 0; i < sk->conns; i++) {
+            sk_conn_t* c = &sk->conn[i];
+            if (c->tx_len) conn_flush(c);
+            pfd[i].fd = c->fd;
+            pfd[i].events = POLLIN | (c->tx_len ? POLLOUT : 0);
+            pfd[i].revents = 0;
+        }
+        if (poll(pfd, (nfds_t)sk->conns, timeout) < 0 && errno != EINTR) return -1;
+        now = now_ns();
+        for (int i = 0; i < sk->conns; i++) {
+            sk_conn_t* c = &sk->conn[i];
+            if (c->fd < 0) continue;
+            if ((pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) && conn_read(sk, c, now) < 0) {
+                fail(sk, "connection %d closed by gateway", i);
+                conn_close(c);
+                return -1;
+            }
+            if (pfd[i].revents & POLLOUT) conn_flush(c);
+        }
+    }
+    expire(sk, now_ns(), 1);
+    sk->rss_end = proc_rss_kb(sk->gw_pid);
+    return g_stop ? -1 : 0;
+}
+
+// ---- отчёт ----
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(sk_t* sk, double secs)
+{
+    const sk_opts_t* o = sk->o;
+    printf("soak: %s backend, threads %d, %d node(s) at %g Hz, %d subscriber(s), %d sender(s) at %g cmd/s, "
+           "%.1f s\n",
+           o->backend, o->threads, o->nodes, o->rate, o->subs, o->senders, o->cmd_rate, secs);
+
+    // пропуски, которые не ACK команды другого соединения, дошедший до него, — потери
+    for (int i = 0; i < sk->conns; i++) {
+        sk_conn_t* c = &sk->conn[i];
+        for (size_t k = 0; k < c->skip_n; k++) {
+            const sk_skip_t* s = &c->skip[k];
+            const sk_node_t* n = &sk->node[s->node];
+            uint64_t t = n->ack_t_ns[s->seq];
+            uint64_t dt = t > s->t_ns ? t - s->t_ns : s->t_ns - t;
+            if (t == 0 || n->ack_conn[s->seq] == (uint8_t)i || dt > SK_SKIP_WINDOW_NS) c->flow[s->node].gaps++;
+        }
+    }
+
+    uint64_t gaps = 0, dups = 0, bad = 0;
+    unsigned reconnects = 0;
+    for (int i = 0; i < sk->conns; i++) {
+        const sk_conn_t* c = &sk->conn[i];
+        uint64_t frames = 0, g = 0, d = 0;
+        for (int n = 0; n < o->nodes; n++) {
+            frames += c->flow[n].frames;
+            g += c->flow[n].gaps;
+            d += c->flow[n].dups;
+        }
+        gaps += g;
+        dups += d;
+        bad += c->bad;
+        reconnects += c->reconnects;
+        if (o->verbose || g || d || c->bad) {
+            printf("  conn %-4d %s %llu frame(s), lost %llu, dup %llu, bad %llu, reconnects %u\n", i,
+                   c->sender ? "sender    " : "subscriber", (unsigned long long)frames, (unsigned long long)g,
+                   (unsigned long long)d, (unsigned long long)c->bad, c->reconnects);
+        }
+    }
+    printf("  frames    lost %llu, dup %llu, bad %llu over %d connection(s), %u reconnect(s)\n",
+           (unsigned long long)gaps, (unsigned long long)dups, (unsigned long long)bad, sk->conns, reconnects);
+    if (gaps || dups || bad) fail(sk, "frames lost or damaged between nodes and clients");
+
+    // темп телеметрии по соединению 0: подключено весь прогон
+    double min_hz = -1;
+    for (int n = 0; n < o->nodes; n++) {
+        double hz = secs > 0 ? (double)sk->conn[0].flow[n].telemetry / secs : 0;
+        printf("  node %-4d telemetry %.0f/s, frames %llu\n", n + 1, hz,
+               (unsigned long long)sk->conn[0].flow[n].frames);
+        if (min_hz < 0 || hz < min_hz) min_hz = hz;
+    }
+    if (min_hz < o->min_rate * o->rate) {
+        fail(sk, "telemetry %.0f/s below %.0f/s", min_hz, o->min_rate * o->rate);
+    }
+
+    uint64_t status_err = 0;
+    for (int n = 0; n < o->nodes; n++) status_err += sk->node[n].status_err;
+    printf("  commands  sent %llu, acked %llu, lost %llu, status != 0: %llu, held back %llu\n",
+           (unsigned long long)sk->sent, (unsigned long long)sk->acked, (unsigned long long)sk->lost,
+           (unsigned long long)status_err, (unsigned long long)sk->held);
+    if (sk->lost || status_err) fail(sk, "commands without ACK or with error status");
+    if (o->senders > 0 && o->cmd_rate > 0 && sk->acked == 0) fail(sk, "no command was acknowledged");
+
+    if (sk->lat_n > 0) {
+        qsort(sk->lat, sk->lat_n, sizeof(*sk->lat), cmp_u32);
+        const double q[] = { 0.5, 0.9, 0.99, 0.999 };
+        uint32_t v[4];
+        for (int i = 0; i < 4; i++) {
+            size_t k = (size_t)(q[i] * (double)sk->lat_n);
+            v[i] = sk->lat[k < sk->lat_n ? k : sk->lat_n - 1];
+        }
+        printf("  latency   us: min %u p50 %u p90 %u p99 %u p99.9 %u max %u\n", (unsigned)sk->lat[0], (unsigned)v[0],
+               (unsigned)v[1], (unsigned)v[2], (unsigned)v[3], (unsigned)sk->lat[sk->lat_n - 1]);
+        if (v[2] > o->max_p99_us) fail(sk, "ACK latency p99 %u us above %u us", (unsigned)v[2], o->max_p99_us);
+    }
+
+    printf("  memory    gateway rss %ld KB after warmup, max %ld KB, at end %ld KB\n", sk->rss_warm, sk->rss_max,
+           sk->rss_end);
+    if (sk->rss_warm < 0) fail(sk, "no RSS samples after warmup");
+    else if (sk->rss_max - sk->rss_warm > (long)o->max_rss_kb) {
+        fail(sk, "gateway rss grew by %ld KB (limit %u KB)", sk->rss_max - sk->rss_warm, o->max_rss_kb);
+    }
+
+    printf("  fds       gateway %ld without clients, max %ld, %ld after disconnect\n", sk->fd_base, sk->fd_max,
+           sk->fd_end);
+    if (sk->fd_end != sk->fd_base) fail(sk, "gateway fd count %ld != %ld after disconnect", sk->fd_end, sk->fd_base);
+
+    if (sk->stats_done != 1) {
+        fail(sk, "no GW_CTL_GET_STATS reply");
+    }
+    for (int i = 0; i < sk->uart_n; i++) {
+        const gw_metrics_rec_t* m = &sk->uart[i];
+        printf("  gateway   uart %u in %u frame(s), out %u, crc %u, framing %u, drops %u, rejected %u\n",
+               (unsigned)m->id, (unsigned)m->frames_in, (unsigned)m->frames_out, (unsigned)m->crc_errors,
+               (unsigned)m->framing_errors, (unsigned)m->drops, (unsigned)m->rejected);
+        if (m->crc_errors || m->framing_errors || m->drops || m->rejected) {
+            fail(sk, "gateway uart %u errors or drops", (unsigned)m->id);
+        }
+    }
+}
+
+static void cleanup_dir(const sk_t* sk)
+{
+    DIR* d = opendir(sk->dir);
+    if (!d) return;
+    struct dirent* e;
+    char path[384];
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", sk->dir, e->d_name);
+        unlink(path);
+    }
+    closedir(d);
+    rmdir(sk->dir);
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+            "Usage: %s -gw PATH -emu PATH [-backend epoll|io_uring] [-threads 0|1] [-nodes N] [-rate HZ]\n"
+            "          [-subs N] [-senders N] [-cmd_rate N] [-time SEC] [-warmup SEC] [-churn SEC]\n"
+            "          [-min_rate F] [-max_p99 US] [-max_rss KB] [-timeout MS] [-keep] [-v]\n",
+            argv0);
+}
+
+int main(int argc, char** argv)
+{
+    sk_opts_t o;
+    memset(&o, 0, sizeof(o));
+    o.backend = "epoll";
+    o.nodes = 3;
+    o.rate = 500;
+    o.subs = 4;
+    o.senders = 2;
+    o.cmd_rate = 300;
+    o.time_s = 20;
+    o.warmup_s = 3;
+    o.churn_s = 1;
+    o.min_rate = 0.9;
+    o.max_p99_us = 50000;
+    o.max_rss_kb = 1024;
+    o.timeout_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "-gw") == 0 && v) { o.gw_path = v; i++; }
+        else if (strcmp(a, "-emu") == 0 && v) { o.emu_path = v; i++; }
+        else if (strcmp(a, "-backend") == 0 && v) { o.backend = v; i++; }
+        else if (strcmp(a, "-threads") == 0 && v) { o.threads = atoi(v); i++; }
+        else if (strcmp(a, "-nodes") == 0 && v) { o.nodes = atoi(v); i++; }
+        else if (strcmp(a, "-rate") == 0 && v) { o.rate = atof(v); i++; }
+        else if (strcmp(a, "-subs") == 0 && v) { o.subs = atoi(v); i++; }
+        else if (strcmp(a, "-senders") == 0 && v) { o.senders = atoi(v); i++; }
+        else if (strcmp(a, "-cmd_rate") == 0 && v) { o.cmd_rate = atof(v); i++; }
+        else if (strcmp(a, "-time") == 0 && v) { o.time_s = atof(v); i++; }
+        else if (strcmp(a, "-warmup") == 0 && v) { o.warmup_s = atof(v); i++; }
+        else if (strcmp(a, "-churn") == 0 && v) { o.churn_s = atof(v); i++; }
+        else if (strcmp(a, "-min_rate") == 0 && v) { o.min_rate = atof(v); i++; }
+        else if (strcmp(a, "-max_p99") == 0 && v) { o.max_p99_us = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-max_rss") == 0 && v) { o.max_rss_kb = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-timeout") == 0 && v) { o.timeout_ms = (unsigned)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "-keep") == 0) o.keep = 1;
+        else if (strcmp(a, "-v") == 0) o.verbose = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!o.gw_path || !o.emu_path || o.nodes < 1 || o.nodes > SK_NODES_MAX || o.rate <= 0 || o.subs < 0 ||
+        o.senders < 0 || o.subs + o.senders < 1 || o.subs + o.senders > SK_CONNS_MAX || o.time_s <= o.warmup_s) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    static sk_t sk;
+    sk.o = &o;
+    sk.conns = o.senders + o.subs;
+    sk.fd_base = sk.fd_max = sk.fd_end = -1;
+    sk.rss_warm = sk.rss_max = sk.rss_end = -1;
+    snprintf(sk.dir, sizeof(sk.dir), "/tmp/gw_soak.XXXXXX");
+    sk.conn = (sk_conn_t*)calloc((size_t)sk.conns, sizeof(sk_conn_t));
+    sk.ring = (sk_ring_t*)calloc(SK_RING_MASK + 1u, sizeof(sk_ring_t));
+    int rc = sk.conn && sk.ring && mkdtemp(sk.dir) ? 0 : -1;
+    if (rc < 0) fprintf(stderr, "gw_soak: %s\n", strerror(errno));
+    for (int i = 0; i < o.nodes && rc == 0; i++) {
+        sk.node[i].slot = (sk_slot_t*)calloc(65536, sizeof(sk_slot_t));
+        sk.node[i].ack_t_ns = (uint64_t*)calloc(65536, sizeof(uint64_t));
+        sk.node[i].ack_conn = (uint8_t*)calloc(65536, 1);
+        if (!sk.node[i].slot || !sk.node[i].ack_t_ns || !sk.node[i].ack_conn) rc = -1;
+    }
+    for (int i = 0; sk.conn && i < sk.conns; i++) {
+        sk.conn[i].fd = -1;
+        sk.conn[i].sender = i < o.senders;
+    }
+
+    if (rc == 0) rc = start(&sk);
+    if (rc == 0) {
+        sk.fd_base = settle_fds(&sk, -1);   // пробное соединение закрыто
+        for (int i = 0; i < sk.conns && rc == 0; i++) {
+            if (conn_open(&sk, &sk.conn[i]) < 0) {
+                fprintf(stderr, "gw_soak: 127.0.0.1:%u: %s\n", (unsigned)sk.port, strerror(errno));
+                rc = -1;
+            }
+        }
+    }
+    uint64_t t0 = now_ns();
+    if (rc == 0) rc = run(&sk);
+    double secs = (double)(now_ns() - t0) / 1e9;
+    for (int i = 0; sk.conn && i < sk.conns; i++) conn_close(&sk.conn[i]);
+    if (rc == 0) {
+        sk.fd_end = settle_fds(&sk, sk.fd_base);
+        report(&sk, secs);
+    }
+
+    char err[96];
+    path_in(&sk, err, sizeof(err), "stderr");
+    stop_child(&sk.gw_pid);   // шлюз первым: без узлов он получает EIO на pty
+    stop_child(&sk.emu_pid);
+    int ok = rc == 0 && !sk.failed;
+    if (!ok) print_file(err, "stderr of ecu_gw and due_emu");
+    printf("soak: %s\n", ok ? "PASS" : "FAIL");
+    if (ok && !o.keep) cleanup_dir(&sk);
+    else if (sk.dir[0]) printf("  files in %s\n", sk.dir);
+
+    for (int i = 0; i < o.nodes; i++) {
+        free(sk.node[i].slot);
+        free(sk.node[i].ack_t_ns);
+        free(sk.node[i].ack_conn);
+    }
+    for (int i = 0; sk.conn && i < sk.conns; i++) free(sk.conn[i].skip);
+    free(sk.conn);
+    free(sk.ring);
+    free(sk.lat);
+    return ok ? 0 : 1;
+}
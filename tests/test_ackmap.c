@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+#include "gw/gw_ackmap.h"
+#include "gw/gw_dispatch.h"
+#include "test_util.h"
+
+// seq шлюза по узлам, пропуск 0, запись снимается первым ACK
+static void test_take(void)
+{
+    gw_ackmap_t m;
+    memset(&m, 0, sizeof(m));
+    uint32_t id = 0;
+    uint16_t cseq = 0;
+
+    CHECK(gw_ackmap_take(&m, 1, 1, &id, &cseq) == 0);
+    uint16_t s1 = gw_ackmap_next(&m, 1);
+    CHECK(s1 == 1);
+    gw_ackmap_put(&m, 1, s1, 7, 100);
+    CHECK(gw_ackmap_next(&m, 1) == 2);
+    CHECK(gw_ackmap_next(&m, 2) == 1);   // свой счётчик у каждого узла
+
+    CHECK(gw_ackmap_take(&m, 2, s1, &id, &cseq) == 0);
+    CHECK(gw_ackmap_take(&m, 1, s1, &id, &cseq) == 1 && id == 7 && cseq == 100);
+    CHECK(gw_ackmap_take(&m, 1, s1, &id, &cseq) == 0);   // повтор ACK — записи уже нет
+
+    // после 0xFFFF — 1
+    m.node[1]->next_seq = 0xFFFF;
+    gw_ackmap_put(&m, 1, 0xFFFF, 7, 5);
+    CHECK(gw_ackmap_next(&m, 1) == 1);
+
+    // место занято командой на GW_ACKMAP_SLOTS позже: старый seq не находится
+    gw_ackmap_put(&m, 1, 3, 7, 1);
+    gw_ackmap_put(&m, 1, (uint16_t)(3 + GW_ACKMAP_SLOTS), 8, 2);
+    CHECK(m.overwritten == 1);
+    CHECK(gw_ackmap_take(&m, 1, 3, &id, &cseq) == 0);
+    CHECK(gw_ackmap_take(&m, 1, (uint16_t)(3 + GW_ACKMAP_SLOTS), &id, &cseq) == 1 && id == 8 && cseq == 2);
+    gw_ackmap_free(&m);
+}
+
+// Отключение клиента снимает только его записи
+static void test_drop_client(void)
+{
+    gw_ackmap_t m;
+    memset(&m, 0, sizeof(m));
+    uint32_t id = 0;
+    uint16_t cseq = 0;
+
+    for (uint16_t s = 1; s <= 4; s++) {
+        CHECK(gw_ackmap_next(&m, 3) == s);
+        gw_ackmap_put(&m, 3, s, s <= 2 ? 10 : 11, (uint16_t)(s + 100));
+    }
+    gw_ackmap_drop_client(&m, 11);
+    gw_ackmap_drop_client(&m, 12);   // записей нет
+    CHECK(gw_ackmap_take(&m, 3, 3, &id, &cseq) == 0);
+    CHECK(gw_ackmap_take(&m, 3, 4, &id, &cseq) == 0);
+    CHECK(gw_ackmap_take(&m, 3, 1, &id, &cseq) == 1 && id == 10 && cseq == 101);
+    CHECK(gw_ackmap_take(&m, 3, 2, &id, &cseq) == 1 && id == 10 && cseq == 102);
+    CHECK(m.forgotten == 2);
+    gw_ackmap_free(&m);
+}
+
+// Кадр узел 1 -> узел 2 с ACK_REQUIRED и тем же seq, что у ждущей команды клиента, пересылается
+// UART -> UART и запись не снимает: ACK на него идёт узлу 1, а ACK узла 2 шлюзу — клиенту
+static void test_forward(void)
+{
+    static gw_state_t st;
+    memset(&st, 0, sizeof(st));
+    int pty[2];
+    for (int i = 0; i < 2; i++) {
+        pty[i] = test_pty_uart(&st.uarts[i], 4096);
+        CHECK(pty[i] >= 0);
+    }
+    st.uart_count = 2;
+    gw_router_init(&st.router, 0, 2, NULL);
+    CHECK(gw_router_set_static(&st.router, 1, GW_UART_1) == 0);
+    CHECK(gw_router_set_static(&st.router, 2, GW_UART_1 + 1) == 0);
+
+    uint16_t s = gw_ackmap_next(&st.acks, 2);
+    gw_ackmap_put(&st.acks, 2, s, 7, 300);
+
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.flags = ECU_F_ACK_REQUIRED;
+    h.seq = s;
+    h.src = 1;
+    h.dst = 2;
+    h.payload_len = sizeof(ecu_command_hdr_t);
+    ecu_command_hdr_t ch = { 7, 0 };
+    uint8_t f[ECU_MAX_FRAME_SIZE], slip[2 * ECU_MAX_FRAME_SIZE + 2];
+    size_t flen = ecu_frame_pack(&h, (const uint8_t*)&ch, f, sizeof(f));
+    size_t n = slip_encode(f, flen, slip, sizeof(slip));
+    CHECK(flen > 0 && n > 0 && gw_uart_feed(&st.uarts[0], slip, n) == (int)n);
+    gw_dispatch_uart_rx(&st, 0, 1000000);
+
+    CHECK(gw_counter_get(&st.uarts[1].stats.tx_frames) == 1);   // переслан узлу 2
+    uint32_t id = 0;
+    uint16_t cseq = 0;
+    CHECK(gw_ackmap_take(&st.acks, 2, s, &id, &cseq) == 1 && id == 7 && cseq == 300);
+    CHECK(st.acks.forgotten == 0);
+
+    gw_ackmap_free(&st.acks);
+    for (int i = 0; i < 2; i++) {
+        gw_uart_close(&st.uarts[i]);
+        close(pty[i]);
+    }
+}
+
+int main(void)
+{
+    test_take();
+    test_drop_client();
+    test_forward();
+    return test_result("test_ackmap");
+}
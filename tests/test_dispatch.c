@@ -0,0 +1,259 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+#include "gw/gw_dispatch.h"
+#include "test_util.h"
+
+#define NODE  1u   // узел на UART 0
+#define NODE2 2u   // узел на UART 1 (без cmd_rate)
+
+static gw_state_t st;
+static int peer[2];
+static int pty_m[2] = { -1, -1 };
+
+// Шлюз без цикла событий: два UART на pty, два клиента на TCP loopback
+static void open_state(uint32_t cmd_rate, uint32_t cmd_burst, size_t tx_queue)
+{
+    memset(&st, 0, sizeof(st));
+    for (int i = 0; i < 2; i++) {
+        pty_m[i] = test_pty_uart(&st.uarts[i], tx_queue);
+        CHECK(pty_m[i] >= 0);
+    }
+    st.uart_count = 2;
+    st.cfg.uarts[0].cmd_rate = cmd_rate;
+    st.cfg.uarts[0].cmd_burst = cmd_burst;
+    gw_router_init(&st.router, 0, 2, NULL);
+    CHECK(gw_router_set_static(&st.router, NODE, GW_UART_1) == 0);
+    CHECK(gw_router_set_static(&st.router, NODE2, GW_UART_1 + 1) == 0);
+
+    CHECK(gw_net_listen(&st.net, 0, 2, 16384, 0) == 0);
+    struct sockaddr_in a;
+    socklen_t al = sizeof(a);
+    CHECK(getsockname(gw_net_listen_fd(&st.net), (struct sockaddr*)&a, &al) == 0);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int i = 0; i < 2; i++) {
+        peer[i] = socket(AF_INET, SOCK_STREAM, 0);
+        CHECK(connect(peer[i], (struct sockaddr*)&a, sizeof(a)) == 0);
+    }
+    CHECK(gw_net_accept(&st.net) == 2);
+}
+
+static void close_state(void)
+{
+    for (int i = 0; i < 2; i++) close(peer[i]);
+    gw_net_close(&st.net);
+    for (int i = 0; i < 2; i++) {
+        gw_uart_close(&st.uarts[i]);
+        close(pty_m[i]);
+    }
+}
+
+// COMMAND узлу dst от src, plen байт параметра, в out; возвращает длину кадра
+static size_t make_cmd(uint8_t* out, size_t cap, uint8_t dst, uint8_t src, uint16_t plen, uint16_t flags)
+{
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.flags = flags;
+    h.src = src;
+    h.dst = dst;
+    h.payload_len = (uint16_t)(sizeof(ecu_command_hdr_t) + plen);
+    uint8_t payload[ECU_MAX_PAYLOAD];
+    ecu_command_hdr_t ch = { 7, plen };
+    memcpy(payload, &ch, sizeof(ch));
+    memset(payload + sizeof(ch), 0x5A, plen);
+    return ecu_frame_pack(&h, payload, out, cap);
+}
+
+// То же в rx_buf клиента как из сокета (длина + кадр)
+static size_t feed_to(gw_net_client_t* c, uint8_t dst, uint8_t src, uint16_t plen, uint16_t flags)
+{
+    uint8_t buf[4 + ECU_MAX_FRAME_SIZE];
+    size_t len = make_cmd(buf + 4, sizeof(buf) - 4, dst, src, plen, flags);
+    buf[0] = (uint8_t)len;
+    buf[1] = (uint8_t)(len >> 8);
+    buf[2] = buf[3] = 0;
+    CHECK(gw_net_client_feed(c, buf, 4 + len) == (int)(4 + len));
+    return len;
+}
+
+static size_t feed(gw_net_client_t* c, uint8_t src, uint16_t plen)
+{
+    return feed_to(c, NODE, src, plen, 0);
+}
+
+// Дозаполнить rx_buf клиента кадрами по plen байт параметра
+static void top_up(gw_net_client_t* c, uint8_t src, uint16_t plen)
+{
+    size_t need = 4 + ECU_HEADER_SIZE + sizeof(ecu_command_hdr_t) + plen + ECU_CRC_SIZE;
+    while (c->rx_spill_len == 0 && c->rx_len + need <= c->rx_cap) feed(c, src, plen);
+}
+
+// Передать очередь UART целиком, байты кадров — по src отправителя
+static void drain(slip_rx_t* rx, uint32_t* bytes)
+{
+    gw_uart_t* u = &st.uarts[0];
+    const uint8_t* p = NULL;
+    size_t chunk;
+    while ((chunk = gw_uart_tx_chunk(u, &p)) > 0) {
+        for (size_t used = 0; used < chunk; used += rx->consumed) {
+            size_t flen = 0;
+            if (slip_rx_push(rx, p + used, chunk - used, &flen) == 1) bytes[rx->out[4]] += (uint32_t)flen;
+        }
+        gw_uart_tx_advance(u, chunk);
+    }
+}
+
+// Два клиента, кадры в 10 раз разной длины, общий UART, который не успевает: байты делятся поровну
+static void test_drr_share(void)
+{
+    open_state(0, 0, 8192);
+    gw_net_client_t* a = &st.net.clients[0];
+    gw_net_client_t* b = &st.net.clients[1];
+    uint8_t out[ECU_MAX_FRAME_SIZE];
+    slip_rx_t rx;
+    slip_rx_init(&rx, out, sizeof(out));
+    static uint32_t bytes[256];
+    memset(bytes, 0, sizeof(bytes));
+
+    uint64_t now = 1000000;
+    for (int i = 0; i < 40; i++, now += 1000) {
+        top_up(a, 0xA0, 1000);
+        top_up(b, 0xB0, 100);
+        CHECK(gw_dispatch_clients(&st, now) == -1);
+        // UART полон: оба ждут места
+        CHECK(a->paused_since == now && b->paused_since == now);
+        drain(&rx, bytes);
+    }
+    double share = (double)bytes[0xA0] / (double)bytes[0xB0];
+    CHECK(bytes[0xA0] > 100000 && share > 0.8 && share < 1.25);
+    CHECK(a->stats.paused_us > 0 && b->stats.paused_us > 0);
+
+    // место появилось, кадров больше нет: ожидание кончилось, клиенты снова читаются
+    for (int i = 0; i < 20 && (a->rx_len > 0 || b->rx_len > 0); i++, now += 1000) {
+        gw_dispatch_clients(&st, now);
+        drain(&rx, bytes);
+    }
+    CHECK(a->rx_len == 0 && b->rx_len == 0);
+    CHECK(!a->rx_paused && !b->rx_paused);
+    CHECK(a->paused_since == 0 && b->paused_since == 0);
+    CHECK(a->stats.rx_rejected == 0 && b->stats.rx_rejected == 0);
+    close_state();
+}
+
+// Корзина cmd_rate/cmd_burst: запас сразу, дальше — по темпу, ожидание и возобновление
+static void test_token_bucket(void)
+{
+    open_state(10000, 2000, 8192);   // 10000 байт/с, запас 2000 байт
+    gw_net_client_t* c = &st.net.clients[0];
+    size_t len = 0;
+    for (int i = 0; i < 6; i++) len = feed(c, 0xC0, (uint16_t)(500 - ECU_HEADER_SIZE - sizeof(ecu_command_hdr_t) - ECU_CRC_SIZE));
+    CHECK(len == 500);
+
+    uint64_t t0 = 5000000;
+    // запас — 4 кадра, пятому не хватает 500 байт: 50 мс
+    CHECK(gw_dispatch_clients(&st, t0) == 50000);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 4);
+    // ждёт кадр, а не сокет: в rx_buf ещё есть место
+    CHECK(!c->rx_paused && c->throttled_since == t0);
+
+    CHECK(gw_dispatch_clients(&st, t0 + 49999) == 1);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 4 && c->rx_len > 0);
+    CHECK(c->stats.throttled_us == 49999);
+
+    // токены накопились: кадр проходит, следующий снова ждёт полный интервал
+    CHECK(gw_dispatch_clients(&st, t0 + 50000) == 50000);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 5 && c->rx_len > 0);
+    CHECK(c->stats.throttled_us == 50000 && c->throttled_since == t0 + 50000);
+
+    // пауза дольше запаса: корзина не копит больше cmd_burst
+    CHECK(gw_dispatch_clients(&st, t0 + 10000000) == -1);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 6);
+    CHECK(!c->rx_paused && c->throttled_since == 0 && c->rx_len == 0);
+    CHECK(c->flow[0].tokens == 1500ull * 1000000u);
+    close_state();
+}
+
+// Кадры клиента в другой UART и срочные проходят мимо ждущего токенов; порядок в потоке сохраняется
+static void test_pass_blocked(void)
+{
+    open_state(10000, 1000, 8192);   // токены только у UART 0
+    gw_net_client_t* c = &st.net.clients[0];
+    uint16_t p = (uint16_t)(500 - ECU_HEADER_SIZE - sizeof(ecu_command_hdr_t) - ECU_CRC_SIZE);
+    for (int i = 0; i < 4; i++) feed_to(c, NODE, 0xC0, p, 0);    // 2 проходят, 2 ждут 50 и 100 мс
+    feed_to(c, NODE2, 0xC0, p, 0);
+    feed_to(c, NODE, 0xC0, p, ECU_F_URGENT);
+    feed_to(c, NODE2, 0xC0, p, 0);
+
+    uint64_t t0 = 5000000;
+    CHECK(gw_dispatch_clients(&st, t0) == 50000);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 3);   // 2 по запасу и срочный
+    CHECK(gw_counter_get(&st.uarts[1].stats.tx_frames) == 2);
+    CHECK(c->flow[0].tokens == 0);                                // срочный токенов не взял
+    CHECK(gw_uart_tx_pending(&st.uarts[0]) > 0 && st.uarts[0].tx_lane[GW_UART_LANE_URGENT].frm_head == 1);
+    CHECK(c->rx_len == 2 * (4 + 500u) && c->throttled_since == t0 && !c->rx_paused);
+
+    // следующий кадр потока — только после ждущего
+    feed_to(c, NODE, 0xC0, 8, 0);
+    CHECK(gw_dispatch_clients(&st, t0 + 1000) == 49000);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 3);
+    CHECK(gw_dispatch_clients(&st, t0 + 100000) == 3000);      // кадр 30 байт
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 5);
+    CHECK(gw_dispatch_clients(&st, t0 + 103000) == -1);
+    CHECK(gw_counter_get(&st.uarts[0].stats.tx_frames) == 6 && c->rx_len == 0);
+
+    // rx_buf занят ждущими кадрами: сокет больше не читается
+    while (c->rx_len + 4 + 500 <= c->rx_cap) feed_to(c, NODE, 0xC0, p, 0);
+    CHECK(gw_dispatch_clients(&st, t0 + 104000) > 0);
+    CHECK(c->rx_paused);
+    close_state();
+}
+
+// Отложенная команда ждёт места в полной очереди UART: без таймера повтора, уходит при следующем вызове
+// после того, как запись освободила место
+static void test_sched_parked(void)
+{
+    open_state(0, 0, 1024);
+    uint8_t f[ECU_MAX_FRAME_SIZE];
+    size_t len = make_cmd(f, sizeof(f), NODE, 0xC0, 600, 0);
+    uint64_t t0 = 5000000;
+    uint32_t id = 0;
+    CHECK(gw_sched_add(&st.sched, t0, 0, f, len, &id) == 0);
+    CHECK(gw_sched_add(&st.sched, t0, 0, f, len, &id) == 0);
+    CHECK(gw_sched_add(&st.sched, t0 + 50000, 0, f, len, &id) == 0);
+
+    CHECK(gw_dispatch_sched(&st, t0) == 50000);   // не 1 мс повтора: до срока третьего
+    CHECK(st.sched.sent == 1 && st.sched.waiting == 1);
+    CHECK(gw_dispatch_sched(&st, t0 + 1000) == 49000);
+    CHECK(st.sched.sent == 1 && st.sched.waiting == 1);
+
+    // запись освободила место — ждущее задание уходит первым
+    gw_uart_t* u = &st.uarts[0];
+    const uint8_t* p = NULL;
+    size_t chunk;
+    while ((chunk = gw_uart_tx_chunk(u, &p)) > 0) gw_uart_tx_advance(u, chunk);
+    CHECK(gw_dispatch_sched(&st, t0 + 2000) == 48000);
+    CHECK(st.sched.sent == 2 && st.sched.waiting == 0 && st.sched.dropped == 0);
+    gw_sched_free(&st.sched);
+    close_state();
+}
+
+int main(void)
+{
+    test_drr_share();
+    test_token_bucket();
+    test_pass_blocked();
+    test_sched_parked();
+    return test_result("test_dispatch");
+}
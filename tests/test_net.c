@@ -0,0 +1,157 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "gw/gw_net.h"
+#include "test_util.h"
+
+// Кадр-метка: тип, узел и первый байт полезной нагрузки (plen >= 1); CRC очереди клиента не нужен
+static size_t frame(uint8_t* f, uint8_t type, uint8_t src, uint8_t tag, uint16_t plen)
+{
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = type;
+    h.src = src;
+    h.dst = ECU_NODE_GW;
+    h.payload_len = plen;
+    memcpy(f, &h, sizeof(h));
+    memset(f + sizeof(h), tag, plen);
+    f[sizeof(h) + plen] = 0;
+    f[sizeof(h) + plen + 1] = 0;
+    return sizeof(h) + plen + 2;
+}
+
+static int send_tag(gw_net_client_t* c, uint8_t type, uint8_t src, uint8_t tag, uint16_t plen)
+{
+    uint8_t f[ECU_MAX_FRAME_SIZE];
+    size_t len = frame(f, type, src, tag, plen);
+    gw_lat_origin_t o = { 0, GW_LAT_TO_NET, src };
+    return gw_net_client_send(c, f, len, 0, &o);
+}
+
+// Метки кадров потока [p, p+n) по порядку: (тип << 8) | метка
+static int parse(const uint8_t* p, size_t n, int* out, int max)
+{
+    int k = 0;
+    while (n >= 4 && k < max) {
+        size_t L = (size_t)p[0] | ((size_t)p[1] << 8) | ((size_t)p[2] << 16) | ((size_t)p[3] << 24);
+        if (L < sizeof(ecu_hdr_t) + 3 || 4 + L > n) return -1;
+        const ecu_hdr_t* h = (const ecu_hdr_t*)(p + 4);
+        if (h->payload_len + sizeof(ecu_hdr_t) + 2 != L) return -1;
+        out[k++] = (h->msg_type << 8) | p[4 + sizeof(ecu_hdr_t)];
+        p += 4 + L;
+        n -= 4 + L;
+    }
+    return n == 0 ? k : -1;
+}
+
+static int queued(const gw_net_client_t* c, int* out, int max)
+{
+    return parse(c->tx_buf + c->tx_off, c->tx_len - c->tx_off, out, max);
+}
+
+#define T(tag) ((ECU_MSG_TELEMETRY << 8) | (tag))
+#define E(tag) ((ECU_MSG_EVENT << 8) | (tag))
+
+static int marks(const gw_net_client_t* c)
+{
+    return (int)(c->tx_marks.head - c->tx_marks.tail);
+}
+
+// Последний кадр очереди той же длины — замена на месте; другой длины — вместо старого
+static void test_replace(gw_net_client_t* c)
+{
+    int q[8];
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 1, 16) == 0);
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 2, 16) == 0);
+    CHECK(queued(c, q, 8) == 1 && q[0] == T(2));
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 3, 40) == 0);
+    CHECK(queued(c, q, 8) == 1 && q[0] == T(3));
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 4, 8) == 0);
+    CHECK(queued(c, q, 8) == 1 && q[0] == T(4));
+    CHECK(c->stats.tx_conflated == 3);
+    CHECK(c->tx_total == c->tx_len && c->tx_marks.queued == c->tx_total);
+    CHECK(marks(c) == 1);
+}
+
+// Свежий TELEMETRY не обгоняет EVENT, поставленный после старого; позиции других узлов сдвигаются
+static void test_order(gw_net_client_t* c)
+{
+    int q[8];
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 1, 16) == 0);
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 6, 1, 16) == 0);
+    CHECK(send_tag(c, ECU_MSG_EVENT, 5, 9, 4) == 0);
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 2, 16) == 0);
+    CHECK(queued(c, q, 8) == 3 && q[0] == T(1) && q[1] == E(9) && q[2] == T(2));
+
+    // старый TELEMETRY узла 6 сдвинут вырезанием — найден и снят по новой позиции
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 6, 2, 24) == 0);
+    CHECK(queued(c, q, 8) == 3 && q[0] == E(9) && q[1] == T(2) && q[2] == T(2));
+    CHECK(((const ecu_hdr_t*)(c->tx_buf + c->tx_len - 24 - 2 - sizeof(ecu_hdr_t)))->src == 6);
+    // кадр узла 5 уже не последний в очереди: снова вырезание, не замена на месте
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 5, 3, 16) == 0);
+    CHECK(queued(c, q, 8) == 3 && q[0] == E(9) && q[1] == T(2) && q[2] == T(3));
+    CHECK(marks(c) == 3 && c->tx_marks.queued == c->tx_total);
+}
+
+// Кадр в незавершённой асинхронной записи не трогается: новый встаёт за ним
+static void test_busy(gw_net_client_t* c)
+{
+    int q[8];
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 7, 1, 16) == 0);
+    c->tx_busy = c->tx_len - c->tx_off;
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 7, 2, 16) == 0);
+    CHECK(queued(c, q, 8) == 2 && q[0] == T(1) && q[1] == T(2));
+    gw_net_client_sent(c, c->tx_busy);
+    CHECK(queued(c, q, 8) == 1 && q[0] == T(2));
+    CHECK(send_tag(c, ECU_MSG_TELEMETRY, 7, 3, 16) == 0);
+    CHECK(queued(c, q, 8) == 1 && q[0] == T(3));
+}
+
+int main(void)
+{
+    gw_net_t n;
+    CHECK(gw_net_listen(&n, 0, 1, 0, 0) == 0);
+    struct sockaddr_in a;
+    socklen_t al = sizeof(a);
+    CHECK(getsockname(gw_net_listen_fd(&n), (struct sockaddr*)&a, &al) == 0);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int peer = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(connect(peer, (struct sockaddr*)&a, sizeof(a)) == 0);
+    CHECK(gw_net_accept(&n) == 1);
+    gw_net_client_t* c = &n.clients[0];
+    CHECK(c->fd >= 0);
+    c->sub = GW_NET_SUB_LATEST;
+
+    test_replace(c);
+    CHECK(gw_net_client_flush(c) > 0);
+    test_order(c);
+
+    // клиент получает ровно очередь: поток не разорван вырезанием
+    int q[16];
+    uint8_t buf[4096];
+    size_t want = c->tx_len - c->tx_off;
+    CHECK(gw_net_client_flush(c) == (int)want);
+    size_t got = 0;
+    size_t first = 4 + sizeof(ecu_hdr_t) + 8 + 2;   // T(4) из test_replace
+    while (got < first + want) {
+        ssize_t r = recv(peer, buf + got, sizeof(buf) - got, 0);
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    int k = parse(buf, got, q, 16);
+    CHECK(k == 4 && q[0] == T(4) && q[1] == E(9) && q[2] == T(2) && q[3] == T(3));
+
+    test_busy(c);
+
+    close(peer);
+    gw_net_close(&n);
+    return test_result("test_net");
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ecu/ecu_limits.h"
+#include "gw/gw_router.h"
+#include "test_util.h"
+
+static int lookup(const gw_router_t* r, uint8_t node)
+{
+    gw_uart_index_t u;
+    return gw_router_lookup(r, node, &u) ? (int)u : -1;
+}
+
+// Статическая привязка, её перекрытие выученной и возврат к статической после устаревания
+static void test_static_override(void)
+{
+    gw_router_t r;
+    gw_router_init(&r, 1000, 3, NULL);
+    CHECK(gw_router_set_static(&r, 1, GW_UART_1) == 0);
+    CHECK(lookup(&r, 1) == 0);
+    CHECK(lookup(&r, 2) == -1);
+
+    CHECK(gw_router_learn(&r, 1, GW_UART_5, 0, 100) == GW_ROUTER_LEARN_NEW);
+    CHECK(lookup(&r, 1) == 2);
+    CHECK(gw_router_learn(&r, 1, GW_UART_5, 0, 200) == GW_ROUTER_LEARN_REFRESH);
+    CHECK(r.nodes[1].rx_frames == 2);
+
+    CHECK(gw_router_learn(&r, 1, GW_UART_4, 1, 300) == GW_ROUTER_LEARN_MOVED);
+    CHECK(lookup(&r, 1) == 1);
+    CHECK(r.nodes[1].moves == 1);
+    CHECK(r.nodes[1].flags & GW_ROUTE_F_HELLO);
+
+    // устаревание считается от последнего кадра
+    CHECK(gw_router_age(&r, 1299) == 0);
+    CHECK(gw_router_age(&r, 1300) == 1);
+    CHECK((r.nodes[1].flags & (GW_ROUTE_F_LEARNED | GW_ROUTE_F_HELLO)) == 0);
+    CHECK(lookup(&r, 1) == 0);
+
+    // заново — снова NEW, счётчик кадров с нуля
+    CHECK(gw_router_learn(&r, 1, GW_UART_4, 0, 2000) == GW_ROUTER_LEARN_NEW);
+    CHECK(r.nodes[1].rx_frames == 1);
+}
+
+// Широковещательный адрес, адрес шлюза и несуществующий UART не учатся
+static void test_reject(void)
+{
+    gw_router_t r;
+    gw_router_init(&r, 0, 2, NULL);
+    CHECK(r.age_ms == GW_ROUTER_AGE_MS);
+    CHECK(gw_router_learn(&r, ECU_NODE_BROADCAST, GW_UART_1, 0, 0) < 0);
+    CHECK(gw_router_learn(&r, ECU_NODE_GW, GW_UART_1, 0, 0) < 0);
+    CHECK(gw_router_learn(&r, 3, GW_UART_5, 0, 0) < 0);
+    CHECK(gw_router_set_static(&r, 3, GW_UART_5) < 0);
+    CHECK(gw_router_set_static(&r, ECU_NODE_GW, GW_UART_1) < 0);
+    CHECK(lookup(&r, ECU_NODE_GW) == -1);
+}
+
+// Перенос выученных привязок и счётчиков пересылки при смене списка UART
+static void test_migrate(void)
+{
+    gw_router_t old;
+    gw_router_t r;
+    gw_router_init(&old, 0, 3, NULL);
+    CHECK(gw_router_learn(&old, 5, GW_UART_4, 0, 10) == GW_ROUTER_LEARN_NEW);
+    CHECK(gw_router_learn(&old, 6, GW_UART_5, 0, 10) == GW_ROUTER_LEARN_NEW);
+    gw_router_count_fwd(&old, GW_UART_4, GW_UART_1, 20, 1);
+    gw_router_count_fwd(&old, GW_UART_4, GW_UART_1, 20, 0);
+
+    // UART 1 убран, UART 0 и 1 поменялись местами
+    const int map[3] = { 1, 0, -1 };
+    gw_router_init(&r, 0, 2, NULL);
+    gw_router_migrate(&r, &old, map);
+    CHECK(lookup(&r, 5) == 0);
+    CHECK(lookup(&r, 6) == -1);
+    CHECK(r.nodes[5].last_seen_ms == 10);
+    CHECK(r.fwd[0][1].frames == 1 && r.fwd[0][1].bytes == 20 && r.fwd[0][1].drops == 1);
+}
+
+int main(void)
+{
+    test_static_override();
+    test_reject();
+    test_migrate();
+    return test_result("test_router");
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "gw/gw_sched.h"
+#include "test_util.h"
+
+// Кадр-метка: первый байт — номер, чтобы проверять, какое задание вышло
+static uint32_t add(gw_sched_t* s, uint64_t at_us, uint8_t tag)
+{
+    uint8_t f[4] = { tag, 0, 0, 0 };
+    uint32_t id = 0;
+    CHECK(gw_sched_add(s, at_us, 1, f, sizeof(f), &id) == 0);
+    return id;
+}
+
+static int pop_tag(gw_sched_t* s)
+{
+    gw_sched_ent_t* e = gw_sched_head(s);
+    if (!e) return -1;
+    int tag = e->frame[0];
+    gw_sched_pop(s);
+    return tag;
+}
+
+// Порядок по сроку, при равных — по порядку постановки
+static void test_order(void)
+{
+    gw_sched_t s;
+    memset(&s, 0, sizeof(s));
+    CHECK(gw_sched_head(&s) == NULL);
+
+    static const uint64_t at[] = { 500, 100, 300, 100, 900, 200, 100, 700, 300, 50 };
+    for (unsigned i = 0; i < sizeof(at) / sizeof(at[0]); i++) add(&s, at[i], (uint8_t)i);
+    CHECK(s.count == 10);
+
+    static const int want[] = { 9, 1, 3, 6, 5, 2, 8, 0, 7, 4 };
+    for (unsigned i = 0; i < sizeof(want) / sizeof(want[0]); i++) CHECK(pop_tag(&s) == want[i]);
+    CHECK(gw_sched_head(&s) == NULL);
+    CHECK(s.queued == 10);
+    gw_sched_free(&s);
+}
+
+// Вперемешку постановка и снятие на полном пуле: места возвращаются, лишнее отклоняется
+static void test_capacity(void)
+{
+    gw_sched_t s;
+    memset(&s, 0, sizeof(s));
+    uint8_t f[4] = { 0 };
+
+    // сроки по убыванию — каждое задание просеивается до корня
+    for (int i = 0; i < GW_SCHED_MAX; i++) add(&s, (uint64_t)(GW_SCHED_MAX - i) * 10u, (uint8_t)i);
+    CHECK(gw_sched_add(&s, 1, 1, f, sizeof(f), NULL) < 0);
+    CHECK(s.rejected == 1);
+
+    uint64_t prev = 0;
+    for (int i = 0; i < GW_SCHED_MAX / 2; i++) {
+        gw_sched_ent_t* e = gw_sched_head(&s);
+        CHECK(e && e->at_us >= prev);
+        prev = e->at_us;
+        gw_sched_pop(&s);
+    }
+    // освободившиеся места снова принимают задания, порядок кучи не нарушен
+    for (int i = 0; i < GW_SCHED_MAX / 2; i++) add(&s, 5u + (uint64_t)i * 37u % 3000u, 0);
+    CHECK(gw_sched_pending(&s) == GW_SCHED_MAX);
+    prev = 0;
+    int n = 0;
+    for (gw_sched_ent_t* e; (e = gw_sched_head(&s)) != NULL; n++) {
+        CHECK(e->at_us >= prev);
+        prev = e->at_us;
+        gw_sched_pop(&s);
+    }
+    CHECK(n == GW_SCHED_MAX);
+    CHECK(s.spare_n == GW_SCHED_MAX);
+    gw_sched_free(&s);
+}
+
+// Списки ожидания UART: порядок внутри UART, освобождение мест, возврат в кучу
+static void test_wait(void)
+{
+    gw_sched_t s;
+    memset(&s, 0, sizeof(s));
+    CHECK(gw_sched_waiting(&s, 0) == NULL);
+
+    add(&s, 10, 1);
+    add(&s, 20, 2);
+    add(&s, 30, 3);
+    add(&s, 40, 4);
+    gw_sched_defer(&s, 1);   // 10
+    gw_sched_defer(&s, 1);   // 20
+    CHECK(s.count == 2 && s.waiting == 2 && gw_sched_pending(&s) == 4);
+    CHECK(gw_sched_head(&s)->frame[0] == 3);
+    CHECK(gw_sched_waiting(&s, 0) == NULL);
+    CHECK(gw_sched_waiting(&s, 1)->frame[0] == 1);
+
+    gw_sched_unwait(&s, 1);
+    CHECK(gw_sched_waiting(&s, 1)->frame[0] == 2);
+    CHECK(s.spare_n == GW_SCHED_MAX - 3);
+
+    // задание из списка ожидания возвращается в кучу на своё место по сроку
+    gw_sched_requeue(&s);
+    CHECK(s.waiting == 0 && gw_sched_waiting(&s, 1) == NULL);
+    CHECK(pop_tag(&s) == 2);
+    CHECK(pop_tag(&s) == 3);
+    CHECK(pop_tag(&s) == 4);
+    CHECK(s.spare_n == GW_SCHED_MAX);
+
+    // после возврата список снова работает
+    add(&s, 50, 5);
+    gw_sched_defer(&s, 7);
+    CHECK(gw_sched_waiting(&s, 7)->frame[0] == 5);
+    gw_sched_unwait(&s, 7);
+    CHECK(gw_sched_pending(&s) == 0);
+    gw_sched_free(&s);
+}
+
+static void test_deadline(void)
+{
+    const uint64_t now = 5000000000ull;   // 5000 с от загрузки
+    uint64_t at = 0;
+
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, 5000200, now, &at) == 0 && at == now + 200000u);
+    // прошедший срок — сейчас
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, 0, now, &at) == 0 && at == now);
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, 4999999, now, &at) == 0 && at == now);
+    // горизонт сутки включительно
+    uint64_t hz_ms = GW_SCHED_HORIZON_US / 1000u;
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, now / 1000u + hz_ms, now, &at) == 0 &&
+          at == now + GW_SCHED_HORIZON_US);
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, now / 1000u + hz_ms + 1, now, &at) < 0);
+    // переполнение мс -> мкс
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, UINT64_MAX, now, &at) < 0);
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_MONO, UINT64_MAX / 1000u, now, &at) < 0);
+    CHECK(gw_sched_deadline(7, 0, now, &at) < 0);
+
+    // unix время: срок через 500 мс по настенным часам — через 500 мс по монотонным
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t unix_ms = (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_UNIX, unix_ms + 500, now, &at) == 0);
+    CHECK(at > now + 490000u && at <= now + 500000u);
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_UNIX, unix_ms - 10000, now, &at) == 0 && at == now);
+    CHECK(gw_sched_deadline(GW_SCHED_CLOCK_UNIX, unix_ms + hz_ms + 1000, now, &at) < 0);
+}
+
+int main(void)
+{
+    test_order();
+    test_capacity();
+    test_wait();
+    test_deadline();
+    return test_result("test_sched");
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include "ecu/ecu_command.h"
+#include "ecu/ecu_limits.h"
+#include "ecu/ecu_proto.h"
+#include "ecu/ecu_slip.h"
+#include "gw/gw_uart.h"
+#include "test_util.h"
+
+// COMMAND узлу dst: command_id cmd, plen байт параметра со значением tag; CRC очереди UART не нужен
+static size_t command(uint8_t* f, uint8_t dst, uint16_t cmd, uint8_t tag, uint16_t plen, uint16_t flags)
+{
+    ecu_hdr_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ECU_MAGIC;
+    h.version = ECU_VERSION;
+    h.msg_type = ECU_MSG_COMMAND;
+    h.src = ECU_NODE_PC;
+    h.dst = dst;
+    h.flags = flags;
+    h.payload_len = (uint16_t)(sizeof(ecu_command_hdr_t) + plen);
+    ecu_command_hdr_t ch = { cmd, plen };
+    memcpy(f, &h, sizeof(h));
+    memcpy(f + sizeof(h), &ch, sizeof(ch));
+    memset(f + sizeof(h) + sizeof(ch), tag, plen);
+    size_t n = sizeof(h) + sizeof(ch) + plen;
+    f[n] = 0;
+    f[n + 1] = 0;
+    return n + 2;
+}
+
+static int send_cmd(gw_uart_t* u, uint8_t dst, uint16_t cmd, uint8_t tag, uint16_t plen, uint16_t flags)
+{
+    uint8_t f[ECU_MAX_FRAME_SIZE];
+    return gw_uart_send_slip(u, f, command(f, dst, cmd, tag, plen, flags));
+}
+
+// Записать n байт куска p так, как их получил бы узел; кадры — в out: (command_id << 8) | метка
+static void take(gw_uart_t* u, slip_rx_t* rx, const uint8_t* p, size_t n, int* out, int* k)
+{
+    for (size_t used = 0; used < n; used += rx->consumed) {
+        size_t flen = 0;
+        if (slip_rx_push(rx, p + used, n - used, &flen) == 1) {
+            const ecu_command_hdr_t* ch = (const ecu_command_hdr_t*)(rx->out + ECU_HEADER_SIZE);
+            out[(*k)++] = (ch->command_id << 8) | rx->out[ECU_HEADER_SIZE + sizeof(*ch)];
+        }
+    }
+    gw_uart_tx_advance(u, n);
+}
+
+// Записать всю очередь; возвращает число записанных байт
+static size_t drain(gw_uart_t* u, slip_rx_t* rx, int* out, int* k)
+{
+    size_t done = 0;
+    const uint8_t* p = NULL;
+    size_t chunk;
+    while ((chunk = gw_uart_tx_chunk(u, &p)) > 0) {
+        take(u, rx, p, chunk, out, k);
+        done += chunk;
+    }
+    return done;
+}
+
+#define C(cmd, tag) (((cmd) << 8) | (tag))
+
+static const gw_uart_lane_t* ctrl(const gw_uart_t* u)
+{
+    return &u->tx_lane[GW_UART_LANE_CTRL];
+}
+
+static size_t lane_bytes(const gw_uart_t* u, unsigned lane)
+{
+    const gw_uart_lane_t* l = &u->tx_lane[lane];
+    return (l->head + u->tx_cap - l->tail) % u->tx_cap;
+}
+
+static size_t frames(const gw_uart_t* u)
+{
+    return ctrl(u)->frm_head - ctrl(u)->frm_tail;
+}
+
+// Та же длина — на месте, другая — старая выбрасывается (DEAD), новая встаёт в конец
+static void test_replace(gw_uart_t* u, slip_rx_t* rx)
+{
+    int out[16];
+    int k = 0;
+    CHECK(send_cmd(u, 3, 0x10, 1, 4, 0) > 0);
+    CHECK(send_cmd(u, 3, 0x20, 1, 4, 0) > 0);
+    CHECK(send_cmd(u, 4, 0x10, 1, 4, 0) > 0);   // другой узел — не заменяет
+    CHECK(send_cmd(u, 3, 0x10, 2, 4, 0) > 0);
+    CHECK(frames(u) == 3 && ctrl(u)->dead == 0);
+    CHECK(gw_counter_get(&u->stats.lane[GW_UART_LANE_CTRL].conflated) == 1);
+
+    CHECK(send_cmd(u, 3, 0x20, 2, 9, 0) > 0);
+    CHECK(frames(u) == 4 && ctrl(u)->dead == 1);
+    // ACK_REQUIRED при conflate = noack не сливается
+    CHECK(send_cmd(u, 4, 0x10, 2, 4, ECU_F_ACK_REQUIRED) > 0);
+    CHECK(frames(u) == 5 && ctrl(u)->dead == 1);
+
+    size_t pending = gw_uart_tx_pending(u);
+    CHECK(drain(u, rx, out, &k) < pending);   // байты выброшенного не передаются
+    CHECK(k == 4 && out[0] == C(0x10, 2) && out[1] == C(0x10, 1) && out[2] == C(0x20, 2) &&
+          out[3] == C(0x10, 2));
+    CHECK(gw_uart_tx_pending(u) == 0 && frames(u) == 0 && ctrl(u)->dead == 0);
+    CHECK(gw_counter_get(&u->stats.lane[GW_UART_LANE_CTRL].conflated) == 2);
+}
+
+// Кадр в куске, отданном на запись (tx_out), и начатый кадр не заменяются
+static void test_in_flight(gw_uart_t* u, slip_rx_t* rx)
+{
+    int out[16];
+    int k = 0;
+    CHECK(send_cmd(u, 5, 0x30, 1, 4, 0) > 0);
+    CHECK(send_cmd(u, 5, 0x31, 1, 4, 0) > 0);
+    size_t first = ctrl(u)->frm[ctrl(u)->frm_tail % u->tx_frm_cap].len;
+
+    // кусок в полёте (io_uring) — первый кадр: его команда встаёт в конец, второй заменяется на месте
+    const uint8_t* p = NULL;
+    size_t chunk = gw_uart_tx_chunk(u, &p);
+    CHECK(chunk == first && u->tx_out == chunk);
+    CHECK(send_cmd(u, 5, 0x30, 2, 4, 0) > 0);
+    CHECK(send_cmd(u, 5, 0x31, 2, 4, 0) > 0);
+    CHECK(frames(u) == 3 && ctrl(u)->dead == 0);
+
+    // записан первый кадр, второй начат (sent > 0)
+    take(u, rx, p, chunk, out, &k);
+    chunk = gw_uart_tx_chunk(u, &p);
+    take(u, rx, p, 3, out, &k);
+    CHECK(ctrl(u)->sent == 3);
+    // заменяется последняя ждущая копия, не начатый кадр
+    CHECK(send_cmd(u, 5, 0x31, 3, 4, 0) > 0);
+    CHECK(frames(u) == 3 && ctrl(u)->dead == 0);
+    CHECK(send_cmd(u, 5, 0x31, 4, 7, 0) > 0);
+    CHECK(frames(u) == 4 && ctrl(u)->dead == 1);
+
+    // начатый кадр дописывается с того же байта, выброшенный пропускается
+    drain(u, rx, out, &k);
+    CHECK(k == 4 && out[0] == C(0x30, 1) && out[1] == C(0x31, 2) && out[2] == C(0x30, 2) &&
+          out[3] == C(0x31, 4));
+    CHECK(gw_uart_tx_pending(u) == 0 && ctrl(u)->dead == 0);
+}
+
+// Срочные кадры уходят одним куском, младшие полосы — по кадру: срочный, поставленный
+// между кусками, уходит раньше остатка полосы
+static void test_one_frame(gw_uart_t* u, slip_rx_t* rx)
+{
+    int out[16];
+    int k = 0;
+    for (uint16_t c = 0x40; c <= 0x42; c++) CHECK(send_cmd(u, 6, c, 1, 8, 0) > 0);
+    CHECK(send_cmd(u, 6, 0x50, 1, 8, ECU_F_URGENT) > 0);
+    CHECK(send_cmd(u, 6, 0x51, 1, 8, ECU_F_URGENT) > 0);
+    size_t urgent = gw_uart_tx_pending(u) - lane_bytes(u, GW_UART_LANE_CTRL);
+
+    const uint8_t* p = NULL;
+    size_t chunk = gw_uart_tx_chunk(u, &p);
+    CHECK(chunk == urgent && u->tx_cur == GW_UART_LANE_URGENT);
+    take(u, rx, p, chunk, out, &k);
+    size_t first = ctrl(u)->frm[ctrl(u)->frm_tail % u->tx_frm_cap].len;
+    chunk = gw_uart_tx_chunk(u, &p);
+    CHECK(chunk == first && u->tx_cur == GW_UART_LANE_CTRL);
+    take(u, rx, p, chunk, out, &k);
+
+    CHECK(send_cmd(u, 6, 0x52, 1, 8, ECU_F_URGENT) > 0);
+    drain(u, rx, out, &k);
+    CHECK(k == 6 && out[0] == C(0x50, 1) && out[1] == C(0x51, 1) && out[2] == C(0x40, 1) &&
+          out[3] == C(0x52, 1) && out[4] == C(0x41, 1) && out[5] == C(0x42, 1));
+}
+
+// Очередь драйвера не ниже бюджета: младшая полоса ждёт, срочная — нет. Очередь — по оценке,
+// TIOCOUTQ — сверка. Вместо порта — сокет (SIOCOUTQ == TIOCOUTQ: байты, ещё не прочитанные другой стороной)
+static void test_hold(gw_uart_t* u)
+{
+    int sv[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    int tty = dup(u->fd);
+    CHECK(tty >= 0 && dup2(sv[0], u->fd) == u->fd);
+    uint8_t buf[4096];
+
+    // кадры больше бюджета: после первого оценка не ниже бюджета
+    CHECK(send_cmd(u, 7, 0x60, 1, 100, 0) > 0);
+    CHECK(send_cmd(u, 7, 0x61, 1, 100, 0) > 0);
+    CHECK(gw_uart_handle_write(u) > 0);   // один кадр младшей полосы за вызов
+    CHECK(frames(u) == 1 && u->tx_hold_until == 0 && u->tx_drv_est >= u->tx_inflight);
+    CHECK(gw_uart_tx_hold_us(u, gw_clock_read_us()) == -1);
+
+    // оценку подтверждает драйвер (одна сверка): ждать
+    CHECK(gw_uart_handle_write(u) == 0 && frames(u) == 1);
+    CHECK(u->tx_drv_trusted && u->tx_drv_sync != 0);
+    long hold = gw_uart_tx_hold_us(u, gw_clock_read_us());
+    CHECK(hold > 0);
+
+    // срочный кадр не ждёт
+    CHECK(send_cmd(u, 7, 0x62, 1, 8, ECU_F_URGENT) > 0);
+    CHECK(gw_uart_tx_hold_us(u, gw_clock_read_us()) == -1);
+    CHECK(gw_uart_handle_write(u) > 0 && u->tx_lane[GW_UART_LANE_URGENT].frm_head == u->tx_lane[GW_UART_LANE_URGENT].frm_tail);
+    CHECK(frames(u) == 1 && gw_uart_tx_hold_us(u, gw_clock_read_us()) > 0);
+
+    // очередь ушла в линию (оценка — секунду назад), срок вышел: следующий кадр
+    CHECK(read(sv[1], buf, sizeof(buf)) > 0);
+    u->tx_hold_until = gw_clock_read_us();
+    u->tx_drv_t -= 1000000u;
+    CHECK(gw_uart_tx_hold_us(u, gw_clock_read_us()) == 0);
+    CHECK(gw_uart_handle_write(u) > 0 && frames(u) == 0 && gw_uart_tx_pending(u) == 0);
+    CHECK(u->tx_hold_until == 0);
+
+    // до следующей сверки — по оценке, без ioctl: драйвер (сокет прочитан) сказал бы, что очередь пуста
+    CHECK(read(sv[1], buf, sizeof(buf)) > 0);
+    uint64_t sync = u->tx_drv_sync;
+    CHECK(send_cmd(u, 7, 0x63, 1, 100, 0) > 0);
+    CHECK(gw_uart_handle_write(u) == 0 && frames(u) == 1 && u->tx_drv_sync == sync);
+
+    // сверка: у драйвера очереди нет (как у pty) — оценке не верить, кадр уходит
+    u->tx_hold_until = 0;
+    u->tx_drv_sync -= GW_UART_OUTQ_SYNC_US;
+    CHECK(gw_uart_handle_write(u) > 0 && frames(u) == 0);
+    CHECK(!u->tx_drv_trusted && u->tx_drv_sync != sync);
+
+    CHECK(dup2(tty, u->fd) == u->fd);
+    close(tty);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main(void)
+{
+    gw_uart_t u;
+    int m = test_pty_uart(&u, 4096);
+    CHECK(m >= 0);
+    u.conflate = GW_UART_CONFLATE_NOACK;
+
+    uint8_t buf[ECU_MAX_FRAME_SIZE];
+    slip_rx_t rx;
+    slip_rx_init(&rx, buf, sizeof(buf));
+    test_replace(&u, &rx);
+    test_in_flight(&u, &rx);
+    test_one_frame(&u, &rx);
+    test_hold(&u);
+
+    gw_uart_close(&u);
+    close(m);
+    return test_result("test_uart");
+}
@@ -0,0 +1,47 @@
+#pragma once
+// Общее для модульных тестов (tests/test_*.c): CHECK, итог и pty вместо порта
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gw/gw_uart.h"
+
+static int failed;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failed++;                                                        \
+        }                                                                    \
+    } while (0)
+
+// Итог теста для main: "test_X: OK" и 0, иначе число проваленных проверок и 1
+static inline int test_result(const char* name)
+{
+    if (failed) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, failed);
+        return 1;
+    }
+    printf("%s: OK\n", name);
+    return 0;
+}
+
+// UART на pty: gw_uart_open_ex(u, 115200, rx 4096, tx_queue) на ведомой стороне, байты очереди
+// копятся у ведущей (её никто не читает). Возвращает fd ведущей стороны (закрыть после
+// gw_uart_close), -1 = ошибка. Имена устройств — свои на каждый вызов (до 4 портов)
+static inline int test_pty_uart(gw_uart_t* u, size_t tx_queue)
+{
+    static char names[4][64];
+    static int n;
+    int m = posix_openpt(O_RDWR | O_NOCTTY);
+    char* dev = names[n++ % 4];
+    if (m < 0 || grantpt(m) != 0 || unlockpt(m) != 0 || ptsname_r(m, dev, sizeof(names[0])) != 0 ||
+        gw_uart_open_ex(u, dev, 115200, 4096, tx_queue) != 0) {
+        if (m >= 0) close(m);
+        return -1;
+    }
+    return m;
+}